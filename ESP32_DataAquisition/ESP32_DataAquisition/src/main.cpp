@@ -12,6 +12,28 @@
 #define TXD2 17   
 #define RXD2 16
 
+// RS-485 bus to the controller (its SensorBus.h): answer polls to
+// NODE_ADDRESS with every channel, in the order of lanes[] below. The
+// controller's "sensor_bus" config lists the lane ids in that order.
+// false: the old point-to-point "id,value" lines, 10 per second.
+#define USE_SENSOR_BUS false
+#define NODE_ADDRESS 1          // 1..247, unique on the bus
+#define BUS_DE_PIN 4            // Driver enable (DE and /RE tied)
+#define BUS_BAUD 115200
+#define BUS_SAMPLE_MS 20        // Channels re-read this often (the controller's SENSOR_BUS_NODE_SAMPLE_MS)
+
+#define BUS_SYNC0 0xA5
+#define BUS_SYNC1 0x5A
+#define BUS_POLL 1
+#define BUS_DATA 2
+#define BUS_PREEMPT 3           // DATA plus a u16 of calling channels
+
+// Emergency-vehicle detector contact, HIGH while it calls (-1 = none), for
+// the approach of lanes[PREEMPT_CHANNEL]. Sent as "PRE,<lane id>" lines, or
+// on the bus as PREEMPT replies.
+#define PREEMPT_PIN -1
+#define PREEMPT_CHANNEL 0
+
 struct LaneConfig {
   int laneID;      
   int analogPin;   
@@ -28,22 +50,127 @@ const LaneConfig lanes[] = {
 
 const int NUM_LANES = sizeof(lanes) / sizeof(lanes[0]);
 
+uint16_t readings[NUM_LANES];
+unsigned long lastSample = 0;
+uint8_t rxFrame[8];             // A poll: sync, sync, address, type, seq, len 0, crc
+int rxPos = 0;
+unsigned long pollsAnswered = 0;
+
+// CRC-16/CCITT-FALSE, as the controller checks it
+uint16_t crc16(const uint8_t *data, int len)
+{
+    uint16_t crc = 0xFFFF;
+    for (int i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+bool preemptCalling()
+{
+    return PREEMPT_PIN >= 0 && digitalRead(PREEMPT_PIN) == HIGH;
+}
+
+void sendReadings(uint8_t seq)
+{
+    uint8_t frame[6 + 1 + 2 * NUM_LANES + 2 + 2];
+    int len = 1 + 2 * NUM_LANES;
+    bool calling = preemptCalling();
+    frame[0] = BUS_SYNC0;
+    frame[1] = BUS_SYNC1;
+    frame[2] = NODE_ADDRESS;
+    frame[3] = calling ? BUS_PREEMPT : BUS_DATA;
+    frame[4] = seq;
+    frame[6] = NUM_LANES;
+    for (int i = 0; i < NUM_LANES; i++) {
+        frame[7 + 2 * i] = readings[i] & 0xFF;
+        frame[8 + 2 * i] = readings[i] >> 8;
+    }
+    if (calling) {
+        uint16_t calls = 1 << PREEMPT_CHANNEL;
+        frame[6 + len] = calls & 0xFF;
+        frame[7 + len] = calls >> 8;
+        len += 2;
+    }
+    frame[5] = len;
+    uint16_t crc = crc16(&frame[2], 4 + len);
+    frame[6 + len] = crc & 0xFF;
+    frame[7 + len] = crc >> 8;
+
+    digitalWrite(BUS_DE_PIN, HIGH);
+    Serial2.write(frame, 6 + len + 2);
+    Serial2.flush();
+    digitalWrite(BUS_DE_PIN, LOW);
+    pollsAnswered++;
+}
+
+// Collect one poll byte by byte; anything else on the bus (other nodes'
+// replies, polls for them) falls out at the address or length check.
+void busReceive(uint8_t b)
+{
+    if ((rxPos == 0 && b != BUS_SYNC0) || (rxPos == 1 && b != BUS_SYNC1) ||
+        (rxPos == 2 && b != NODE_ADDRESS) || (rxPos == 3 && b != BUS_POLL) || (rxPos == 5 && b != 0)) {
+        rxPos = (b == BUS_SYNC0) ? 1 : 0;
+        return;
+    }
+    rxFrame[rxPos++] = b;
+    if (rxPos < (int)sizeof(rxFrame))
+        return;
+    rxPos = 0;
+
+    uint16_t crc = rxFrame[6] | (rxFrame[7] << 8);
+    if (crc == crc16(&rxFrame[2], 4))
+        sendReadings(rxFrame[4]);
+}
+
+void busLoop()
+{
+    unsigned long now = millis();
+    if (now - lastSample >= BUS_SAMPLE_MS) {
+        lastSample = now;
+        for (int i = 0; i < NUM_LANES; i++)
+            readings[i] = analogRead(lanes[i].analogPin);
+    }
+
+    while (Serial2.available() > 0)
+        busReceive(Serial2.read());
+
+    static unsigned long lastReport = 0;
+    if (now - lastReport >= 10000) {
+        lastReport = now;
+        Serial.printf("[BUS] node %d: %lu polls answered\n", NODE_ADDRESS, pollsAnswered);
+    }
+}
+
 void setup()
 {
     Serial.begin(9600);                         
-    Serial2.begin(9600, SERIAL_8N1, RXD2, TXD2); 
+    Serial2.begin(USE_SENSOR_BUS ? BUS_BAUD : 9600, SERIAL_8N1, RXD2, TXD2); 
+    if (USE_SENSOR_BUS) {
+        pinMode(BUS_DE_PIN, OUTPUT);
+        digitalWrite(BUS_DE_PIN, LOW);
+    }
 
     analogReadResolution(10);
 
     for (int i = 0; i < NUM_LANES; i++) {
         pinMode(lanes[i].analogPin, INPUT);
     }
+    if (PREEMPT_PIN >= 0)
+        pinMode(PREEMPT_PIN, INPUT);
 
     Serial.println("Sender READY");
 }
 
 void loop()
 {
+    if (USE_SENSOR_BUS) {
+        busLoop();
+        return;
+    }
+
     String outputString = "";
     
     for (int i = 0; i < NUM_LANES; i++) {
@@ -57,6 +184,8 @@ void loop()
 
     // Send to RECEIVER
     Serial2.println(outputString);
+    if (preemptCalling())
+        Serial2.printf("PRE,%d\n", lanes[PREEMPT_CHANNEL].laneID);
 
     // Print for debugging
     Serial.print("[TX] ");
@@ -0,0 +1,193 @@
+// Checks of the controller itself (../src/TrafficController.cpp), run through
+// the host library on a four-leg junction with a crosswalk on every leg.
+//
+//   make test
+//
+// Walk after yellow: every crossing is pressed while any approach shows
+// yellow. No WALK may start before each conflicting vehicle movement that
+// ended has had its yellow and its red clearance toward the crossing
+// (intergreen_ms()), whichever phase the crossing rides along with.
+//
+// Unsafe phase: a configured phase with conflicting movements fails the load.
+// Ring rejects: ring/barrier layouts whose phases would run conflicting
+// movements fall back to the configured phases.
+//
+// Exits non-zero when a check fails.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "IntersectionGraph.h"
+#include "TrafficController.h"
+#include "urbanflow.h"
+
+// --- SIMULATION CONSTANTS ---
+static const uint32_t STEP_MS = 100;          // Finer than the 500 ms tick, so early WALKs show
+static const uint32_t DURATION_MS = 1800000;  // Half an hour of switching
+static const uint32_t YELLOW_DURATION_MS = 2000; // TrafficController.cpp
+static const uint16_t QUEUE = 12;             // Vehicles kept waiting on both approaches
+
+// Lanes 0, 2, 4, 6 inbound, 1, 3, 5, 7 exits, 8-11 crosswalks. Phases 0 and 1
+// (0 -> 1 and 6 -> 7) never conflict, so switching between them takes the
+// yellow alone, while the crosswalks that ride along with one of them need
+// the other's movement cleared for longer than that.
+static const char LAYOUT[] = R"({"name": "Crosswalks", "default_phase_duration_ms": 3000,
+  "lanes": [{"id": 0, "type": 0, "bearing": 0}, {"id": 1, "type": 1, "bearing": 270},
+            {"id": 2, "type": 0, "bearing": 270}, {"id": 3, "type": 1, "bearing": 180},
+            {"id": 4, "type": 0, "bearing": 180}, {"id": 5, "type": 1, "bearing": 90},
+            {"id": 6, "type": 0, "bearing": 90}, {"id": 7, "type": 1, "bearing": 0},
+            {"id": 100, "type": 2, "bearing": 0}, {"id": 101, "type": 2, "bearing": 90},
+            {"id": 102, "type": 2, "bearing": 180}, {"id": 103, "type": 2, "bearing": 270}],
+  "connections": [{"source_lane_idx": 0, "target_lane_idx": 1}, {"source_lane_idx": 0, "target_lane_idx": 3},
+                  {"source_lane_idx": 0, "target_lane_idx": 5}, {"source_lane_idx": 2, "target_lane_idx": 3},
+                  {"source_lane_idx": 2, "target_lane_idx": 5}, {"source_lane_idx": 2, "target_lane_idx": 7},
+                  {"source_lane_idx": 4, "target_lane_idx": 1}, {"source_lane_idx": 4, "target_lane_idx": 5},
+                  {"source_lane_idx": 4, "target_lane_idx": 7}, {"source_lane_idx": 6, "target_lane_idx": 1},
+                  {"source_lane_idx": 6, "target_lane_idx": 3}, {"source_lane_idx": 6, "target_lane_idx": 7}],
+  "phases": [{"active_connections_mask": 1}, {"active_connections_mask": 2048},
+             {"active_connections_mask": 56}, {"active_connections_mask": 448}]})";
+
+// --- HELPERS ---
+
+// Earliest a WALK on crosswalk lane_idx may start, given when each lane last turned yellow
+static uint32_t walk_allowed_ms(uint32_t lane_idx, const uint32_t *yellow_at, const bool *ended)
+{
+    uint32_t allowed = 0;
+    for (uint32_t p = 0; p < intr.connection_cnt; p++)
+    {
+        if (intr.connections[p].source_lane_idx != lane_idx)
+            continue;
+        for (uint32_t c = 0; c < intr.connection_cnt; c++)
+        {
+            uint32_t src = intr.connections[c].source_lane_idx;
+            if (intr.lanes[src].type != LANE_IN || !ended[src])
+                continue;
+            uint32_t needed = intergreen_ms(&intr, c, p, YELLOW_DURATION_MS);
+            if (needed && yellow_at[src] + needed > allowed)
+                allowed = yellow_at[src] + needed;
+        }
+    }
+    return allowed;
+}
+
+// Crossings pressed during every yellow; counts the WALKs and those that came early
+static bool check_walk_after_yellow()
+{
+    UrbanFlowBank *bank = urbanflow_bank_create(1);
+    if (!bank || urbanflow_load_json(bank, LAYOUT, sizeof(LAYOUT) - 1, URBANFLOW_ALGO_MAX_PRESSURE) != 0)
+    {
+        printf("%-24s layout did not load  FAILED\n", "walk after yellow");
+        urbanflow_bank_destroy(bank);
+        return false;
+    }
+    UrbanFlowInfo info;
+    urbanflow_info(bank, 0, &info);
+
+    uint16_t queues[URBANFLOW_MAX_LANES] = {0};
+    uint64_t crosswalks = 0;
+    for (uint32_t i = 0; i < info.lane_cnt; i++)
+    {
+        if (i == 0 || i == 6)
+            queues[i] = QUEUE;
+        if (i >= 8)
+            crosswalks |= (uint64_t)1 << i;
+    }
+
+    uint8_t last[URBANFLOW_MAX_LANES], lights[URBANFLOW_MAX_LANES];
+    uint32_t yellow_at[URBANFLOW_MAX_LANES] = {0};
+    bool ended[URBANFLOW_MAX_LANES] = {false};
+    urbanflow_step(bank, 0, 1, STEP_MS);
+    urbanflow_read_lights(bank, 0, 1, last, URBANFLOW_MAX_LANES);
+
+    uint32_t walks = 0, early = 0, worst_early_ms = 0;
+    bool yellow = false;
+    for (uint32_t now = 2 * STEP_MS; now <= DURATION_MS; now += STEP_MS)
+    {
+        uint64_t pressed = yellow ? crosswalks : 0;
+        urbanflow_push_sensors(bank, 0, 1, queues, URBANFLOW_MAX_LANES);
+        urbanflow_push_calls(bank, 0, 1, &pressed, NULL);
+        urbanflow_step(bank, 0, 1, STEP_MS);
+        urbanflow_read_lights(bank, 0, 1, lights, URBANFLOW_MAX_LANES);
+
+        yellow = false;
+        for (uint32_t i = 0; i < info.lane_cnt; i++)
+        {
+            if (lights[i] == URBANFLOW_LIGHT_YELLOW && last[i] != URBANFLOW_LIGHT_YELLOW)
+            {
+                yellow_at[i] = now;
+                ended[i] = true;
+            }
+            yellow |= lights[i] == URBANFLOW_LIGHT_YELLOW;
+
+            if (i >= 8 && lights[i] == URBANFLOW_LIGHT_GREEN && last[i] != URBANFLOW_LIGHT_GREEN)
+            {
+                uint32_t allowed = walk_allowed_ms(i, yellow_at, ended);
+                walks++;
+                if (now < allowed)
+                {
+                    early++;
+                    if (allowed - now > worst_early_ms)
+                        worst_early_ms = allowed - now;
+                }
+            }
+        }
+        memcpy(last, lights, sizeof(last));
+    }
+    urbanflow_bank_destroy(bank);
+
+    bool ok = walks > 0 && early == 0;
+    printf("%-24s %lu WALKs, %lu early, worst by %lu ms  %s\n", "walk after yellow", (unsigned long)walks,
+           (unsigned long)early, (unsigned long)worst_early_ms, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// Loads a variant of LAYOUT; returns the status, with the phase count in *phase_cnt
+static int32_t load_variant(const std::string &layout, uint32_t *phase_cnt)
+{
+    UrbanFlowBank *bank = urbanflow_bank_create(1);
+    int32_t status = bank ? urbanflow_load_json(bank, layout.c_str(), layout.size(), URBANFLOW_ALGO_MAX_PRESSURE) : -1;
+    UrbanFlowInfo info = {};
+    if (status == 0)
+        urbanflow_info(bank, 0, &info);
+    urbanflow_bank_destroy(bank);
+    *phase_cnt = info.phase_cnt;
+    return status;
+}
+
+// A ring layout must never bring phases the safety monitor would trip on: a
+// movement whose lanes conflict among themselves is rejected, and the
+// junction runs its configured phases as the board does
+static bool check_ring_rejects(const char *name, const char *ring_barrier)
+{
+    uint32_t phase_cnt = 0;
+    std::string layout(LAYOUT, sizeof(LAYOUT) - 2);
+    int32_t status = load_variant(layout + ", \"ring_barrier\": " + ring_barrier + "}", &phase_cnt);
+    bool ok = status == URBANFLOW_OK && phase_cnt == 4;
+    printf("%-24s load %ld, %lu phases  %s\n", name, (long)status, (unsigned long)phase_cnt, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// A configured phase with conflicting movements fails the whole load
+static bool check_unsafe_phase_refused()
+{
+    uint32_t phase_cnt = 0;
+    // Phase 0 gains connection 2 -> 3, which crosses its 0 -> 1
+    std::string layout(LAYOUT), phase0 = "\"active_connections_mask\": 1}";
+    layout.replace(layout.find(phase0), phase0.size(), "\"active_connections_mask\": 9}");
+    int32_t status = load_variant(layout, &phase_cnt);
+    bool ok = status == URBANFLOW_ERR_CONFIG;
+    printf("%-24s load %ld  %s\n", "unsafe phase", (long)status, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+    ok &= check_walk_after_yellow();
+    // Lanes 0 and 2 cross each other
+    ok &= check_unsafe_phase_refused();
+    ok &= check_ring_rejects("ring conflicting lanes", R"({"barriers": [[[{"lanes": [0, 2]}]], [[4]], [[6]]]})");
+    printf(ok ? "OK\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+// Checks of the intergreens drawn movement paths give (../src/IntersectionGraph.cpp)
+// against the chord fallback the same lanes get without paths. The ending
+// movement is measured to where it leaves the conflict zone and the starting
+// one to where it enters it, so a drawn path never clears sooner than its
+// chord would, and a straight path drawn on the chord only adds the band of
+// path_clearance_m around the crossing point.
+//
+//   make test
+//
+// Exits non-zero when a drawn intergreen falls short of the chord one, or
+// overshoots it where the case bounds that.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "Arduino.h"
+#include "IntersectionGraph.h"
+
+// --- SIMULATION CONSTANTS ---
+static const uint32_t YELLOW_MS = 2000; // TrafficController.cpp's YELLOW_DURATION_MS
+static const uint32_t VIA_MAX = 2;
+
+typedef struct {
+    const char *name;
+    uint16_t bearing[4];      // Movement A source, target, then movement B
+    float via_b[2 * VIA_MAX]; // B's path between its rim points; A's is its chord
+    uint32_t via_cnt;
+    int32_t max_over_ms;      // Most the drawn intergreen may exceed the chord one, -1 = unbounded
+} Case;
+
+static uint8_t storage[intersection_storage_bytes(4, 2, 1)] __attribute__((aligned(8)));
+
+// --- HELPERS ---
+
+// Where the chord fallback puts the lane at this bearing
+static void rim_point(uint16_t bearing, float *xy)
+{
+    xy[0] = INTERGREEN_JUNCTION_RADIUS_M * sinf(bearing * (float)M_PI / 180.0f);
+    xy[1] = INTERGREEN_JUNCTION_RADIUS_M * cosf(bearing * (float)M_PI / 180.0f);
+}
+
+// Movements A (connection 0) and B (connection 1), with their paths when drawn
+static void build(Intersection *intr, const Case *c, bool drawn)
+{
+    IntersectionArena arena;
+    arena_init(&arena, storage, sizeof(storage));
+    intersection_init(intr, 10000, &arena, 4, 2, 1);
+
+    LaneHardware hw = {-1, -1, -1, -1};
+    for (uint32_t m = 0; m < 2; m++)
+    {
+        uint32_t in = add_lane(intr, 2 * m, LANE_IN, hw, c->bearing[2 * m]);
+        uint32_t out = add_lane(intr, 2 * m + 1, LANE_OUT, hw, c->bearing[2 * m + 1]);
+        add_connection(intr, in, out);
+    }
+    if (drawn)
+    {
+        float a[4], b[2 * (VIA_MAX + 2)];
+        rim_point(c->bearing[0], a);
+        rim_point(c->bearing[1], a + 2);
+        rim_point(c->bearing[2], b);
+        memcpy(b + 2, c->via_b, 2 * c->via_cnt * sizeof(float));
+        rim_point(c->bearing[3], b + 2 * (c->via_cnt + 1));
+        set_connection_path(intr, 0, a, 2);
+        set_connection_path(intr, 1, b, c->via_cnt + 2);
+    }
+    compute_conflicts_on_device(intr);
+    compute_clearances_on_device(intr);
+}
+
+static bool run(const Case *c)
+{
+    Intersection chord, drawn;
+    uint32_t ms[2][2]; // [chord, drawn][A ending, B ending]
+    build(&chord, c, false);
+    ms[0][0] = intergreen_ms(&chord, 0, 1, YELLOW_MS);
+    ms[0][1] = intergreen_ms(&chord, 1, 0, YELLOW_MS);
+    build(&drawn, c, true);
+    ms[1][0] = intergreen_ms(&drawn, 0, 1, YELLOW_MS);
+    ms[1][1] = intergreen_ms(&drawn, 1, 0, YELLOW_MS);
+
+    bool ok = true;
+    static const char *const dirs[] = {"A -> B", "B -> A"};
+    for (int d = 0; d < 2; d++)
+    {
+        int32_t over = (int32_t)ms[1][d] - (int32_t)ms[0][d];
+        bool fine = ms[0][d] > 0 && over >= 0 && (c->max_over_ms < 0 || over <= c->max_over_ms);
+        printf("%-10s %-7s %9lu %9lu  %s\n", c->name, dirs[d], (unsigned long)ms[0][d], (unsigned long)ms[1][d],
+               fine ? "ok" : "WRONG");
+        ok &= fine;
+    }
+    return ok;
+}
+
+int main()
+{
+    static const Case cases[] = {
+        // South to north across west to east, each drawn as its chord
+        {"crossing", {180, 0, 270, 90}, {}, 0, 500},
+        // B comes up beside A, 1 m to its west, for most of the junction
+        // before cutting across it: the zone runs the length of the merge
+        {"merge", {180, 0, 200, 10}, {-1.0f, -4.0f, -1.0f, 4.0f}, 2, -1},
+    };
+
+    printf("%-10s %-7s %9s %9s\n", "case", "ending", "chord ms", "drawn ms");
+    bool ok = true;
+    for (const Case &c : cases)
+        ok &= run(&c);
+    printf(ok ? "OK\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+// Globals of the host platform shim (platform/), and its UDP sockets, for every host program
+#include <stdlib.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "Arduino.h"
+#include "LittleFS.h"
+#include "WiFiUdp.h"
+#include "Wire.h"
+#include "esp_heap_caps.h"
+#include "freertos/semphr.h"
+#include "soc/gpio_reg.h"
+
+HostSerial Serial;
+EspClass ESP;
+TwoWire Wire;
+LittleFSClass LittleFS;
+unsigned long host_millis = 0;
+HostHeap *host_heap = NULL;
+uint32_t host_gpio_regs[6];
+uint8_t host_mutex;
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    if ((caps & MALLOC_CAP_SPIRAM) || !host_heap || host_heap->block_cnt == HOST_HEAP_MAX_BLOCKS)
+        return NULL;
+
+    void *block = malloc(size);
+    if (block)
+        host_heap->blocks[host_heap->block_cnt++] = block;
+    return block;
+}
+
+void host_heap_free(HostHeap *heap)
+{
+    for (uint32_t i = 0; i < heap->block_cnt; i++)
+        free(heap->blocks[i]);
+    heap->block_cnt = 0;
+}
+
+// --- NETWORK ---
+
+bool IPAddress::fromString(const char *host)
+{
+    struct in_addr a;
+    if (!host || inet_pton(AF_INET, host, &a) != 1)
+        return false;
+    addr = a.s_addr;
+    return true;
+}
+
+uint8_t WiFiUDP::begin(uint16_t port)
+{
+    stop();
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return 0;
+
+    struct sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&local, sizeof(local)) != 0 || fcntl(fd, F_SETFL, O_NONBLOCK) != 0)
+    {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+void WiFiUDP::stop()
+{
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port)
+{
+    tx_ip = ip;
+    tx_port = port;
+    tx_len = 0;
+    return fd >= 0;
+}
+
+size_t WiFiUDP::write(const uint8_t *buf, size_t len)
+{
+    if (len > DATAGRAM_MAX - tx_len)
+        len = DATAGRAM_MAX - tx_len;
+    memcpy(&tx[tx_len], buf, len);
+    tx_len += len;
+    return len;
+}
+
+int WiFiUDP::endPacket()
+{
+    struct sockaddr_in to = {};
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = tx_ip.addr;
+    to.sin_port = htons(tx_port);
+    return fd >= 0 && sendto(fd, tx, tx_len, 0, (struct sockaddr *)&to, sizeof(to)) == (ssize_t)tx_len;
+}
+
+// Size of the next datagram, even when it was longer than rx, as on the board
+int WiFiUDP::parsePacket()
+{
+    if (fd < 0)
+        return 0;
+    struct sockaddr_in from = {};
+    socklen_t from_len = sizeof(from);
+    ssize_t size = recvfrom(fd, rx, sizeof(rx), MSG_TRUNC, (struct sockaddr *)&from, &from_len);
+    if (size <= 0)
+        return 0;
+    rx_len = (size_t)size < sizeof(rx) ? (size_t)size : sizeof(rx);
+    remote_ip.addr = from.sin_addr.s_addr;
+    remote_port = ntohs(from.sin_port);
+    return (int)size;
+}
+
+int WiFiUDP::read(uint8_t *buf, size_t len)
+{
+    if (len > rx_len)
+        len = rx_len;
+    memcpy(buf, rx, len);
+    rx_len = 0;
+    return (int)len;
+}
@@ -0,0 +1,91 @@
+#ifndef URBANFLOW_HOST_ARDUINO_H
+#define URBANFLOW_HOST_ARDUINO_H
+
+// Just enough of the Arduino core for the firmware sources to build on a
+// host (see host/Makefile). Console output is dropped: a simulator stepping
+// thousands of junctions has no use for the per-decision log. millis() is
+// the clock of the junction being stepped, which the host sets before each
+// pass; micros() is real time, for the timings the sources measure. Inputs
+// read LOW and interrupts never fire: a host feeds the controller through its
+// API instead.
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define RISING 1
+#define digitalPinToInterrupt(pin) (pin)
+
+class HostSerial
+{
+public:
+    template <typename... Args>
+    int printf(const char *, Args...) { return 0; }
+    template <typename T>
+    size_t print(T) { return 0; }
+    template <typename T>
+    size_t println(T) { return 0; }
+    size_t println() { return 0; }
+    size_t write(uint8_t) { return 1; }
+    size_t write(const uint8_t *, size_t len) { return len; }
+    int availableForWrite() { return INT_MAX; }
+    int available() { return 0; }
+    int read() { return -1; }
+};
+
+class EspClass
+{
+public:
+    // A 240 MHz cycle counter on the host's clock
+    uint32_t getCycleCount()
+    {
+        using namespace std::chrono;
+        return (uint32_t)(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count() * 240 / 1000);
+    }
+    uint32_t getCpuFreqMHz() { return 240; }
+};
+
+extern HostSerial Serial;
+extern EspClass ESP;
+extern unsigned long host_millis; // Clock of the junction being stepped
+
+inline unsigned long micros()
+{
+    using namespace std::chrono;
+    return (unsigned long)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline unsigned long millis()
+{
+    return host_millis;
+}
+
+inline void delay(unsigned long) {}
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return LOW; }
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline void attachInterrupt(int, void (*)(), int) {}
+inline void attachInterruptArg(int, void (*)(void *), void *, int) {}
+
+inline long random(long low, long high)
+{
+    return high > low ? low + rand() % (high - low) : low;
+}
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef URBANFLOW_HOST_CONFIG_H
+#define URBANFLOW_HOST_CONFIG_H
+
+// The board's CONFIG.h, with what the host changes. The board values are
+// kept under BOARD_* names so the rest of the file stays as it is.
+//   - No simulation: the host's simulator feeds the queues (urbanflow_push_sensors()).
+//   - The algorithm is per junction, set by the host before each pass.
+//   - Lamps go to the mock backend, read back with light_output_read().
+
+#define SIMULATION_MODE BOARD_SIMULATION_MODE
+#define CONTROL_ALGORITHM BOARD_CONTROL_ALGORITHM
+#define LIGHT_OUTPUT_BACKEND BOARD_LIGHT_OUTPUT_BACKEND
+#include_next "CONFIG.h"
+#undef SIMULATION_MODE
+#undef CONTROL_ALGORITHM
+#undef LIGHT_OUTPUT_BACKEND
+
+const bool SIMULATION_MODE = false;
+extern ControlAlgorithm CONTROL_ALGORITHM;
+const LightOutputKind LIGHT_OUTPUT_BACKEND = LIGHT_OUTPUT_MOCK;
+
+#endif
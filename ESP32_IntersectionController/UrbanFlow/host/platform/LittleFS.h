@@ -0,0 +1,26 @@
+#ifndef URBANFLOW_HOST_LITTLEFS_H
+#define URBANFLOW_HOST_LITTLEFS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// No flash: mounting fails, so a flight recording stays in its RAM ring
+class File
+{
+public:
+    explicit operator bool() const { return false; }
+    size_t write(const uint8_t *, size_t) { return 0; }
+    int read(uint8_t *, size_t) { return -1; }
+    void close() {}
+};
+
+class LittleFSClass
+{
+public:
+    bool begin(bool) { return false; }
+    File open(const char *, const char *) { return File(); }
+};
+
+extern LittleFSClass LittleFS;
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef URBANFLOW_HOST_PREFERENCES_H
+#define URBANFLOW_HOST_PREFERENCES_H
+
+#include <stddef.h>
+
+// No NVS: every junction starts from the defaults and keeps nothing
+class Preferences
+{
+public:
+    bool begin(const char *, bool) { return false; }
+    void end() {}
+    size_t putBytes(const char *, const void *, size_t) { return 0; }
+    size_t getBytes(const char *, void *, size_t) { return 0; }
+};
+
+#endif
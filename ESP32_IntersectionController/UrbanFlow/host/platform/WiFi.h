@@ -0,0 +1,16 @@
+#ifndef URBANFLOW_HOST_WIFI_H
+#define URBANFLOW_HOST_WIFI_H
+
+#include <stdint.h>
+
+// IPv4 only: green-wave peers are dotted quads in the config
+class IPAddress
+{
+public:
+    bool fromString(const char *host);
+    bool operator==(const IPAddress &other) const { return addr == other.addr; }
+
+    uint32_t addr; // Network byte order
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef URBANFLOW_HOST_WIFIUDP_H
+#define URBANFLOW_HOST_WIFIUDP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "WiFi.h"
+
+// A non-blocking UDP socket (platform.cpp), so green-wave peers on this host
+// talk over real datagrams. The object lives in the junction's state: the
+// socket follows its junction through the swaps, and the one datagram
+// parsePacket() took is read from rx.
+class WiFiUDP
+{
+public:
+    uint8_t begin(uint16_t port);
+    void stop();
+    int beginPacket(IPAddress ip, uint16_t port);
+    size_t write(const uint8_t *buf, size_t len);
+    int endPacket();
+    int parsePacket();
+    int read(uint8_t *buf, size_t len);
+    IPAddress remoteIP() { return remote_ip; }
+    uint16_t remotePort() { return remote_port; }
+
+private:
+    static const size_t DATAGRAM_MAX = 512; // Green-wave messages stay under 300 bytes
+
+    int fd = -1;
+    uint8_t tx[DATAGRAM_MAX] = {};
+    size_t tx_len = 0;
+    IPAddress tx_ip = {};
+    uint16_t tx_port = 0;
+    uint8_t rx[DATAGRAM_MAX] = {};
+    size_t rx_len = 0;
+    IPAddress remote_ip = {};
+    uint16_t remote_port = 0;
+};
+
+#endif
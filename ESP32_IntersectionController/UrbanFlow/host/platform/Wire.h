@@ -0,0 +1,18 @@
+#ifndef URBANFLOW_HOST_WIRE_H
+#define URBANFLOW_HOST_WIRE_H
+
+#include <stdint.h>
+
+// No I2C bus: the expander backend fails to start
+class TwoWire
+{
+public:
+    bool begin(int, int, uint32_t) { return false; }
+    void beginTransmission(int) {}
+    size_t write(uint8_t) { return 0; }
+    uint8_t endTransmission() { return 4; } // "Other error"
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef URBANFLOW_HOST_SPI_MASTER_H
+#define URBANFLOW_HOST_SPI_MASTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// No SPI bus: the shift register backend fails to start
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define SPI_DMA_CH_AUTO 3
+
+typedef enum {
+    SPI1_HOST,
+    SPI2_HOST,
+    SPI3_HOST
+} spi_host_device_t;
+
+typedef struct {
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int max_transfer_sz;
+} spi_bus_config_t;
+
+typedef struct {
+    int clock_speed_hz;
+    uint8_t mode;
+    int spics_io_num;
+    int queue_size;
+} spi_device_interface_config_t;
+
+typedef struct spi_device_t *spi_device_handle_t;
+
+typedef struct {
+    size_t length;
+    const void *tx_buffer;
+    void *rx_buffer;
+} spi_transaction_t;
+
+inline esp_err_t spi_bus_initialize(spi_host_device_t, const spi_bus_config_t *, int)
+{
+    return ESP_FAIL;
+}
+
+inline esp_err_t spi_bus_add_device(spi_host_device_t, const spi_device_interface_config_t *, spi_device_handle_t *)
+{
+    return ESP_FAIL;
+}
+
+inline esp_err_t spi_device_transmit(spi_device_handle_t, spi_transaction_t *)
+{
+    return ESP_FAIL;
+}
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef URBANFLOW_HOST_ESP_ATTR_H
+#define URBANFLOW_HOST_ESP_ATTR_H
+
+// Placement attributes mean nothing off the chip
+#define IRAM_ATTR
+#define DMA_ATTR
+
+#endif
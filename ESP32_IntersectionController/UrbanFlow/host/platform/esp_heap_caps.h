@@ -0,0 +1,30 @@
+#ifndef URBANFLOW_HOST_ESP_HEAP_CAPS_H
+#define URBANFLOW_HOST_ESP_HEAP_CAPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// There is no PSRAM: those requests fail, as on a board without it. Everything
+// else is charged to host_heap, so the host frees what a junction's
+// controller allocated along with the junction.
+
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+#define HOST_HEAP_MAX_BLOCKS 4
+
+typedef struct {
+    void *blocks[HOST_HEAP_MAX_BLOCKS];
+    uint32_t block_cnt;
+} HostHeap;
+
+extern HostHeap *host_heap; // NULL = nobody to charge, so nothing is handed out
+
+void *heap_caps_malloc(size_t size, uint32_t caps);
+
+// Frees everything charged to heap
+void host_heap_free(HostHeap *heap);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef URBANFLOW_HOST_FREERTOS_H
+#define URBANFLOW_HOST_FREERTOS_H
+
+#include <stdint.h>
+
+// One thread and no scheduler. Tasks are accepted but never run: the safety
+// monitor's check is there to call directly (safety_check_outputs()).
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef void *TaskHandle_t;
+
+#define pdPASS 1
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xFFFFFFFF
+#define configMAX_PRIORITIES 25
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+extern unsigned long host_millis; // Arduino.h
+
+inline TickType_t xTaskGetTickCount()
+{
+    return (TickType_t)host_millis;
+}
+
+inline void vTaskDelay(TickType_t) {}
+inline void vTaskDelayUntil(TickType_t *, TickType_t) {}
+
+inline BaseType_t xTaskCreatePinnedToCore(void (*)(void *), const char *, uint32_t, void *, int, TaskHandle_t *handle,
+                                          int)
+{
+    if (handle)
+        *handle = NULL;
+    return pdPASS;
+}
+
+#endif
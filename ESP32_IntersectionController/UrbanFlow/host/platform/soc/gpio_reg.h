@@ -0,0 +1,19 @@
+#ifndef URBANFLOW_HOST_GPIO_REG_H
+#define URBANFLOW_HOST_GPIO_REG_H
+
+#include <stdint.h>
+
+// The output registers, as plain words
+#define GPIO_OUT_REG 0
+#define GPIO_OUT_W1TS_REG 1
+#define GPIO_OUT_W1TC_REG 2
+#define GPIO_OUT1_REG 3
+#define GPIO_OUT1_W1TS_REG 4
+#define GPIO_OUT1_W1TC_REG 5
+
+extern uint32_t host_gpio_regs[6];
+
+#define REG_READ(reg) (host_gpio_regs[(reg)])
+#define REG_WRITE(reg, value) (host_gpio_regs[(reg)] = (value))
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef URBANFLOW_HOST_SOC_H
+#define URBANFLOW_HOST_SOC_H
+
+// Register addresses come from gpio_reg.h on the host
+
+#endif
@@ -0,0 +1,189 @@
+// Execution time of the safety monitor's check (../src/SafetyMonitor.cpp) on
+// the largest junction the tables hold: MAX_LANE_CNT lanes, half of them
+// inbound with lamps, MAX_CONNECTION_CNT connections, every pair from
+// different lanes in conflict. safety_check_outputs() walks all of them whatever the
+// frame, so all-red, all-green and random frames must cost the same; the
+// worst single call is what a monitor sample adds on top of reading the
+// outputs.
+//
+//   make wcet
+//
+// Host time, not the board's: the same run on the ESP32-S3 is the
+// "[SAFETY] Monitor WCET" console line. The host OS preempts the odd call,
+// which lands in the maximum; the 99.99th percentile is the check itself.
+// Exits non-zero when a frame is checked wrongly or that percentile exceeds
+// one monitor period.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "Arduino.h"
+#include "IntersectionGraph.h"
+#include "LightOutput.h"
+#include "SafetyMonitor.h"
+
+// --- SIMULATION CONSTANTS ---
+static const uint32_t IN_LANE_CNT = MAX_LANE_CNT / 2; // The rest are exits, without lamps
+static const uint32_t CALLS = 200000;                 // Per frame kind
+static const uint32_t BATCH = 1000;                   // Calls per clock read, for the mean
+
+static uint8_t storage[intersection_storage_bytes(MAX_LANE_CNT, MAX_CONNECTION_CNT, 1)] __attribute__((aligned(8)));
+static volatile uint64_t sink; // Keeps the checks from being optimised away
+
+typedef enum {
+    FRAME_ALL_RED,
+    FRAME_ALL_GREEN,
+    FRAME_RANDOM
+} FrameKind;
+
+typedef struct {
+    double mean_ns;
+    uint64_t p9999_ns;
+    uint64_t worst_ns;
+    bool ok;
+} Timing;
+
+// --- HELPERS ---
+
+static uint64_t now_ns()
+{
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Inbound lane k feeds exits k and k + 1, so every lane has two movements
+static void build(Intersection *intr)
+{
+    IntersectionArena arena;
+    arena_init(&arena, storage, sizeof(storage));
+    intersection_init(intr, 10000, &arena, MAX_LANE_CNT, MAX_CONNECTION_CNT, 1);
+
+    for (uint32_t k = 0; k < IN_LANE_CNT; k++)
+    {
+        // Red, yellow and green on channels 3k..3k+2, as urbanflow.cpp wires them
+        LaneHardware hw = {-1, (int16_t)(3 * k + 2), (int16_t)(3 * k + 1), (int16_t)(3 * k)};
+        add_lane(intr, k, LANE_IN, hw, (uint16_t)(k * 360 / IN_LANE_CNT));
+    }
+    for (uint32_t k = 0; k < IN_LANE_CNT; k++)
+    {
+        LaneHardware hw = {-1, -1, -1, -1};
+        add_lane(intr, IN_LANE_CNT + k, LANE_OUT, hw, (uint16_t)(k * 360 / IN_LANE_CNT));
+    }
+    for (uint32_t k = 0; k < IN_LANE_CNT; k++)
+    {
+        add_connection(intr, k, IN_LANE_CNT + k);
+        add_connection(intr, k, IN_LANE_CNT + (k + 1) % IN_LANE_CNT);
+    }
+    for (uint32_t a = 0; a < intr->connection_cnt; a++)
+    {
+        for (uint32_t b = a + 1; b < intr->connection_cnt; b++)
+        {
+            if (intr->connections[a].source_lane_idx == intr->connections[b].source_lane_idx)
+                continue;
+            intr->conflict_masks[a] |= ((uint64_t)1 << b);
+            intr->conflict_masks[b] |= ((uint64_t)1 << a);
+        }
+    }
+}
+
+// Greens on the lanes in green_lanes; reds on the rest
+static void make_frame(LightFrame *frame, uint64_t green_lanes)
+{
+    memset(frame, 0, sizeof(LightFrame));
+    for (uint32_t k = 0; k < IN_LANE_CNT; k++)
+    {
+        uint32_t channel = (green_lanes >> k) & 1 ? 3 * k + 2 : 3 * k;
+        frame->bits[channel >> 3] |= (uint8_t)(1 << (channel & 7));
+    }
+}
+
+static uint64_t lane_mask(FrameKind kind)
+{
+    if (kind == FRAME_ALL_RED)
+        return 0;
+    if (kind == FRAME_ALL_GREEN)
+        return ((uint64_t)1 << IN_LANE_CNT) - 1;
+    return ((uint64_t)rand() << 16 ^ (uint64_t)rand()) & (((uint64_t)1 << IN_LANE_CNT) - 1);
+}
+
+// Two lanes or more showing green always conflict here
+static bool expect_violation(uint64_t green_lanes)
+{
+    return (green_lanes & (green_lanes - 1)) != 0;
+}
+
+static Timing measure(const SafetyTables *tables, FrameKind kind)
+{
+    static LightFrame frames[BATCH];
+    static uint64_t lanes[BATCH];
+    Timing t = {0, 0, 0, true};
+    std::vector<uint64_t> calls_ns;
+    calls_ns.reserve(CALLS);
+
+    uint64_t total_ns = 0;
+    for (uint32_t done = 0; done < CALLS; done += BATCH)
+    {
+        for (uint32_t i = 0; i < BATCH; i++)
+        {
+            lanes[i] = lane_mask(kind);
+            make_frame(&frames[i], lanes[i]);
+        }
+
+        // Every call on its own clock for the worst case
+        for (uint32_t i = 0; i < BATCH; i++)
+        {
+            uint64_t start = now_ns();
+            uint64_t violations = safety_check_outputs(tables, &frames[i]);
+            calls_ns.push_back(now_ns() - start);
+            t.ok &= (violations != 0) == expect_violation(lanes[i]);
+            sink = violations;
+        }
+
+        // The whole batch on one for the mean, without the clock's own cost
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < BATCH; i++)
+            sink = safety_check_outputs(tables, &frames[i]);
+        total_ns += now_ns() - start;
+    }
+    t.mean_ns = (double)total_ns / CALLS;
+
+    std::sort(calls_ns.begin(), calls_ns.end());
+    t.p9999_ns = calls_ns[(size_t)(calls_ns.size() * 0.9999)];
+    t.worst_ns = calls_ns.back();
+    return t;
+}
+
+int main()
+{
+    static Intersection intr;
+    build(&intr);
+    static SafetyTables tables;
+    safety_build_tables(&tables, &intr);
+
+    static const char *const names[] = {"all red", "all green", "random"};
+    printf("%lu lanes, %lu connections, %lu calls per frame kind\n", (unsigned long)intr.lane_cnt,
+           (unsigned long)intr.connection_cnt, (unsigned long)CALLS);
+    printf("%-10s %10s %10s %10s\n", "frame", "mean ns", "p99.99 ns", "worst ns");
+
+    bool ok = true;
+    uint64_t p9999_ns = 0, worst_ns = 0;
+    for (int kind = FRAME_ALL_RED; kind <= FRAME_RANDOM; kind++)
+    {
+        Timing t = measure(&tables, (FrameKind)kind);
+        printf("%-10s %10.1f %10llu %10llu  %s\n", names[kind], t.mean_ns, (unsigned long long)t.p9999_ns,
+               (unsigned long long)t.worst_ns, t.ok ? "ok" : "WRONG");
+        ok &= t.ok;
+        p9999_ns = std::max(p9999_ns, t.p9999_ns);
+        worst_ns = std::max(worst_ns, t.worst_ns);
+    }
+
+    printf("p99.99 %llu ns, worst %llu ns, against a %d ms monitor period\n", (unsigned long long)p9999_ns,
+           (unsigned long long)worst_ns, SAFETY_MONITOR_PERIOD_MS);
+    ok &= p9999_ns < (uint64_t)SAFETY_MONITOR_PERIOD_MS * 1000000;
+    printf(ok ? "OK\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,325 @@
+// Loopback of the RS-485 sensor bus: the controller's scheduler
+// (../src/SensorBus.cpp) against simulated acquisition nodes on one
+// half-duplex pair, in virtual time at the bus baud rate. Every byte takes
+// its ten bit times on the wire; bytes from two talkers overlapping on the
+// wire arrive garbled. The nodes behave like ESP32_DataAquisition in bus mode:
+// channels re-read every SENSOR_BUS_NODE_SAMPLE_MS, each node on its own
+// phase, and a poll answered after a turnaround.
+//
+// Each reading carries its lane and sample time (lane << 10 | ms % 1024), so
+// the run checks that every value reached the right lane and how old the
+// controller's copy ever got, against sensor_bus_latency_bound_us(). The
+// first node's emergency detector on its second channel calls for a while,
+// answering its polls with PREEMPT; the call must reach that lane alone,
+// within the same bound.
+//
+//   make loopback && build/sensor_bus_loopback
+//
+// Exits non-zero when a value or a call lands on the wrong lane, or a clean
+// bus misses a poll, lets a reading age past the bound or is that late with
+// the call.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "Arduino.h"
+#include "SensorBus.h"
+
+// --- SIMULATION CONSTANTS ---
+static const uint32_t STEP_US = 50;
+static const uint32_t SERVICE_US = 500;    // Controller loop() period around sensor_bus_service()
+static const uint32_t NODE_TURNAROUND_US = 300;
+static const uint32_t RUN_MS = 60000;
+static const uint32_t CALL_FROM_MS = 20000; // Node 0's emergency detector, channel CALL_CHANNEL
+static const uint32_t CALL_TO_MS = 30000;
+static const uint32_t CALL_CHANNEL = 1;
+
+typedef struct {
+    int sender;                  // -1 = controller, else node index
+    uint64_t start_us;
+    std::vector<uint8_t> bytes;
+    uint32_t delivered;
+} Transmission;
+
+typedef struct {
+    uint8_t address;
+    uint32_t channel_cnt;
+    uint8_t lane_idx[SENSOR_BUS_MAX_CHANNELS];
+    uint32_t turnaround_us;
+    bool dead;
+
+    SensorBusParser parser;
+    uint16_t readings[SENSOR_BUS_MAX_CHANNELS];
+    uint64_t reply_at;           // 0 = nothing pending
+    uint8_t reply_seq;
+    uint16_t calls;              // Channels whose emergency detector calls
+} SimNode;
+
+typedef struct {
+    const char *name;
+    uint32_t node_cnt;
+    uint32_t channels;
+    double byte_error_rate;
+    int dead_node;               // -1 = none
+    int slow_node;               // Answers after twice the slot, -1 = none
+    bool clean;                  // Held to the zero-miss and latency checks
+} Scenario;
+
+// --- HELPERS ---
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static double rng_uniform()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (rng_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static bool wire_busy(const std::vector<Transmission> &wire, size_t self, uint64_t from_us, uint64_t to_us,
+                      uint32_t byte_us)
+{
+    for (size_t t = 0; t < wire.size(); t++)
+    {
+        if (t == self)
+            continue;
+        uint64_t start = wire[t].start_us;
+        uint64_t end = start + wire[t].bytes.size() * byte_us;
+        if (start < to_us && from_us < end)
+            return true;
+    }
+    return false;
+}
+
+static bool run(const Scenario *sc)
+{
+    SensorBus bus;
+    sensor_bus_init(&bus, SENSOR_BUS_BAUD);
+    uint32_t byte_us = 10 * 1000000 / bus.baud;
+
+    std::vector<SimNode> nodes(sc->node_cnt);
+    uint32_t lane = 0;
+    for (uint32_t n = 0; n < sc->node_cnt; n++)
+    {
+        SimNode *node = &nodes[n];
+        memset(node, 0, sizeof(*node));
+        node->address = 1 + n;
+        node->channel_cnt = sc->channels;
+        for (uint32_t k = 0; k < sc->channels; k++)
+            node->lane_idx[k] = lane++;
+        node->dead = (int)n == sc->dead_node;
+        sensor_bus_add_node(&bus, node->address, node->lane_idx, node->channel_cnt);
+        node->turnaround_us = (int)n == sc->slow_node ? 2 * bus.nodes[n].slot_us : NODE_TURNAROUND_US;
+    }
+    uint32_t lane_cnt = lane;
+
+    uint16_t values[MAX_LANE_CNT] = {0};
+    uint64_t sample_ms[MAX_LANE_CNT] = {0}; // Of the controller's copy
+    bool seen[MAX_LANE_CNT] = {false};
+    uint64_t max_age_us = 0;
+    uint32_t frames = 0;
+    uint64_t readings = 0;
+    uint32_t misrouted = 0;
+    uint32_t collisions = 0;
+    uint64_t busy_us = 0;
+    int64_t call_us = -1; // Detector to controller, first call
+
+    std::vector<Transmission> wire;
+    uint8_t frame[SENSOR_BUS_MAX_FRAME];
+    uint64_t run_us = (uint64_t)RUN_MS * 1000;
+
+    for (uint64_t now = STEP_US; now <= run_us; now += STEP_US)
+    {
+        uint64_t now_ms = now / 1000;
+
+        // Nodes sample their channels, from the first step on
+        for (uint32_t n = 0; n < nodes.size(); n++)
+        {
+            SimNode &node = nodes[n];
+            bool calling = n == 0 && now_ms >= CALL_FROM_MS && now_ms < CALL_TO_MS;
+            node.calls = calling ? (uint16_t)(1 << CALL_CHANNEL) : 0;
+            if ((now + n * 7 * STEP_US) % (SENSOR_BUS_NODE_SAMPLE_MS * 1000) == STEP_US || now == STEP_US)
+            {
+                for (uint32_t k = 0; k < node.channel_cnt; k++)
+                    node.readings[k] = (uint16_t)(node.lane_idx[k] << 10 | (now_ms % 1024));
+            }
+        }
+
+        // Bytes whose last bit has arrived reach every other station
+        for (size_t t = 0; t < wire.size(); t++)
+        {
+            Transmission *tx = &wire[t];
+            while (tx->delivered < tx->bytes.size() && tx->start_us + (tx->delivered + 1) * byte_us <= now)
+            {
+                uint64_t from = tx->start_us + tx->delivered * byte_us;
+                uint8_t b = tx->bytes[tx->delivered++];
+                if (wire_busy(wire, t, from, from + byte_us, byte_us))
+                {
+                    b ^= 0x5A;
+                    collisions++;
+                }
+                if (rng_uniform() < sc->byte_error_rate)
+                    b ^= (uint8_t)(1 << (int)(rng_uniform() * 8));
+
+                if (tx->sender >= 0)
+                    sensor_bus_receive(&bus, &b, 1, now);
+                for (uint32_t n = 0; n < nodes.size(); n++)
+                {
+                    SimNode *node = &nodes[n];
+                    SensorBusFrame f;
+                    if ((int)n == tx->sender || node->dead || !sensor_bus_parse(&node->parser, b, &f))
+                        continue;
+                    if (f.type == SENSOR_BUS_POLL && f.address == node->address)
+                    {
+                        node->reply_at = now + node->turnaround_us;
+                        node->reply_seq = f.seq;
+                    }
+                }
+            }
+        }
+        for (size_t t = 0; t < wire.size();)
+        {
+            // Kept until nothing can overlap it any more
+            if (wire[t].delivered == wire[t].bytes.size() &&
+                wire[t].start_us + (wire[t].bytes.size() + SENSOR_BUS_MAX_FRAME) * byte_us < now)
+                wire.erase(wire.begin() + t);
+            else
+                t++;
+        }
+
+        // Replies due go on the wire, whether or not it is free
+        for (uint32_t n = 0; n < nodes.size(); n++)
+        {
+            SimNode *node = &nodes[n];
+            if (node->reply_at == 0 || node->reply_at > now)
+                continue;
+            node->reply_at = 0;
+            uint8_t payload[SENSOR_BUS_MAX_PAYLOAD];
+            payload[0] = node->channel_cnt;
+            for (uint32_t k = 0; k < node->channel_cnt; k++)
+            {
+                payload[1 + 2 * k] = node->readings[k] & 0xFF;
+                payload[2 + 2 * k] = node->readings[k] >> 8;
+            }
+            uint8_t len = 1 + 2 * node->channel_cnt;
+            uint8_t type = SENSOR_BUS_DATA;
+            if (node->calls)
+            {
+                payload[len++] = node->calls & 0xFF;
+                payload[len++] = node->calls >> 8;
+                type = SENSOR_BUS_PREEMPT;
+            }
+            Transmission tx = {(int)n, now, {}, 0};
+            tx.bytes.assign(frame, frame + sensor_bus_encode(frame, node->address, type, node->reply_seq, payload, len));
+            busy_us += tx.bytes.size() * byte_us;
+            wire.push_back(tx);
+        }
+
+        // The controller's loop
+        if (now % SERVICE_US == 0)
+        {
+            uint32_t len = sensor_bus_poll(&bus, now, frame);
+            if (len)
+            {
+                Transmission tx = {-1, now, std::vector<uint8_t>(frame, frame + len), 0};
+                busy_us += len * byte_us;
+                wire.push_back(tx);
+            }
+
+            uint64_t called = sensor_bus_take_preemption(&bus);
+            if (called & ~(1ULL << nodes[0].lane_idx[CALL_CHANNEL]))
+                misrouted++;
+            if (called && call_us < 0)
+                call_us = (int64_t)(now - (uint64_t)CALL_FROM_MS * 1000);
+
+            uint64_t reported;
+            if (sensor_bus_take_frame(&bus, values, &reported))
+            {
+                frames++;
+                for (uint32_t i = 0; i < lane_cnt; i++)
+                {
+                    if (!((reported >> i) & 1))
+                        continue;
+                    readings++;
+                    if ((values[i] >> 10) != i)
+                    {
+                        misrouted++;
+                        continue;
+                    }
+                    uint64_t age_ms = (now_ms - (values[i] & 0x3FF) + 1024) % 1024;
+                    sample_ms[i] = now_ms - age_ms;
+                    seen[i] = true;
+                }
+            }
+        }
+
+        // How old the controller's copy is, for lanes on nodes that never missed
+        if (now % 1000 == 0 && now_ms > 1000)
+        {
+            for (uint32_t n = 0; n < nodes.size(); n++)
+            {
+                if (bus.nodes[n].missed)
+                    continue;
+                for (uint32_t k = 0; k < nodes[n].channel_cnt; k++)
+                {
+                    uint32_t i = nodes[n].lane_idx[k];
+                    if (seen[i] && (now_ms - sample_ms[i]) * 1000 > max_age_us)
+                        max_age_us = (now_ms - sample_ms[i]) * 1000;
+                }
+            }
+        }
+    }
+
+    uint32_t polls = 0, replies = 0, missed = 0, crc_errors = 0, offline = 0;
+    for (uint32_t n = 0; n < bus.node_cnt; n++)
+    {
+        polls += bus.nodes[n].polls;
+        replies += bus.nodes[n].replies;
+        missed += bus.nodes[n].missed;
+        crc_errors += bus.nodes[n].crc_errors;
+        offline += bus.nodes[n].offline;
+    }
+    uint32_t bound_us = sensor_bus_latency_bound_us(&bus);
+
+    printf("%-10s %5lu %6lu %8.1f %8.1f %10.0f %6.1f%% %8.1f %8.1f %8.1f %7lu %7lu %5lu %6lu %7lu %6lu %5lu %8lu\n",
+           sc->name, (unsigned long)sc->node_cnt, (unsigned long)lane_cnt, bus.max_cycle_us / 1000.0,
+           frames * 1000.0 / RUN_MS, readings * 1000.0 / RUN_MS, 100.0 * busy_us / run_us, max_age_us / 1000.0,
+           call_us / 1000.0, bound_us / 1000.0, (unsigned long)polls, (unsigned long)replies, (unsigned long)missed,
+           (unsigned long)crc_errors, (unsigned long)bus.stray_frames, (unsigned long)collisions, (unsigned long)offline,
+           (unsigned long)misrouted);
+
+    bool ok = misrouted == 0;
+    if (sc->clean && (missed > 0 || max_age_us > bound_us || call_us < 0 || call_us > bound_us))
+        ok = false;
+    return ok;
+}
+
+int main()
+{
+    static const Scenario scenarios[] = {
+        {"clean", 1, 4, 0.0, -1, -1, true},
+        {"clean", 2, 4, 0.0, -1, -1, true},
+        {"clean", 4, 4, 0.0, -1, -1, true},
+        {"clean", 8, 4, 0.0, -1, -1, true},
+        {"clean", 16, 4, 0.0, -1, -1, true},
+        {"clean", 4, 16, 0.0, -1, -1, true},
+        {"noise", 8, 8, 1e-3, -1, -1, false},
+        {"dead", 8, 8, 0.0, 3, -1, false},
+        {"slow", 8, 8, 0.0, -1, 5, false},
+        {"all", 8, 8, 1e-3, 3, 5, false},
+    };
+
+    printf("%lu baud, %lu ms cycle, %lu s per run\n", (unsigned long)SENSOR_BUS_BAUD,
+           (unsigned long)SENSOR_BUS_CYCLE_MS, (unsigned long)(RUN_MS / 1000));
+    printf("%-10s %5s %6s %8s %8s %10s %7s %8s %8s %8s %7s %7s %5s %6s %7s %6s %5s %8s\n", "scenario", "nodes", "lanes",
+           "cycle_ms", "frames/s", "readings/s", "busy", "age_ms", "call_ms", "bound_ms", "polls", "replies", "miss", "crc",
+           "stray", "coll", "offl", "misroute");
+
+    bool ok = true;
+    for (const Scenario &sc : scenarios)
+        ok &= run(&sc);
+    printf(ok ? "OK\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,1221 @@
+#include "urbanflow.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "CONFIG.h"
+#include "Actuation.h"
+#include "FlightRecorder.h"
+#include "GreenWave.h"
+#include "IntersectionGraph.h"
+#include "LightOutput.h"
+#include "PolicyNet.h"
+#include "QueueEstimator.h"
+#include "RingBarrier.h"
+#include "Spillback.h"
+#include "TrafficController.h"
+#include "esp_heap_caps.h"
+
+// --- Configuration & Constants ---
+static const uint32_t DEFAULT_PHASE_DURATION_MS = 3000; // Layouts without default_phase_duration_ms
+
+static_assert((int)URBANFLOW_STATE_GREEN == STATE_GREEN_RUNNING && (int)URBANFLOW_STATE_INTERGREEN == STATE_YELLOW_TRANSITION &&
+                  (int)URBANFLOW_STATE_PEDESTRIAN == STATE_PEDESTRIAN_RED &&
+                  (int)URBANFLOW_STATE_PREEMPT_CLEARANCE == STATE_PREEMPT_CLEARANCE &&
+                  (int)URBANFLOW_STATE_PREEMPT_HOLD == STATE_PREEMPT_HOLD,
+              "UrbanFlowState mirrors ControllerState");
+
+// --- STATE ---
+// The firmware modules' file-scope variables, gathered into one section by
+// the Makefile. Exactly one junction's copy is in there at a time.
+extern "C" uint8_t __start_urbanflow_state[];
+extern "C" uint8_t __stop_urbanflow_state[];
+
+static size_t state_bytes()
+{
+    return (size_t)(__stop_urbanflow_state - __start_urbanflow_state);
+}
+
+ControlAlgorithm CONTROL_ALGORITHM = ALGO_MAX_PRESSURE; // platform/CONFIG.h: the running junction's
+
+typedef struct {
+    uint8_t *state;   // Its urbanflow_state, while another junction is in
+    uint8_t *storage; // Intersection arena
+    HostHeap heap;    // What its controller allocated (the flight recorder ring)
+    Intersection layout; // Copy of intr after loading; the arrays are in storage
+    uint8_t algorithm;
+    bool rings;       // Phases from a "ring_barrier" block, which the binary image can't carry
+    uint32_t preempt_bound_ms;
+    unsigned long now;
+
+    // Config beyond the graph, for urbanflow_save_binary()
+    uint16_t exit_storage[MAX_LANE_CNT];
+    uint32_t gap_ms[MAX_PHASE_CNT];
+    uint32_t max_green_ms[MAX_PHASE_CNT];
+
+    uint16_t queues[MAX_LANE_CNT]; // Last pushed; the estimator gets the differences as counts
+
+    // Outputs after the last pass, so reads need no switch
+    uint8_t phase;
+    uint8_t pending;
+    uint8_t controller_state;
+    LightFrame lights;
+    uint32_t preempt_worst_ms;
+    LookaheadStats lookahead;
+    GreenWaveStats wave;
+} HostJunction;
+
+struct UrbanFlowBank
+{
+    HostJunction *junctions;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+static uint8_t *pristine_state;  // urbanflow_state as the library was loaded
+static HostJunction *resident;   // Junction whose state is in urbanflow_state
+
+// --- JSON ---
+// Small DOM reader for the layout documents, so the library needs nothing
+// beyond the firmware sources. Numbers keep their exact unsigned value as
+// well, since phase masks use all 64 bits.
+
+struct JsonValue
+{
+    enum Kind
+    {
+        JSON_NULL,
+        JSON_BOOL,
+        JSON_NUMBER,
+        JSON_STRING,
+        JSON_ARRAY,
+        JSON_OBJECT
+    } kind = JSON_NULL;
+    double number = 0;
+    uint64_t integer = 0;
+    std::string text;
+    std::vector<JsonValue> items;
+    std::vector<std::string> keys; // JSON_OBJECT: keys[i] names items[i]
+
+    const JsonValue *get(const char *key) const
+    {
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            if (keys[i] == key)
+                return &items[i];
+        }
+        return NULL;
+    }
+
+    double num(const char *key, double fallback) const
+    {
+        const JsonValue *v = get(key);
+        return v && v->kind == JSON_NUMBER ? v->number : fallback;
+    }
+
+    uint64_t u64(const char *key) const
+    {
+        const JsonValue *v = get(key);
+        return v && v->kind == JSON_NUMBER ? v->integer : 0;
+    }
+
+    const JsonValue *array(const char *key) const
+    {
+        const JsonValue *v = get(key);
+        return v && v->kind == JSON_ARRAY ? v : NULL;
+    }
+};
+
+class JsonReader
+{
+public:
+    JsonReader(const char *text, size_t len) : p(text), end(text + len) {}
+
+    bool parse(JsonValue *out)
+    {
+        if (!value(out, 0))
+            return false;
+        skip_space();
+        return p == end;
+    }
+
+private:
+    static const int MAX_DEPTH = 32;
+    const char *p;
+    const char *end;
+
+    void skip_space()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            p++;
+    }
+
+    bool literal(const char *word)
+    {
+        size_t n = strlen(word);
+        if ((size_t)(end - p) < n || strncmp(p, word, n) != 0)
+            return false;
+        p += n;
+        return true;
+    }
+
+    bool string(std::string *out)
+    {
+        p++; // Opening quote
+        while (p < end && *p != '"')
+        {
+            if (*p != '\\')
+            {
+                out->push_back(*p++);
+                continue;
+            }
+            if (++p >= end)
+                return false;
+            switch (*p)
+            {
+            case 'n':
+                out->push_back('\n');
+                break;
+            case 't':
+                out->push_back('\t');
+                break;
+            case 'r':
+                out->push_back('\r');
+                break;
+            case 'b':
+                out->push_back('\b');
+                break;
+            case 'f':
+                out->push_back('\f');
+                break;
+            case 'u': // Names only; the controller never reads the text
+                if (end - p < 5)
+                    return false;
+                out->push_back('?');
+                p += 4;
+                break;
+            default:
+                out->push_back(*p);
+            }
+            p++;
+        }
+        if (p >= end)
+            return false;
+        p++;
+        return true;
+    }
+
+    bool number(JsonValue *out)
+    {
+        const char *start = p;
+        bool plain = true; // No sign, fraction or exponent
+        while (p < end && (isdigit((unsigned char)*p) || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E'))
+        {
+            if (!isdigit((unsigned char)*p))
+                plain = false;
+            p++;
+        }
+        std::string token(start, p - start);
+        char *stop = NULL;
+        out->kind = JsonValue::JSON_NUMBER;
+        out->number = strtod(token.c_str(), &stop);
+        if (token.empty() || *stop != '\0')
+            return false;
+        out->integer = plain ? strtoull(token.c_str(), NULL, 10) : (out->number > 0 ? (uint64_t)out->number : 0);
+        return true;
+    }
+
+    bool value(JsonValue *out, int depth)
+    {
+        skip_space();
+        if (p >= end || depth > MAX_DEPTH)
+            return false;
+
+        switch (*p)
+        {
+        case '{':
+        case '[':
+        {
+            bool object = *p == '{';
+            char close = object ? '}' : ']';
+            out->kind = object ? JsonValue::JSON_OBJECT : JsonValue::JSON_ARRAY;
+            p++;
+            skip_space();
+            if (p < end && *p == close)
+            {
+                p++;
+                return true;
+            }
+            for (;;)
+            {
+                if (object)
+                {
+                    skip_space();
+                    out->keys.emplace_back();
+                    if (p >= end || *p != '"' || !string(&out->keys.back()))
+                        return false;
+                    skip_space();
+                    if (p >= end || *p != ':')
+                        return false;
+                    p++;
+                }
+                out->items.emplace_back();
+                if (!value(&out->items.back(), depth + 1))
+                    return false;
+                skip_space();
+                if (p < end && *p == ',')
+                {
+                    p++;
+                    continue;
+                }
+                if (p < end && *p == close)
+                {
+                    p++;
+                    return true;
+                }
+                return false;
+            }
+        }
+        case '"':
+            out->kind = JsonValue::JSON_STRING;
+            return string(&out->text);
+        case 't':
+            out->kind = JsonValue::JSON_BOOL;
+            out->number = 1;
+            return literal("true");
+        case 'f':
+            out->kind = JsonValue::JSON_BOOL;
+            return literal("false");
+        case 'n':
+            return literal("null");
+        default:
+            return number(out);
+        }
+    }
+};
+
+
+// --- JUNCTIONS ---
+
+// Makes j the junction the firmware runs. Its state is only swapped in when
+// another junction's is there, so stepping one junction copies nothing.
+static void enter(HostJunction *j)
+{
+    if (resident != j)
+    {
+        if (resident)
+            memcpy(resident->state, __start_urbanflow_state, state_bytes());
+        memcpy(__start_urbanflow_state, j->state, state_bytes());
+        resident = j;
+    }
+    host_millis = j->now;
+    host_heap = &j->heap;
+    CONTROL_ALGORITHM = (ControlAlgorithm)j->algorithm;
+}
+
+static void junction_free(HostJunction *j)
+{
+    // Closes its green-wave socket, if it opened one
+    if (j->state)
+    {
+        enter(j);
+        green_wave_reset();
+    }
+    if (resident == j)
+        resident = NULL;
+    host_heap_free(&j->heap);
+    free(j->state);
+    free(j->storage);
+    memset(j, 0, sizeof(*j));
+}
+
+// A fresh controller for j, entered, with intr in an arena sized exactly to
+// the junction, as parseConfig() does on the board
+static bool junction_alloc(HostJunction *j, uint32_t lane_cnt, uint32_t connection_cap, uint32_t phase_cap,
+                           uint32_t default_duration_ms, int32_t algorithm)
+{
+    memset(j, 0, sizeof(*j));
+    j->algorithm = (uint8_t)algorithm;
+    j->state = (uint8_t *)malloc(state_bytes() ? state_bytes() : 1);
+    if (!j->state)
+        return false;
+    memcpy(j->state, pristine_state, state_bytes());
+    enter(j);
+
+    if (lane_cnt > MAX_LANE_CNT || connection_cap > MAX_CONNECTION_CNT || phase_cap > MAX_PHASE_CNT)
+        return false;
+    size_t storage_bytes = intersection_storage_bytes(lane_cnt, connection_cap, phase_cap);
+    j->storage = (uint8_t *)malloc(storage_bytes);
+    if (!j->storage)
+        return false;
+
+    IntersectionArena arena;
+    arena_init(&arena, j->storage, storage_bytes);
+    return intersection_init(&intr, default_duration_ms, &arena, lane_cnt, connection_cap, phase_cap);
+}
+
+// Lamps on the mock backend: red, yellow, green of lane slot i on channels 3i..3i+2
+static LaneHardware lane_hardware(uint32_t lane_idx, LaneType type)
+{
+    LaneHardware hw = {-1, -1, -1, -1};
+    if (type != LANE_OUT)
+    {
+        hw.red_pin = (int16_t)(3 * lane_idx);
+        hw.yellow_pin = (int16_t)(3 * lane_idx + 1);
+        hw.green_pin = (int16_t)(3 * lane_idx + 2);
+    }
+    return hw;
+}
+
+static void capture_outputs(HostJunction *j)
+{
+    j->phase = (uint8_t)current_phase_idx;
+    bool heading = current_state == STATE_YELLOW_TRANSITION || current_state == STATE_PEDESTRIAN_RED;
+    j->pending = (uint8_t)(heading ? next_pending_phase_idx : current_phase_idx);
+    j->controller_state = (uint8_t)current_state;
+    light_output_read(&j->lights);
+    j->preempt_worst_ms = preempt_max_latency_ms;
+    j->lookahead = lookahead_stats;
+    j->wave = *green_wave_stats();
+}
+
+// The finished graph goes live: controller_setup(), then queues from the
+// simulator's counts on every inbound lane. A phase with conflicting
+// movements fails the load, as parseConfig() fails it on the board.
+static int32_t junction_start(HostJunction *j)
+{
+    if (intr.phase_cnt == 0)
+        return URBANFLOW_ERR_CONFIG;
+    for (uint32_t p = 0; p < intr.phase_cnt; p++)
+    {
+        if (!is_phase_safe(&intr, intr.phases[p].active_connections_mask))
+            return URBANFLOW_ERR_CONFIG;
+    }
+
+    for (uint32_t i = 0; i < intr.lane_cnt; i++)
+        j->exit_storage[i] = spillback_storage(i);
+
+    controller_setup();
+    for (uint32_t i = 0; i < intr.lane_cnt; i++)
+    {
+        if (intr.lanes[i].type == LANE_IN)
+            queue_estimator_attach(&queue_estimator, i, QUEUE_SOURCE_ARRIVALS | QUEUE_SOURCE_DEPARTURES);
+    }
+
+    j->layout = intr;
+    j->preempt_bound_ms = preempt_latency_bound_ms;
+    capture_outputs(j);
+    return URBANFLOW_OK;
+}
+
+// --- LOADING ---
+
+static void store_path(uint32_t conn_idx, const JsonValue *points)
+{
+    if (!points || points->kind != JsonValue::JSON_ARRAY || points->items.size() < 2 ||
+        points->items.size() > PATH_MAX_POINTS)
+        return;
+
+    float xy[2 * PATH_MAX_POINTS];
+    for (size_t i = 0; i < points->items.size(); i++)
+    {
+        const JsonValue &point = points->items[i];
+        if (point.kind != JsonValue::JSON_ARRAY || point.items.size() != 2)
+            return;
+        xy[2 * i] = (float)point.items[0].number;
+        xy[2 * i + 1] = (float)point.items[1].number;
+    }
+    set_connection_path(&intr, conn_idx, xy, points->items.size());
+}
+
+// Same derivation as parsePathGeometry() in main.cpp
+static void parse_path_geometry(const JsonValue *lanes, const JsonValue *connections)
+{
+    for (uint32_t i = 0; i < intr.connection_cnt; i++)
+    {
+        const Connection *conn = &intr.connections[i];
+        const JsonValue *cfg = i < connections->items.size() ? &connections->items[i] : NULL;
+        const JsonValue *arc = cfg ? cfg->get("arc") : NULL;
+
+        if (cfg && cfg->array("path"))
+        {
+            store_path(i, cfg->array("path"));
+        }
+        else if (arc && arc->kind == JsonValue::JSON_OBJECT)
+        {
+            set_connection_arc(&intr, i, arc->num("cx", 0), arc->num("cy", 0), arc->num("r", 0), arc->num("from", 0),
+                               arc->num("to", 0));
+        }
+        else
+        {
+            const JsonValue *src = lanes->items[conn->source_lane_idx].array("path");
+            const JsonValue *tgt = lanes->items[conn->target_lane_idx].array("path");
+            if (conn->source_lane_idx == conn->target_lane_idx)
+            {
+                store_path(i, src);
+            }
+            else if (src && tgt && src->items.size() >= 2 && tgt->items.size() >= 2)
+            {
+                JsonValue line;
+                line.kind = JsonValue::JSON_ARRAY;
+                line.items.push_back(src->items.back());
+                line.items.push_back(tgt->items.front());
+                store_path(i, &line);
+            }
+        }
+    }
+}
+
+// Same layouts as parseRingBarrier() in main.cpp
+static bool parse_ring_barrier(const JsonValue *rb)
+{
+    if (rb->kind == JsonValue::JSON_BOOL)
+        return rb->number != 0 && ring_barrier_build_auto(&intr);
+
+    const JsonValue *barriers = rb->array("barriers");
+    if (!barriers)
+        return false;
+    for (uint32_t b = 0; b < barriers->items.size(); b++)
+    {
+        const JsonValue &rings = barriers->items[b];
+        for (uint32_t r = 0; r < rings.items.size(); r++)
+        {
+            for (const JsonValue &mv : rings.items[r].items)
+            {
+                uint32_t idx[MAX_LANE_CNT];
+                uint32_t cnt = 0;
+                const JsonValue *ids = mv.array("lanes");
+                if (!ids)
+                {
+                    idx[cnt++] = find_lane_index_by_id(&intr, (uint32_t)mv.number);
+                }
+                else
+                {
+                    for (const JsonValue &id : ids->items)
+                    {
+                        if (cnt < MAX_LANE_CNT)
+                            idx[cnt++] = find_lane_index_by_id(&intr, (uint32_t)id.number);
+                    }
+                }
+
+                if (ring_barrier_add_movement(&intr, idx, cnt, r, b, (uint32_t)mv.num("max_green_ms", 0)) < 0)
+                    return false;
+            }
+        }
+    }
+    return ring_barrier_movement_cnt() > 0;
+}
+
+// Same shape rules as parsePolicy() in main.cpp; a policy that does not fit
+// the junction is dropped, as on the board
+static void parse_policy(const JsonValue *p)
+{
+    policy_reset(&policy);
+
+    const JsonValue *w1 = p->array("w1");
+    const JsonValue *b1 = p->array("b1");
+    const JsonValue *w2 = p->array("w2");
+    const JsonValue *b2 = p->array("b2");
+    if (!w1 || !b1 || !w2 || !b2)
+        return;
+
+    size_t input_cnt = w1->items.empty() ? 0 : w1->items[0].items.size();
+    if (w1->items.size() > POLICY_MAX_HIDDEN || input_cnt > POLICY_MAX_INPUTS || w2->items.size() > MAX_PHASE_CNT ||
+        b1->items.size() != w1->items.size() || b2->items.size() != w2->items.size())
+        return;
+
+    policy.hidden_cnt = w1->items.size();
+    policy.output_cnt = w2->items.size();
+    policy.input_cnt = input_cnt;
+    policy.queue_shift = (uint8_t)p->num("queue_shift", 0);
+    policy.hidden_mult = (int32_t)p->num("hidden_mult", 1);
+    policy.hidden_shift = (uint8_t)p->num("hidden_shift", 8);
+
+    bool ok = true;
+
+    for (uint32_t j = 0; ok && j < policy.hidden_cnt; j++)
+    {
+        const JsonValue &row = w1->items[j];
+        ok = row.items.size() == policy.input_cnt;
+        for (uint32_t i = 0; ok && i < policy.input_cnt; i++)
+            policy.w1[j][i] = (int8_t)row.items[i].number;
+        policy.b1[j] = (int32_t)b1->items[j].number;
+    }
+    for (uint32_t k = 0; ok && k < policy.output_cnt; k++)
+    {
+        const JsonValue &row = w2->items[k];
+        ok = row.items.size() == policy.hidden_cnt;
+        for (uint32_t j = 0; ok && j < policy.hidden_cnt; j++)
+            policy.w2[k][j] = (int8_t)row.items[j].number;
+        policy.b2[k] = (int32_t)b2->items[k].number;
+    }
+
+    if (!ok || !policy_validate(&policy, &intr))
+        policy_reset(&policy);
+}
+
+// Same as parseGreenWave() in main.cpp: peers, and the links from their
+// outbound lanes to ours. Peers and links that do not fit are skipped.
+static void parse_green_wave(const JsonValue *gw, uint16_t *port, uint32_t *node_id)
+{
+    *port = (uint16_t)gw->num("port", GREEN_WAVE_PORT);
+    *node_id = (uint32_t)gw->num("node_id", 0);
+
+    const JsonValue *peers = gw->array("peers");
+    if (!peers)
+        return;
+    for (const JsonValue &p : peers->items)
+    {
+        const JsonValue *host = p.get("host");
+        int peer = host && host->kind == JsonValue::JSON_STRING
+                       ? green_wave_add_peer(host->text.c_str(), (uint16_t)p.num("port", GREEN_WAVE_PORT))
+                       : -1;
+        const JsonValue *links = p.array("links");
+        if (peer < 0 || !links)
+            continue;
+        for (const JsonValue &link : links->items)
+        {
+            uint32_t lane_idx = find_lane_index_by_id(&intr, (uint32_t)link.num("lane_id", 0));
+            if (lane_idx < intr.lane_cnt && intr.lanes[lane_idx].type == LANE_IN)
+                green_wave_add_link(lane_idx, peer, (uint32_t)link.num("peer_lane_id", 0),
+                                    (uint32_t)link.num("travel_ms", 0));
+        }
+    }
+}
+
+// One layout object, built in parseConfig()'s order. A "green_wave" block
+// opens the junction's UDP socket once it has loaded, as the board does
+// once WiFi is up; peers on this host are junctions of the same or another
+// process.
+static int32_t load_layout(HostJunction *j, const JsonValue *doc, int32_t algorithm)
+{
+    const JsonValue *lanes = doc->array("lanes");
+    const JsonValue *connections = doc->array("connections");
+    const JsonValue *phases = doc->array("phases");
+    if (doc->kind != JsonValue::JSON_OBJECT || !lanes || !connections || !phases)
+        return URBANFLOW_ERR_PARSE;
+
+    uint32_t crosswalk_cnt = 0;
+    for (const JsonValue &l : lanes->items)
+    {
+        if ((int)l.num("type", LANE_IN) == LANE_CROSSWALK)
+            crosswalk_cnt++;
+    }
+
+    // The ring model generates its own phases, one per ring combination
+    const JsonValue *rb = doc->get("ring_barrier");
+    uint32_t phase_cap = rb && phases->items.size() < MAX_PHASE_CNT ? MAX_PHASE_CNT : phases->items.size();
+
+    uint32_t default_ms = (uint32_t)doc->num("default_phase_duration_ms", DEFAULT_PHASE_DURATION_MS);
+    if (!junction_alloc(j, lanes->items.size(), connections->items.size() + crosswalk_cnt, phase_cap, default_ms,
+                        algorithm))
+        return URBANFLOW_ERR_CONFIG;
+
+    spillback_reset();
+    for (const JsonValue &l : lanes->items)
+    {
+        LaneType type = (LaneType)(int)l.num("type", LANE_IN);
+        uint32_t idx = add_lane(&intr, (uint32_t)l.num("id", 0), type, lane_hardware(intr.lane_cnt, type),
+                                (uint16_t)l.num("bearing", 0));
+        if (idx == INTGRAPH_INVALID_INDEX)
+            return URBANFLOW_ERR_CONFIG;
+        if (type == LANE_OUT)
+            spillback_set_storage(idx, (uint16_t)l.num("storage", 0));
+    }
+
+    for (const JsonValue &conn : connections->items)
+    {
+        if (add_connection(&intr, (uint32_t)conn.num("source_lane_idx", 0), (uint32_t)conn.num("target_lane_idx", 0)) ==
+            INTGRAPH_INVALID_INDEX)
+            return URBANFLOW_ERR_CONFIG;
+    }
+    add_crosswalk_connections(&intr);
+
+    intr.path_clearance_m = (float)doc->num("path_clearance_m", PATH_CLEARANCE_M);
+    parse_path_geometry(lanes, connections);
+
+    compute_conflicts_on_device(&intr);
+    compute_clearances_on_device(&intr);
+
+    // A ring layout the board would reject falls back to the configured phases there too
+    actuation_reset();
+    ring_barrier_reset();
+    if (rb && !(parse_ring_barrier(rb) && ring_barrier_load_phases(&intr)))
+        ring_barrier_reset();
+    j->rings = ring_barrier_active();
+
+    if (!j->rings)
+    {
+        for (const JsonValue &p : phases->items)
+        {
+            uint32_t idx = intr.phase_cnt;
+            add_phase(&intr, p.u64("active_connections_mask"), (uint32_t)p.num("duration_ms", 0));
+            j->gap_ms[idx] = (uint32_t)p.num("gap_ms", 0);
+            j->max_green_ms[idx] = (uint32_t)p.num("max_green_ms", 0);
+            actuation_set_phase_limits(idx, j->gap_ms[idx], j->max_green_ms[idx]);
+        }
+    }
+
+    policy_reset(&policy);
+    const JsonValue *net = doc->get("policy");
+    if (net && net->kind == JsonValue::JSON_OBJECT)
+        parse_policy(net);
+
+    green_wave_reset();
+    uint16_t wave_port = 0;
+    uint32_t wave_node_id = 0;
+    const JsonValue *gw = doc->get("green_wave");
+    if (gw && gw->kind == JsonValue::JSON_OBJECT)
+        parse_green_wave(gw, &wave_port, &wave_node_id);
+
+    int32_t status = junction_start(j);
+    if (status == URBANFLOW_OK)
+        green_wave_setup(wave_port, wave_node_id);
+    return status;
+}
+
+// --- BINARY IMAGE ---
+// Little endian, in this order:
+//   u32 magic, u16 version, u8 lane_cnt, connection_cnt, phase_cnt, has_policy,
+//   u32 default_ms, f32 path_clearance_m
+//   lanes:       u32 id, u8 type, u16 bearing, u16 storage (exit lanes, vehicles)
+//   connections: u8 src, u8 tgt, u8 point_cnt, {i16 x, i16 y}[point_cnt]  (PATH_UNIT_M)
+//   phases:      u64 mask, u32 duration_ms, u32 gap_ms, u32 max_green_ms
+//   policy:      u8 input_cnt, hidden_cnt, output_cnt, queue_shift, i32 hidden_mult, u8 hidden_shift,
+//                i8 w1[hidden][input], i32 b1[hidden], i8 w2[output][hidden], i32 b2[output]
+// Connections include the pedestrian ones, so loading adds none.
+
+class ImageWriter
+{
+public:
+    ImageWriter(uint8_t *out, size_t capacity) : out(out), capacity(capacity), size(0) {}
+
+    void put(uint64_t v, size_t bytes)
+    {
+        for (size_t i = 0; i < bytes; i++, size++)
+        {
+            if (out && size < capacity)
+                out[size] = (uint8_t)(v >> (8 * i));
+        }
+    }
+
+    uint8_t *out;
+    size_t capacity;
+    size_t size;
+};
+
+class ImageReader
+{
+public:
+    ImageReader(const uint8_t *data, size_t len) : data(data), len(len), pos(0), ok(true) {}
+
+    uint64_t get(size_t bytes)
+    {
+        if (len - pos < bytes)
+        {
+            ok = false;
+            return 0;
+        }
+        uint64_t v = 0;
+        for (size_t i = 0; i < bytes; i++)
+            v |= (uint64_t)data[pos++] << (8 * i);
+        return v;
+    }
+
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+    bool ok;
+};
+
+static void put_float(ImageWriter *w, float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, 4);
+    w->put(bits, 4);
+}
+
+static float get_float(ImageReader *r)
+{
+    uint32_t bits = (uint32_t)r->get(4);
+    float f;
+    memcpy(&f, &bits, 4);
+    return f;
+}
+
+// Junction j, entered
+static size_t write_image(const HostJunction *j, ImageWriter *w)
+{
+    const Intersection *layout = &j->layout;
+    const PolicyNet *net = policy.loaded ? &policy : NULL;
+
+    w->put(URBANFLOW_BINARY_MAGIC, 4);
+    w->put(URBANFLOW_BINARY_VERSION, 2);
+    w->put(layout->lane_cnt, 1);
+    w->put(layout->connection_cnt, 1);
+    w->put(layout->phase_cnt, 1);
+    w->put(net != NULL, 1);
+    w->put(layout->default_phase_duration_ms, 4);
+    put_float(w, layout->path_clearance_m);
+
+    for (uint32_t i = 0; i < layout->lane_cnt; i++)
+    {
+        w->put(layout->lanes[i].id, 4);
+        w->put(layout->lanes[i].type, 1);
+        w->put(layout->lanes[i].bearing, 2);
+        w->put(j->exit_storage[i], 2);
+    }
+    for (uint32_t i = 0; i < layout->connection_cnt; i++)
+    {
+        const ConnectionPath *path = &layout->paths[i];
+        uint8_t points = path->point_cnt >= 2 ? path->point_cnt : 0;
+        w->put(layout->connections[i].source_lane_idx, 1);
+        w->put(layout->connections[i].target_lane_idx, 1);
+        w->put(points, 1);
+        for (uint32_t k = 0; k < points; k++)
+        {
+            w->put((uint16_t)path->x[k], 2);
+            w->put((uint16_t)path->y[k], 2);
+        }
+    }
+    for (uint32_t p = 0; p < layout->phase_cnt; p++)
+    {
+        w->put(layout->phases[p].active_connections_mask, 8);
+        w->put(layout->phases[p].duration_ms, 4);
+        w->put(j->gap_ms[p], 4);
+        w->put(j->max_green_ms[p], 4);
+    }
+
+    if (net)
+    {
+        w->put(net->input_cnt, 1);
+        w->put(net->hidden_cnt, 1);
+        w->put(net->output_cnt, 1);
+        w->put(net->queue_shift, 1);
+        w->put((uint32_t)net->hidden_mult, 4);
+        w->put(net->hidden_shift, 1);
+        for (uint32_t h = 0; h < net->hidden_cnt; h++)
+        {
+            for (uint32_t i = 0; i < net->input_cnt; i++)
+                w->put((uint8_t)net->w1[h][i], 1);
+        }
+        for (uint32_t h = 0; h < net->hidden_cnt; h++)
+            w->put((uint32_t)net->b1[h], 4);
+        for (uint32_t k = 0; k < net->output_cnt; k++)
+        {
+            for (uint32_t h = 0; h < net->hidden_cnt; h++)
+                w->put((uint8_t)net->w2[k][h], 1);
+        }
+        for (uint32_t k = 0; k < net->output_cnt; k++)
+            w->put((uint32_t)net->b2[k], 4);
+    }
+    return w->size;
+}
+
+// Into the global policy
+static bool read_policy(ImageReader *r)
+{
+    policy_reset(&policy);
+    policy.input_cnt = r->get(1);
+    policy.hidden_cnt = r->get(1);
+    policy.output_cnt = r->get(1);
+    policy.queue_shift = r->get(1);
+    policy.hidden_mult = (int32_t)r->get(4);
+    policy.hidden_shift = r->get(1);
+    if (policy.input_cnt > POLICY_MAX_INPUTS || policy.hidden_cnt > POLICY_MAX_HIDDEN ||
+        policy.output_cnt > MAX_PHASE_CNT)
+        return false;
+
+    for (uint32_t h = 0; h < policy.hidden_cnt; h++)
+    {
+        for (uint32_t i = 0; i < policy.input_cnt; i++)
+            policy.w1[h][i] = (int8_t)r->get(1);
+    }
+    for (uint32_t h = 0; h < policy.hidden_cnt; h++)
+        policy.b1[h] = (int32_t)r->get(4);
+    for (uint32_t k = 0; k < policy.output_cnt; k++)
+    {
+        for (uint32_t h = 0; h < policy.hidden_cnt; h++)
+            policy.w2[k][h] = (int8_t)r->get(1);
+    }
+    for (uint32_t k = 0; k < policy.output_cnt; k++)
+        policy.b2[k] = (int32_t)r->get(4);
+
+    return r->ok && policy_validate(&policy, &intr);
+}
+
+static int32_t read_image(HostJunction *j, ImageReader *r, int32_t algorithm)
+{
+    if (r->get(4) != URBANFLOW_BINARY_MAGIC || r->get(2) != URBANFLOW_BINARY_VERSION)
+        return URBANFLOW_ERR_PARSE;
+
+    uint32_t lane_cnt = r->get(1);
+    uint32_t connection_cnt = r->get(1);
+    uint32_t phase_cnt = r->get(1);
+    bool has_policy = r->get(1) != 0;
+    uint32_t default_ms = r->get(4);
+    float path_clearance_m = get_float(r);
+    if (!r->ok)
+        return URBANFLOW_ERR_PARSE;
+    if (!junction_alloc(j, lane_cnt, connection_cnt, phase_cnt, default_ms, algorithm))
+        return URBANFLOW_ERR_CONFIG;
+    intr.path_clearance_m = path_clearance_m;
+
+    spillback_reset();
+    for (uint32_t i = 0; i < lane_cnt; i++)
+    {
+        uint32_t id = r->get(4);
+        LaneType type = (LaneType)r->get(1);
+        uint16_t bearing = r->get(2);
+        uint16_t storage = r->get(2);
+        if (!r->ok || add_lane(&intr, id, type, lane_hardware(i, type), bearing) == INTGRAPH_INVALID_INDEX)
+            return URBANFLOW_ERR_PARSE;
+        if (type == LANE_OUT)
+            spillback_set_storage(i, storage);
+    }
+    for (uint32_t i = 0; i < connection_cnt && r->ok; i++)
+    {
+        uint32_t src = r->get(1);
+        uint32_t tgt = r->get(1);
+        uint32_t points = r->get(1);
+        if (add_connection(&intr, src, tgt) == INTGRAPH_INVALID_INDEX || points > PATH_MAX_POINTS)
+            return URBANFLOW_ERR_CONFIG;
+        ConnectionPath *path = &intr.paths[i];
+        for (uint32_t k = 0; k < points; k++)
+        {
+            path->x[k] = (int16_t)r->get(2);
+            path->y[k] = (int16_t)r->get(2);
+        }
+        path->point_cnt = points;
+    }
+    compute_conflicts_on_device(&intr);
+    compute_clearances_on_device(&intr);
+
+    actuation_reset();
+    ring_barrier_reset();
+    for (uint32_t p = 0; p < phase_cnt; p++)
+    {
+        uint64_t mask = r->get(8);
+        uint32_t duration_ms = r->get(4);
+        j->gap_ms[p] = r->get(4);
+        j->max_green_ms[p] = r->get(4);
+        add_phase(&intr, mask, duration_ms);
+        actuation_set_phase_limits(p, j->gap_ms[p], j->max_green_ms[p]);
+    }
+    if (!r->ok)
+        return URBANFLOW_ERR_PARSE;
+
+    policy_reset(&policy);
+    if (has_policy && !read_policy(r))
+        return URBANFLOW_ERR_PARSE;
+    green_wave_reset();
+
+    return junction_start(j);
+}
+
+// --- PUBLIC API ---
+
+static bool range_ok(const UrbanFlowBank *bank, uint32_t first, uint32_t n)
+{
+    return bank && first <= bank->count && n <= bank->count - first;
+}
+
+uint32_t urbanflow_abi_version(void)
+{
+    return URBANFLOW_ABI_VERSION;
+}
+
+UrbanFlowBank *urbanflow_bank_create(uint32_t capacity)
+{
+    // Taken before any junction has run in it
+    if (!pristine_state)
+    {
+        pristine_state = (uint8_t *)malloc(state_bytes() ? state_bytes() : 1);
+        if (!pristine_state)
+            return NULL;
+        memcpy(pristine_state, __start_urbanflow_state, state_bytes());
+    }
+
+    UrbanFlowBank *bank = (UrbanFlowBank *)calloc(1, sizeof(UrbanFlowBank));
+    if (!bank)
+        return NULL;
+    bank->junctions = (HostJunction *)calloc(capacity ? capacity : 1, sizeof(HostJunction));
+    if (!bank->junctions)
+    {
+        free(bank);
+        return NULL;
+    }
+    bank->capacity = capacity;
+    return bank;
+}
+
+void urbanflow_bank_destroy(UrbanFlowBank *bank)
+{
+    if (!bank)
+        return;
+    for (uint32_t i = 0; i < bank->count; i++)
+        junction_free(&bank->junctions[i]);
+    free(bank->junctions);
+    free(bank);
+}
+
+uint32_t urbanflow_count(const UrbanFlowBank *bank)
+{
+    return bank ? bank->count : 0;
+}
+
+int32_t urbanflow_load_json(UrbanFlowBank *bank, const char *json, size_t len, int32_t algorithm)
+{
+    if (!bank || !json || algorithm < URBANFLOW_ALGO_MAX_PRESSURE || algorithm > URBANFLOW_ALGO_LEARNED_POLICY)
+        return URBANFLOW_ERR_ARGUMENT;
+
+    JsonValue doc;
+    JsonReader reader(json, len);
+    if (!reader.parse(&doc))
+        return URBANFLOW_ERR_PARSE;
+
+    // Either one layout or the dashboard's array of them; all or nothing
+    std::vector<const JsonValue *> layouts;
+    if (doc.kind == JsonValue::JSON_ARRAY)
+    {
+        for (const JsonValue &item : doc.items)
+            layouts.push_back(&item);
+    }
+    else
+    {
+        layouts.push_back(&doc);
+    }
+    if (layouts.empty())
+        return URBANFLOW_ERR_CONFIG;
+    if (layouts.size() > bank->capacity - bank->count)
+        return URBANFLOW_ERR_FULL;
+
+    uint32_t first = bank->count;
+    for (const JsonValue *layout : layouts)
+    {
+        HostJunction *j = &bank->junctions[bank->count];
+        int32_t status = load_layout(j, layout, algorithm);
+        if (status != URBANFLOW_OK)
+        {
+            junction_free(j);
+            while (bank->count > first)
+                junction_free(&bank->junctions[--bank->count]);
+            return status;
+        }
+        bank->count++;
+    }
+    return first;
+}
+
+int32_t urbanflow_load_binary(UrbanFlowBank *bank, const void *data, size_t len, int32_t algorithm)
+{
+    if (!bank || !data || algorithm < URBANFLOW_ALGO_MAX_PRESSURE || algorithm > URBANFLOW_ALGO_LEARNED_POLICY)
+        return URBANFLOW_ERR_ARGUMENT;
+    if (bank->count >= bank->capacity)
+        return URBANFLOW_ERR_FULL;
+
+    HostJunction *j = &bank->junctions[bank->count];
+    ImageReader reader((const uint8_t *)data, len);
+    int32_t status = read_image(j, &reader, algorithm);
+    if (status != URBANFLOW_OK)
+    {
+        junction_free(j);
+        return status;
+    }
+    return bank->count++;
+}
+
+int32_t urbanflow_save_binary(const UrbanFlowBank *bank, uint32_t idx, void *out, size_t capacity)
+{
+    if (!range_ok(bank, idx, 1))
+        return URBANFLOW_ERR_ARGUMENT;
+
+    HostJunction *j = &bank->junctions[idx];
+    if (j->rings)
+        return URBANFLOW_ERR_CONFIG;
+    enter(j);
+
+    ImageWriter sizer(NULL, 0);
+    size_t size = write_image(j, &sizer);
+    if (out && size <= capacity)
+    {
+        ImageWriter writer((uint8_t *)out, capacity);
+        write_image(j, &writer);
+    }
+    return (int32_t)size;
+}
+
+int32_t urbanflow_info(const UrbanFlowBank *bank, uint32_t idx, UrbanFlowInfo *info)
+{
+    if (!range_ok(bank, idx, 1) || !info)
+        return URBANFLOW_ERR_ARGUMENT;
+
+    const HostJunction *j = &bank->junctions[idx];
+    info->lane_cnt = j->layout.lane_cnt;
+    info->connection_cnt = j->layout.connection_cnt;
+    info->phase_cnt = j->layout.phase_cnt;
+    info->preempt_bound_ms = j->preempt_bound_ms;
+    info->preempt_worst_ms = j->preempt_worst_ms;
+    info->lookahead_calls = j->lookahead.calls;
+    info->lookahead_mean_us = j->lookahead.calls ? (uint32_t)(j->lookahead.total_us / j->lookahead.calls) : 0;
+    info->lookahead_worst_us = j->lookahead.max_compute_us;
+    info->lookahead_worst_nodes = j->lookahead.max_nodes;
+    info->wave_messages_sent = j->wave.messages_sent;
+    info->wave_messages_received = j->wave.messages_received;
+    info->wave_platoons_predicted = j->wave.platoons_predicted;
+    return URBANFLOW_OK;
+}
+
+int32_t urbanflow_push_sensors(UrbanFlowBank *bank, uint32_t first, uint32_t n, const uint16_t *queues,
+                               uint32_t stride)
+{
+    if (!range_ok(bank, first, n) || !queues)
+        return URBANFLOW_ERR_ARGUMENT;
+
+    for (uint32_t k = 0; k < n; k++)
+    {
+        HostJunction *j = &bank->junctions[first + k];
+        if (stride < j->layout.lane_cnt)
+            return URBANFLOW_ERR_ARGUMENT;
+        enter(j);
+
+        const uint16_t *row = &queues[(size_t)k * stride];
+        for (uint32_t i = 0; i < j->layout.lane_cnt; i++)
+        {
+            uint16_t q = row[i] < 255 ? row[i] : 255; // The estimator's ceiling
+            if (j->layout.lanes[i].type == LANE_IN)
+            {
+                uint16_t last = j->queues[i];
+                queue_estimator_count(&queue_estimator, i, q > last ? q - last : 0, q < last ? last - q : 0);
+            }
+            else if (j->layout.lanes[i].type == LANE_OUT)
+            {
+                spillback_queue(i, q, j->now);
+            }
+            j->queues[i] = q;
+        }
+    }
+    return URBANFLOW_OK;
+}
+
+int32_t urbanflow_push_calls(UrbanFlowBank *bank, uint32_t first, uint32_t n, const uint64_t *crossings,
+                             const int16_t *preempt_lanes)
+{
+    if (!range_ok(bank, first, n))
+        return URBANFLOW_ERR_ARGUMENT;
+
+    for (uint32_t k = 0; k < n; k++)
+    {
+        HostJunction *j = &bank->junctions[first + k];
+        uint64_t pressed = crossings ? crossings[k] : 0;
+        int16_t preempt = preempt_lanes ? preempt_lanes[k] : -1;
+        if (!pressed && preempt < 0)
+            continue;
+        enter(j);
+
+        for (uint32_t i = 0; i < j->layout.lane_cnt; i++)
+        {
+            if ((pressed >> i) & 1)
+                controller_request_crossing(i);
+        }
+        if (preempt >= 0)
+            controller_request_preemption((uint32_t)preempt);
+    }
+    return URBANFLOW_OK;
+}
+
+int32_t urbanflow_step(UrbanFlowBank *bank, uint32_t first, uint32_t n, uint32_t dt_ms)
+{
+    if (!range_ok(bank, first, n))
+        return URBANFLOW_ERR_ARGUMENT;
+
+    for (uint32_t k = 0; k < n; k++)
+    {
+        HostJunction *j = &bank->junctions[first + k];
+        j->now += dt_ms;
+        enter(j);
+        controller_loop();
+        capture_outputs(j);
+    }
+    return URBANFLOW_OK;
+}
+
+int32_t urbanflow_read_phases(const UrbanFlowBank *bank, uint32_t first, uint32_t n, uint8_t *phase, uint8_t *pending,
+                              uint8_t *state)
+{
+    if (!range_ok(bank, first, n))
+        return URBANFLOW_ERR_ARGUMENT;
+
+    for (uint32_t k = 0; k < n; k++)
+    {
+        const HostJunction *j = &bank->junctions[first + k];
+        if (phase)
+            phase[k] = j->phase;
+        if (pending)
+            pending[k] = j->pending;
+        if (state)
+            state[k] = j->controller_state;
+    }
+    return URBANFLOW_OK;
+}
+
+int32_t urbanflow_read_lights(const UrbanFlowBank *bank, uint32_t first, uint32_t n, uint8_t *lights,
+                              uint32_t stride)
+{
+    if (!range_ok(bank, first, n) || !lights)
+        return URBANFLOW_ERR_ARGUMENT;
+
+    for (uint32_t k = 0; k < n; k++)
+    {
+        const HostJunction *j = &bank->junctions[first + k];
+        if (stride < j->layout.lane_cnt)
+            return URBANFLOW_ERR_ARGUMENT;
+
+        uint8_t *row = &lights[(size_t)k * stride];
+        for (uint32_t i = 0; i < j->layout.lane_cnt; i++)
+        {
+            const Lane *lane = &j->layout.lanes[i];
+            if (lane->type == LANE_OUT)
+                row[i] = URBANFLOW_LIGHT_NONE;
+            else if (j->lights.bits[lane->hw.green_pin >> 3] & (1 << (lane->hw.green_pin & 7)))
+                row[i] = URBANFLOW_LIGHT_GREEN;
+            else if (j->lights.bits[lane->hw.yellow_pin >> 3] & (1 << (lane->hw.yellow_pin & 7)))
+                row[i] = URBANFLOW_LIGHT_YELLOW;
+            else
+                row[i] = URBANFLOW_LIGHT_RED;
+        }
+    }
+    return URBANFLOW_OK;
+}
+
+// --- FLIGHT REPLAY ---
+
+int32_t urbanflow_replay_decision(UrbanFlowBank *bank, uint32_t idx, const void *payload, size_t len,
+                                  uint8_t *chosen, uint8_t *reason, uint8_t *exclusive)
+{
+    if (!range_ok(bank, idx, 1) || !payload || !chosen || !reason || !exclusive)
+        return URBANFLOW_ERR_ARGUMENT;
+
+    HostJunction *j = &bank->junctions[idx];
+    enter(j);
+
+    DecisionContext ctx;
+    uint8_t recorded_phase;
+    DecisionReason recorded_reason;
+    bool recorded_walk;
+    if (len > UINT16_MAX ||
+        !recorder_parse_decision(&intr, (const uint8_t *)payload, (uint32_t)len, &ctx, &recorded_phase,
+                                 &recorded_reason, &recorded_walk))
+        return URBANFLOW_ERR_PARSE;
+
+    DecisionReason why;
+    bool walk;
+    *chosen = (uint8_t)determine_next_phase(&intr, &ctx, &why, &walk);
+    *reason = (uint8_t)why;
+    *exclusive = walk ? 1 : 0;
+    return URBANFLOW_OK;
+}
@@ -0,0 +1,179 @@
+#ifndef URBANFLOW_H
+#define URBANFLOW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Host build of the UrbanFlow controller for external traffic simulators.
+// A bank holds many independent junctions; every call works on a range of
+// them and reads or writes caller-owned arrays, so co-simulating thousands
+// of junctions costs one call per step rather than one per junction.
+//
+// Every junction runs the firmware itself: controller_loop() from
+// TrafficController.cpp and the modules under it, built against the shims in
+// platform/ (see the Makefile). Each junction keeps its own copy of the
+// firmware's file-scope state, about 30 KB, plus the flight recorder's 16 KB
+// ring; a pass on a different junction than the last one swaps the copies.
+// On the host the controller runs without SIMULATION_MODE, with its lamps on
+// the mock backend and its inbound queues counted from what the simulator
+// pushes. A "green_wave" block opens a UDP socket on this host, so junctions
+// coordinate over real datagrams with their peers (tools/green_wave_bench.py).
+// There is no flash, and the safety monitor's task does not run; a layout
+// with a phase it would trip on fails to load, as it does on the board.
+//
+// Typical loop, with the simulator's own arrivals and departures in between:
+//   UrbanFlowBank *bank = urbanflow_bank_create(4096);
+//   urbanflow_load_json(bank, text, len, URBANFLOW_ALGO_MAX_PRESSURE); // once per layout
+//   for (;;) {
+//       urbanflow_push_sensors(bank, 0, n, queues, URBANFLOW_MAX_LANES);
+//       urbanflow_step(bank, 0, n, 500);
+//       urbanflow_read_lights(bank, 0, n, lights, URBANFLOW_MAX_LANES);
+//   }
+//
+// Not thread-safe: all junctions share the one set of firmware statics.
+// Build with `make` in this directory (libufhost.so).
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define URBANFLOW_API __declspec(dllexport)
+#else
+#define URBANFLOW_API __attribute__((visibility("default")))
+#endif
+
+// --- Configuration & Constants ---
+#define URBANFLOW_ABI_VERSION 6
+#define URBANFLOW_MAX_LANES 64 // MAX_LANE_CNT; a stride of this fits every junction
+
+#define URBANFLOW_BINARY_MAGIC 0x42434655 // "UFCB"
+#define URBANFLOW_BINARY_VERSION 2
+
+typedef enum {
+    URBANFLOW_OK = 0,
+    URBANFLOW_ERR_ARGUMENT = -1, // NULL pointer or index range outside the bank
+    URBANFLOW_ERR_PARSE = -2,    // Malformed JSON or binary image
+    URBANFLOW_ERR_CONFIG = -3,   // Well-formed, but not a junction the controller can run
+    URBANFLOW_ERR_FULL = -4,     // Bank capacity reached
+    URBANFLOW_ERR_MEMORY = -5
+} UrbanFlowStatus;
+
+// Same values as ControlAlgorithm in CONFIG.h
+typedef enum {
+    URBANFLOW_ALGO_MAX_PRESSURE,
+    URBANFLOW_ALGO_LOOKAHEAD,
+    URBANFLOW_ALGO_LEARNED_POLICY // Falls back to max pressure without a "policy" block
+} UrbanFlowAlgorithm;
+
+// Same values as ControllerState in TrafficController.h
+typedef enum {
+    URBANFLOW_STATE_GREEN,
+    URBANFLOW_STATE_INTERGREEN,
+    URBANFLOW_STATE_PEDESTRIAN,        // All red, every waiting crossing on WALK
+    URBANFLOW_STATE_PREEMPT_CLEARANCE, // Intergreen toward an emergency approach
+    URBANFLOW_STATE_PREEMPT_HOLD       // Emergency approach green, everything else red
+} UrbanFlowState;
+
+// Per lane. Outbound lanes have no signal; crosswalks show WALK as green.
+typedef enum {
+    URBANFLOW_LIGHT_RED,
+    URBANFLOW_LIGHT_YELLOW,
+    URBANFLOW_LIGHT_GREEN,
+    URBANFLOW_LIGHT_NONE
+} UrbanFlowLight;
+
+typedef struct {
+    uint32_t lane_cnt;
+    uint32_t connection_cnt; // Including the pedestrian movements added for crosswalks
+    uint32_t phase_cnt;
+    uint32_t preempt_bound_ms;  // Longest request-to-green an emergency call may see (clearance matrix)
+    uint32_t preempt_worst_ms;  // Longest the controller has measured so far
+    // URBANFLOW_ALGO_LOOKAHEAD: searches run so far, their cost in host time and
+    // the largest in nodes (LOOKAHEAD_MAX_NODES caps it; nodes carry over to the board)
+    uint32_t lookahead_calls;
+    uint32_t lookahead_mean_us;
+    uint32_t lookahead_worst_us;
+    uint32_t lookahead_worst_nodes;
+    // "green_wave" block: datagrams so far, and platoons predicted from synced peers' timing
+    uint32_t wave_messages_sent;
+    uint32_t wave_messages_received;
+    uint32_t wave_platoons_predicted;
+} UrbanFlowInfo;
+
+typedef struct UrbanFlowBank UrbanFlowBank;
+
+// --- Bank ---
+URBANFLOW_API uint32_t urbanflow_abi_version(void);
+
+// NULL when out of memory. capacity = most junctions the bank will hold.
+URBANFLOW_API UrbanFlowBank *urbanflow_bank_create(uint32_t capacity);
+URBANFLOW_API void urbanflow_bank_destroy(UrbanFlowBank *bank);
+URBANFLOW_API uint32_t urbanflow_count(const UrbanFlowBank *bank);
+
+// --- Loading ---
+// A layout object as served to the board, or an array of them
+// (intersections.json). Every layout is appended to the bank. Returns the
+// index of the first one added, or a negative UrbanFlowStatus (nothing added).
+URBANFLOW_API int32_t urbanflow_load_json(UrbanFlowBank *bank, const char *json, size_t len, int32_t algorithm);
+
+// Image written by urbanflow_save_binary(): no parsing, for loading the same
+// layouts many times over. Returns the new index or a negative UrbanFlowStatus.
+// Junctions phased by a "ring_barrier" block have no image (URBANFLOW_ERR_CONFIG),
+// and the image leaves out the "green_wave" block.
+URBANFLOW_API int32_t urbanflow_load_binary(UrbanFlowBank *bank, const void *data, size_t len, int32_t algorithm);
+
+// Writes junction idx as a binary image. Returns the image size; nothing is
+// written when it exceeds capacity, so call with out = NULL to size the buffer.
+URBANFLOW_API int32_t urbanflow_save_binary(const UrbanFlowBank *bank, uint32_t idx, void *out, size_t capacity);
+
+URBANFLOW_API int32_t urbanflow_info(const UrbanFlowBank *bank, uint32_t idx, UrbanFlowInfo *info);
+
+// --- Batched stepping ---
+// Arrays hold one row per junction, first..first+n-1, stride entries apart;
+// entry i of a row is lane slot i (config order).
+
+// Queued vehicles per lane, at most 255. On inbound lanes the change since
+// the last push reaches the queue estimator as counted arrivals or
+// departures, so lane_traffic follows it exactly from the next pass on. On
+// exit lanes it is the spillback queue. Crosswalk entries are ignored.
+URBANFLOW_API int32_t urbanflow_push_sensors(UrbanFlowBank *bank, uint32_t first, uint32_t n, const uint16_t *queues,
+                                             uint32_t stride);
+
+// One entry per junction; either array may be NULL. crossings: a bit per
+// crosswalk lane slot whose button was pressed. preempt_lanes: inbound lane
+// slot calling for emergency preemption, -1 = none; repeat every step the
+// call lasts, as the detector does.
+URBANFLOW_API int32_t urbanflow_push_calls(UrbanFlowBank *bank, uint32_t first, uint32_t n, const uint64_t *crossings,
+                                           const int16_t *preempt_lanes);
+
+// Advances each junction's clock by dt_ms and runs one controller pass.
+// Steps of 500 ms match the firmware simulation tick and kpi_bench.py.
+URBANFLOW_API int32_t urbanflow_step(UrbanFlowBank *bank, uint32_t first, uint32_t n, uint32_t dt_ms);
+
+// Any output pointer may be NULL. pending is the phase an intergreen or an
+// exclusive pedestrian interval leads to. state is an UrbanFlowState.
+URBANFLOW_API int32_t urbanflow_read_phases(const UrbanFlowBank *bank, uint32_t first, uint32_t n, uint8_t *phase,
+                                            uint8_t *pending, uint8_t *state);
+
+// UrbanFlowLight per lane
+URBANFLOW_API int32_t urbanflow_read_lights(const UrbanFlowBank *bank, uint32_t first, uint32_t n, uint8_t *lights,
+                                            uint32_t stride);
+
+// --- Flight replay ---
+// Re-runs one recorded decision (the payload of a REC_DECISION record,
+// FlightRecorder.h) through the firmware's determine_next_phase() on
+// junction idx, which must be the layout the board ran. chosen and reason
+// (a DecisionReason) are what the firmware picks now; exclusive is nonzero
+// when it asks for an all-red walk. Overwrites the junction's queues and
+// connection weights with the recorded ones, so replay on a junction that
+// is not stepped otherwise. URBANFLOW_ERR_PARSE when the payload does not
+// fit the junction.
+URBANFLOW_API int32_t urbanflow_replay_decision(UrbanFlowBank *bank, uint32_t idx, const void *payload, size_t len,
+                                                uint8_t *chosen, uint8_t *reason, uint8_t *exclusive);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef ACTUATION_H
+#define ACTUATION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "IntersectionGraph.h"
+
+// Vehicle-actuated control on top of the decision logic. With
+// ACTUATED_DETECTORS (CONFIG.h) the inbound lanes' sensor_pin is a loop or
+// presence detector, and every such lane keeps a gap timer: the time since
+// the detector last pulsed or was occupied.
+//
+// A green gaps out once every detector lane it serves has gone longer than
+// its phase's gap threshold without a vehicle and none of its lanes has a
+// counted queue left (lane_traffic). Greens made only of counted lanes never
+// gap out: pressure already ends them at the next decision, and cutting them
+// on an empty count only adds intergreens (tools/kpi_bench.py). Max-out is
+// per phase. Both are checked on every controller pass, so the switch is
+// decided within one loop iteration instead of at the next
+// DECISION_TIME_INTERVAL.
+//
+// A detector lane without a counted queue places a call when a vehicle is
+// seen while it is red; the call counts as one queued vehicle until the lane
+// is served.
+
+// --- Configuration & Constants ---
+#define ACTUATION_GAP_MS 1500 // Passage time: longest headway that still extends a green
+
+// --- API ---
+// Forget per-phase limits (before loading a new config).
+void actuation_reset();
+
+// Per-phase "gap_ms" / "max_green_ms" from the config, 0 = controller default.
+void actuation_set_phase_limits(uint32_t phase_idx, uint32_t gap_ms, uint32_t max_green_ms);
+
+// Arms the detector interrupts on the inbound lanes' sensor pins (none unless use_detectors).
+void actuation_setup(const Intersection *intr, bool use_detectors, unsigned long now);
+
+// Every controller pass: detector edges restart the gap timers, lanes
+// showing green have their calls answered.
+void actuation_update(const Intersection *intr, uint64_t green_lanes, unsigned long now);
+
+// The phase's detector lanes have been idle past its gap threshold and its counted queues are empty.
+bool actuation_gapped_out(const Intersection *intr, uint32_t phase_idx, unsigned long now);
+
+// Max green for the phase, or default_ms when the config sets none.
+uint32_t actuation_max_green(uint32_t phase_idx, uint32_t default_ms);
+
+// A detector call is waiting on this lane.
+bool actuation_called(uint32_t lane_idx);
+uint64_t actuation_called_lanes();
+
+// Raw detector state for the queue estimator: vehicles that crossed the
+// detector during the last actuation_update(), and whether one stands on it.
+bool actuation_has_detector(uint32_t lane_idx);
+uint16_t actuation_new_pulses(uint32_t lane_idx);
+bool actuation_occupied(uint32_t lane_idx);
+
+#endif
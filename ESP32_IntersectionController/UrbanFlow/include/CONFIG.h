@@ -1,6 +1,51 @@
 #ifndef CONFIG_HEADERGUARD
 #define CONFIG_HEADERGUARD
 
+#include "LightOutput.h"
+
 const bool SIMULATION_MODE = true;
 
+// Boot straight from the compile-time plan in DEFAULT_STATIC_CONFIG.h
+// (no WiFi, no cloud config). For fixed deployments.
+const bool USE_STATIC_CONFIG = false;
+
+enum ControlAlgorithm {
+    ALGO_MAX_PRESSURE, // Myopic: highest current pressure wins
+    ALGO_LOOKAHEAD,    // Rolling-horizon search over phase sequences (PhaseOptimizer.h)
+    ALGO_LEARNED_POLICY // Int8 policy from the config "policy" block (PolicyNet.h)
+};
+const ControlAlgorithm CONTROL_ALGORITHM = ALGO_MAX_PRESSURE;
+
+// What the lane pins in the config mean: GPIOs, or channels on a 74HC595
+// chain / MCP23017 expanders for junctions with more lamps than GPIOs.
+const LightOutputKind LIGHT_OUTPUT_BACKEND = LIGHT_OUTPUT_GPIO;
+
+// Emergency-vehicle preemption: a detector contact on PREEMPT_PIN (-1 = none)
+// calls for PREEMPT_LANE_ID. The sensor link can call for any inbound lane:
+// a "PRE,<lane id>" line, or on the bus a node's PREEMPT reply (SensorBus.h).
+const int16_t PREEMPT_PIN = -1;
+const uint32_t PREEMPT_LANE_ID = 1;
+
+// Vehicle-actuated gap-out (Actuation.h): the inbound lanes' sensor_pin is a
+// loop/presence detector. Off while those pins carry anything else.
+const bool ACTUATED_DETECTORS = false;
+
+// Spillback detection (Spillback.h): the exit lanes' sensor_pin is a presence
+// detector just past the junction. Queue inputs from the sensor link work either way.
+const bool EXIT_DETECTORS = false;
+
+// Sensor link (SensorBus.h): an RS-485 bus polling many addressed acquisition
+// nodes, lanes mapped by the config "sensor_bus" block. Off: the single
+// acquisition board's "id,value" lines, and "PRE," calls.
+const bool SENSOR_BUS = false;
+
+// Status posts to the dashboard (sendStatusUrl): one once the config is in,
+// then one every STATUS_REPORT_INTERVAL_MS carrying the spillback counters
+// (Spillback.h). Sent from a green, never mid-transition. 0 = only the first.
+const uint32_t STATUS_REPORT_INTERVAL_MS = 60000;
+
+// Local time for the per-15-minute demand profiles (SensorHealth.h)
+#define TIME_ZONE "EET-2EEST,M3.5.0/3,M10.5.0/4"
+#define NTP_SERVER "pool.ntp.org"
+
 #endif
\ No newline at end of file
@@ -0,0 +1,67 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "IntersectionGraph.h"
+
+// Online self-calibration of every movement from departure events during
+// green, in fixed memory (exponentially weighted, integer):
+//
+//   saturation headway  gap from the lane's previous departure to a vehicle
+//                       taking this movement, while the lane still had a
+//                       queue behind it (turning vehicles leave slower)
+//   start-up lost time  first departure after the lane's green started,
+//                       beyond one headway, when a queue was waiting
+//   turning ratio       share of the lane's departures taking this movement,
+//                       counted only while all of the lane's movements are green
+//
+// Once every movement out of a lane has CALIBRATION_MIN_SAMPLES, their
+// Connection::weight becomes ratio x lane movements x reference headway /
+// headway, so uniform turns at the reference flow keep the uncalibrated
+// weight of 1.0. Max pressure and the lookahead's service rates then run on
+// the junction's own capacity, and the lookahead charges the learned lost
+// time on every switch. Learned values persist in flash (NVS) per movement,
+// keyed by its lanes' ids.
+
+// --- Configuration & Constants ---
+#define CALIBRATION_REFERENCE_HEADWAY_MS 1000 // Weight 1.0: LOOKAHEAD_SATURATION_VPS per movement
+#define CALIBRATION_MIN_HEADWAY_MS 500        // Shorter gaps are two vehicles counted in one sensor tick
+#define CALIBRATION_MAX_HEADWAY_MS 6000       // Longer ones are not saturated flow
+#define CALIBRATION_MAX_LOST_MS 8000
+#define CALIBRATION_EWMA_SHIFT 5              // New sample counts 1/32
+#define CALIBRATION_MIN_SAMPLES 20            // Before a learned value is used
+#define CALIBRATION_SAVE_INTERVAL_MS 900000   // Flash writes at most every 15 minutes
+#define CALIBRATION_ANY_CONNECTION 0xFFFFFFFF // Stop-line detector: lane known, movement not
+
+#define CALIBRATION_WEIGHT_MIN 1                           // A lane never drops out of the pressure
+#define CALIBRATION_WEIGHT_MAX (4 * CONNECTION_WEIGHT_ONE)
+
+typedef struct {
+    uint16_t headway_ms;
+    uint16_t lost_ms;
+    uint16_t ratio_q15;      // 32768 = every departure of the lane
+    uint16_t headway_samples; // Saturate at 0xFFFF
+    uint16_t lost_samples;
+    uint16_t ratio_samples;
+} ConnectionCalibration;
+
+// --- API ---
+// Loads the stored calibration for the configured movements and applies the weights.
+void calibration_setup(Intersection *intr);
+
+// Every controller pass: green start/end per lane, periodic save.
+void calibration_update(Intersection *intr, uint64_t green_lanes, unsigned long now);
+
+// A vehicle left lane_idx on conn_idx (or CALIBRATION_ANY_CONNECTION).
+// moving_conns are the movements green right now, queue_left what still
+// stands on the lane behind it.
+void calibration_departure(Intersection *intr, uint32_t lane_idx, uint32_t conn_idx, uint64_t moving_conns,
+                           uint16_t queue_left, unsigned long now);
+
+// Mean learned start-up lost time over conns, 0 while none is learned.
+uint32_t calibration_lost_time_ms(const Intersection *intr, uint64_t conns);
+
+const ConnectionCalibration *calibration_connection(uint32_t conn_idx);
+
+#endif
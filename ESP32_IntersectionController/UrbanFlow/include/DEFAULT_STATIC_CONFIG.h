@@ -0,0 +1,57 @@
+#ifndef STATIC_CONFIG_HG
+#define STATIC_CONFIG_HG
+
+#include "StaticIntersection.h"
+
+// Offline plan for IntersectieComplexa2, resolved entirely at compile time.
+// Used as the SIMULATION_MODE fallback and, with USE_STATIC_CONFIG, as the
+// only configuration of a fixed deployment.
+//
+// Pins are listed as wired: the dashboard JSON has red/green swapped and
+// parseConfig() swaps them back, so green here is the JSON "red_pin".
+
+constexpr StaticLaneDef OFFLINE_LANES[] = {
+    // id, type, { sensor, green, yellow, red }, bearing
+    {0, LANE_OUT, {-1, -1, -1, -1}, 0},
+    {1, LANE_IN, {1, 41, 21, 42}, 0},
+    {2, LANE_IN, {2, 39, 21, 40}, 0},
+    {3, LANE_OUT, {-1, -1, -1, -1}, 270},
+    {4, LANE_IN, {4, 37, 21, 38}, 270},
+    {5, LANE_OUT, {-1, -1, -1, -1}, 180},
+    {6, LANE_IN, {6, 15, 21, 8}, 180},
+    {7, LANE_IN, {7, 48, 21, 45}, 180},
+    {8, LANE_OUT, {-1, -1, -1, -1}, 90},
+    {9, LANE_IN, {9, 13, 21, 12}, 90},
+};
+
+constexpr StaticConnectionDef OFFLINE_CONNECTIONS[] = {
+    {1, 8}, // 0
+    {6, 3}, // 1
+    {7, 8}, // 2
+    {7, 0}, // 3
+    {2, 5}, // 4
+    {2, 3}, // 5
+    {9, 0}, // 6
+    {9, 3}, // 7
+    {9, 5}, // 8
+    {4, 0}, // 9
+    {4, 5}, // 10
+    {4, 8}, // 11
+};
+
+// The dashboard plan runs connections 2-5 together, but 3 (7->0) and 4/5
+// (2->5, 2->3) cross under the bearing model, so that phase is split in two.
+constexpr StaticPhaseDef OFFLINE_PHASES[] = {
+    {0x003, 5000},  // 0, 1
+    {0x00C, 10000}, // 2, 3
+    {0x030, 10000}, // 4, 5
+    {0x1C0, 5000},  // 6, 7, 8
+    {0xE00, 5000},  // 9, 10, 11
+};
+
+constexpr auto OFFLINE_INTERSECTION = make_static_intersection(3000, OFFLINE_LANES, OFFLINE_CONNECTIONS, OFFLINE_PHASES);
+
+static_assert(OFFLINE_INTERSECTION.valid, "Offline plan references unknown lanes/connections or repeats a lane id");
+static_assert(static_intersection_is_safe(OFFLINE_INTERSECTION), "Offline plan contains a phase with conflicting greens");
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "IntersectionGraph.h"
+#include "LightOutput.h"
+#include "PhaseOptimizer.h"
+#include "RingBarrier.h"
+
+// Binary flight recorder. Everything the controller sees and decides goes
+// into a RAM ring (PSRAM when the board has it): sensor frames, queue
+// snapshots, decisions with their reason, state changes, output frames and
+// blocked exits. The oldest records are dropped when the ring is full. The ring is written
+// to flash on a safety fault or on demand, led by the junction layout (kept
+// outside the ring so wrap-around never loses it); tools/flight_replay.py decodes it
+// and re-runs every decision against the recorded inputs. A decision record
+// carries everything determine_next_phase() read, so each one replays on its
+// own, however much of the lead-up the ring has lost.
+//
+// Record layout (little endian): u32 time_ms, u8 type, u16 payload_len, payload.
+
+// --- Configuration & Constants ---
+#define RECORDER_PSRAM_BYTES (256 * 1024)
+#define RECORDER_INTERNAL_BYTES (16 * 1024) // Boards without PSRAM
+#define RECORDER_FILE "/flight.bin"
+#define RECORDER_MAGIC 0x52464655 // "UFFR"
+#define RECORDER_VERSION 2
+#define RECORDER_SAVE_SLICE_BYTES 4096   // Flash written per recorder_dump_step()
+#define RECORDER_DUMP_LINE_BYTES 32      // Bytes per hex line
+#define RECORDER_DUMP_LINES_PER_PASS 8
+
+typedef enum {
+    REC_BOOT = 1,     // u8 lane_cnt, conn_cnt, phase_cnt, algorithm; u32 default_ms;
+                      // lane types[lane_cnt]; {src,tgt}[conn_cnt]; {u64 mask, u32 ms}[phase_cnt]
+    REC_SENSOR_FRAME, // u64 reported_lanes, u16 value per reported lane
+    REC_QUEUES,       // u64 serving_lanes, u16 lane_traffic[lane_cnt]
+    REC_DECISION,     // u8 current, u8 chosen, u8 reason, u8 flags (RECORDER_DECISION_*), u32 green_ms,
+                      // u32 max_green_ms; u16 lane_traffic[lane_cnt]; u16 weight[conn_cnt];
+                      // u64 blocked_conns, u64 called_lanes, u64 waiting_crossings;
+                      // u32 wait_ms per waiting crossing; u32 since_served_ms[phase_cnt];
+                      // i32 wave_bonus[phase_cnt]; u8 ring_cnt, u32 ring_elapsed_ms[ring_cnt];
+                      // u32 switch_loss_ms; f32 arrival_rate_vps per inbound lane
+    REC_STATE,        // u8 from, u8 to, u8 current_phase, u8 pending_phase
+    REC_OUTPUT,       // LightFrame
+    REC_FAULT,        // u8 source, u8 code, u8 detail (lane for sensor faults)
+    REC_SPILLBACK     // u64 blocked exit lanes (Spillback.h), on every change
+} RecorderEventType;
+
+typedef enum {
+    REASON_PEDESTRIAN,
+    REASON_IDLE,
+    REASON_STARVATION,
+    REASON_LOOKAHEAD,
+    REASON_POLICY,
+    REASON_MAX_PRESSURE,
+    REASON_GREEN_WAVE, // Max pressure with platoons from upstream peers
+    REASON_GAP_OUT,    // Every lane of the green went quiet (Actuation.h)
+    REASON_RING_BARRIER // Rings sequencing their own movements (RingBarrier.h)
+} DecisionReason;
+
+#define RECORDER_DECISION_GAPPED_OUT 0x01
+#define RECORDER_DECISION_EXCLUSIVE_WALK 0x02 // An overdue crossing no phase carries: all red next
+
+// What a decision reads besides the layout, lane_traffic and the connection
+// weights, gathered by the controller at decision time
+typedef struct {
+    uint32_t current_phase;
+    uint32_t green_ms;     // Into the current green
+    uint32_t max_green_ms; // Its max-out
+    bool gapped_out;
+    uint64_t blocked_conns;     // Into spilled-back exits (Spillback.h)
+    uint64_t called_lanes;      // Detector calls (Actuation.h)
+    uint64_t waiting_crossings; // Crosswalks with a pedestrian waiting
+    uint32_t crossing_wait_ms[MAX_LANE_CNT];
+    uint32_t since_served_ms[MAX_PHASE_CNT];
+    int32_t wave_bonus[MAX_PHASE_CNT]; // Platoons due from upstream peers (GreenWave.h)
+    uint8_t ring_cnt;                  // 0 without the ring model
+    uint32_t ring_elapsed_ms[RING_MAX_RINGS];
+    uint32_t switch_loss_ms;  // Lookahead: yellow plus the learned start-up lost time
+    ArrivalEstimator arrival; // Lookahead: only the rates are recorded
+} DecisionContext;
+
+typedef enum {
+    FAULT_SOURCE_SAFETY,
+    FAULT_SOURCE_SENSOR
+} FaultSource;
+
+// --- API ---
+// Allocates the ring (once) and records the junction layout.
+void recorder_setup(const Intersection *intr, uint8_t algorithm);
+
+void recorder_sensor_frame(const uint16_t *values, uint64_t reported_lanes, uint32_t lane_cnt);
+void recorder_queues(const Intersection *intr, uint64_t serving_lanes);
+// Carries the queues, weights and context the decision was made on
+void recorder_decision(const Intersection *intr, const DecisionContext *ctx, uint8_t chosen_phase,
+                       DecisionReason reason, bool exclusive_walk);
+// The other way round, for the host replay: restores lane_traffic and the
+// weights into intr and fills ctx. False if the payload does not fit intr.
+bool recorder_parse_decision(Intersection *intr, const uint8_t *payload, uint32_t len, DecisionContext *ctx,
+                             uint8_t *chosen_phase, DecisionReason *reason, bool *exclusive_walk);
+void recorder_state(uint8_t from, uint8_t to, uint8_t current_phase, uint8_t pending_phase);
+void recorder_output(const LightFrame *frame);
+void recorder_fault(FaultSource source, uint8_t code, uint8_t detail);
+void recorder_spillback(uint64_t blocked_lanes);
+
+// Ring -> RECORDER_FILE, oldest record first, in one go (after a safety
+// fault, with the outputs already latched). Returns bytes written (0 on failure).
+uint32_t recorder_flush();
+
+// Console dump: saves the ring, then streams RECORDER_FILE over Serial as hex
+// between FLIGHT BEGIN / END markers. Never blocks: each step writes one
+// slice of flash or the hex lines the TX buffer has room for, so loop() and
+// the controller keep running through a dump of the whole ring.
+void recorder_dump_start();
+void recorder_dump_step();
+bool recorder_dump_active();
+
+uint32_t recorder_bytes_used();
+uint32_t recorder_records_dropped();
+
+#endif
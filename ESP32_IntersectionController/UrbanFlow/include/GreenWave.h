@@ -0,0 +1,84 @@
+#ifndef GREEN_WAVE_H
+#define GREEN_WAVE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "IntersectionGraph.h"
+
+// Green-wave coordination with neighbouring controllers over UDP.
+// Every controller tells its peers when its current green started and how
+// many vehicles it is sending down each outbound lane. A peer whose inbound
+// lane is fed by that outbound lane (a configured link, with the travel
+// time between the stop lines) turns this into a predicted platoon arrival
+// window, and max pressure counts the platoon as if it were already queued
+// once it is due within GREEN_WAVE_HORIZON_MS. Greens then line up with the
+// platoons and the offsets along a corridor form by themselves.
+//
+// Clocks: each node keeps its own millis(). Peers exchange NTP-style
+// request/reply pairs and keep the offset of the lowest round-trip sample
+// among the last GREEN_WAVE_SYNC_SAMPLES, which is all the accuracy a
+// platoon a few seconds long needs. Timing from a peer that has not been
+// synced yet is ignored.
+//
+// Messages (little endian), all led by u16 magic, u8 version, u8 type, u32 node_id:
+//   SYNC_REQUEST  u32 t1 (requester clock)
+//   SYNC_REPLY    u32 t1, u32 t2 (received), u32 t3 (sent), replier clock
+//   TIMING        u32 sent_at, u8 phase, u8 platoon_cnt, u32 green_start, u32 green_min_end,
+//                 {u32 out_lane_id, u16 vehicles, u32 depart_start, u32 depart_end}[platoon_cnt]
+// tools/green_wave_bench.py runs this module on host junctions (host/) over loopback UDP.
+
+// --- Configuration & Constants ---
+#define GREEN_WAVE_PORT 4210
+#define GREEN_WAVE_MAX_PEERS 4
+#define GREEN_WAVE_MAX_LINKS 8
+#define GREEN_WAVE_MAX_PLATOONS 16          // Outbound lanes reported per message
+#define GREEN_WAVE_SYNC_INTERVAL_MS 5000
+#define GREEN_WAVE_SYNC_SAMPLES 8
+#define GREEN_WAVE_TIMING_INTERVAL_MS 1000  // Repeated, so a lost datagram costs one interval
+#define GREEN_WAVE_HORIZON_MS 10000         // Platoons due this soon bias the decision
+#define GREEN_WAVE_HEADWAY_MS 1000          // Queue discharge per connection (LOOKAHEAD_SATURATION_VPS)
+#define GREEN_WAVE_WEIGHT 1                 // Pressure per expected platoon vehicle
+
+#define GREEN_WAVE_MAGIC 0x5747 // "GW"
+#define GREEN_WAVE_VERSION 1
+
+typedef enum {
+    GREEN_WAVE_SYNC_REQUEST = 1,
+    GREEN_WAVE_SYNC_REPLY,
+    GREEN_WAVE_TIMING
+} GreenWaveMessageType;
+
+typedef struct {
+    uint32_t messages_sent;
+    uint32_t messages_received;
+    uint32_t messages_rejected; // Bad magic/version/length or unknown sender
+    uint32_t platoons_predicted;
+} GreenWaveStats;
+
+// --- API ---
+// Forget every peer and link (before loading a new config).
+void green_wave_reset();
+
+// Returns the peer index, or -1 when GREEN_WAVE_MAX_PEERS is reached or host is not an IP address.
+int green_wave_add_peer(const char *host, uint16_t port);
+
+// Inbound lane_idx here is fed by the outbound lane peer_lane_id of peer, travel_ms away.
+bool green_wave_add_link(uint32_t lane_idx, int peer, uint32_t peer_lane_id, uint32_t travel_ms);
+
+// Opens the UDP socket. Needs WiFi; does nothing without peers.
+void green_wave_setup(uint16_t port, uint32_t node_id);
+
+// Every controller pass: receive, clock sync, periodic timing messages.
+void green_wave_update(const Intersection *intr, uint32_t current_phase_idx, unsigned long now);
+
+// On every green start: snapshots the departing platoons and announces them.
+void green_wave_phase_started(const Intersection *intr, uint32_t phase_idx, unsigned long now);
+
+// Vehicles expected on the phase's inbound lanes within GREEN_WAVE_HORIZON_MS,
+// times GREEN_WAVE_WEIGHT. 0 when coordination is off.
+int32_t green_wave_phase_bonus(const Intersection *intr, uint32_t phase_idx, unsigned long now);
+
+bool green_wave_enabled();
+const GreenWaveStats *green_wave_stats();
+
+#endif
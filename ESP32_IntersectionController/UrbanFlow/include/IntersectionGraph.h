@@ -2,6 +2,7 @@
 #define INTGRAPH_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 // --- Configuration & Constants ---
@@ -9,12 +10,33 @@
 #define MAX_CONNECTION_CNT 64 
 #define MAX_PHASE_CNT 32
 
+// Intergreen geometry. Lane bearings are taken to sit on a circle of this
+// radius and every movement drives the chord between its two bearings.
+#define INTERGREEN_JUNCTION_RADIUS_M 12.0f
+#define INTERGREEN_CROSSWALK_LENGTH_M 8.0f
+#define INTERGREEN_VEHICLE_LENGTH_M 6.0f
+#define INTERGREEN_CLEAR_SPEED_MPS 10.0f  // Last vehicle leaving on yellow
+#define INTERGREEN_ENTER_SPEED_MPS 11.1f  // First vehicle arriving on green
+#define INTERGREEN_WALK_SPEED_MPS 1.2f
+#define INTERGREEN_UNIT_MS 100            // Resolution of the clearance matrix
+
+// Optional drawn paths. Movements that both carry one are checked against
+// each other geometrically instead of by bearing order.
+#define PATH_MAX_POINTS 8                 // Per movement; arcs are split into this many points
+#define PATH_UNIT_M 0.1f                  // Stored coordinates are decimetres
+#define PATH_CLEARANCE_M 2.0f             // Default gap two paths need to be concurrent
+
+// Connection::weight is fixed point: pressure per vehicle queued on the
+// source lane. Uniform until Calibration.h has learned the movement.
+#define CONNECTION_WEIGHT_ONE 256
+
 // Error sentinel. Check against this when aitdding lanes/connections.
 #define INTGRAPH_INVALID_INDEX 0xFFFFFFFF 
 
 typedef enum {
     LANE_IN, // Traffic entering the intersection
-    LANE_OUT   // Traffic leaving the intersection
+    LANE_OUT,  // Traffic leaving the intersection
+    LANE_CROSSWALK // Pedestrian crossing over the leg at `bearing`. sensor_pin = push button, green/red = WALK/DON'T WALK
 } LaneType;
 
 typedef struct {
@@ -24,57 +46,109 @@ typedef struct {
     int16_t red_pin;
 } LaneHardware;
 
+// Cold: identity, pins and geometry. Only read at setup and on light changes.
 typedef struct {
     uint32_t id;       
     LaneType type;
-    uint32_t current_traffic_value; 
     LaneHardware hw; 
     uint16_t bearing; //Entry/exit angle - for conflict calculation 
 } Lane;
 
+// Indices are lane slots (< MAX_LANE_CNT), so a byte is enough.
 typedef struct {
-    uint32_t source_lane_idx;    
-    uint32_t target_lane_idx;    
-    uint32_t weight;        
+    uint8_t source_lane_idx;    
+    uint8_t target_lane_idx;    
+    uint16_t weight; // CONNECTION_WEIGHT_ONE = 1.0
 } Connection;
 
+// Drawn path of a movement on a junction-centred plane (x east, y north,
+// PATH_UNIT_M), same orientation as the bearings. point_cnt < 2: none.
+typedef struct {
+    int16_t x[PATH_MAX_POINTS];
+    int16_t y[PATH_MAX_POINTS];
+    uint8_t point_cnt;
+} ConnectionPath;
+
 typedef struct {
     // Bit N high means Connection N is GREEN.
     uint64_t active_connections_mask; 
+
+    // Bit N high means Lane N shows GREEN (derived from the connections).
+    uint64_t green_lanes_mask;
     
     // Duration for this specific phase. 
     // If set to 0 during init, it will inherit the Intersection's default.
     uint32_t duration_ms; 
 } Phase;
 
+// Bump allocator the Intersection arrays are carved from. The caller owns
+// the buffer (static, heap or a slab shared by many simulated junctions);
+// size it with intersection_storage_bytes(). Buffer must be 8-byte aligned.
 typedef struct {
-    // Storage
-    Lane lanes[MAX_LANE_CNT];
-    uint32_t lane_cnt;
-
-    Connection connections[MAX_CONNECTION_CNT];
-    uint32_t connection_cnt;
+    uint8_t *base;
+    size_t capacity;
+    size_t used;
+} IntersectionArena;
 
-    Phase phases[MAX_PHASE_CNT];
-    uint32_t phase_cnt;
+typedef struct {
+    // Hot: touched on every decision
+    uint16_t *lane_traffic; // Current traffic value per lane, contiguous
+    Connection *connections;
+    Phase *phases;
+    uint64_t *conflict_masks; //Conflict computation on edge device
+
+    // Cold
+    Lane *lanes;
+    // connection_cap x connection_cap, row = ending movement, column = starting one.
+    // Red clearance in INTERGREEN_UNIT_MS after the ending movement's yellow
+    // (or WALK) ends; only meaningful where conflict_masks has the pair.
+    uint8_t *clearance;
+    ConnectionPath *paths; // Per connection, optional
+
+    uint8_t lane_cnt;
+    uint8_t lane_cap;
+    uint8_t connection_cnt;
+    uint8_t connection_cap;
+    uint8_t phase_cnt;
+    uint8_t phase_cap;
 
     // Configuration
     uint32_t default_phase_duration_ms;
-
-   
+    float path_clearance_m;
 
     // Runtime State
     uint32_t current_phase_idx;
-
-    //Conflict computation on edge device
-    uint64_t conflict_masks[MAX_CONNECTION_CNT];
-
-
-
 } Intersection;
 
+// --- Storage ---
+constexpr size_t arena_align_up(size_t n, size_t align)
+{
+    return (n + align - 1) & ~(align - 1);
+}
+
+// Exact arena bytes for a junction of this size. Same order as intersection_init().
+constexpr size_t intersection_storage_bytes(uint32_t lane_cnt, uint32_t connection_cnt, uint32_t phase_cnt)
+{
+    size_t n = 0;
+    n = arena_align_up(n, alignof(uint16_t)) + lane_cnt * sizeof(uint16_t);
+    n = arena_align_up(n, alignof(Connection)) + connection_cnt * sizeof(Connection);
+    n = arena_align_up(n, alignof(Phase)) + phase_cnt * sizeof(Phase);
+    n = arena_align_up(n, alignof(uint64_t)) + connection_cnt * sizeof(uint64_t);
+    n = arena_align_up(n, alignof(Lane)) + lane_cnt * sizeof(Lane);
+    n = arena_align_up(n, alignof(ConnectionPath)) + connection_cnt * sizeof(ConnectionPath);
+    n += connection_cnt * connection_cnt * sizeof(uint8_t);
+    return n;
+}
+
+void arena_init(IntersectionArena *arena, void *buffer, size_t capacity);
+
+// Returns NULL when the arena is exhausted
+void *arena_alloc(IntersectionArena *arena, size_t size, size_t align);
+
 // --- API ---
-bool intersection_init(Intersection *intr, uint32_t default_duration_ms);
+// Carves storage for exactly lane_cap/connection_cap/phase_cap entries from the arena.
+bool intersection_init(Intersection *intr, uint32_t default_duration_ms, IntersectionArena *arena,
+                       uint32_t lane_cap, uint32_t connection_cap, uint32_t phase_cap);
 
 void intersection_reset(Intersection *intr);
 
@@ -85,6 +159,12 @@ uint32_t add_lane(Intersection *intr, uint32_t id, LaneType type, LaneHardware h
 // Returns INTGRAPH_INVALID_INDEX on failure
 uint32_t add_connection(Intersection *intr, uint32_t source_lane_idx, uint32_t target_lane_idx);
 
+// Pedestrian movements are connections from a crosswalk lane to itself, so they
+// sit in the conflict matrix with the vehicle movements. Appends one for every
+// crosswalk that has none yet; call after the configured connections so phase
+// masks keep their bit positions. Returns the number added.
+uint32_t add_crosswalk_connections(Intersection *intr);
+
 // Add a phase. 
 // Pass duration_ms = 0 to use the Intersection's default time.
 void add_phase(Intersection *intr, uint64_t connection_mask, uint32_t duration_ms);
@@ -92,8 +172,27 @@ void add_phase(Intersection *intr, uint64_t connection_mask, uint32_t duration_m
 // --- Helpers ---
 uint32_t find_lane_index_by_id(Intersection *intr, uint32_t id);
 
+// --- PATH GEOMETRY ---
+// Optional, after add_connection() and before compute_conflicts_on_device().
+// xy holds point_cnt (x, y) pairs in metres. Returns false on bad input.
+bool set_connection_path(Intersection *intr, uint32_t conn_idx, const float *xy, uint32_t point_cnt);
+
+// Circular arc around (cx, cy) from start_deg to end_deg, compass degrees
+// like the bearings (end below start sweeps anticlockwise).
+bool set_connection_arc(Intersection *intr, uint32_t conn_idx, float cx, float cy, float radius_m, float start_deg,
+                        float end_deg);
+
 // --- SAFETY CHECKS ---
+// Bearing rule, or paths closer than path_clearance_m where both movements have one
 void compute_conflicts_on_device(Intersection *intr);
 bool is_phase_safe(Intersection *intr, uint64_t phase_mask);
 
+// --- INTERGREENS ---
+// Fills the clearance matrix from lane geometry. Call after compute_conflicts_on_device().
+void compute_clearances_on_device(Intersection *intr);
+
+// ms the starting connection must wait after the ending one loses its green
+// (yellow_ms is added when the ending movement is a vehicle one). 0 if they don't conflict.
+uint32_t intergreen_ms(const Intersection *intr, uint32_t ending_conn, uint32_t starting_conn, uint32_t yellow_ms);
+
 #endif
\ No newline at end of file
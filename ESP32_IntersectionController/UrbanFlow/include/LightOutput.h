@@ -0,0 +1,102 @@
+#ifndef LIGHT_OUTPUT_H
+#define LIGHT_OUTPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Everything that drives a lamp goes through here. The pins in LaneHardware
+// are output *channels*: a GPIO number for the direct backend, a bit position
+// along the chain for shift registers and I/O expanders. set_lights() only
+// stages a frame; light_output_commit() sends the whole intersection at once.
+
+// --- Configuration & Constants ---
+#define LIGHT_OUTPUT_MAX_CHANNELS 192 // 64 lanes x red/yellow/green
+#define LIGHT_OUTPUT_FRAME_BYTES (LIGHT_OUTPUT_MAX_CHANNELS / 8)
+
+// 74HC595 chain on SPI (DMA). RCLK is wired to CS, so the rising CS edge at
+// the end of the transfer latches every register in the chain together.
+#define SHIFT_REGISTER_DATA_PIN 11
+#define SHIFT_REGISTER_CLOCK_PIN 12
+#define SHIFT_REGISTER_LATCH_PIN 10
+#define SHIFT_REGISTER_COUNT 24 // 8 channels each
+#define SHIFT_REGISTER_CLOCK_HZ 10000000
+#define SHIFT_REGISTER_OE_PIN 13  // /OE of every register, pulled up on the board: dark until set up
+
+// MCP23017 expanders, 16 channels each, at consecutive addresses
+#define I2C_EXPANDER_SDA_PIN 8
+#define I2C_EXPANDER_SCL_PIN 9
+#define I2C_EXPANDER_BASE_ADDRESS 0x20
+#define I2C_EXPANDER_COUNT 8
+#define I2C_EXPANDER_CLOCK_HZ 400000
+#define I2C_EXPANDER_RESET_PIN 14 // /RESET of every expander: pins back to inputs, lamps off
+
+#define LIGHT_OUTPUT_MOCK_FRAMES 64 // Ring of recorded frames
+
+typedef enum {
+    LIGHT_OUTPUT_GPIO,
+    LIGHT_OUTPUT_SHIFT_REGISTER,
+    LIGHT_OUTPUT_I2C_EXPANDER,
+    LIGHT_OUTPUT_MOCK // Records frames instead of driving anything (host and bench runs)
+} LightOutputKind;
+
+typedef struct {
+    uint8_t bits[LIGHT_OUTPUT_FRAME_BYTES]; // Bit N set = channel N on
+} LightFrame;
+
+typedef struct {
+    LightFrame frame;
+    uint32_t time_ms;
+} LightOutputMockRecord;
+
+// A backend moves whole frames. commit() gets the frame currently shown so
+// hardware that can't update atomically can switch lamps off before it
+// switches new ones on. blank() is the safety monitor's way in while the
+// controller holds the bus, maybe wedged inside a commit: it must take the
+// lamps safe without the bus (output registers, an enable or reset line),
+// showing frame if it can and nothing otherwise. unblank() runs with the bus
+// back: it puts frame on the lamps and lifts whatever blank() did.
+typedef struct {
+    const char *name;
+    uint16_t channel_cnt;
+    bool (*begin)();
+    void (*claim)(int16_t channel); // Every channel in use, before the first commit
+    void (*commit)(const LightFrame *shown, const LightFrame *next);
+    void (*read_back)(LightFrame *out); // What is really driven, or the last frame sent
+    void (*blank)(const LightFrame *frame);
+    void (*unblank)(const LightFrame *frame);
+} LightOutputBackend;
+
+// --- API ---
+bool light_output_setup(LightOutputKind kind);
+bool light_output_setup_backend(const LightOutputBackend *backend);
+const char *light_output_name();
+
+void light_output_claim(int16_t channel);
+
+// Staged only; nothing changes on the lamps until the next commit
+void light_output_set(int16_t channel, bool on);
+
+// Sends the staged frame in one transaction if it differs from the one shown
+void light_output_commit();
+
+// For the safety monitor (other core). Neither waits for the bus.
+// read returns false while the controller is mid-commit. force sends frame as
+// a commit when the bus is free; when it is held, the backend's blank() takes
+// the lamps safe at once and the frame follows on a later call. Returns true
+// once the frame itself is out.
+bool light_output_read(LightFrame *out);
+bool light_output_force(const LightFrame *frame);
+
+uint32_t light_output_commit_count();
+
+// Mock backend: number of frames recorded so far, and one of the last
+// LIGHT_OUTPUT_MOCK_FRAMES (0 = oldest still held). NULL if out of range.
+uint32_t light_output_mock_count();
+const LightOutputMockRecord *light_output_mock_record(uint32_t idx);
+
+static inline bool light_frame_get(const LightFrame *frame, uint16_t channel)
+{
+    return channel < LIGHT_OUTPUT_MAX_CHANNELS && ((frame->bits[channel >> 3] >> (channel & 7)) & 1);
+}
+
+#endif
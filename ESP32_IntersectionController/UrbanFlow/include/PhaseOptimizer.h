@@ -0,0 +1,55 @@
+#ifndef PHASE_OPTIMIZER_H
+#define PHASE_OPTIMIZER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "IntersectionGraph.h"
+
+// Rolling-horizon phase optimizer. At each decision it searches phase
+// sequences over the next LOOKAHEAD_HORIZON_MS in LOOKAHEAD_BLOCK_MS blocks
+// (branch-and-bound over phase orderings; repeating a phase = a longer
+// green), charging the transition loss on every switch, and returns the
+// first phase of the sequence with the least predicted queue-seconds. The
+// node budget is split evenly over the first phases, so each one is searched
+// however many phases the junction has.
+
+// --- Configuration & Constants ---
+#define LOOKAHEAD_HORIZON_MS 20000
+#define LOOKAHEAD_BLOCK_MS 5000          // Matches MIN_GREEN_TIME
+#define LOOKAHEAD_DEPTH (LOOKAHEAD_HORIZON_MS / LOOKAHEAD_BLOCK_MS)
+#define LOOKAHEAD_MAX_NODES 4096         // Hard cap so the search always fits the decision budget
+#define LOOKAHEAD_SATURATION_VPS 1.0f    // Discharge per active connection at weight 1.0, vehicles/s
+#define ARRIVAL_EWMA_ALPHA 0.2f
+
+// Per-lane arrival rates, learned from queue growth while a lane is red
+// (no departures then, so growth is pure arrivals).
+typedef struct {
+    float arrival_rate_vps[MAX_LANE_CNT];
+    uint16_t last_queue[MAX_LANE_CNT];
+    bool primed;
+} ArrivalEstimator;
+
+typedef struct {
+    uint32_t nodes;          // Search nodes expanded by the last call
+    uint32_t compute_us;     // Cost of the last call
+    uint32_t max_compute_us; // Worst call so far
+    uint32_t max_nodes;      // Largest search so far
+    uint32_t calls;
+    uint64_t total_us;       // All calls, for the mean
+    float predicted_cost;    // Queue-seconds of the chosen sequence
+} LookaheadStats;
+
+// --- API ---
+void arrival_estimator_reset(ArrivalEstimator *est);
+
+// serving_lanes: lanes that were discharging during the last elapsed_ms
+void arrival_estimator_update(ArrivalEstimator *est, const Intersection *intr, uint64_t serving_lanes, uint32_t elapsed_ms);
+
+// transition_loss_ms: yellow (+ any all-red) time lost on a switch.
+// force_switch excludes the current phase from the first block (max-out).
+// blocked_conns discharge nothing (movements into a spilled-back exit).
+int lookahead_next_phase(const Intersection *intr, const ArrivalEstimator *est, uint32_t current_phase_idx,
+                         uint32_t transition_loss_ms, bool force_switch, uint64_t blocked_conns,
+                         LookaheadStats *stats);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef POLICY_NET_H
+#define POLICY_NET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "IntersectionGraph.h"
+
+// Int8 learned phase-selection policy: a two-layer perceptron
+//   x (int8) -> ReLU(W1 x + b1) requantized to int8 -> W2 h + b2 -> argmax
+// Integer-only, no allocation, so the same code gives bit-identical
+// results on the ESP32 and on a host (tools/train_policy.py mirrors it).
+//
+// Input vector, one int8 per entry:
+//   [0, lane_cnt)                 min(lane_traffic >> queue_shift, 127)
+//   [lane_cnt, lane_cnt+phase_cnt) 127 for the current phase, else 0
+//   [lane_cnt+phase_cnt]          elapsed green in seconds, max 127
+
+// --- Configuration & Constants ---
+#define POLICY_MAX_INPUTS (MAX_LANE_CNT + MAX_PHASE_CNT + 1)
+#define POLICY_MAX_HIDDEN 32
+
+typedef struct {
+    uint8_t input_cnt;
+    uint8_t hidden_cnt;
+    uint8_t output_cnt; // == phase_cnt
+    uint8_t queue_shift;
+
+    // Hidden requantization: h = clamp((acc * hidden_mult + round) >> hidden_shift, 0, 127)
+    int32_t hidden_mult;
+    uint8_t hidden_shift;
+
+    int8_t w1[POLICY_MAX_HIDDEN][POLICY_MAX_INPUTS];
+    int32_t b1[POLICY_MAX_HIDDEN];
+    int8_t w2[MAX_PHASE_CNT][POLICY_MAX_HIDDEN];
+    int32_t b2[MAX_PHASE_CNT];
+
+    bool loaded;
+} PolicyNet;
+
+// --- API ---
+void policy_reset(PolicyNet *net);
+
+// Checks the shape against the loaded intersection and marks the net usable.
+bool policy_validate(PolicyNet *net, const Intersection *intr);
+
+void policy_build_input(const PolicyNet *net, const Intersection *intr, uint32_t current_phase_idx,
+                        uint32_t green_elapsed_ms, int8_t *x);
+
+// Returns the phase with the highest logit (lowest index on ties).
+// logits may be NULL; otherwise it receives output_cnt values.
+int policy_infer(const PolicyNet *net, const int8_t *x, int32_t *logits);
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef QUEUE_ESTIMATOR_H
+#define QUEUE_ESTIMATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "IntersectionGraph.h"
+
+// Per-lane queue estimate with its uncertainty: a scalar Kalman filter in
+// fixed point (Q8, 1/256 vehicle), so a step over MAX_LANE_CNT lanes costs
+// the same every time and needs no FPU.
+//
+// Predict: the queue grows by the upstream arrivals (counted, or the lane's
+// expected rate from its demand reading) and, while the lane is served,
+// shrinks by the stop-line departures (counted, or saturation flow).
+// Expected counts add their Poisson variance; counted ones add only the
+// detector miss rate.
+//
+// Correct: a direct queue reading (a count sensor, or the simulation's own
+// queue) is fused by Kalman gain. A stop-line detector on red says whether
+// the queue reaches the line at all: occupied means at least one vehicle,
+// clear means none.
+//
+// The controller writes the estimate into lane_traffic, so max pressure,
+// lookahead and the policy all run on it.
+
+// --- Configuration & Constants ---
+#define QUEUE_ESTIMATOR_PERIOD_MS 100 // Sensor frame rate
+#define QUEUE_Q8 256
+#define QUEUE_MAX (255 * QUEUE_Q8)
+#define QUEUE_MAX_VARIANCE (64 * 64 * QUEUE_Q8)  // Stddev cap of 64 vehicles, however long it runs open loop
+#define QUEUE_SATURATION_Q8 (QUEUE_Q8 / 2)        // 0.5 veh/s per lane at the stop line (the simulation's discharge)
+#define QUEUE_COUNT_MISS_PERMILLE 20              // Counted vehicles: variance per vehicle
+#define QUEUE_READING_VARIANCE (QUEUE_Q8 / 4)     // Direct queue reading: 0.5 vehicle stddev
+#define QUEUE_OCCUPANCY_VARIANCE QUEUE_Q8         // Stop-line detector: 1 vehicle stddev
+
+// What feeds a lane besides its expected rate (bitmask per lane)
+typedef enum {
+    QUEUE_SOURCE_ARRIVALS = 1,   // Upstream counts
+    QUEUE_SOURCE_DEPARTURES = 2, // Stop-line counts while green
+    QUEUE_SOURCE_OCCUPANCY = 4,  // Stop-line presence while red
+    QUEUE_SOURCE_READING = 8     // Direct queue length
+} QueueSource;
+
+typedef struct {
+    int32_t queue_q8[MAX_LANE_CNT];
+    int32_t variance_q8[MAX_LANE_CNT];  // vehicles^2, Q8
+    uint32_t rate_q8[MAX_LANE_CNT];     // Expected arrivals per second, Q8
+    uint8_t sources[MAX_LANE_CNT];
+
+    // Measurements since the last step
+    uint16_t arrivals[MAX_LANE_CNT];
+    uint16_t departures[MAX_LANE_CNT];
+    uint16_t reading[MAX_LANE_CNT];
+    uint64_t read_lanes;
+    uint64_t occupied_lanes;
+    uint64_t occupancy_lanes; // Lanes whose detector reported since the last step
+
+    uint32_t steps;
+    uint32_t last_step_us;
+    uint32_t max_step_us;
+} QueueEstimator;
+
+// --- API ---
+void queue_estimator_reset(QueueEstimator *est);
+
+// Which measurements lane_idx has (QueueSource bits).
+void queue_estimator_attach(QueueEstimator *est, uint32_t lane_idx, uint8_t sources);
+
+// Expected arrivals per second, for lanes without upstream counts.
+void queue_estimator_set_rate(QueueEstimator *est, uint32_t lane_idx, uint32_t rate_q8);
+
+// Measurements, any time between steps.
+void queue_estimator_count(QueueEstimator *est, uint32_t lane_idx, uint16_t arrivals, uint16_t departures);
+void queue_estimator_occupancy(QueueEstimator *est, uint32_t lane_idx, bool occupied);
+void queue_estimator_reading(QueueEstimator *est, uint32_t lane_idx, uint16_t queue);
+
+// One predict/correct step over every inbound lane. serving_lanes are the
+// lanes discharging (green, or still on yellow).
+void queue_estimator_step(QueueEstimator *est, const Intersection *intr, uint64_t serving_lanes, uint32_t elapsed_ms);
+
+// Estimate in whole vehicles (rounded), and its standard deviation.
+uint16_t queue_estimate(const QueueEstimator *est, uint32_t lane_idx);
+float queue_estimate_stddev(const QueueEstimator *est, uint32_t lane_idx);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef RING_BARRIER_H
+#define RING_BARRIER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "IntersectionGraph.h"
+
+// Dual-ring (or more) barrier phase model. A movement is a signal group of
+// inbound lanes and every connection out of them. Movements are placed on
+// rings and between barriers: within one barrier group, every movement of a
+// ring is compatible with every movement of every other ring, so each ring
+// can end its movement and start the next one in its sequence on its own
+// while the others keep their green. A barrier is crossed only once every
+// ring has run out of demand (or max green) in its group.
+//
+// The controller still drives one Phase at a time: the model loads one
+// composite phase per combination of ring movements in a barrier group, and
+// switching a single ring is a transition between two composites that share
+// the other rings' lanes, so those carry straight through the intergreen.
+// Safety stays with the conflict matrix, the clearance matrix and the safety
+// monitor as for any other phase.
+//
+// Config ("ring_barrier" in the dashboard JSON): either true, to build the
+// rings from the conflict matrix, or
+//   {"barriers": [ [ [movement, ...] per ring ] per barrier group ]}
+// where a movement is an inbound lane id, or {"lanes": [ids], "max_green_ms": n}.
+// The composites replace the configured phases while the model is loaded.
+
+// --- Configuration & Constants ---
+#define RING_MAX_RINGS 4
+#define RING_MAX_BARRIERS 8
+#define RING_MAX_MOVEMENTS 16
+#define RING_NONE 0xFF // Ring with no movement in a barrier group
+
+typedef struct {
+    uint64_t lanes;
+    uint64_t connections;
+    uint32_t max_green_ms; // 0 = controller default
+    uint8_t ring;
+    uint8_t barrier;
+} RingMovement;
+
+// --- API ---
+// Forget the model (before loading a new config).
+void ring_barrier_reset();
+
+// Explicit layout, in service order within each ring. Returns the movement
+// index, or -1 when a limit is reached or a lane is not inbound or already used.
+int ring_barrier_add_movement(const Intersection *intr, const uint32_t *lane_idx, uint32_t lane_cnt, uint8_t ring,
+                              uint8_t barrier, uint32_t max_green_ms);
+
+// Derives movements, rings and barriers from the conflict matrix (two rings).
+// Call after compute_conflicts_on_device(). Returns false if nothing fits.
+bool ring_barrier_build_auto(const Intersection *intr);
+
+// Checks every barrier group is concurrent across rings, then loads one
+// composite phase per ring combination with add_phase(). The intersection
+// must have no phases yet and room for them. False leaves the model unloaded.
+bool ring_barrier_load_phases(Intersection *intr);
+
+bool ring_barrier_active();
+
+// On every green start: rings whose movement changed restart their timers.
+void ring_barrier_phase_started(uint32_t phase_idx, unsigned long now);
+
+// Time each ring has been timing its movement, RING_MAX_RINGS entries.
+// Returns the ring count, 0 while the model is not loaded.
+uint8_t ring_barrier_elapsed(unsigned long now, uint32_t *elapsed_ms);
+
+// Composite phase to run next: every ring past min green whose movement has
+// no demand left (or reached its max green) moves on to the next movement in
+// its sequence with demand; once all rings are done, the next barrier group
+// with demand starts. Returns current_phase when nothing changes. Demand is
+// the queue on a movement's open connections (not in blocked_conns), or a
+// detector call (called_lanes) on an empty lane; ring_elapsed_ms as filled
+// by ring_barrier_elapsed().
+uint32_t ring_barrier_next_phase(const Intersection *intr, uint32_t current_phase, const uint32_t *ring_elapsed_ms,
+                                 uint64_t blocked_conns, uint64_t called_lanes, uint32_t min_green_ms,
+                                 uint32_t max_green_ms);
+
+uint32_t ring_barrier_movement_cnt();
+const RingMovement *ring_barrier_movement(uint32_t movement_idx);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef SAFETY_MONITOR_H
+#define SAFETY_MONITOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "IntersectionGraph.h"
+#include "LightOutput.h"
+
+// --- Configuration & Constants ---
+#define SAFETY_MONITOR_PERIOD_MS 1          // 1 kHz sampling of the light outputs
+#define SAFETY_HEARTBEAT_TIMEOUT_MS 2000    // controller_loop() must check in faster than this
+#define SAFETY_MONITOR_CORE 0               // Arduino loop() runs on core 1
+
+typedef enum {
+    SAFETY_OK,
+    SAFETY_FAULT_CONFLICTING_GREEN,
+    SAFETY_FAULT_STALE_HEARTBEAT
+} SafetyFault;
+
+// Private copy of everything the monitor needs. Built once from the
+// Intersection so a corrupted controller state cannot disable the checks.
+typedef struct {
+    // Where lane i's green channel sits in a LightFrame (bit 0 = lane has no green)
+    uint8_t lane_green_byte[MAX_LANE_CNT];
+    uint8_t lane_green_bit[MAX_LANE_CNT];
+    // Connections whose source is lane i
+    uint64_t lane_connections[MAX_LANE_CNT];
+    uint64_t conflict_masks[MAX_CONNECTION_CNT];
+
+    // Channel masks used to build the fallback frame
+    LightFrame green_yellow_channels;
+    LightFrame red_channels;
+} SafetyTables;
+
+// --- API ---
+void safety_build_tables(SafetyTables *tables, const Intersection *intr);
+
+// Pure check, usable without hardware. Constant time: always walks
+// MAX_LANE_CNT lanes and MAX_CONNECTION_CNT connections.
+// Returns the mask of connections that are green together with an enemy.
+uint64_t safety_check_outputs(const SafetyTables *tables, const LightFrame *output_levels);
+
+// Starts the high-priority sampling task. Call after initialize_hardware().
+void safety_monitor_setup(const Intersection *intr);
+
+// Called by the controller on every loop pass.
+void safety_monitor_heartbeat();
+
+// Once tripped the monitor latches all-red until reboot.
+bool safety_monitor_tripped();
+SafetyFault safety_monitor_fault();
+
+// Worst case execution time of one sample+check, measured on device.
+// host/safety_wcet.cpp times the check alone on a host (make wcet).
+uint32_t safety_monitor_wcet_us();
+
+#endif
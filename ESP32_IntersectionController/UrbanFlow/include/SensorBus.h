@@ -0,0 +1,147 @@
+#ifndef SENSOR_BUS_H
+#define SENSOR_BUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "IntersectionGraph.h"
+
+// Multi-drop RS-485 bus to the acquisition nodes. The controller is the only
+// master: it polls every node in turn, each inside its own time slot, and a
+// node only ever speaks to answer a poll addressed to it, so the half-duplex
+// pair never has two talkers. One pass over the nodes is a cycle. A cycle
+// starts every SENSOR_BUS_CYCLE_MS (back to back if the slots need longer)
+// and its readings reach the controller as one sensor frame, so every node
+// adds its channels to each frame and no reading is older than
+// sensor_bus_latency_bound_us().
+//
+// Frame (little endian):
+//   u8 SYNC0, u8 SYNC1, u8 address, u8 type, u8 seq, u8 len, payload[len],
+//   u16 CRC-16/CCITT-FALSE over address..payload
+//   POLL     controller -> node, no payload; seq numbers the poll
+//   DATA     node -> controller, same seq: u8 n, u16 reading[n] (0..1023)
+//   PREEMPT  node -> controller, in place of DATA while an emergency detector
+//            calls: DATA's payload, then u16 calls, a bit per channel whose
+//            lane the emergency vehicle approaches on
+//
+// Which lane a node's channel k reads comes from the config:
+//   "sensor_bus": {"nodes": [{"address": 1, "lanes": [lane id per channel]}, ...]}
+// Without it, node 1 carries every inbound lane in config order. A node that
+// misses SENSOR_BUS_OFFLINE_MISSES polls in a row is offline and only retried
+// every SENSOR_BUS_RETRY_CYCLES cycles, so a dead cabinet costs the others no
+// latency; its lanes then time out in SensorHealth. Slots are sized for a
+// PREEMPT reply, so a calling node never overruns its slot.
+
+// --- Configuration & Constants ---
+#define SENSOR_BUS_BAUD 115200
+#define SENSOR_BUS_MAX_NODES 16
+#define SENSOR_BUS_MAX_CHANNELS 16    // Per node
+#define SENSOR_BUS_CYCLE_MS 100       // The point-to-point link's frame rate
+#define SENSOR_BUS_TURNAROUND_US 1000 // A node's poll-to-reply budget
+#define SENSOR_BUS_NODE_SAMPLE_MS 20  // Nodes re-read their channels this often
+#define SENSOR_BUS_SLOT_MARGIN_US 500
+#define SENSOR_BUS_OFFLINE_MISSES 3
+#define SENSOR_BUS_RETRY_CYCLES 10
+#define SENSOR_BUS_NO_LANE 0xFF       // Channel not wired to a configured lane
+
+#define SENSOR_BUS_SYNC0 0xA5
+#define SENSOR_BUS_SYNC1 0x5A
+#define SENSOR_BUS_HEADER_BYTES 6
+#define SENSOR_BUS_CRC_BYTES 2
+#define SENSOR_BUS_MAX_PAYLOAD (1 + 2 * SENSOR_BUS_MAX_CHANNELS + 2)
+#define SENSOR_BUS_MAX_FRAME (SENSOR_BUS_HEADER_BYTES + SENSOR_BUS_MAX_PAYLOAD + SENSOR_BUS_CRC_BYTES)
+
+typedef enum {
+    SENSOR_BUS_POLL = 1,
+    SENSOR_BUS_DATA = 2,
+    SENSOR_BUS_PREEMPT = 3
+} SensorBusFrameType;
+
+typedef struct {
+    uint8_t address;
+    uint8_t type;
+    uint8_t seq;
+    uint8_t len;
+    uint8_t payload[SENSOR_BUS_MAX_PAYLOAD];
+} SensorBusFrame;
+
+// Byte-at-a-time receiver; resynchronises on the sync bytes after any error
+typedef struct {
+    uint8_t buf[SENSOR_BUS_MAX_FRAME];
+    uint8_t pos;
+    uint32_t crc_errors;
+    uint32_t skipped_bytes; // Outside any frame: line noise or a lost sync
+} SensorBusParser;
+
+typedef struct {
+    uint8_t address;
+    uint8_t channel_cnt;
+    uint8_t lane_idx[SENSOR_BUS_MAX_CHANNELS];
+    uint32_t slot_us;
+
+    uint32_t polls;
+    uint32_t replies;
+    uint32_t missed;       // No valid reply inside the slot
+    uint32_t crc_errors;   // Corrupt frames inside its slot
+    uint32_t max_reply_us; // Poll handed out to reply complete
+    uint8_t misses_in_row;
+    bool offline;
+} SensorBusNode;
+
+typedef struct {
+    SensorBusNode nodes[SENSOR_BUS_MAX_NODES];
+    uint32_t node_cnt;
+    uint32_t baud;
+    SensorBusParser parser;
+
+    int32_t current;           // Node holding the slot, -1 = between cycles
+    bool replied;
+    uint8_t seq;
+    unsigned long cycle_start_us;
+    unsigned long slot_start_us;
+    uint16_t values[MAX_LANE_CNT];
+    uint64_t cycle_lanes;      // Lanes read so far this cycle
+    uint64_t frame_lanes;      // Last finished cycle, until taken
+    bool frame_ready;
+    uint64_t preempt_lanes;    // Called since last taken
+
+
+    uint32_t cycles;
+    uint32_t max_cycle_us;
+    uint32_t stray_frames;     // Valid, but not the answer to the running poll
+    uint32_t preempt_calls;    // PREEMPT replies accepted
+} SensorBus;
+
+// --- API ---
+// Frame level, shared by both ends of the bus.
+uint16_t sensor_bus_crc16(const uint8_t *data, uint32_t len);
+uint32_t sensor_bus_encode(uint8_t *out, uint8_t address, uint8_t type, uint8_t seq, const uint8_t *payload,
+                           uint8_t len);
+// True when byte completes a frame with a good CRC, copied to out.
+bool sensor_bus_parse(SensorBusParser *parser, uint8_t byte, SensorBusFrame *out);
+// Bytes on the wire for a frame with this payload, and their time at baud.
+uint32_t sensor_bus_frame_us(uint32_t baud, uint32_t payload_len);
+
+// Controller side.
+void sensor_bus_init(SensorBus *bus, uint32_t baud);
+// lane_idx per channel (SENSOR_BUS_NO_LANE for spare ones). Returns the node
+// index, or -1 when the bus is full, the address is taken or out of 1..247.
+int sensor_bus_add_node(SensorBus *bus, uint8_t address, const uint8_t *lane_idx, uint32_t channel_cnt);
+
+// Every pass. When a poll is due, writes it to out (SENSOR_BUS_MAX_FRAME
+// bytes) and returns its length; the caller sends it at once.
+uint32_t sensor_bus_poll(SensorBus *bus, unsigned long now_us, uint8_t *out);
+// Whatever the line delivered since the last call.
+void sensor_bus_receive(SensorBus *bus, const uint8_t *data, uint32_t len, unsigned long now_us);
+// Once per finished cycle: readings into values (by lane), lanes read into
+// reported_lanes. Lanes not read keep their previous value.
+bool sensor_bus_take_frame(SensorBus *bus, uint16_t *values, uint64_t *reported_lanes);
+// Every pass: lanes an emergency detector called for since the last call,
+// without waiting for the cycle to finish.
+uint64_t sensor_bus_take_preemption(SensorBus *bus);
+
+// Oldest a reading can be when the controller uses it: one node sample
+// interval before the poll, one cycle of slots to reach the controller, one
+// cycle period until the next frame replaces it.
+uint32_t sensor_bus_latency_bound_us(const SensorBus *bus);
+
+#endif
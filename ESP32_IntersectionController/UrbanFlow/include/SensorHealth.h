@@ -0,0 +1,55 @@
+#ifndef SENSOR_HEALTH_H
+#define SENSOR_HEALTH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "IntersectionGraph.h"
+
+// Watches the per-lane values coming from the acquisition unit and decides
+// which ones can be trusted. Healthy lanes also teach a per-lane demand
+// profile in 15-minute slots, kept in flash (NVS). While a sensor is flagged
+// the controller gets the learned value for this time of day instead.
+
+// --- Configuration & Constants ---
+#define SENSOR_MAX_VALUE 1023             // 10-bit ADC on the acquisition unit
+#define SENSOR_FRAME_TIMEOUT_MS 3000      // Frames normally arrive every 100 ms
+#define SENSOR_RAIL_MARGIN 4              // Within this of 0 / max counts as pinned to a rail
+#define SENSOR_STUCK_MS 120000            // Pinned to a rail this long = stuck
+#define SENSOR_NOISE_BAND 2               // A live ADC never sits closer than this
+#define SENSOR_FLATLINE_MS 600000         // No change at all this long = dead
+#define SENSOR_MAX_STEP 600               // Jump between consecutive frames nothing physical produces
+#define SENSOR_MAX_JUMPS_PER_MIN 5
+#define SENSOR_RECOVERY_MS 30000          // Clean readings needed before trusting a sensor again
+
+#define SENSOR_PROFILE_SLOT_MIN 15
+#define SENSOR_PROFILE_SLOTS (24 * 60 / SENSOR_PROFILE_SLOT_MIN)
+#define SENSOR_PROFILE_UNKNOWN 0xFF       // Slot not learned yet
+#define SENSOR_PROFILE_WEIGHT 4           // New day counts 1/4 against the history
+
+typedef enum {
+    SENSOR_OK,
+    SENSOR_MISSING,    // No frames for this lane
+    SENSOR_STUCK,      // Pinned to a rail
+    SENSOR_FLATLINE,   // Value never moves
+    SENSOR_IMPLAUSIBLE // Jumps faster than traffic can
+} SensorStatus;
+
+// --- API ---
+// Loads the stored profiles for the configured lanes.
+void sensor_health_setup(const Intersection *intr);
+
+// After each frame from the acquisition unit. values is indexed by lane,
+// reported_lanes has a bit for every lane present in the frame.
+void sensor_health_on_frame(const Intersection *intr, const uint16_t *values, uint64_t reported_lanes, unsigned long now);
+
+// Every controller pass: frame timeouts, profile slot rollover, persistence.
+void sensor_health_update(const Intersection *intr, unsigned long now);
+
+// Value the controller should use for lane_idx: the live reading while the
+// sensor is healthy, otherwise the learned profile (or the last good reading).
+uint16_t sensor_demand(uint32_t lane_idx);
+
+SensorStatus sensor_status(uint32_t lane_idx);
+const char *sensor_status_name(SensorStatus status);
+
+#endif
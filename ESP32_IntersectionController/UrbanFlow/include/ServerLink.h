@@ -0,0 +1,39 @@
+#ifndef SERVER_LINK_H
+#define SERVER_LINK_H
+
+#include <Arduino.h>
+
+// One long-lived HTTPS connection to the dashboard server, shared by the
+// config fetch and status reporting. The TLS session stays open between
+// requests (HTTP keep-alive), so only the first request - or the first one
+// after the server drops us - pays the handshake.
+
+// --- Configuration & Constants ---
+#define SERVER_LINK_TIMEOUT_MS 5000
+#define SERVER_LINK_BACKOFF_MIN_MS 500
+#define SERVER_LINK_BACKOFF_MAX_MS 30000
+
+// Returned instead of an HTTP code while waiting out a reconnect backoff
+#define SERVER_LINK_ERROR_BACKOFF -100
+
+typedef struct {
+    uint32_t requests;
+    uint32_t handshakes;     // New TLS connections opened
+    uint32_t failures;
+    uint32_t last_latency_ms;
+} ServerLinkStats;
+
+// --- API ---
+void server_link_setup();
+
+// Return the HTTP status code, a negative HTTPClient error, or
+// SERVER_LINK_ERROR_BACKOFF. body (may be NULL) receives the response.
+int server_link_get(const char *url, String *body);
+int server_link_post(const String &url, const String &payload, String *body);
+
+// Milliseconds until the next connection attempt is allowed (0 = now)
+uint32_t server_link_backoff_remaining();
+
+const ServerLinkStats *server_link_stats();
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef SPILLBACK_H
+#define SPILLBACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "IntersectionGraph.h"
+
+// Downstream spillback on the exit (LANE_OUT) lanes. Each exit has a storage,
+// the vehicles that fit between this junction and the next stop line (config
+// "storage" on the lane), and up to two occupancy inputs:
+//
+//   queue      vehicles standing on the exit, from the sensor link (the exit
+//              lane's id in a frame, 0..SPILLBACK_READING_FULL = empty..full),
+//              a neighbouring controller, or the simulation
+//   detector   a presence detector on the exit lane's sensor_pin, just past
+//              the junction (EXIT_DETECTORS): occupied for long means standing
+//
+// An exit blocks when its queue reaches SPILLBACK_ON_PERCENT of storage or
+// its detector has been occupied for SPILLBACK_OCCUPIED_MS, and clears only
+// once the queue is down to SPILLBACK_OFF_PERCENT and the detector has been
+// free for SPILLBACK_CLEAR_MS. Movements into a blocked exit carry no
+// pressure, so the controller gives no green to vehicles that could only stop
+// in the box and lock the cross streets. An inbound lane whose every movement
+// is blocked is held: kept red, or ended with its yellow, even while the rest
+// of its phase runs.
+
+// --- Configuration & Constants ---
+#define SPILLBACK_DEFAULT_STORAGE 20      // Vehicles, when the config gives none
+#define SPILLBACK_READING_FULL 1023       // Sensor link value for a full exit
+#define SPILLBACK_ON_PERCENT 90
+#define SPILLBACK_OFF_PERCENT 60
+#define SPILLBACK_OCCUPIED_MS 4000        // Detector occupied this long: traffic stands on it
+#define SPILLBACK_CLEAR_MS 2000           // Detector free this long: moving again
+#define SPILLBACK_READING_TIMEOUT_MS 5000 // A queue input gone quiet stops counting
+
+typedef struct {
+    uint32_t events;           // Exits that became blocked
+    uint32_t blocked_ms;       // Summed over exits
+    uint64_t blocked_lanes;
+    uint64_t blocked_conns;    // Movements into those exits
+    uint64_t held_lanes;       // Inbound lanes with nowhere to go
+    uint32_t holds;            // Inbound lanes that became held
+} SpillbackStats;
+
+// --- API ---
+// Forget the storages (before loading a new config).
+void spillback_reset();
+void spillback_set_storage(uint32_t lane_idx, uint16_t vehicles);
+uint16_t spillback_storage(uint32_t lane_idx);
+
+// Clears the state; exits without a storage get the default.
+void spillback_setup(const Intersection *intr, bool use_detectors, unsigned long now);
+
+// Queue inputs: vehicles, or a sensor link reading scaled to the storage.
+void spillback_queue(uint32_t lane_idx, uint16_t vehicles, unsigned long now);
+void spillback_reading(uint32_t lane_idx, uint16_t value, unsigned long now);
+
+// Every controller pass: detectors, hysteresis, logging and recording.
+void spillback_update(const Intersection *intr, unsigned long now);
+
+uint64_t spillback_blocked_lanes();
+uint64_t spillback_blocked_connections();
+uint64_t spillback_held_lanes();
+const SpillbackStats *spillback_stats();
+
+#endif
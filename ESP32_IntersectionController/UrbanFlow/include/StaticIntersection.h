@@ -0,0 +1,230 @@
+#ifndef STATIC_INTERSECTION_H
+#define STATIC_INTERSECTION_H
+
+#include <stdint.h>
+#include <string.h>
+#include "IntersectionGraph.h"
+
+// Compile-time intersection definitions for fixed deployments.
+// Everything below is constexpr: the conflict matrix, the phase safety
+// verdict and the per-phase lane output masks are computed by the compiler
+// and the finished tables land in flash (.rodata). Loading one at boot is a
+// plain copy - no JSON, no heap, no conflict computation.
+
+// --- Geometry (shared with compute_conflicts_on_device) ---
+
+// ABAB test on the bearings of two movements. srcA/srcB are lane ids so
+// movements from the same lane (diverge) or into the same lane (merge) are
+// never conflicts. The four points are insertion sorted, which is stable,
+// so ties resolve exactly like they always have at runtime.
+constexpr bool bearing_paths_cross(uint32_t src_id_a, uint16_t src_bearing_a, uint32_t tgt_id_a, uint16_t tgt_bearing_a,
+                                   uint32_t src_id_b, uint16_t src_bearing_b, uint32_t tgt_id_b, uint16_t tgt_bearing_b)
+{
+    if (src_id_a == src_id_b) // if both start from the same point then they diverge(SAFE)
+        return false;
+
+    // Merges are allowed for this demo
+    if (tgt_id_a == tgt_id_b)
+        return false;
+
+    uint16_t angle[4] = {src_bearing_a, tgt_bearing_a, src_bearing_b, tgt_bearing_b};
+    int owner[4] = {0, 0, 1, 1};
+
+    for (int i = 1; i < 4; i++)
+    {
+        uint16_t a = angle[i];
+        int o = owner[i];
+        int j = i - 1;
+        while (j >= 0 && angle[j] > a)
+        {
+            angle[j + 1] = angle[j];
+            owner[j + 1] = owner[j];
+            j--;
+        }
+        angle[j + 1] = a;
+        owner[j + 1] = o;
+    }
+
+    // Crossed: 0 -> 1 -> 0 -> 1 (ABAB). Safe: 0 -> 0 -> 1 -> 1 (AABB)
+    return (owner[0] != owner[1]) && (owner[1] != owner[2]);
+}
+
+// A crosswalk blocks every vehicle movement that enters or leaves through the
+// leg it crosses. Crosswalks never conflict with each other.
+constexpr bool lanes_paths_cross(const Lane &srcA, const Lane &tgtA, const Lane &srcB, const Lane &tgtB)
+{
+    bool walk_a = srcA.type == LANE_CROSSWALK;
+    bool walk_b = srcB.type == LANE_CROSSWALK;
+
+    if (walk_a && walk_b)
+        return false;
+    if (walk_a)
+        return srcB.bearing == srcA.bearing || tgtB.bearing == srcA.bearing;
+    if (walk_b)
+        return srcA.bearing == srcB.bearing || tgtA.bearing == srcB.bearing;
+
+    return bearing_paths_cross(srcA.id, srcA.bearing, tgtA.id, tgtA.bearing,
+                               srcB.id, srcB.bearing, tgtB.id, tgtB.bearing);
+}
+
+// --- Definition types ---
+
+typedef struct {
+    uint32_t id;
+    LaneType type;
+    LaneHardware hw; // Pins exactly as wired - no red/green swap like the JSON path
+    uint16_t bearing;
+} StaticLaneDef;
+
+typedef struct {
+    uint8_t source_lane_idx;
+    uint8_t target_lane_idx;
+} StaticConnectionDef;
+
+typedef struct {
+    uint64_t active_connections_mask;
+    uint32_t duration_ms; // 0 inherits the default
+} StaticPhaseDef;
+
+template <uint32_t LANES, uint32_t CONNS, uint32_t PHASES>
+struct StaticIntersection {
+    static_assert(LANES > 0 && LANES <= MAX_LANE_CNT, "Lane count out of range");
+    static_assert(CONNS > 0 && CONNS <= MAX_CONNECTION_CNT, "Connection count out of range");
+    static_assert(PHASES > 0 && PHASES <= MAX_PHASE_CNT, "Phase count out of range");
+
+    uint32_t default_phase_duration_ms;
+    Lane lanes[LANES];
+    Connection connections[CONNS];
+    Phase phases[PHASES];
+    uint64_t conflict_masks[CONNS];
+
+    // Structural checks that cannot be expressed as static_assert inside the builder
+    bool valid;
+};
+
+// --- Builder ---
+
+template <uint32_t LANES, uint32_t CONNS, uint32_t PHASES>
+constexpr StaticIntersection<LANES, CONNS, PHASES> make_static_intersection(uint32_t default_duration_ms,
+                                                                            const StaticLaneDef (&lanes)[LANES],
+                                                                            const StaticConnectionDef (&conns)[CONNS],
+                                                                            const StaticPhaseDef (&phases)[PHASES])
+{
+    StaticIntersection<LANES, CONNS, PHASES> s{};
+    s.default_phase_duration_ms = default_duration_ms;
+    s.valid = true;
+
+    for (uint32_t i = 0; i < LANES; i++)
+    {
+        s.lanes[i].id = lanes[i].id;
+        s.lanes[i].type = lanes[i].type;
+        s.lanes[i].hw = lanes[i].hw;
+        s.lanes[i].bearing = lanes[i].bearing;
+
+        for (uint32_t j = 0; j < i; j++)
+            if (lanes[j].id == lanes[i].id)
+                s.valid = false; // duplicate id
+    }
+
+    for (uint32_t c = 0; c < CONNS; c++)
+    {
+        if (conns[c].source_lane_idx >= LANES || conns[c].target_lane_idx >= LANES)
+        {
+            s.valid = false;
+            continue;
+        }
+        s.connections[c].source_lane_idx = conns[c].source_lane_idx;
+        s.connections[c].target_lane_idx = conns[c].target_lane_idx;
+        s.connections[c].weight = CONNECTION_WEIGHT_ONE;
+    }
+
+    if (!s.valid)
+        return s;
+
+    // Same pair order (i < j) as compute_conflicts_on_device()
+    for (uint32_t i = 0; i < CONNS; i++)
+    {
+        for (uint32_t j = i + 1; j < CONNS; j++)
+        {
+            const Lane &srcA = s.lanes[s.connections[i].source_lane_idx];
+            const Lane &tgtA = s.lanes[s.connections[i].target_lane_idx];
+            const Lane &srcB = s.lanes[s.connections[j].source_lane_idx];
+            const Lane &tgtB = s.lanes[s.connections[j].target_lane_idx];
+
+            if (lanes_paths_cross(srcA, tgtA, srcB, tgtB))
+            {
+                s.conflict_masks[i] |= ((uint64_t)1 << j);
+                s.conflict_masks[j] |= ((uint64_t)1 << i);
+            }
+        }
+    }
+
+    for (uint32_t p = 0; p < PHASES; p++)
+    {
+        uint64_t mask = phases[p].active_connections_mask;
+        if (CONNS < 64 && (mask >> CONNS) != 0)
+            s.valid = false; // references a connection that does not exist
+
+        s.phases[p].active_connections_mask = mask;
+        s.phases[p].duration_ms = phases[p].duration_ms > 0 ? phases[p].duration_ms : default_duration_ms;
+
+        uint64_t green_lanes = 0;
+        for (uint32_t c = 0; c < CONNS; c++)
+            if (mask & ((uint64_t)1 << c))
+                green_lanes |= ((uint64_t)1 << s.connections[c].source_lane_idx);
+        s.phases[p].green_lanes_mask = green_lanes;
+    }
+
+    return s;
+}
+
+// --- Compile-time checks ---
+
+template <uint32_t LANES, uint32_t CONNS, uint32_t PHASES>
+constexpr bool static_phase_is_safe(const StaticIntersection<LANES, CONNS, PHASES> &s, uint32_t phase_idx)
+{
+    uint64_t mask = s.phases[phase_idx].active_connections_mask;
+    for (uint32_t c = 0; c < CONNS; c++)
+        if (((mask >> c) & 1) && (mask & s.conflict_masks[c]))
+            return false;
+    return true;
+}
+
+template <uint32_t LANES, uint32_t CONNS, uint32_t PHASES>
+constexpr bool static_intersection_is_safe(const StaticIntersection<LANES, CONNS, PHASES> &s)
+{
+    if (!s.valid)
+        return false;
+    for (uint32_t p = 0; p < PHASES; p++)
+        if (!static_phase_is_safe(s, p))
+            return false;
+    return true;
+}
+
+// --- Boot ---
+
+// Copies a verified plan into the runtime Intersection. No parsing, no heap:
+// storage is a static buffer sized exactly for this plan. Clearance times
+// need trigonometry, so those are filled in here rather than by the compiler.
+template <uint32_t LANES, uint32_t CONNS, uint32_t PHASES>
+bool intersection_load_static(Intersection *intr, const StaticIntersection<LANES, CONNS, PHASES> &s)
+{
+    alignas(8) static uint8_t storage[intersection_storage_bytes(LANES, CONNS, PHASES)];
+    IntersectionArena arena;
+    arena_init(&arena, storage, sizeof(storage));
+
+    if (!intersection_init(intr, s.default_phase_duration_ms, &arena, LANES, CONNS, PHASES))
+        return false;
+
+    memcpy(intr->lanes, s.lanes, sizeof(s.lanes));
+    memcpy(intr->connections, s.connections, sizeof(s.connections));
+    memcpy(intr->phases, s.phases, sizeof(s.phases));
+    memcpy(intr->conflict_masks, s.conflict_masks, sizeof(s.conflict_masks));
+    intr->lane_cnt = LANES;
+    intr->connection_cnt = CONNS;
+    intr->phase_cnt = PHASES;
+    compute_clearances_on_device(intr);
+    return true;
+}
+
+#endif
@@ -2,11 +2,44 @@
 #define TRAFFIC_CONTROLLER_H
 
 #include <Arduino.h>
+#include "FlightRecorder.h"
 #include "IntersectionGraph.h"
+#include "PolicyNet.h"
+#include "QueueEstimator.h"
+
+enum ControllerState {
+    STATE_GREEN_RUNNING,
+    STATE_YELLOW_TRANSITION, // Intergreen: yellows, clearances and carried-over greens
+    STATE_PEDESTRIAN_RED,
+    STATE_PREEMPT_CLEARANCE, // Intergreen toward the emergency approach
+    STATE_PREEMPT_HOLD       // Emergency approach green, everything else red
+};
+
+extern const uint32_t MIN_GREEN_TIME; // No decision ends a green sooner
 
 extern Intersection intr;
+extern PolicyNet policy;
+extern ControllerState current_state;
+extern uint32_t current_phase_idx;
+extern uint32_t next_pending_phase_idx;
+extern QueueEstimator queue_estimator;
+extern uint32_t preempt_latency_bound_ms;
+extern uint32_t preempt_max_latency_ms;
+extern LookaheadStats lookahead_stats;
 
 void controller_setup();
 void controller_loop();
+
+// Emergency vehicle approaching on lane_idx (inbound). Repeat while the call
+// lasts; the approach is held green until PREEMPT_HOLD_MS after the last one.
+void controller_request_preemption(uint32_t lane_idx);
+
+// Pedestrian button on crosswalk lane_idx, as if its sensor_pin had gone HIGH.
+void controller_request_crossing(uint32_t lane_idx);
+
+// The next phase for the queues and weights in intr and the context the
+// controller gathered (the same call replays a recorded decision on a host).
+// Sets *exclusive_walk when an overdue crossing needs an all-red walk.
+int determine_next_phase(Intersection *intr, const DecisionContext *ctx, DecisionReason *reason, bool *exclusive_walk);
 extern uint16_t received_sensor_value[64];
 #endif
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "Actuation.h"
+#include <string.h>
+#include <Arduino.h>
+
+// --- STATE ---
+static uint32_t phase_gap_ms[MAX_PHASE_CNT];
+static uint32_t phase_max_green_ms[MAX_PHASE_CNT];
+
+static unsigned long last_seen[MAX_LANE_CNT]; // Gap timer start per lane
+static uint64_t detector_lanes = 0;
+static uint64_t called_lanes = 0;
+static uint64_t occupied_lanes = 0;
+
+// Written by the detector interrupts, drained by actuation_update()
+static volatile uint32_t pulse_count[MAX_LANE_CNT];
+static uint32_t pulses_seen[MAX_LANE_CNT];
+static uint16_t new_pulses[MAX_LANE_CNT]; // Drained by the last actuation_update()
+
+// --- DETECTORS ---
+
+static void IRAM_ATTR detector_isr(void *arg)
+{
+    pulse_count[(uintptr_t)arg]++;
+}
+
+// --- PUBLIC API ---
+
+void actuation_reset()
+{
+    memset(phase_gap_ms, 0, sizeof(phase_gap_ms));
+    memset(phase_max_green_ms, 0, sizeof(phase_max_green_ms));
+}
+
+void actuation_set_phase_limits(uint32_t phase_idx, uint32_t gap_ms, uint32_t max_green_ms)
+{
+    if (phase_idx >= MAX_PHASE_CNT)
+        return;
+    phase_gap_ms[phase_idx] = gap_ms;
+    phase_max_green_ms[phase_idx] = max_green_ms;
+}
+
+void actuation_setup(const Intersection *intr, bool use_detectors, unsigned long now)
+{
+    called_lanes = 0;
+    occupied_lanes = 0;
+    detector_lanes = 0;
+    uint32_t detectors = 0;
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        last_seen[i] = now;
+        pulse_count[i] = 0;
+        pulses_seen[i] = 0;
+        new_pulses[i] = 0;
+
+        const Lane *lane = &intr->lanes[i];
+        if (!use_detectors || lane->type != LANE_IN || lane->hw.sensor_pin == -1)
+            continue;
+        attachInterruptArg(digitalPinToInterrupt(lane->hw.sensor_pin), detector_isr, (void *)(uintptr_t)i, RISING);
+        detector_lanes |= (1ULL << i);
+        detectors++;
+    }
+    Serial.printf("[ACTUATED] %lu detectors, gap %lu ms by default\n", (unsigned long)detectors,
+                  (unsigned long)ACTUATION_GAP_MS);
+}
+
+void actuation_update(const Intersection *intr, uint64_t green_lanes, unsigned long now)
+{
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        if (!((detector_lanes >> i) & 1))
+            continue;
+
+        uint32_t pulses = pulse_count[i];
+        bool occupied = digitalRead(intr->lanes[i].hw.sensor_pin) == HIGH;
+        bool detected = pulses != pulses_seen[i] || occupied;
+        new_pulses[i] = (uint16_t)(pulses - pulses_seen[i]);
+        pulses_seen[i] = pulses;
+        if (occupied)
+            occupied_lanes |= (1ULL << i);
+        else
+            occupied_lanes &= ~(1ULL << i);
+
+        if (detected)
+            last_seen[i] = now;
+        if (detected && !((green_lanes >> i) & 1))
+            called_lanes |= (1ULL << i);
+    }
+    called_lanes &= ~green_lanes;
+}
+
+bool actuation_gapped_out(const Intersection *intr, uint32_t phase_idx, unsigned long now)
+{
+    uint32_t gap = phase_gap_ms[phase_idx] ? phase_gap_ms[phase_idx] : ACTUATION_GAP_MS;
+    uint64_t lanes = intr->phases[phase_idx].green_lanes_mask;
+    bool has_detector = false;
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        const Lane *lane = &intr->lanes[i];
+        if (!((lanes >> i) & 1) || lane->type != LANE_IN)
+            continue;
+        if (intr->lane_traffic[i] > 0)
+            return false;
+        if ((detector_lanes >> i) & 1)
+        {
+            if (now - last_seen[i] <= gap)
+                return false;
+            has_detector = true;
+        }
+    }
+    return has_detector;
+}
+
+uint32_t actuation_max_green(uint32_t phase_idx, uint32_t default_ms)
+{
+    return phase_max_green_ms[phase_idx] ? phase_max_green_ms[phase_idx] : default_ms;
+}
+
+bool actuation_called(uint32_t lane_idx)
+{
+    return (called_lanes >> lane_idx) & 1;
+}
+
+uint64_t actuation_called_lanes()
+{
+    return called_lanes;
+}
+
+bool actuation_has_detector(uint32_t lane_idx)
+{
+    return (detector_lanes >> lane_idx) & 1;
+}
+
+uint16_t actuation_new_pulses(uint32_t lane_idx)
+{
+    return new_pulses[lane_idx];
+}
+
+bool actuation_occupied(uint32_t lane_idx)
+{
+    return (occupied_lanes >> lane_idx) & 1;
+}
@@ -0,0 +1,234 @@
+#include "Calibration.h"
+#include <string.h>
+#include <Arduino.h>
+#include <Preferences.h>
+
+// --- STATE ---
+typedef struct {
+    unsigned long green_since;    // 0 = red
+    unsigned long last_departure; // 0 = none this green
+    bool queued_at_green;
+    bool saturated;               // Last departure left a queue behind it
+} CalibrationLaneState;
+
+static ConnectionCalibration calib[MAX_CONNECTION_CNT];
+static CalibrationLaneState lanes[MAX_LANE_CNT];
+static uint64_t prev_green_lanes = 0;
+static unsigned long last_save = 0;
+static bool dirty = false;
+static Preferences prefs;
+
+static const char *PREFS_NAMESPACE = "calib";
+
+// --- HELPERS ---
+
+static void connection_key(const Intersection *intr, uint32_t c, char *key, size_t len)
+{
+    const Connection *conn = &intr->connections[c];
+    snprintf(key, len, "c%lu_%lu", (unsigned long)intr->lanes[conn->source_lane_idx].id,
+             (unsigned long)intr->lanes[conn->target_lane_idx].id);
+}
+
+static void ewma(uint16_t *value, uint16_t *samples, uint32_t sample)
+{
+    if (*samples == 0)
+        *value = (uint16_t)sample;
+    else
+        *value = (uint16_t)(*value + (((int32_t)sample - (int32_t)*value) >> CALIBRATION_EWMA_SHIFT));
+    if (*samples < 0xFFFF)
+        (*samples)++;
+}
+
+static uint64_t lane_connections(const Intersection *intr, uint32_t lane_idx)
+{
+    uint64_t conns = 0;
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+    {
+        if (intr->connections[c].source_lane_idx == lane_idx)
+            conns |= (1ULL << c);
+    }
+    return conns;
+}
+
+// Weights of every movement out of lane_idx; uniform until all of them are learned
+static void apply_weights(Intersection *intr, uint32_t lane_idx)
+{
+    uint64_t conns = lane_connections(intr, lane_idx);
+    uint32_t n = __builtin_popcountll(conns);
+    bool learned = true;
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+    {
+        if (((conns >> c) & 1) && (calib[c].headway_samples < CALIBRATION_MIN_SAMPLES ||
+                                   calib[c].ratio_samples < CALIBRATION_MIN_SAMPLES))
+            learned = false;
+    }
+
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+    {
+        if (!((conns >> c) & 1))
+            continue;
+        if (!learned)
+        {
+            intr->connections[c].weight = CONNECTION_WEIGHT_ONE;
+            continue;
+        }
+
+        uint64_t w = (uint64_t)calib[c].ratio_q15 * n * CONNECTION_WEIGHT_ONE * CALIBRATION_REFERENCE_HEADWAY_MS /
+                     ((uint64_t)calib[c].headway_ms * 32768);
+        if (w < CALIBRATION_WEIGHT_MIN)
+            w = CALIBRATION_WEIGHT_MIN;
+        if (w > CALIBRATION_WEIGHT_MAX)
+            w = CALIBRATION_WEIGHT_MAX;
+        intr->connections[c].weight = (uint16_t)w;
+    }
+}
+
+static void save_calibration(const Intersection *intr)
+{
+    if (!prefs.begin(PREFS_NAMESPACE, false))
+        return;
+
+    char key[16];
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+    {
+        connection_key(intr, c, key, sizeof(key));
+        prefs.putBytes(key, &calib[c], sizeof(ConnectionCalibration));
+    }
+    prefs.end();
+    dirty = false;
+}
+
+// --- PUBLIC API ---
+
+void calibration_setup(Intersection *intr)
+{
+    memset(calib, 0, sizeof(calib));
+    memset(lanes, 0, sizeof(lanes));
+    prev_green_lanes = 0;
+    last_save = millis();
+    dirty = false;
+
+    uint32_t loaded = 0;
+    if (prefs.begin(PREFS_NAMESPACE, true))
+    {
+        char key[16];
+        for (uint32_t c = 0; c < intr->connection_cnt; c++)
+        {
+            connection_key(intr, c, key, sizeof(key));
+            if (prefs.getBytes(key, &calib[c], sizeof(ConnectionCalibration)) == sizeof(ConnectionCalibration))
+                loaded++;
+            else
+                memset(&calib[c], 0, sizeof(ConnectionCalibration));
+        }
+        prefs.end();
+    }
+
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        if (intr->lanes[i].type == LANE_IN)
+            apply_weights(intr, i);
+    }
+    Serial.printf("[CALIB] Stored calibration loaded for %lu of %d movements\n", (unsigned long)loaded,
+                  intr->connection_cnt);
+}
+
+void calibration_update(Intersection *intr, uint64_t green_lanes, unsigned long now)
+{
+    uint64_t changed = green_lanes ^ prev_green_lanes;
+    for (uint32_t i = 0; i < intr->lane_cnt && changed; i++)
+    {
+        if (!((changed >> i) & 1))
+            continue;
+        CalibrationLaneState *s = &lanes[i];
+        s->green_since = ((green_lanes >> i) & 1) ? (now | 1) : 0;
+        s->last_departure = 0;
+        s->queued_at_green = intr->lane_traffic[i] > 0;
+        s->saturated = false;
+    }
+    prev_green_lanes = green_lanes;
+
+    if (dirty && now - last_save >= CALIBRATION_SAVE_INTERVAL_MS)
+    {
+        save_calibration(intr);
+        last_save = now;
+    }
+}
+
+void calibration_departure(Intersection *intr, uint32_t lane_idx, uint32_t conn_idx, uint64_t moving_conns,
+                           uint16_t queue_left, unsigned long now)
+{
+    if (lane_idx >= intr->lane_cnt)
+        return;
+    CalibrationLaneState *s = &lanes[lane_idx];
+    if (s->green_since == 0)
+        return;
+
+    uint64_t lane_conns = lane_connections(intr, lane_idx);
+    uint64_t took = conn_idx == CALIBRATION_ANY_CONNECTION ? (lane_conns & moving_conns) : (1ULL << conn_idx);
+
+    // Start-up lost time: the first vehicle of a standing queue, beyond one headway
+    if (s->last_departure == 0 && s->queued_at_green)
+    {
+        for (uint32_t c = 0; c < intr->connection_cnt; c++)
+        {
+            if (!((took >> c) & 1))
+                continue;
+            uint32_t headway = calib[c].headway_samples ? calib[c].headway_ms : CALIBRATION_REFERENCE_HEADWAY_MS;
+            uint32_t first = now - s->green_since;
+            uint32_t lost = first > headway ? first - headway : 0;
+            if (lost <= CALIBRATION_MAX_LOST_MS)
+                ewma(&calib[c].lost_ms, &calib[c].lost_samples, lost);
+        }
+    }
+
+    // Saturation headway: only while vehicles were still queued behind the previous one
+    if (s->last_departure != 0 && s->saturated)
+    {
+        uint32_t gap = now - s->last_departure;
+        if (gap >= CALIBRATION_MIN_HEADWAY_MS && gap <= CALIBRATION_MAX_HEADWAY_MS)
+        {
+            for (uint32_t c = 0; c < intr->connection_cnt; c++)
+            {
+                if ((took >> c) & 1)
+                    ewma(&calib[c].headway_ms, &calib[c].headway_samples, gap);
+            }
+        }
+    }
+
+    // Turning ratio: only when every movement out of the lane was open to it
+    if (conn_idx != CALIBRATION_ANY_CONNECTION && (lane_conns & ~moving_conns) == 0)
+    {
+        for (uint32_t c = 0; c < intr->connection_cnt; c++)
+        {
+            if ((lane_conns >> c) & 1)
+                ewma(&calib[c].ratio_q15, &calib[c].ratio_samples, c == conn_idx ? 32768 : 0);
+        }
+    }
+
+    // A headway ends with the next vehicle; several in one sensor tick still start one
+    if (s->last_departure == 0 || now - s->last_departure >= CALIBRATION_MIN_HEADWAY_MS)
+        s->last_departure = now;
+    s->saturated = queue_left > 0;
+    dirty = true;
+    apply_weights(intr, lane_idx);
+}
+
+uint32_t calibration_lost_time_ms(const Intersection *intr, uint64_t conns)
+{
+    uint32_t sum = 0;
+    uint32_t n = 0;
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+    {
+        if (((conns >> c) & 1) && calib[c].lost_samples >= CALIBRATION_MIN_SAMPLES)
+        {
+            sum += calib[c].lost_ms;
+            n++;
+        }
+    }
+    return n ? sum / n : 0;
+}
+
+const ConnectionCalibration *calibration_connection(uint32_t conn_idx)
+{
+    return &calib[conn_idx];
+}
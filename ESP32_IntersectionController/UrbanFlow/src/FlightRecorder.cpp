@@ -0,0 +1,440 @@
+#include "FlightRecorder.h"
+#include <string.h>
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "esp_heap_caps.h"
+
+// --- STATE ---
+static uint8_t *ring = NULL;
+static uint32_t ring_size = 0;
+static uint32_t head = 0; // Next byte to write
+static uint32_t tail = 0; // Oldest record
+static uint32_t used = 0;
+static uint32_t dropped = 0;
+
+// The layout lives outside the ring so it survives wrap-around; flush writes it first
+static uint8_t layout[8 + MAX_LANE_CNT + 2 * MAX_CONNECTION_CNT + 12 * MAX_PHASE_CNT];
+static uint16_t layout_len = 0;
+static uint32_t layout_time = 0;
+
+static const uint32_t HEADER_BYTES = 7; // u32 time, u8 type, u16 len
+// Largest REC_DECISION, counting every lane as both a waiting crossing and inbound
+static const uint32_t DECISION_MAX_BYTES = 12 + 2 * MAX_LANE_CNT + 2 * MAX_CONNECTION_CNT + 24 + 4 * MAX_LANE_CNT +
+                                           8 * MAX_PHASE_CNT + 1 + 4 * RING_MAX_RINGS + 4 + 4 * MAX_LANE_CNT;
+
+// Save in progress: the part of the ring still to go to flash. New records
+// only take free space meanwhile, nothing is dropped from under the save.
+static bool saving = false;
+static uint32_t save_pos = 0;
+static uint32_t save_left = 0;
+
+// Console dump, one slice per recorder_dump_step()
+typedef enum {
+    DUMP_IDLE,
+    DUMP_SAVE,
+    DUMP_STREAM
+} DumpState;
+static DumpState dump_state = DUMP_IDLE;
+static File dump_file;
+
+// --- RING ---
+
+static void ring_put(const void *src, uint32_t len)
+{
+    const uint8_t *p = (const uint8_t *)src;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        ring[head] = p[i];
+        head = (head + 1) % ring_size;
+    }
+}
+
+static uint32_t record_len_at(uint32_t pos)
+{
+    uint8_t lo = ring[(pos + 5) % ring_size];
+    uint8_t hi = ring[(pos + 6) % ring_size];
+    return HEADER_BYTES + (lo | (hi << 8));
+}
+
+static void record(RecorderEventType type, const void *payload, uint16_t len)
+{
+    uint32_t total = HEADER_BYTES + len;
+    if (!ring || total > ring_size)
+        return;
+
+    if (saving && ring_size - used < total)
+    {
+        dropped++;
+        return;
+    }
+
+    // Make room by dropping whole records from the old end
+    while (ring_size - used < total)
+    {
+        uint32_t oldest = record_len_at(tail);
+        tail = (tail + oldest) % ring_size;
+        used -= oldest;
+        dropped++;
+    }
+
+    uint32_t now = millis();
+    uint8_t t = (uint8_t)type;
+    ring_put(&now, 4);
+    ring_put(&t, 1);
+    ring_put(&len, 2);
+    ring_put(payload, len);
+    used += total;
+}
+
+// --- PAYLOADS ---
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t len;
+} RecordWriter;
+
+typedef struct {
+    const uint8_t *buf;
+    uint32_t len;
+    uint32_t pos;
+    bool overrun;
+} RecordReader;
+
+static void put(RecordWriter *w, const void *src, uint32_t len)
+{
+    memcpy(&w->buf[w->len], src, len);
+    w->len += len;
+}
+
+static bool get(RecordReader *r, void *dst, uint32_t len)
+{
+    if (r->overrun || len > r->len - r->pos)
+    {
+        r->overrun = true;
+        return false;
+    }
+    memcpy(dst, &r->buf[r->pos], len);
+    r->pos += len;
+    return true;
+}
+
+// --- SAVE ---
+
+// Opens RECORDER_FILE and writes the header and layout; the ring follows
+// through save_chunk(). Returns the file's total size, 0 on failure.
+static uint32_t save_begin(File &f)
+{
+    if (!ring)
+        return 0;
+    if (!LittleFS.begin(true))
+    {
+        Serial.println("[REC] Flash filesystem unavailable.");
+        return 0;
+    }
+
+    f = LittleFS.open(RECORDER_FILE, "w");
+    if (!f)
+        return 0;
+
+    uint32_t boot_bytes = HEADER_BYTES + layout_len;
+    uint32_t header[4] = {RECORDER_MAGIC, RECORDER_VERSION, boot_bytes + used, dropped};
+    f.write((const uint8_t *)header, sizeof(header));
+
+    uint8_t boot_header[HEADER_BYTES] = {(uint8_t)layout_time, (uint8_t)(layout_time >> 8), (uint8_t)(layout_time >> 16),
+                                         (uint8_t)(layout_time >> 24), REC_BOOT, (uint8_t)layout_len,
+                                         (uint8_t)(layout_len >> 8)};
+    f.write(boot_header, sizeof(boot_header));
+    f.write(layout, layout_len);
+
+    saving = true;
+    save_pos = tail;
+    save_left = used;
+    Serial.printf("[REC] Saving %lu bytes to %s (%lu records dropped)\n", (unsigned long)(boot_bytes + used),
+                  RECORDER_FILE, (unsigned long)dropped);
+    return sizeof(header) + boot_bytes + used;
+}
+
+// Up to max_bytes more of the ring, oldest first; the region may wrap the end
+static void save_chunk(File &f, uint32_t max_bytes)
+{
+    uint32_t n = save_left < max_bytes ? save_left : max_bytes;
+    while (n > 0)
+    {
+        uint32_t run = ring_size - save_pos < n ? ring_size - save_pos : n;
+        f.write(&ring[save_pos], run);
+        save_pos = (save_pos + run) % ring_size;
+        save_left -= run;
+        n -= run;
+    }
+    if (save_left == 0)
+        saving = false;
+}
+
+// --- PUBLIC API ---
+
+void recorder_setup(const Intersection *intr, uint8_t algorithm)
+{
+    if (!ring)
+    {
+        ring_size = RECORDER_PSRAM_BYTES;
+        ring = (uint8_t *)heap_caps_malloc(ring_size, MALLOC_CAP_SPIRAM);
+        if (!ring)
+        {
+            ring_size = RECORDER_INTERNAL_BYTES;
+            ring = (uint8_t *)heap_caps_malloc(ring_size, MALLOC_CAP_DEFAULT);
+        }
+        if (!ring)
+        {
+            ring_size = 0;
+            Serial.println("[REC] No memory for the flight recorder.");
+            return;
+        }
+        Serial.printf("[REC] Flight recorder: %lu KB ring\n", (unsigned long)(ring_size / 1024));
+    }
+    head = tail = used = dropped = 0;
+
+    uint32_t n = 0;
+    layout[n++] = intr->lane_cnt;
+    layout[n++] = intr->connection_cnt;
+    layout[n++] = intr->phase_cnt;
+    layout[n++] = algorithm;
+    memcpy(&layout[n], &intr->default_phase_duration_ms, 4);
+    n += 4;
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+        layout[n++] = (uint8_t)intr->lanes[i].type;
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+    {
+        layout[n++] = intr->connections[c].source_lane_idx;
+        layout[n++] = intr->connections[c].target_lane_idx;
+    }
+    for (uint32_t p = 0; p < intr->phase_cnt; p++)
+    {
+        memcpy(&layout[n], &intr->phases[p].active_connections_mask, 8);
+        memcpy(&layout[n + 8], &intr->phases[p].duration_ms, 4);
+        n += 12;
+    }
+    layout_len = n;
+    layout_time = millis();
+}
+
+void recorder_sensor_frame(const uint16_t *values, uint64_t reported_lanes, uint32_t lane_cnt)
+{
+    uint8_t buf[8 + 2 * MAX_LANE_CNT];
+    uint32_t n = 8;
+    memcpy(buf, &reported_lanes, 8);
+    for (uint32_t i = 0; i < lane_cnt && i < MAX_LANE_CNT; i++)
+    {
+        if ((reported_lanes >> i) & 1)
+        {
+            memcpy(&buf[n], &values[i], 2);
+            n += 2;
+        }
+    }
+    record(REC_SENSOR_FRAME, buf, n);
+}
+
+void recorder_queues(const Intersection *intr, uint64_t serving_lanes)
+{
+    uint8_t buf[8 + 2 * MAX_LANE_CNT];
+    memcpy(buf, &serving_lanes, 8);
+    memcpy(&buf[8], intr->lane_traffic, intr->lane_cnt * sizeof(uint16_t));
+    record(REC_QUEUES, buf, 8 + intr->lane_cnt * sizeof(uint16_t));
+}
+
+void recorder_decision(const Intersection *intr, const DecisionContext *ctx, uint8_t chosen_phase,
+                       DecisionReason reason, bool exclusive_walk)
+{
+    uint8_t buf[DECISION_MAX_BYTES];
+    RecordWriter w = {buf, 0};
+    uint8_t flags = (ctx->gapped_out ? RECORDER_DECISION_GAPPED_OUT : 0) |
+                    (exclusive_walk ? RECORDER_DECISION_EXCLUSIVE_WALK : 0);
+    uint8_t head[4] = {(uint8_t)ctx->current_phase, chosen_phase, (uint8_t)reason, flags};
+    put(&w, head, 4);
+    put(&w, &ctx->green_ms, 4);
+    put(&w, &ctx->max_green_ms, 4);
+    put(&w, intr->lane_traffic, intr->lane_cnt * sizeof(uint16_t));
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+        put(&w, &intr->connections[c].weight, 2);
+
+    put(&w, &ctx->blocked_conns, 8);
+    put(&w, &ctx->called_lanes, 8);
+    put(&w, &ctx->waiting_crossings, 8);
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        if ((ctx->waiting_crossings >> i) & 1)
+            put(&w, &ctx->crossing_wait_ms[i], 4);
+    }
+    put(&w, ctx->since_served_ms, intr->phase_cnt * 4);
+    put(&w, ctx->wave_bonus, intr->phase_cnt * 4);
+    put(&w, &ctx->ring_cnt, 1);
+    put(&w, ctx->ring_elapsed_ms, ctx->ring_cnt * 4);
+
+    put(&w, &ctx->switch_loss_ms, 4);
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        if (intr->lanes[i].type == LANE_IN)
+            put(&w, &ctx->arrival.arrival_rate_vps[i], 4);
+    }
+    record(REC_DECISION, buf, (uint16_t)w.len);
+}
+
+bool recorder_parse_decision(Intersection *intr, const uint8_t *payload, uint32_t len, DecisionContext *ctx,
+                             uint8_t *chosen_phase, DecisionReason *reason, bool *exclusive_walk)
+{
+    RecordReader r = {payload, len, 0};
+    memset(ctx, 0, sizeof(DecisionContext));
+
+    uint8_t head[4];
+    if (!get(&r, head, 4) || head[0] >= intr->phase_cnt)
+        return false;
+    ctx->current_phase = head[0];
+    *chosen_phase = head[1];
+    *reason = (DecisionReason)head[2];
+    ctx->gapped_out = head[3] & RECORDER_DECISION_GAPPED_OUT;
+    *exclusive_walk = head[3] & RECORDER_DECISION_EXCLUSIVE_WALK;
+    get(&r, &ctx->green_ms, 4);
+    get(&r, &ctx->max_green_ms, 4);
+    get(&r, intr->lane_traffic, intr->lane_cnt * sizeof(uint16_t));
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+        get(&r, &intr->connections[c].weight, 2);
+
+    get(&r, &ctx->blocked_conns, 8);
+    get(&r, &ctx->called_lanes, 8);
+    get(&r, &ctx->waiting_crossings, 8);
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        if ((ctx->waiting_crossings >> i) & 1)
+            get(&r, &ctx->crossing_wait_ms[i], 4);
+    }
+    get(&r, ctx->since_served_ms, intr->phase_cnt * 4);
+    get(&r, ctx->wave_bonus, intr->phase_cnt * 4);
+    if (!get(&r, &ctx->ring_cnt, 1) || ctx->ring_cnt > RING_MAX_RINGS)
+        return false;
+    get(&r, ctx->ring_elapsed_ms, ctx->ring_cnt * 4);
+
+    get(&r, &ctx->switch_loss_ms, 4);
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        if (intr->lanes[i].type == LANE_IN)
+            get(&r, &ctx->arrival.arrival_rate_vps[i], 4);
+    }
+    ctx->arrival.primed = true;
+
+    // Every field read, nothing left over: the layout is the one recorded
+    return !r.overrun && r.pos == len;
+}
+
+void recorder_state(uint8_t from, uint8_t to, uint8_t current_phase, uint8_t pending_phase)
+{
+    uint8_t buf[4] = {from, to, current_phase, pending_phase};
+    record(REC_STATE, buf, sizeof(buf));
+}
+
+void recorder_output(const LightFrame *frame)
+{
+    record(REC_OUTPUT, frame->bits, sizeof(frame->bits));
+}
+
+void recorder_fault(FaultSource source, uint8_t code, uint8_t detail)
+{
+    uint8_t buf[3] = {(uint8_t)source, code, detail};
+    record(REC_FAULT, buf, sizeof(buf));
+}
+
+void recorder_spillback(uint64_t blocked_lanes)
+{
+    record(REC_SPILLBACK, &blocked_lanes, sizeof(blocked_lanes));
+}
+
+uint32_t recorder_flush()
+{
+    if (dump_state != DUMP_IDLE)
+    {
+        Serial.println("[REC] Console dump abandoned.");
+        dump_file.close();
+        dump_state = DUMP_IDLE;
+    }
+
+    File f;
+    uint32_t bytes = save_begin(f);
+    if (bytes == 0)
+        return 0;
+    save_chunk(f, save_left);
+    f.close();
+    return bytes;
+}
+
+void recorder_dump_start()
+{
+    if (dump_state != DUMP_IDLE)
+        return;
+    if (save_begin(dump_file) == 0)
+    {
+        Serial.println("[REC] No recording to dump.");
+        return;
+    }
+    dump_state = DUMP_SAVE;
+}
+
+void recorder_dump_step()
+{
+    if (dump_state == DUMP_SAVE)
+    {
+        save_chunk(dump_file, RECORDER_SAVE_SLICE_BYTES);
+        if (saving)
+            return;
+        dump_file.close();
+        dump_file = LittleFS.open(RECORDER_FILE, "r");
+        if (!dump_file)
+        {
+            dump_state = DUMP_IDLE;
+            return;
+        }
+        Serial.println("---FLIGHT BEGIN---");
+        dump_state = DUMP_STREAM;
+        return;
+    }
+    if (dump_state != DUMP_STREAM)
+        return;
+
+    // Whole lines, only as many as the TX buffer takes without waiting
+    static const char hex[] = "0123456789abcdef";
+    char line[2 * RECORDER_DUMP_LINE_BYTES + 1];
+    for (uint32_t l = 0; l < RECORDER_DUMP_LINES_PER_PASS; l++)
+    {
+        if (Serial.availableForWrite() < (int)sizeof(line))
+            return;
+
+        uint8_t chunk[RECORDER_DUMP_LINE_BYTES];
+        int n = dump_file.read(chunk, sizeof(chunk));
+        if (n <= 0)
+        {
+            dump_file.close();
+            Serial.println("---FLIGHT END---");
+            dump_state = DUMP_IDLE;
+            return;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            line[2 * i] = hex[chunk[i] >> 4];
+            line[2 * i + 1] = hex[chunk[i] & 0xF];
+        }
+        line[2 * n] = '\n';
+        Serial.write((const uint8_t *)line, 2 * n + 1);
+    }
+}
+
+bool recorder_dump_active()
+{
+    return dump_state != DUMP_IDLE;
+}
+
+uint32_t recorder_bytes_used()
+{
+    return used;
+}
+
+uint32_t recorder_records_dropped()
+{
+    return dropped;
+}
@@ -0,0 +1,466 @@
+#include "GreenWave.h"
+#include <string.h>
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include "TrafficController.h"
+
+// --- STATE ---
+typedef struct {
+    IPAddress ip;
+    uint16_t port;
+    uint32_t node_id;
+
+    // Clock sync: peer clock - our clock, from the lowest round trip seen lately
+    int32_t sample_offset[GREEN_WAVE_SYNC_SAMPLES];
+    uint32_t sample_rtt[GREEN_WAVE_SYNC_SAMPLES];
+    uint8_t sample_cnt;
+    uint8_t sample_next;
+    int32_t offset_ms;
+    uint32_t rtt_ms;
+    bool synced;
+    unsigned long last_heard;
+} GreenWavePeer;
+
+// Predicted arrival of one platoon, our clock
+typedef struct {
+    uint32_t depart_key; // Peer's depart_start, so repeats of the same green overwrite
+    uint16_t vehicles;
+    unsigned long arrive_start;
+    unsigned long arrive_end;
+} GreenWavePlatoon;
+
+typedef struct {
+    uint8_t lane_idx;
+    uint8_t peer;
+    uint32_t peer_lane_id;
+    uint32_t travel_ms;
+    GreenWavePlatoon platoons[2]; // Current green and the one before, both may still be in flight
+} GreenWaveLink;
+
+typedef struct {
+    uint32_t out_lane_id;
+    uint16_t vehicles;
+    uint32_t depart_start;
+    uint32_t depart_end;
+} GreenWaveDeparture;
+
+static GreenWavePeer peers[GREEN_WAVE_MAX_PEERS];
+static uint8_t peer_cnt = 0;
+static GreenWaveLink links[GREEN_WAVE_MAX_LINKS];
+static uint8_t link_cnt = 0;
+
+static WiFiUDP udp;
+static bool running = false;
+static uint32_t own_node_id = 0;
+static GreenWaveStats stats;
+
+// What we are sending this green
+static GreenWaveDeparture departures[GREEN_WAVE_MAX_PLATOONS];
+static uint8_t departure_cnt = 0;
+static uint8_t announced_phase = 0;
+static uint32_t green_start = 0;
+static unsigned long last_timing_sent = 0;
+static unsigned long last_sync_sent = 0;
+
+static const uint32_t HEADER_BYTES = 8;
+static const uint32_t MAX_MESSAGE_BYTES = HEADER_BYTES + 18 + GREEN_WAVE_MAX_PLATOONS * 14;
+
+// --- WIRE FORMAT ---
+
+static uint32_t put_header(uint8_t *buf, GreenWaveMessageType type)
+{
+    uint16_t magic = GREEN_WAVE_MAGIC;
+    memcpy(&buf[0], &magic, 2);
+    buf[2] = GREEN_WAVE_VERSION;
+    buf[3] = (uint8_t)type;
+    memcpy(&buf[4], &own_node_id, 4);
+    return HEADER_BYTES;
+}
+
+static void send_to(const GreenWavePeer *peer, const uint8_t *buf, uint32_t len)
+{
+    udp.beginPacket(peer->ip, peer->port);
+    udp.write(buf, len);
+    udp.endPacket();
+    stats.messages_sent++;
+}
+
+static void send_sync_requests(unsigned long now)
+{
+    uint8_t buf[HEADER_BYTES + 4];
+    uint32_t n = put_header(buf, GREEN_WAVE_SYNC_REQUEST);
+    uint32_t t1 = now;
+    memcpy(&buf[n], &t1, 4);
+    for (uint32_t p = 0; p < peer_cnt; p++)
+        send_to(&peers[p], buf, sizeof(buf));
+}
+
+static void send_timing(unsigned long now)
+{
+    uint8_t buf[MAX_MESSAGE_BYTES];
+    uint32_t n = put_header(buf, GREEN_WAVE_TIMING);
+    uint32_t sent_at = now;
+    uint32_t green_min_end = green_start + MIN_GREEN_TIME; // The shortest green a peer can count on
+    memcpy(&buf[n], &sent_at, 4);
+    buf[n + 4] = announced_phase;
+    buf[n + 5] = departure_cnt;
+    memcpy(&buf[n + 6], &green_start, 4);
+    memcpy(&buf[n + 10], &green_min_end, 4);
+    n += 14;
+    for (uint32_t i = 0; i < departure_cnt; i++)
+    {
+        const GreenWaveDeparture *d = &departures[i];
+        memcpy(&buf[n], &d->out_lane_id, 4);
+        memcpy(&buf[n + 4], &d->vehicles, 2);
+        memcpy(&buf[n + 6], &d->depart_start, 4);
+        memcpy(&buf[n + 10], &d->depart_end, 4);
+        n += 14;
+    }
+    for (uint32_t p = 0; p < peer_cnt; p++)
+        send_to(&peers[p], buf, n);
+    last_timing_sent = now;
+}
+
+// --- CLOCK SYNC ---
+
+static void add_sync_sample(GreenWavePeer *peer, uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4)
+{
+    uint32_t rtt = (t4 - t1) - (t3 - t2);
+    int32_t offset = ((int32_t)(t2 - t1) + (int32_t)(t3 - t4)) / 2;
+
+    peer->sample_offset[peer->sample_next] = offset;
+    peer->sample_rtt[peer->sample_next] = rtt;
+    peer->sample_next = (peer->sample_next + 1) % GREEN_WAVE_SYNC_SAMPLES;
+    if (peer->sample_cnt < GREEN_WAVE_SYNC_SAMPLES)
+        peer->sample_cnt++;
+
+    // Queuing delay only ever adds to a round trip, so the fastest one is the most accurate
+    uint32_t best = 0;
+    for (uint32_t i = 1; i < peer->sample_cnt; i++)
+    {
+        if (peer->sample_rtt[i] < peer->sample_rtt[best])
+            best = i;
+    }
+    if (!peer->synced)
+        Serial.printf("[WAVE] Peer %lu synced: offset %ld ms, rtt %lu ms\n", (unsigned long)peer->node_id,
+                      (long)peer->sample_offset[best], (unsigned long)peer->sample_rtt[best]);
+    peer->offset_ms = peer->sample_offset[best];
+    peer->rtt_ms = peer->sample_rtt[best];
+    peer->synced = true;
+}
+
+// --- PREDICTION ---
+
+static void predict_platoon(GreenWaveLink *link, const GreenWavePeer *peer, const GreenWaveDeparture *d)
+{
+    GreenWavePlatoon platoon;
+    platoon.depart_key = d->depart_start;
+    platoon.vehicles = d->vehicles;
+    platoon.arrive_start = (unsigned long)(d->depart_start - peer->offset_ms + link->travel_ms);
+    platoon.arrive_end = (unsigned long)(d->depart_end - peer->offset_ms + link->travel_ms);
+
+    if (link->platoons[0].vehicles > 0 && link->platoons[0].depart_key == platoon.depart_key)
+    {
+        link->platoons[0] = platoon;
+        return;
+    }
+    link->platoons[1] = link->platoons[0];
+    link->platoons[0] = platoon;
+    stats.platoons_predicted++;
+}
+
+// Vehicles of the platoon arriving inside [from, to], assuming they are spread evenly over its window
+static float platoon_share(const GreenWavePlatoon *platoon, unsigned long from, unsigned long to)
+{
+    if (platoon->vehicles == 0)
+        return 0;
+    long start = (long)(platoon->arrive_start - from);
+    long end = (long)(platoon->arrive_end - from);
+    long window = (long)(to - from);
+    if (end < 0 || start > window)
+        return 0;
+    if (end <= start)
+        return platoon->vehicles;
+
+    long overlap = (end < window ? end : window) - (start > 0 ? start : 0);
+    return platoon->vehicles * (float)overlap / (float)(end - start);
+}
+
+static float lane_expected(uint32_t lane_idx, unsigned long from, unsigned long to)
+{
+    float vehicles = 0;
+    for (uint32_t l = 0; l < link_cnt; l++)
+    {
+        if (links[l].lane_idx != lane_idx || !peers[links[l].peer].synced)
+            continue;
+        vehicles += platoon_share(&links[l].platoons[0], from, to);
+        vehicles += platoon_share(&links[l].platoons[1], from, to);
+    }
+    return vehicles;
+}
+
+// --- RECEIVE ---
+
+static void handle_timing(const GreenWavePeer *peer, int p, const uint8_t *body, uint32_t len)
+{
+    if (len < 14)
+        return;
+    uint8_t platoon_cnt = body[5];
+    if (len < 14 + platoon_cnt * 14u || !peer->synced)
+        return;
+
+    for (uint32_t i = 0; i < platoon_cnt; i++)
+    {
+        GreenWaveDeparture d;
+        const uint8_t *rec = &body[14 + i * 14];
+        memcpy(&d.out_lane_id, &rec[0], 4);
+        memcpy(&d.vehicles, &rec[4], 2);
+        memcpy(&d.depart_start, &rec[6], 4);
+        memcpy(&d.depart_end, &rec[10], 4);
+
+        for (uint32_t l = 0; l < link_cnt; l++)
+        {
+            if (links[l].peer == p && links[l].peer_lane_id == d.out_lane_id)
+                predict_platoon(&links[l], peer, &d);
+        }
+    }
+}
+
+static void receive_all(unsigned long now)
+{
+    uint8_t buf[MAX_MESSAGE_BYTES];
+    int size;
+    while ((size = udp.parsePacket()) > 0)
+    {
+        int len = udp.read(buf, sizeof(buf));
+        uint32_t t_receive = millis();
+
+        int p = -1;
+        for (uint32_t i = 0; i < peer_cnt; i++)
+        {
+            if (peers[i].ip == udp.remoteIP() && peers[i].port == udp.remotePort())
+                p = i;
+        }
+
+        uint16_t magic;
+        memcpy(&magic, buf, 2);
+        if (p == -1 || len < (int)HEADER_BYTES || size > (int)sizeof(buf) || magic != GREEN_WAVE_MAGIC ||
+            buf[2] != GREEN_WAVE_VERSION)
+        {
+            stats.messages_rejected++;
+            continue;
+        }
+        stats.messages_received++;
+
+        GreenWavePeer *peer = &peers[p];
+        memcpy(&peer->node_id, &buf[4], 4);
+        peer->last_heard = now;
+        const uint8_t *body = &buf[HEADER_BYTES];
+        uint32_t body_len = len - HEADER_BYTES;
+
+        switch (buf[3])
+        {
+        case GREEN_WAVE_SYNC_REQUEST:
+            if (body_len >= 4)
+            {
+                uint8_t reply[HEADER_BYTES + 12];
+                uint32_t n = put_header(reply, GREEN_WAVE_SYNC_REPLY);
+                uint32_t t3 = millis();
+                memcpy(&reply[n], body, 4);
+                memcpy(&reply[n + 4], &t_receive, 4);
+                memcpy(&reply[n + 8], &t3, 4);
+                send_to(peer, reply, sizeof(reply));
+            }
+            break;
+        case GREEN_WAVE_SYNC_REPLY:
+            if (body_len >= 12)
+            {
+                uint32_t t1, t2, t3;
+                memcpy(&t1, &body[0], 4);
+                memcpy(&t2, &body[4], 4);
+                memcpy(&t3, &body[8], 4);
+                add_sync_sample(peer, t1, t2, t3, t_receive);
+            }
+            break;
+        case GREEN_WAVE_TIMING:
+            handle_timing(peer, p, body, body_len);
+            break;
+        default:
+            stats.messages_rejected++;
+        }
+    }
+}
+
+// --- PUBLIC API ---
+
+void green_wave_reset()
+{
+    if (running)
+        udp.stop();
+    running = false;
+    peer_cnt = 0;
+    link_cnt = 0;
+    departure_cnt = 0;
+    memset(peers, 0, sizeof(peers));
+    memset(links, 0, sizeof(links));
+    memset(&stats, 0, sizeof(stats));
+}
+
+int green_wave_add_peer(const char *host, uint16_t port)
+{
+    if (peer_cnt >= GREEN_WAVE_MAX_PEERS || !host)
+        return -1;
+
+    GreenWavePeer *peer = &peers[peer_cnt];
+    memset(peer, 0, sizeof(*peer));
+    if (!peer->ip.fromString(host))
+        return -1;
+    peer->port = port ? port : GREEN_WAVE_PORT;
+    return peer_cnt++;
+}
+
+bool green_wave_add_link(uint32_t lane_idx, int peer, uint32_t peer_lane_id, uint32_t travel_ms)
+{
+    if (link_cnt >= GREEN_WAVE_MAX_LINKS || lane_idx >= MAX_LANE_CNT || peer < 0 || peer >= peer_cnt)
+        return false;
+
+    GreenWaveLink *link = &links[link_cnt++];
+    memset(link, 0, sizeof(*link));
+    link->lane_idx = lane_idx;
+    link->peer = peer;
+    link->peer_lane_id = peer_lane_id;
+    link->travel_ms = travel_ms;
+    return true;
+}
+
+void green_wave_setup(uint16_t port, uint32_t node_id)
+{
+    if (peer_cnt == 0)
+        return;
+
+    own_node_id = node_id;
+    running = udp.begin(port ? port : GREEN_WAVE_PORT);
+    last_sync_sent = 0;
+    last_timing_sent = 0;
+    Serial.printf("[WAVE] Node %lu: %d peers, %d links, UDP %u %s\n", (unsigned long)node_id, peer_cnt, link_cnt,
+                  port ? port : GREEN_WAVE_PORT, running ? "open" : "FAILED");
+}
+
+void green_wave_update(const Intersection *intr, uint32_t current_phase_idx, unsigned long now)
+{
+    if (!running)
+        return;
+
+    receive_all(now);
+
+    // Faster until every peer answered once, then at the normal interval
+    bool all_synced = true;
+    for (uint32_t p = 0; p < peer_cnt; p++)
+        all_synced = all_synced && peers[p].synced;
+    uint32_t sync_interval = all_synced ? GREEN_WAVE_SYNC_INTERVAL_MS : GREEN_WAVE_TIMING_INTERVAL_MS;
+    if (last_sync_sent == 0 || now - last_sync_sent >= sync_interval)
+    {
+        send_sync_requests(now);
+        last_sync_sent = now | 1;
+    }
+
+    if (now - last_timing_sent >= GREEN_WAVE_TIMING_INTERVAL_MS && announced_phase == current_phase_idx)
+        send_timing(now);
+
+    // Platoons that have fully arrived are done with
+    for (uint32_t l = 0; l < link_cnt; l++)
+    {
+        for (uint32_t k = 0; k < 2; k++)
+        {
+            GreenWavePlatoon *platoon = &links[l].platoons[k];
+            if (platoon->vehicles > 0 && (long)(now - platoon->arrive_end) > 0)
+                platoon->vehicles = 0;
+        }
+    }
+}
+
+// Queued vehicles leave at one per GREEN_WAVE_HEADWAY_MS per connection, split
+// evenly over the lane's active movements; platoons we are expecting on a
+// lane that is now green pass straight on, which carries the wave down the
+// corridor.
+void green_wave_phase_started(const Intersection *intr, uint32_t phase_idx, unsigned long now)
+{
+    announced_phase = phase_idx;
+    green_start = now;
+    departure_cnt = 0;
+    if (!running)
+        return;
+
+    uint64_t mask = intr->phases[phase_idx].active_connections_mask;
+    uint8_t conns_from[MAX_LANE_CNT] = {0};
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+    {
+        if ((mask >> c) & 1)
+            conns_from[intr->connections[c].source_lane_idx]++;
+    }
+
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+    {
+        if (!((mask >> c) & 1))
+            continue;
+        uint32_t src = intr->connections[c].source_lane_idx;
+        const Lane *out = &intr->lanes[intr->connections[c].target_lane_idx];
+        if (intr->lanes[src].type != LANE_IN || out->type != LANE_OUT)
+            continue;
+
+        float share = (intr->lane_traffic[src] + lane_expected(src, now, now + GREEN_WAVE_HORIZON_MS)) / conns_from[src];
+        uint32_t discharge_ms = (uint32_t)(share * GREEN_WAVE_HEADWAY_MS);
+
+        // Merge movements into the same outbound lane
+        GreenWaveDeparture *d = NULL;
+        for (uint32_t i = 0; i < departure_cnt; i++)
+        {
+            if (departures[i].out_lane_id == out->id)
+                d = &departures[i];
+        }
+        if (!d)
+        {
+            if (departure_cnt >= GREEN_WAVE_MAX_PLATOONS)
+                continue;
+            d = &departures[departure_cnt++];
+            d->out_lane_id = out->id;
+            d->vehicles = 0;
+            d->depart_start = now;
+            d->depart_end = now;
+        }
+        d->vehicles += (uint16_t)(share + 0.5f);
+        if ((int32_t)(now + discharge_ms - d->depart_end) > 0)
+            d->depart_end = now + discharge_ms;
+    }
+
+    send_timing(now);
+}
+
+int32_t green_wave_phase_bonus(const Intersection *intr, uint32_t phase_idx, unsigned long now)
+{
+    if (!running || link_cnt == 0)
+        return 0;
+
+    uint64_t lanes = intr->phases[phase_idx].green_lanes_mask;
+    float vehicles = 0;
+    for (uint32_t l = 0; l < link_cnt; l++)
+    {
+        uint32_t lane = links[l].lane_idx;
+        if (!((lanes >> lane) & 1))
+            continue;
+        lanes &= ~(1ULL << lane); // Two links into one lane are counted once
+        vehicles += lane_expected(lane, now, now + GREEN_WAVE_HORIZON_MS);
+    }
+    return (int32_t)(vehicles * GREEN_WAVE_WEIGHT + 0.5f);
+}
+
+bool green_wave_enabled()
+{
+    return running;
+}
+
+const GreenWaveStats *green_wave_stats()
+{
+    return &stats;
+}
@@ -1,23 +1,13 @@
 #include "IntersectionGraph.h"
+#include "StaticIntersection.h"
 #include <string.h> // Required for memset
-#include <vector>
-#include <algorithm>
 #include <Arduino.h>
+#include <math.h>
 
-typedef struct
-{
-    int id;
-    int angle;
-} Point;
-
-bool comparePoints(Point a, Point b)
-{
-    return a.angle < b.angle;
-}
 // Helper to manually add a conflict to the matrix
 void add_conflict(Intersection *intr, uint32_t conn_idx_a, uint32_t conn_idx_b)
 {
-    if (!intr || conn_idx_a >= MAX_CONNECTION_CNT || conn_idx_b >= MAX_CONNECTION_CNT)
+    if (!intr || conn_idx_a >= intr->connection_cap || conn_idx_b >= intr->connection_cap)
         return;
 
     // Set bit B in A's mask
@@ -28,31 +18,208 @@ void add_conflict(Intersection *intr, uint32_t conn_idx_a, uint32_t conn_idx_b)
 
 bool do_paths_cross(Lane *srcA, Lane *tgtA, Lane *srcB, Lane *tgtB)
 {
-    if (srcA->id == srcB->id) // if both start from the same point then they diverge(SAFE)
-        return false;
+    // Same constexpr rule the compile-time plans are checked with
+    return lanes_paths_cross(*srcA, *tgtA, *srcB, *tgtB);
+}
+
+// --- PATH GEOMETRY ---
+
+typedef struct {
+    float x, y;
+} GeoPoint;
+
+static bool has_path(const ConnectionPath *path)
+{
+    return path->point_cnt >= 2;
+}
+
+static GeoPoint path_point(const ConnectionPath *path, uint32_t i)
+{
+    GeoPoint p = {path->x[i] * PATH_UNIT_M, path->y[i] * PATH_UNIT_M};
+    return p;
+}
+
+static float path_length(const ConnectionPath *path)
+{
+    float len = 0.0f;
+    for (uint32_t i = 1; i < path->point_cnt; i++)
+    {
+        GeoPoint a = path_point(path, i - 1), b = path_point(path, i);
+        len += sqrtf((b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y));
+    }
+    return len;
+}
+
+// Distance from p to segment ab; *t = where along ab (0..1) the closest point is
+static float point_segment_distance(GeoPoint p, GeoPoint a, GeoPoint b, float *t)
+{
+    float dx = b.x - a.x, dy = b.y - a.y;
+    float len2 = dx * dx + dy * dy;
+    float u = len2 > 0.0f ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / len2 : 0.0f;
+    u = u < 0.0f ? 0.0f : (u > 1.0f ? 1.0f : u);
+    *t = u;
+    float cx = a.x + u * dx - p.x, cy = a.y + u * dy - p.y;
+    return sqrtf(cx * cx + cy * cy);
+}
+
+// Closest approach of segments a0a1 and b0b1, with where it happens along each (0..1)
+static float segment_distance(GeoPoint a0, GeoPoint a1, GeoPoint b0, GeoPoint b1, float *ta, float *tb)
+{
+    float ax = a1.x - a0.x, ay = a1.y - a0.y;
+    float bx = b1.x - b0.x, by = b1.y - b0.y;
+    float denom = ax * by - ay * bx;
+    if (fabsf(denom) > 1e-6f)
+    {
+        float t = ((b0.x - a0.x) * by - (b0.y - a0.y) * bx) / denom;
+        float u = ((b0.x - a0.x) * ay - (b0.y - a0.y) * ax) / denom;
+        if (t >= 0.0f && t <= 1.0f && u >= 0.0f && u <= 1.0f)
+        {
+            *ta = t;
+            *tb = u;
+            return 0.0f;
+        }
+    }
+
+    // No crossing: the closest approach involves an end point
+    GeoPoint ends[4] = {a0, a1, b0, b1};
+    float best = -1.0f;
+    for (int k = 0; k < 4; k++)
+    {
+        float t;
+        float d = k < 2 ? point_segment_distance(ends[k], b0, b1, &t) : point_segment_distance(ends[k], a0, a1, &t);
+        if (best < 0.0f || d < best)
+        {
+            best = d;
+            *ta = k < 2 ? (float)k : t;
+            *tb = k < 2 ? t : (float)(k - 2);
+        }
+    }
+    return best;
+}
+
+// Where segment p0p1 stops being within clearance_m of segment q0q1, searching
+// from t_in (inside) toward t_out (0 or 1). Points near a segment form a convex
+// region, so the stretch of p0p1 inside it is one interval and bisection finds its edge.
+static float band_edge(GeoPoint p0, GeoPoint p1, GeoPoint q0, GeoPoint q1, float t_in, float t_out,
+                       float clearance_m)
+{
+    float t;
+    GeoPoint end = {p0.x + t_out * (p1.x - p0.x), p0.y + t_out * (p1.y - p0.y)};
+    if (point_segment_distance(end, q0, q1, &t) < clearance_m)
+        return t_out;
+
+    for (int k = 0; k < 16; k++)
+    {
+        float mid = 0.5f * (t_in + t_out);
+        GeoPoint m = {p0.x + mid * (p1.x - p0.x), p0.y + mid * (p1.y - p0.y)};
+        if (point_segment_distance(m, q0, q1, &t) < clearance_m)
+            t_in = mid;
+        else
+            t_out = mid;
+    }
+    return t_in;
+}
 
-    // This line controlls merges. We shall allow merges for this demo
-    if (tgtA->id == tgtB->id)
+// Conflict zone of paths a and b: everywhere they come within clearance_m of
+// each other. dist_a is where a last leaves it, dist_b where b first enters
+// it, both measured along the path from its source; with dist_a NULL the first
+// hit answers. Segment pairs whose bounding boxes are further apart than
+// clearance_m are skipped unmeasured.
+static bool paths_conflict(const ConnectionPath *a, const ConnectionPath *b, float clearance_m, float *dist_a,
+                           float *dist_b)
+{
+    bool hit = false;
+    float last_a = 0.0f, first_b = 0.0f, along_a = 0.0f;
+    for (uint32_t i = 1; i < a->point_cnt; i++)
+    {
+        GeoPoint a0 = path_point(a, i - 1), a1 = path_point(a, i);
+        float a_len = sqrtf((a1.x - a0.x) * (a1.x - a0.x) + (a1.y - a0.y) * (a1.y - a0.y));
+        float min_x = fminf(a0.x, a1.x) - clearance_m, max_x = fmaxf(a0.x, a1.x) + clearance_m;
+        float min_y = fminf(a0.y, a1.y) - clearance_m, max_y = fmaxf(a0.y, a1.y) + clearance_m;
+
+        float along_b = 0.0f;
+        for (uint32_t j = 1; j < b->point_cnt; j++)
+        {
+            GeoPoint b0 = path_point(b, j - 1), b1 = path_point(b, j);
+            float b_len = sqrtf((b1.x - b0.x) * (b1.x - b0.x) + (b1.y - b0.y) * (b1.y - b0.y));
+            bool apart = fmaxf(b0.x, b1.x) < min_x || fminf(b0.x, b1.x) > max_x || fmaxf(b0.y, b1.y) < min_y ||
+                         fminf(b0.y, b1.y) > max_y;
+
+            float ta, tb;
+            if (!apart && segment_distance(a0, a1, b0, b1, &ta, &tb) < clearance_m)
+            {
+                if (!dist_a)
+                    return true;
+                float leave_a = along_a + band_edge(a0, a1, b0, b1, ta, 1.0f, clearance_m) * a_len;
+                float enter_b = along_b + band_edge(b0, b1, a0, a1, tb, 0.0f, clearance_m) * b_len;
+                if (!hit || leave_a > last_a)
+                    last_a = leave_a;
+                if (!hit || enter_b < first_b)
+                    first_b = enter_b;
+                hit = true;
+            }
+            along_b += b_len;
+        }
+        along_a += a_len;
+    }
+
+    if (hit)
+    {
+        *dist_a = last_a;
+        *dist_b = first_b;
+    }
+    return hit;
+}
+
+static void store_point(ConnectionPath *path, float x, float y)
+{
+    float qx = roundf(x / PATH_UNIT_M), qy = roundf(y / PATH_UNIT_M);
+    path->x[path->point_cnt] = (int16_t)fmaxf(-32767.0f, fminf(32767.0f, qx));
+    path->y[path->point_cnt] = (int16_t)fmaxf(-32767.0f, fminf(32767.0f, qy));
+    path->point_cnt++;
+}
+
+bool set_connection_path(Intersection *intr, uint32_t conn_idx, const float *xy, uint32_t point_cnt)
+{
+    if (!intr || !intr->paths || conn_idx >= intr->connection_cnt || point_cnt < 2 || point_cnt > PATH_MAX_POINTS)
         return false;
 
-    std::vector<Point> points;
-    points.push_back({0, srcA->bearing});
-    points.push_back({0, tgtA->bearing});
-    points.push_back({1, srcB->bearing});
-    points.push_back({1, tgtB->bearing});
-    std::sort(points.begin(), points.end(), comparePoints);
+    ConnectionPath *path = &intr->paths[conn_idx];
+    path->point_cnt = 0;
+    for (uint32_t i = 0; i < point_cnt; i++)
+        store_point(path, xy[2 * i], xy[2 * i + 1]);
+    return true;
+}
 
-    // 5. Check the pattern
-    // If crossed: 0 -> 1 -> 0 -> 1  (ABAB)
-    // If safe:    0 -> 0 -> 1 -> 1  (AABB)
+bool set_connection_arc(Intersection *intr, uint32_t conn_idx, float cx, float cy, float radius_m, float start_deg,
+                        float end_deg)
+{
+    if (!intr || !intr->paths || conn_idx >= intr->connection_cnt || radius_m <= 0.0f)
+        return false;
 
-    // We just check if the ID of the first point matches the ID of the second point.
-    // If points[0].id == points[1].id, then it is AA... (Safe)
-    // If points[0].id != points[1].id, then it is AB... (Potential Cross)
+    ConnectionPath *path = &intr->paths[conn_idx];
+    path->point_cnt = 0;
+    for (uint32_t i = 0; i < PATH_MAX_POINTS; i++)
+    {
+        float deg = start_deg + (end_deg - start_deg) * i / (PATH_MAX_POINTS - 1);
+        float rad = deg * (float)M_PI / 180.0f;
+        store_point(path, cx + radius_m * sinf(rad), cy + radius_m * cosf(rad));
+    }
+    return true;
+}
 
-    bool is_abab = (points[0].id != points[1].id) && (points[1].id != points[2].id);
+// Movements out of one lane diverge and merges are allowed, whatever is drawn;
+// crossings never conflict with each other. Everything else is measured.
+static bool paths_cross(Intersection *intr, uint32_t conn_a, uint32_t conn_b)
+{
+    const Connection *cA = &intr->connections[conn_a];
+    const Connection *cB = &intr->connections[conn_b];
+    if (cA->source_lane_idx == cB->source_lane_idx || cA->target_lane_idx == cB->target_lane_idx)
+        return false;
+    if (intr->lanes[cA->source_lane_idx].type == LANE_CROSSWALK && intr->lanes[cB->source_lane_idx].type == LANE_CROSSWALK)
+        return false;
 
-    return is_abab;
+    return paths_conflict(&intr->paths[conn_a], &intr->paths[conn_b], intr->path_clearance_m, NULL, NULL);
 }
 
 void compute_conflicts_on_device(Intersection *intr)
@@ -63,7 +230,7 @@ void compute_conflicts_on_device(Intersection *intr)
     Serial.println("[GEO] Computing geometry conflicts...");
 
     // 1. Clear old conflicts
-    memset(intr->conflict_masks, 0, sizeof(intr->conflict_masks));
+    memset(intr->conflict_masks, 0, intr->connection_cap * sizeof(uint64_t));
 
     // 2. Check every connection against every other connection
     for (int i = 0; i < intr->connection_cnt; i++)
@@ -80,7 +247,8 @@ void compute_conflicts_on_device(Intersection *intr)
             Lane *srcB = &intr->lanes[cB->source_lane_idx];
             Lane *tgtB = &intr->lanes[cB->target_lane_idx];
 
-            if (do_paths_cross(srcA, tgtA, srcB, tgtB))
+            bool drawn = has_path(&intr->paths[i]) && has_path(&intr->paths[j]);
+            if (drawn ? paths_cross(intr, i, j) : do_paths_cross(srcA, tgtA, srcB, tgtB))
             {
                 add_conflict(intr, i, j);
                 Serial.printf("[GEO] CONFLICT: Conn %d vs %d\n", i, j);
@@ -89,6 +257,131 @@ void compute_conflicts_on_device(Intersection *intr)
     }
 }
 
+// --- INTERGREENS ---
+
+static GeoPoint bearing_point(uint16_t bearing)
+{
+    float rad = bearing * (float)M_PI / 180.0f;
+    GeoPoint p = {INTERGREEN_JUNCTION_RADIUS_M * sinf(rad), INTERGREEN_JUNCTION_RADIUS_M * cosf(rad)};
+    return p;
+}
+
+static float geo_distance(GeoPoint a, GeoPoint b)
+{
+    return sqrtf((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+}
+
+static float movement_length(const Lane *src, const Lane *tgt)
+{
+    return geo_distance(bearing_point(src->bearing), bearing_point(tgt->bearing));
+}
+
+// Distance along each chord from its source to where the two chords cross.
+// Returns false if they don't (parallel or only touching at the rim).
+static bool chord_crossing(const Lane *srcA, const Lane *tgtA, const Lane *srcB, const Lane *tgtB,
+                           float *dist_a, float *dist_b)
+{
+    GeoPoint a0 = bearing_point(srcA->bearing), a1 = bearing_point(tgtA->bearing);
+    GeoPoint b0 = bearing_point(srcB->bearing), b1 = bearing_point(tgtB->bearing);
+
+    float ax = a1.x - a0.x, ay = a1.y - a0.y;
+    float bx = b1.x - b0.x, by = b1.y - b0.y;
+    float denom = ax * by - ay * bx;
+    if (fabsf(denom) < 1e-6f)
+        return false;
+
+    float t = ((b0.x - a0.x) * by - (b0.y - a0.y) * bx) / denom;
+    float u = ((b0.x - a0.x) * ay - (b0.y - a0.y) * ax) / denom;
+    if (t < 0.0f || t > 1.0f || u < 0.0f || u > 1.0f)
+        return false;
+
+    *dist_a = t * sqrtf(ax * ax + ay * ay);
+    *dist_b = u * sqrtf(bx * bx + by * by);
+    return true;
+}
+
+// Classic intergreen split: the last user of the ending movement must clear the
+// conflict point before the first user of the starting one can reach it.
+static float clearance_seconds(Intersection *intr, uint32_t ending_idx, uint32_t starting_idx)
+{
+    const Connection *ending = &intr->connections[ending_idx];
+    const Connection *starting = &intr->connections[starting_idx];
+    const Lane *srcA = &intr->lanes[ending->source_lane_idx];
+    const Lane *tgtA = &intr->lanes[ending->target_lane_idx];
+    const Lane *srcB = &intr->lanes[starting->source_lane_idx];
+    const Lane *tgtB = &intr->lanes[starting->target_lane_idx];
+
+    // Drawn paths: along them to where the ending one leaves the conflict zone and the starting one enters it
+    const ConnectionPath *pathA = &intr->paths[ending_idx];
+    const ConnectionPath *pathB = &intr->paths[starting_idx];
+    float clear, enter;
+    if (has_path(pathA) && has_path(pathB) && paths_conflict(pathA, pathB, intr->path_clearance_m, &clear, &enter))
+    {
+        if (srcA->type == LANE_CROSSWALK)
+            return path_length(pathA) / INTERGREEN_WALK_SPEED_MPS - enter / INTERGREEN_ENTER_SPEED_MPS;
+        return (clear + INTERGREEN_VEHICLE_LENGTH_M) / INTERGREEN_CLEAR_SPEED_MPS - enter / INTERGREEN_ENTER_SPEED_MPS;
+    }
+
+    // Pedestrians leaving: the whole crossing, nobody enters it before that
+    if (srcA->type == LANE_CROSSWALK)
+    {
+        enter = srcB->bearing == srcA->bearing ? 0.0f : movement_length(srcB, tgtB);
+        return INTERGREEN_CROSSWALK_LENGTH_M / INTERGREEN_WALK_SPEED_MPS - enter / INTERGREEN_ENTER_SPEED_MPS;
+    }
+
+    // Vehicles leaving over a crosswalk that is about to show WALK
+    if (srcB->type == LANE_CROSSWALK)
+    {
+        clear = srcA->bearing == srcB->bearing ? 0.0f : movement_length(srcA, tgtA);
+        return (clear + INTERGREEN_VEHICLE_LENGTH_M) / INTERGREEN_CLEAR_SPEED_MPS;
+    }
+
+    if (!chord_crossing(srcA, tgtA, srcB, tgtB, &clear, &enter))
+    {
+        // No clean crossing point: assume the worst, the whole path against an immediate arrival
+        clear = movement_length(srcA, tgtA);
+        enter = 0.0f;
+    }
+    return (clear + INTERGREEN_VEHICLE_LENGTH_M) / INTERGREEN_CLEAR_SPEED_MPS - enter / INTERGREEN_ENTER_SPEED_MPS;
+}
+
+void compute_clearances_on_device(Intersection *intr)
+{
+    if (!intr || !intr->clearance)
+        return;
+
+    uint32_t n = intr->connection_cnt;
+    memset(intr->clearance, 0, intr->connection_cap * intr->connection_cap * sizeof(uint8_t));
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        for (uint32_t j = 0; j < n; j++)
+        {
+            if (!((intr->conflict_masks[i] >> j) & 1))
+                continue;
+
+            float seconds = clearance_seconds(intr, i, j);
+            float units = ceilf(seconds * 1000.0f / INTERGREEN_UNIT_MS);
+            if (units < 0.0f)
+                units = 0.0f;
+            if (units > 255.0f)
+                units = 255.0f;
+            intr->clearance[i * intr->connection_cap + j] = (uint8_t)units;
+        }
+    }
+}
+
+uint32_t intergreen_ms(const Intersection *intr, uint32_t ending_conn, uint32_t starting_conn, uint32_t yellow_ms)
+{
+    if (!((intr->conflict_masks[ending_conn] >> starting_conn) & 1))
+        return 0;
+
+    uint32_t ms = intr->clearance[ending_conn * intr->connection_cap + starting_conn] * INTERGREEN_UNIT_MS;
+    if (intr->lanes[intr->connections[ending_conn].source_lane_idx].type != LANE_CROSSWALK)
+        ms += yellow_ms; // Crosswalks have no yellow, their clearance is the flashing DON'T WALK
+    return ms;
+}
+
 // The Runtime Safety Check
 bool is_phase_safe(Intersection *intr, uint64_t phase_mask)
 {
@@ -107,15 +400,64 @@ bool is_phase_safe(Intersection *intr, uint64_t phase_mask)
     return true;
 }
 
-bool intersection_init(Intersection *intr, uint32_t default_duration_ms)
+void arena_init(IntersectionArena *arena, void *buffer, size_t capacity)
 {
-    if (!intr)
+    arena->base = (uint8_t *)buffer;
+    arena->capacity = buffer ? capacity : 0;
+    arena->used = 0;
+}
+
+void *arena_alloc(IntersectionArena *arena, size_t size, size_t align)
+{
+    size_t offset = arena_align_up(arena->used, align);
+    if (offset + size > arena->capacity)
+    {
+        return NULL;
+    }
+    arena->used = offset + size;
+    return arena->base + offset;
+}
+
+bool intersection_init(Intersection *intr, uint32_t default_duration_ms, IntersectionArena *arena,
+                       uint32_t lane_cap, uint32_t connection_cap, uint32_t phase_cap)
+{
+    if (!intr || !arena)
+    {
+        return false;
+    }
+    if (lane_cap > MAX_LANE_CNT || connection_cap > MAX_CONNECTION_CNT || phase_cap > MAX_PHASE_CNT)
     {
         return false;
     }
     memset(intr, 0, sizeof(Intersection));
 
+    // Hot arrays first so they share cache lines; order matches intersection_storage_bytes()
+    intr->lane_traffic = (uint16_t *)arena_alloc(arena, lane_cap * sizeof(uint16_t), alignof(uint16_t));
+    intr->connections = (Connection *)arena_alloc(arena, connection_cap * sizeof(Connection), alignof(Connection));
+    intr->phases = (Phase *)arena_alloc(arena, phase_cap * sizeof(Phase), alignof(Phase));
+    intr->conflict_masks = (uint64_t *)arena_alloc(arena, connection_cap * sizeof(uint64_t), alignof(uint64_t));
+    intr->lanes = (Lane *)arena_alloc(arena, lane_cap * sizeof(Lane), alignof(Lane));
+    intr->paths = (ConnectionPath *)arena_alloc(arena, connection_cap * sizeof(ConnectionPath), alignof(ConnectionPath));
+    intr->clearance = (uint8_t *)arena_alloc(arena, connection_cap * connection_cap * sizeof(uint8_t), alignof(uint8_t));
+
+    if (!intr->lane_traffic || !intr->connections || !intr->phases || !intr->conflict_masks || !intr->lanes ||
+        (connection_cap > 0 && (!intr->clearance || !intr->paths)))
+    {
+        memset(intr, 0, sizeof(Intersection));
+        return false;
+    }
+
+    memset(intr->lane_traffic, 0, lane_cap * sizeof(uint16_t));
+    memset(intr->conflict_masks, 0, connection_cap * sizeof(uint64_t));
+    memset(intr->clearance, 0, connection_cap * connection_cap * sizeof(uint8_t));
+    memset(intr->paths, 0, connection_cap * sizeof(ConnectionPath));
+
+    intr->lane_cap = lane_cap;
+    intr->connection_cap = connection_cap;
+    intr->phase_cap = phase_cap;
+
     intr->default_phase_duration_ms = default_duration_ms;
+    intr->path_clearance_m = PATH_CLEARANCE_M;
     intr->current_phase_idx = 0;
 
     return true;
@@ -129,14 +471,17 @@ void intersection_reset(Intersection *intr)
         intr->connection_cnt = 0;
         intr->phase_cnt = 0;
         intr->current_phase_idx = 0;
-        memset(intr->conflict_masks, 0, sizeof(intr->conflict_masks));
+        memset(intr->lane_traffic, 0, intr->lane_cap * sizeof(uint16_t));
+        memset(intr->conflict_masks, 0, intr->connection_cap * sizeof(uint64_t));
+        memset(intr->clearance, 0, intr->connection_cap * intr->connection_cap * sizeof(uint8_t));
+        memset(intr->paths, 0, intr->connection_cap * sizeof(ConnectionPath));
     }
 }
 
 uint32_t add_lane(Intersection *intr, uint32_t id, LaneType type, LaneHardware hw, uint16_t bearing)
 {
     // 1. Validation
-    if (!intr || intr->lane_cnt >= MAX_LANE_CNT)
+    if (!intr || intr->lane_cnt >= intr->lane_cap)
     {
         return INTGRAPH_INVALID_INDEX;
     }
@@ -154,15 +499,15 @@ uint32_t add_lane(Intersection *intr, uint32_t id, LaneType type, LaneHardware h
     l->id = id;
     l->type = type;
     l->hw = hw;
-    l->current_traffic_value = 0; // Default start value
     l->bearing = bearing;
+    intr->lane_traffic[idx] = 0; // Default start value
     intr->lane_cnt++;
     return idx;
 }
 
 uint32_t add_connection(Intersection *intr, uint32_t source_lane_idx, uint32_t target_lane_idx)
 {
-    if (!intr || intr->connection_cnt >= MAX_CONNECTION_CNT)
+    if (!intr || intr->connection_cnt >= intr->connection_cap)
     {
         return INTGRAPH_INVALID_INDEX;
     }
@@ -177,15 +522,48 @@ uint32_t add_connection(Intersection *intr, uint32_t source_lane_idx, uint32_t t
 
     c->source_lane_idx = source_lane_idx;
     c->target_lane_idx = target_lane_idx;
-    c->weight = 1;
+    c->weight = CONNECTION_WEIGHT_ONE;
 
     intr->connection_cnt++;
     return idx;
 }
 
+uint32_t add_crosswalk_connections(Intersection *intr)
+{
+    if (!intr)
+    {
+        return 0;
+    }
+
+    uint32_t added = 0;
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        if (intr->lanes[i].type != LANE_CROSSWALK)
+        {
+            continue;
+        }
+
+        bool has_connection = false;
+        for (uint32_t c = 0; c < intr->connection_cnt; c++)
+        {
+            if (intr->connections[c].source_lane_idx == i)
+            {
+                has_connection = true;
+                break;
+            }
+        }
+
+        if (!has_connection && add_connection(intr, i, i) != INTGRAPH_INVALID_INDEX)
+        {
+            added++;
+        }
+    }
+    return added;
+}
+
 void add_phase(Intersection *intr, uint64_t connection_mask, uint32_t duration_ms)
 {
-    if (!intr || intr->phase_cnt >= MAX_PHASE_CNT)
+    if (!intr || intr->phase_cnt >= intr->phase_cap)
     {
         return;
     }
@@ -195,6 +573,15 @@ void add_phase(Intersection *intr, uint64_t connection_mask, uint32_t duration_m
 
     p->active_connections_mask = connection_mask;
 
+    p->green_lanes_mask = 0;
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+    {
+        if (connection_mask & ((uint64_t)1 << c))
+        {
+            p->green_lanes_mask |= ((uint64_t)1 << intr->connections[c].source_lane_idx);
+        }
+    }
+
     if (duration_ms > 0)
     {
         p->duration_ms = duration_ms;
@@ -0,0 +1,375 @@
+#include "LightOutput.h"
+#include <string.h>
+#include <Arduino.h>
+#include <Wire.h>
+#include "esp_attr.h"
+#include "driver/spi_master.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "soc/gpio_reg.h"
+#include "soc/soc.h"
+
+static_assert(SHIFT_REGISTER_COUNT * 8 <= LIGHT_OUTPUT_MAX_CHANNELS, "Shift register chain longer than a frame");
+static_assert(I2C_EXPANDER_COUNT * 16 <= LIGHT_OUTPUT_MAX_CHANNELS, "More expander channels than a frame");
+static_assert(I2C_EXPANDER_COUNT <= 8, "MCP23017 has 8 addresses");
+
+// --- STATE ---
+static const LightOutputBackend *active = NULL;
+static LightFrame staged;
+static LightFrame shown;
+static SemaphoreHandle_t bus_lock = NULL;
+static uint32_t commit_count = 0;
+static volatile bool blanked = false; // blank() in effect, until the forced frame is out
+
+static void no_claim(int16_t channel)
+{
+    (void)channel;
+}
+
+// Single-register write, safe from any core without a lock
+static void IRAM_ATTR pin_write_fast(int16_t pin, bool high)
+{
+    if (pin < 0 || pin >= 64)
+        return;
+    if (pin < 32)
+        REG_WRITE(high ? GPIO_OUT_W1TS_REG : GPIO_OUT_W1TC_REG, (uint32_t)1 << pin);
+    else
+        REG_WRITE(high ? GPIO_OUT1_W1TS_REG : GPIO_OUT1_W1TC_REG, (uint32_t)1 << (pin - 32));
+}
+
+static void shown_read_back(LightFrame *out)
+{
+    *out = shown;
+}
+
+// --- GPIO ---
+// Channel N = GPIO N. Two register writes per commit.
+
+static uint64_t gpio_claimed = 0;
+
+static bool gpio_begin()
+{
+    gpio_claimed = 0;
+    return true;
+}
+
+static void gpio_claim(int16_t channel)
+{
+    if (channel < 0 || channel >= 64)
+        return;
+    pinMode(channel, OUTPUT);
+    gpio_claimed |= (uint64_t)1 << channel;
+}
+
+static void gpio_commit(const LightFrame *shown_frame, const LightFrame *next)
+{
+    (void)shown_frame;
+    uint64_t levels = 0;
+    for (int i = 0; i < 8; i++)
+        levels |= (uint64_t)next->bits[i] << (8 * i);
+
+    uint64_t on = levels & gpio_claimed;
+    uint64_t off = ~levels & gpio_claimed;
+
+    // Clear before set: lamps can go dark for a moment, never double up
+    REG_WRITE(GPIO_OUT_W1TC_REG, (uint32_t)off);
+    REG_WRITE(GPIO_OUT1_W1TC_REG, (uint32_t)(off >> 32));
+    REG_WRITE(GPIO_OUT_W1TS_REG, (uint32_t)on);
+    REG_WRITE(GPIO_OUT1_W1TS_REG, (uint32_t)(on >> 32));
+}
+
+// The registers need no bus: the frame itself goes out, either way
+static void gpio_blank(const LightFrame *frame)
+{
+    gpio_commit(&shown, frame);
+}
+
+static void gpio_read_back(LightFrame *out)
+{
+    // The output latches themselves, so stray writes from anywhere are visible
+    uint64_t levels = ((uint64_t)REG_READ(GPIO_OUT1_REG) << 32) | REG_READ(GPIO_OUT_REG);
+    memset(out, 0, sizeof(LightFrame));
+    for (int i = 0; i < 8; i++)
+        out->bits[i] = (uint8_t)(levels >> (8 * i));
+}
+
+// --- 74HC595 CHAIN ---
+// Channel N = output N % 8 of register N / 8, register 0 nearest the ESP32.
+
+static spi_device_handle_t shift_device = NULL;
+DMA_ATTR static uint8_t shift_tx[SHIFT_REGISTER_COUNT];
+
+static bool shift_begin()
+{
+    pinMode(SHIFT_REGISTER_OE_PIN, OUTPUT);
+    pin_write_fast(SHIFT_REGISTER_OE_PIN, false);
+
+    spi_bus_config_t bus;
+    memset(&bus, 0, sizeof(bus));
+    bus.mosi_io_num = SHIFT_REGISTER_DATA_PIN;
+    bus.miso_io_num = -1;
+    bus.sclk_io_num = SHIFT_REGISTER_CLOCK_PIN;
+    bus.quadwp_io_num = -1;
+    bus.quadhd_io_num = -1;
+    bus.max_transfer_sz = SHIFT_REGISTER_COUNT;
+    if (spi_bus_initialize(SPI2_HOST, &bus, SPI_DMA_CH_AUTO) != ESP_OK)
+        return false;
+
+    spi_device_interface_config_t dev;
+    memset(&dev, 0, sizeof(dev));
+    dev.clock_speed_hz = SHIFT_REGISTER_CLOCK_HZ;
+    dev.mode = 0;
+    dev.spics_io_num = SHIFT_REGISTER_LATCH_PIN;
+    dev.queue_size = 1;
+    return spi_bus_add_device(SPI2_HOST, &dev, &shift_device) == ESP_OK;
+}
+
+static void shift_commit(const LightFrame *shown_frame, const LightFrame *next)
+{
+    (void)shown_frame; // The latch makes every commit atomic
+
+    // The first byte shifted out travels to the far end of the chain
+    for (int r = 0; r < SHIFT_REGISTER_COUNT; r++)
+        shift_tx[SHIFT_REGISTER_COUNT - 1 - r] = next->bits[r];
+
+    spi_transaction_t t;
+    memset(&t, 0, sizeof(t));
+    t.length = SHIFT_REGISTER_COUNT * 8;
+    t.tx_buffer = shift_tx;
+    spi_device_transmit(shift_device, &t);
+}
+
+// /OE high: every output off at once, whatever is on the SPI bus
+static void shift_blank(const LightFrame *frame)
+{
+    (void)frame;
+    pin_write_fast(SHIFT_REGISTER_OE_PIN, true);
+}
+
+// Latched before the outputs come back on
+static void shift_unblank(const LightFrame *frame)
+{
+    shift_commit(&shown, frame);
+    pin_write_fast(SHIFT_REGISTER_OE_PIN, false);
+}
+
+// --- MCP23017 EXPANDERS ---
+// Channel N = bit N % 16 of expander N / 16 (GPA0..7 then GPB0..7).
+
+#define MCP23017_IODIRA 0x00
+#define MCP23017_OLATA 0x14
+
+static bool expander_write(uint8_t chip, uint8_t reg, uint8_t a, uint8_t b)
+{
+    Wire.beginTransmission(I2C_EXPANDER_BASE_ADDRESS + chip);
+    Wire.write(reg);
+    Wire.write(a); // Register pairs auto-increment A -> B
+    Wire.write(b);
+    return Wire.endTransmission() == 0;
+}
+
+static bool expander_begin()
+{
+    pinMode(I2C_EXPANDER_RESET_PIN, OUTPUT);
+    pin_write_fast(I2C_EXPANDER_RESET_PIN, true);
+    if (!Wire.begin(I2C_EXPANDER_SDA_PIN, I2C_EXPANDER_SCL_PIN, I2C_EXPANDER_CLOCK_HZ))
+        return false;
+
+    for (uint8_t chip = 0; chip < I2C_EXPANDER_COUNT; chip++)
+    {
+        // Latches low first so nothing lights up when the pins become outputs
+        if (!expander_write(chip, MCP23017_OLATA, 0x00, 0x00) || !expander_write(chip, MCP23017_IODIRA, 0x00, 0x00))
+        {
+            Serial.printf("[OUT] No expander answering at 0x%02x\n", I2C_EXPANDER_BASE_ADDRESS + chip);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void expander_send(const LightFrame *frame)
+{
+    for (uint8_t chip = 0; chip < I2C_EXPANDER_COUNT; chip++)
+        expander_write(chip, MCP23017_OLATA, frame->bits[2 * chip], frame->bits[2 * chip + 1]);
+}
+
+static void expander_commit(const LightFrame *shown_frame, const LightFrame *next)
+{
+    // Separate chips can't latch together, so break before make:
+    // first only what stays on, then the full new frame.
+    LightFrame kept;
+    for (int i = 0; i < LIGHT_OUTPUT_FRAME_BYTES; i++)
+        kept.bits[i] = shown_frame->bits[i] & next->bits[i];
+
+    if (memcmp(&kept, shown_frame, sizeof(LightFrame)) != 0)
+        expander_send(&kept);
+    expander_send(next);
+}
+
+// /RESET low: every pin back to an input, lamps off, whatever is on the I2C bus
+static void expander_blank(const LightFrame *frame)
+{
+    (void)frame;
+    pin_write_fast(I2C_EXPANDER_RESET_PIN, false);
+}
+
+// Out of reset the expanders are inputs with their latches low; the frame
+// goes into the latches before the pins become outputs again
+static void expander_unblank(const LightFrame *frame)
+{
+    pin_write_fast(I2C_EXPANDER_RESET_PIN, true);
+    expander_send(frame);
+    for (uint8_t chip = 0; chip < I2C_EXPANDER_COUNT; chip++)
+        expander_write(chip, MCP23017_IODIRA, 0x00, 0x00);
+}
+
+// --- MOCK ---
+
+static LightOutputMockRecord mock_records[LIGHT_OUTPUT_MOCK_FRAMES];
+static uint32_t mock_count = 0;
+
+static bool mock_begin()
+{
+    mock_count = 0;
+    return true;
+}
+
+static void mock_commit(const LightFrame *shown_frame, const LightFrame *next)
+{
+    (void)shown_frame;
+    LightOutputMockRecord *rec = &mock_records[mock_count % LIGHT_OUTPUT_MOCK_FRAMES];
+    rec->frame = *next;
+    rec->time_ms = millis();
+    mock_count++;
+}
+
+// Recorded like a commit, so a bench sees the lamps go safe
+static void mock_blank(const LightFrame *frame)
+{
+    mock_commit(&shown, frame);
+}
+
+static const LightOutputBackend BACKENDS[] = {
+    {"gpio", 64, gpio_begin, gpio_claim, gpio_commit, gpio_read_back, gpio_blank, gpio_blank},
+    {"74hc595", SHIFT_REGISTER_COUNT * 8, shift_begin, no_claim, shift_commit, shown_read_back, shift_blank,
+     shift_unblank},
+    {"mcp23017", I2C_EXPANDER_COUNT * 16, expander_begin, no_claim, expander_commit, shown_read_back, expander_blank,
+     expander_unblank},
+    {"mock", LIGHT_OUTPUT_MAX_CHANNELS, mock_begin, no_claim, mock_commit, shown_read_back, mock_blank, mock_blank},
+};
+
+// --- PUBLIC API ---
+
+bool light_output_setup(LightOutputKind kind)
+{
+    if ((uint32_t)kind >= sizeof(BACKENDS) / sizeof(BACKENDS[0]))
+        return false;
+    return light_output_setup_backend(&BACKENDS[kind]);
+}
+
+bool light_output_setup_backend(const LightOutputBackend *backend)
+{
+    if (!backend || backend->channel_cnt > LIGHT_OUTPUT_MAX_CHANNELS)
+        return false;
+    if (bus_lock == NULL)
+        bus_lock = xSemaphoreCreateMutex();
+
+    xSemaphoreTake(bus_lock, portMAX_DELAY);
+    active = backend;
+    memset(&staged, 0, sizeof(staged));
+    memset(&shown, 0, sizeof(shown));
+    commit_count = 0;
+    bool ok = active->begin();
+    xSemaphoreGive(bus_lock);
+
+    Serial.printf("[OUT] %s backend, %d channels%s\n", active->name, active->channel_cnt, ok ? "" : " - INIT FAILED");
+    return ok;
+}
+
+const char *light_output_name()
+{
+    return active ? active->name : "none";
+}
+
+void light_output_claim(int16_t channel)
+{
+    if (active && channel >= 0 && channel < active->channel_cnt)
+        active->claim(channel);
+}
+
+void light_output_set(int16_t channel, bool on)
+{
+    if (!active || channel < 0 || channel >= active->channel_cnt)
+        return;
+
+    uint8_t bit = (uint8_t)(1 << (channel & 7));
+    if (on)
+        staged.bits[channel >> 3] |= bit;
+    else
+        staged.bits[channel >> 3] &= (uint8_t)~bit;
+}
+
+void light_output_commit()
+{
+    if (!active)
+        return;
+
+    xSemaphoreTake(bus_lock, portMAX_DELAY);
+    if (memcmp(&staged, &shown, sizeof(LightFrame)) != 0)
+    {
+        active->commit(&shown, &staged);
+        shown = staged;
+        commit_count++;
+    }
+    xSemaphoreGive(bus_lock);
+}
+
+bool light_output_read(LightFrame *out)
+{
+    if (!active || xSemaphoreTake(bus_lock, 0) != pdTRUE)
+        return false;
+    active->read_back(out);
+    xSemaphoreGive(bus_lock);
+    return true;
+}
+
+bool light_output_force(const LightFrame *frame)
+{
+    if (!active)
+        return false;
+    if (xSemaphoreTake(bus_lock, 0) != pdTRUE)
+    {
+        // The controller holds the bus, maybe for good: no waiting for it
+        active->blank(frame);
+        blanked = true;
+        return false;
+    }
+
+    if (blanked)
+        active->unblank(frame);
+    else
+        active->commit(&shown, frame);
+    blanked = false;
+    shown = *frame;
+    commit_count++;
+    xSemaphoreGive(bus_lock);
+    return true;
+}
+
+uint32_t light_output_commit_count()
+{
+    return commit_count;
+}
+
+uint32_t light_output_mock_count()
+{
+    return mock_count;
+}
+
+const LightOutputMockRecord *light_output_mock_record(uint32_t idx)
+{
+    uint32_t held = mock_count < LIGHT_OUTPUT_MOCK_FRAMES ? mock_count : LIGHT_OUTPUT_MOCK_FRAMES;
+    if (idx >= held)
+        return NULL;
+    return &mock_records[(mock_count - held + idx) % LIGHT_OUTPUT_MOCK_FRAMES];
+}
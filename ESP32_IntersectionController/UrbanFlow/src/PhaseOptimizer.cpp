@@ -0,0 +1,221 @@
+#include "PhaseOptimizer.h"
+#include <string.h>
+#include <Arduino.h>
+
+// --- SEARCH CONTEXT ---
+// File-scope so the search never touches the loop() stack or the heap.
+static struct {
+    const Intersection *intr;
+    const float *arrival;
+    uint8_t in_lanes[MAX_LANE_CNT]; // Only inbound lanes queue
+    uint32_t in_lane_cnt;
+    float service[MAX_PHASE_CNT][MAX_LANE_CNT]; // Discharge per lane per phase, vehicles/s
+    float queue[LOOKAHEAD_DEPTH + 1][MAX_LANE_CNT];
+    float block_s;
+    float loss_s;
+    bool force_switch;
+
+    uint32_t nodes;
+    uint32_t node_limit; // Share of LOOKAHEAD_MAX_NODES for the first phase being expanded
+    float best_cost;
+    int best_first_phase;
+} ctx;
+
+void arrival_estimator_reset(ArrivalEstimator *est)
+{
+    memset(est, 0, sizeof(ArrivalEstimator));
+}
+
+void arrival_estimator_update(ArrivalEstimator *est, const Intersection *intr, uint64_t serving_lanes, uint32_t elapsed_ms)
+{
+    if (!est || !intr || elapsed_ms == 0)
+        return;
+
+    if (!est->primed)
+    {
+        memcpy(est->last_queue, intr->lane_traffic, intr->lane_cnt * sizeof(uint16_t));
+        est->primed = true;
+        return;
+    }
+
+    float dt = elapsed_ms / 1000.0f;
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        uint16_t q = intr->lane_traffic[i];
+
+        // Departures are unknown while a lane is served, so only learn from red time
+        if (intr->lanes[i].type == LANE_IN && !((serving_lanes >> i) & 1))
+        {
+            float observed = (q > est->last_queue[i]) ? (q - est->last_queue[i]) / dt : 0.0f;
+            est->arrival_rate_vps[i] += ARRIVAL_EWMA_ALPHA * (observed - est->arrival_rate_vps[i]);
+        }
+        est->last_queue[i] = q;
+    }
+}
+
+// Queue-seconds over t seconds of a queue changing linearly at net_rate, floored at zero
+static float segment_cost(float *q, float net_rate, float t)
+{
+    float end = *q + net_rate * t;
+    if (end >= 0)
+    {
+        float cost = t * (*q + end) * 0.5f;
+        *q = end;
+        return cost;
+    }
+
+    // Clears before the segment ends; afterwards arrivals are served on the spot
+    float t_clear = *q / -net_rate;
+    float cost = *q * t_clear * 0.5f;
+    *q = 0;
+    return cost;
+}
+
+static float advance_block(int depth, int phase, bool switching)
+{
+    const float *q_in = ctx.queue[depth];
+    float *q_out = ctx.queue[depth + 1];
+    float loss_s = switching ? ctx.loss_s : 0.0f;
+    float green_s = ctx.block_s - loss_s;
+    float cost = 0;
+
+    for (uint32_t k = 0; k < ctx.in_lane_cnt; k++)
+    {
+        uint32_t l = ctx.in_lanes[k];
+        float q = q_in[l];
+        float lambda = ctx.arrival[l];
+
+        // Yellow / all-red: nobody is served
+        if (loss_s > 0)
+            cost += segment_cost(&q, lambda, loss_s);
+
+        cost += segment_cost(&q, lambda - ctx.service[phase][l], green_s);
+        q_out[l] = q;
+    }
+    return cost;
+}
+
+// Depth-first below one first phase, within ctx.node_limit
+static void search(int depth, int prev_phase, float cost_so_far, int first_phase)
+{
+    if (depth == LOOKAHEAD_DEPTH)
+    {
+        if (cost_so_far < ctx.best_cost)
+        {
+            ctx.best_cost = cost_so_far;
+            ctx.best_first_phase = first_phase;
+        }
+        return;
+    }
+
+    uint32_t phase_cnt = ctx.intr->phase_cnt;
+
+    // Staying in prev_phase first: it is usually good, so it tightens the bound early
+    for (uint32_t n = 0; n < phase_cnt; n++)
+    {
+        int p = (prev_phase + n) % phase_cnt;
+        if (ctx.nodes >= ctx.node_limit)
+            return;
+        ctx.nodes++;
+
+        float cost = cost_so_far + advance_block(depth, p, p != prev_phase);
+
+        // Bound: queue-seconds only accumulate
+        if (cost >= ctx.best_cost)
+            continue;
+
+        search(depth + 1, p, cost, first_phase);
+    }
+}
+
+// Every first phase is costed before any is expanded, then each expands in
+// an even share of the nodes left (what one leaves unused passes on), so a
+// junction with many phases can't spend the budget under the first choice.
+static void search_root(int current_phase)
+{
+    uint32_t phase_cnt = ctx.intr->phase_cnt;
+    int first[MAX_PHASE_CNT];
+    float first_cost[MAX_PHASE_CNT];
+    uint32_t first_cnt = 0;
+
+    for (uint32_t n = 0; n < phase_cnt; n++)
+    {
+        int p = (current_phase + n) % phase_cnt;
+        if (ctx.force_switch && p == current_phase)
+            continue;
+        ctx.nodes++;
+        first[first_cnt] = p;
+        first_cost[first_cnt++] = advance_block(0, p, p != current_phase);
+    }
+
+    for (uint32_t k = 0; k < first_cnt; k++)
+    {
+        uint32_t left = ctx.nodes < LOOKAHEAD_MAX_NODES ? LOOKAHEAD_MAX_NODES - ctx.nodes : 0;
+        ctx.node_limit = ctx.nodes + left / (first_cnt - k);
+        if (first_cost[k] >= ctx.best_cost)
+            continue;
+
+        // The costing pass left the last first phase's queues behind
+        advance_block(0, first[k], first[k] != current_phase);
+        search(1, first[k], first_cost[k], first[k]);
+    }
+}
+
+int lookahead_next_phase(const Intersection *intr, const ArrivalEstimator *est, uint32_t current_phase_idx,
+                         uint32_t transition_loss_ms, bool force_switch, uint64_t blocked_conns,
+                         LookaheadStats *stats)
+{
+    unsigned long start = micros();
+
+    ctx.intr = intr;
+    ctx.arrival = est->arrival_rate_vps;
+    ctx.block_s = LOOKAHEAD_BLOCK_MS / 1000.0f;
+    ctx.loss_s = (transition_loss_ms < LOOKAHEAD_BLOCK_MS ? transition_loss_ms : LOOKAHEAD_BLOCK_MS) / 1000.0f;
+    ctx.force_switch = force_switch;
+    ctx.nodes = 0;
+    ctx.best_cost = 3.4e38f;
+    ctx.best_first_phase = -1;
+
+    // 1. Inbound lanes and their current queues
+    ctx.in_lane_cnt = 0;
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        if (intr->lanes[i].type == LANE_IN)
+            ctx.in_lanes[ctx.in_lane_cnt++] = i;
+        ctx.queue[0][i] = intr->lane_traffic[i];
+    }
+
+    // 2. Service rate of every lane under every phase
+    for (uint32_t p = 0; p < intr->phase_cnt; p++)
+    {
+        memset(ctx.service[p], 0, intr->lane_cnt * sizeof(float));
+        uint64_t mask = intr->phases[p].active_connections_mask & ~blocked_conns;
+        for (uint32_t c = 0; c < intr->connection_cnt; c++)
+        {
+            if (mask & (1ULL << c))
+                ctx.service[p][intr->connections[c].source_lane_idx] +=
+                    LOOKAHEAD_SATURATION_VPS * intr->connections[c].weight / CONNECTION_WEIGHT_ONE;
+        }
+    }
+
+    // 3. Branch and bound
+    search_root(current_phase_idx);
+
+    int chosen = ctx.best_first_phase;
+    if (chosen == -1)
+        chosen = force_switch ? (current_phase_idx + 1) % intr->phase_cnt : current_phase_idx;
+
+    if (stats)
+    {
+        stats->nodes = ctx.nodes;
+        stats->compute_us = micros() - start;
+        if (stats->compute_us > stats->max_compute_us)
+            stats->max_compute_us = stats->compute_us;
+        if (stats->nodes > stats->max_nodes)
+            stats->max_nodes = stats->nodes;
+        stats->calls++;
+        stats->total_us += stats->compute_us;
+        stats->predicted_cost = ctx.best_cost;
+    }
+    return chosen;
+}
@@ -0,0 +1,85 @@
+#include "PolicyNet.h"
+#include <string.h>
+
+static int8_t clamp_int8(int32_t v, int32_t lo)
+{
+    if (v < lo)
+        return (int8_t)lo;
+    if (v > 127)
+        return 127;
+    return (int8_t)v;
+}
+
+void policy_reset(PolicyNet *net)
+{
+    memset(net, 0, sizeof(PolicyNet));
+}
+
+bool policy_validate(PolicyNet *net, const Intersection *intr)
+{
+    net->loaded = false;
+    if (!intr || intr->phase_cnt == 0)
+        return false;
+    if (net->input_cnt != intr->lane_cnt + intr->phase_cnt + 1)
+        return false;
+    if (net->output_cnt != intr->phase_cnt)
+        return false;
+    if (net->hidden_cnt == 0 || net->hidden_cnt > POLICY_MAX_HIDDEN)
+        return false;
+    if (net->hidden_shift == 0 || net->hidden_shift > 31 || net->queue_shift > 15)
+        return false;
+
+    net->loaded = true;
+    return true;
+}
+
+void policy_build_input(const PolicyNet *net, const Intersection *intr, uint32_t current_phase_idx,
+                        uint32_t green_elapsed_ms, int8_t *x)
+{
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+        x[n++] = clamp_int8(intr->lane_traffic[i] >> net->queue_shift, 0);
+
+    for (uint32_t p = 0; p < intr->phase_cnt; p++)
+        x[n++] = (p == current_phase_idx) ? 127 : 0;
+
+    x[n] = clamp_int8(green_elapsed_ms / 1000, 0);
+}
+
+int policy_infer(const PolicyNet *net, const int8_t *x, int32_t *logits)
+{
+    int8_t h[POLICY_MAX_HIDDEN];
+    int64_t round = (int64_t)1 << (net->hidden_shift - 1);
+
+    // 1. Hidden layer, ReLU folded into the clamp
+    for (uint32_t j = 0; j < net->hidden_cnt; j++)
+    {
+        const int8_t *w = net->w1[j];
+        int32_t acc = net->b1[j];
+        for (uint32_t i = 0; i < net->input_cnt; i++)
+            acc += (int32_t)w[i] * x[i];
+
+        int64_t scaled = ((int64_t)acc * net->hidden_mult + round) >> net->hidden_shift;
+        h[j] = (int8_t)(scaled < 0 ? 0 : (scaled > 127 ? 127 : scaled));
+    }
+
+    // 2. Output layer + argmax
+    int best = 0;
+    int32_t best_logit = INT32_MIN;
+    for (uint32_t k = 0; k < net->output_cnt; k++)
+    {
+        const int8_t *w = net->w2[k];
+        int32_t acc = net->b2[k];
+        for (uint32_t j = 0; j < net->hidden_cnt; j++)
+            acc += (int32_t)w[j] * h[j];
+
+        if (logits)
+            logits[k] = acc;
+        if (acc > best_logit)
+        {
+            best_logit = acc;
+            best = k;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,155 @@
+#include "QueueEstimator.h"
+#include <math.h>
+#include <string.h>
+#include <Arduino.h>
+
+// --- HELPERS ---
+
+// Kalman correction toward measurement z (both Q8) with variance r
+static void correct(QueueEstimator *est, uint32_t i, int32_t z, int32_t r)
+{
+    int64_t p = est->variance_q8[i];
+    int32_t gain_q8 = (int32_t)((p * QUEUE_Q8) / (p + r));
+    est->queue_q8[i] += (int32_t)(((int64_t)(z - est->queue_q8[i]) * gain_q8) / QUEUE_Q8);
+    est->variance_q8[i] = (int32_t)((p * (QUEUE_Q8 - gain_q8)) / QUEUE_Q8);
+}
+
+static int32_t clamp_queue(int32_t q)
+{
+    if (q < 0)
+        return 0;
+    return q > QUEUE_MAX ? QUEUE_MAX : q;
+}
+
+// --- PUBLIC API ---
+
+void queue_estimator_reset(QueueEstimator *est)
+{
+    memset(est, 0, sizeof(*est));
+}
+
+void queue_estimator_attach(QueueEstimator *est, uint32_t lane_idx, uint8_t sources)
+{
+    if (lane_idx < MAX_LANE_CNT)
+        est->sources[lane_idx] = sources;
+}
+
+void queue_estimator_set_rate(QueueEstimator *est, uint32_t lane_idx, uint32_t rate_q8)
+{
+    if (lane_idx < MAX_LANE_CNT)
+        est->rate_q8[lane_idx] = rate_q8;
+}
+
+void queue_estimator_count(QueueEstimator *est, uint32_t lane_idx, uint16_t arrivals, uint16_t departures)
+{
+    if (lane_idx >= MAX_LANE_CNT)
+        return;
+    est->arrivals[lane_idx] += arrivals;
+    est->departures[lane_idx] += departures;
+}
+
+void queue_estimator_occupancy(QueueEstimator *est, uint32_t lane_idx, bool occupied)
+{
+    if (lane_idx >= MAX_LANE_CNT)
+        return;
+    est->occupancy_lanes |= (1ULL << lane_idx);
+    if (occupied)
+        est->occupied_lanes |= (1ULL << lane_idx);
+}
+
+void queue_estimator_reading(QueueEstimator *est, uint32_t lane_idx, uint16_t queue)
+{
+    if (lane_idx >= MAX_LANE_CNT)
+        return;
+    est->reading[lane_idx] = queue;
+    est->read_lanes |= (1ULL << lane_idx);
+}
+
+void queue_estimator_step(QueueEstimator *est, const Intersection *intr, uint64_t serving_lanes, uint32_t elapsed_ms)
+{
+    uint32_t start = micros();
+
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        if (intr->lanes[i].type != LANE_IN)
+            continue;
+
+        uint8_t sources = est->sources[i];
+        bool serving = (serving_lanes >> i) & 1;
+        int32_t q = est->queue_q8[i];
+        int32_t p = est->variance_q8[i];
+
+        // --- Predict ---
+        int32_t arrivals, departures;
+        if (sources & QUEUE_SOURCE_ARRIVALS)
+        {
+            arrivals = est->arrivals[i] * QUEUE_Q8;
+            p += est->arrivals[i] * QUEUE_Q8 * QUEUE_COUNT_MISS_PERMILLE / 1000;
+        }
+        else
+        {
+            arrivals = (int32_t)((est->rate_q8[i] * elapsed_ms) / 1000);
+            p += arrivals; // Poisson: variance = mean
+        }
+
+        if (sources & QUEUE_SOURCE_DEPARTURES)
+        {
+            departures = est->departures[i] * QUEUE_Q8;
+            p += est->departures[i] * QUEUE_Q8 * QUEUE_COUNT_MISS_PERMILLE / 1000;
+        }
+        else if (serving)
+        {
+            departures = (int32_t)(QUEUE_SATURATION_Q8 * elapsed_ms / 1000);
+            if (departures > q + arrivals)
+                departures = q + arrivals;
+            p += departures / 2;
+        }
+        else
+        {
+            departures = 0;
+        }
+
+        est->queue_q8[i] = clamp_queue(q + arrivals - departures);
+        est->variance_q8[i] = p > QUEUE_MAX_VARIANCE ? QUEUE_MAX_VARIANCE : p;
+
+        // --- Correct ---
+        if ((sources & QUEUE_SOURCE_READING) && ((est->read_lanes >> i) & 1))
+            correct(est, i, est->reading[i] * QUEUE_Q8, QUEUE_READING_VARIANCE);
+
+        // A stop-line detector only tells something while the queue stands still on it
+        if ((sources & QUEUE_SOURCE_OCCUPANCY) && !serving && ((est->occupancy_lanes >> i) & 1))
+        {
+            if ((est->occupied_lanes >> i) & 1)
+            {
+                if (est->queue_q8[i] < QUEUE_Q8)
+                    correct(est, i, QUEUE_Q8, QUEUE_OCCUPANCY_VARIANCE);
+            }
+            else
+            {
+                correct(est, i, 0, QUEUE_OCCUPANCY_VARIANCE);
+            }
+        }
+        est->queue_q8[i] = clamp_queue(est->queue_q8[i]);
+
+        est->arrivals[i] = 0;
+        est->departures[i] = 0;
+    }
+
+    est->read_lanes = 0;
+    est->occupied_lanes = 0;
+    est->occupancy_lanes = 0;
+    est->steps++;
+    est->last_step_us = micros() - start;
+    if (est->last_step_us > est->max_step_us)
+        est->max_step_us = est->last_step_us;
+}
+
+uint16_t queue_estimate(const QueueEstimator *est, uint32_t lane_idx)
+{
+    return (uint16_t)((est->queue_q8[lane_idx] + QUEUE_Q8 / 2) / QUEUE_Q8);
+}
+
+float queue_estimate_stddev(const QueueEstimator *est, uint32_t lane_idx)
+{
+    return sqrtf(est->variance_q8[lane_idx] / (float)QUEUE_Q8);
+}
@@ -0,0 +1,571 @@
+#include "RingBarrier.h"
+#include <string.h>
+#include <Arduino.h>
+
+// --- STATE ---
+static RingMovement movements[RING_MAX_MOVEMENTS]; // Index order is service order within a ring
+static uint64_t movement_conflicts[RING_MAX_MOVEMENTS];
+static uint32_t movement_cnt = 0;
+static uint8_t ring_cnt = 0;
+static uint8_t barrier_cnt = 0;
+static uint64_t used_lanes = 0;
+static bool loaded = false;
+
+// Composite phase N runs composite_movement[N][ring] on every ring
+static uint8_t composite_movement[MAX_PHASE_CNT][RING_MAX_RINGS];
+static uint8_t composite_barrier[MAX_PHASE_CNT];
+static uint32_t composite_cnt = 0;
+
+static uint8_t ring_movement[RING_MAX_RINGS]; // What each ring is timing
+static unsigned long ring_start[RING_MAX_RINGS];
+
+// Inputs of the ring_barrier_next_phase() call running
+static uint64_t demand_blocked_conns = 0;
+static uint64_t demand_called_lanes = 0;
+
+// --- HELPERS ---
+
+static uint64_t lane_connections(const Intersection *intr, uint64_t lanes)
+{
+    uint64_t conns = 0;
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+    {
+        if ((lanes >> intr->connections[c].source_lane_idx) & 1)
+            conns |= (1ULL << c);
+    }
+    return conns;
+}
+
+static uint64_t connection_conflicts(const Intersection *intr, uint64_t conns)
+{
+    uint64_t conflicts = 0;
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+    {
+        if ((conns >> c) & 1)
+            conflicts |= intr->conflict_masks[c];
+    }
+    return conflicts;
+}
+
+static bool movements_compatible(uint32_t a, uint32_t b)
+{
+    return (movement_conflicts[a] & movements[b].connections) == 0 &&
+           (movement_conflicts[b] & movements[a].connections) == 0;
+}
+
+// Queued vehicles over the movement's connections; a detector call counts as one.
+// Connections into a spilled-back exit have none.
+static int32_t movement_demand(const Intersection *intr, uint32_t m)
+{
+    int32_t demand = 0;
+    uint64_t open = movements[m].connections & ~demand_blocked_conns;
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+    {
+        if (!((open >> c) & 1))
+            continue;
+        uint32_t src = intr->connections[c].source_lane_idx;
+        if (intr->lane_traffic[src] == 0 && ((demand_called_lanes >> src) & 1))
+            demand += 1;
+        demand += intr->lane_traffic[src];
+    }
+    return demand;
+}
+
+// Next movement after m on its ring with demand, within the same barrier
+// group; wrapping back to the ring's earlier movements only when allowed.
+static uint8_t ring_successor(const Intersection *intr, uint32_t m, bool wrap)
+{
+    uint8_t ring = movements[m].ring;
+    uint8_t barrier = movements[m].barrier;
+    for (uint32_t step = 1; step < movement_cnt; step++)
+    {
+        uint32_t s = m + step;
+        if (s >= movement_cnt)
+        {
+            if (!wrap)
+                break;
+            s -= movement_cnt;
+        }
+        if (movements[s].ring == ring && movements[s].barrier == barrier && movement_demand(intr, s) > 0)
+            return (uint8_t)s;
+    }
+    return RING_NONE;
+}
+
+// First movement of a ring in a barrier group, and the one after m (no demand check, no wrap)
+static uint8_t ring_first(uint8_t ring, uint8_t barrier)
+{
+    for (uint32_t m = 0; m < movement_cnt; m++)
+    {
+        if (movements[m].ring == ring && movements[m].barrier == barrier)
+            return (uint8_t)m;
+    }
+    return RING_NONE;
+}
+
+static uint8_t ring_following(uint32_t m)
+{
+    for (uint32_t s = m + 1; s < movement_cnt; s++)
+    {
+        if (movements[s].ring == movements[m].ring && movements[s].barrier == movements[m].barrier)
+            return (uint8_t)s;
+    }
+    return RING_NONE;
+}
+
+// Where a ring starts in a barrier group: its first movement with demand, else its first movement
+static uint8_t ring_entry(const Intersection *intr, uint8_t ring, uint8_t barrier)
+{
+    uint8_t first = RING_NONE;
+    for (uint32_t m = 0; m < movement_cnt; m++)
+    {
+        if (movements[m].ring != ring || movements[m].barrier != barrier)
+            continue;
+        if (movement_demand(intr, m) > 0)
+            return (uint8_t)m;
+        if (first == RING_NONE)
+            first = (uint8_t)m;
+    }
+    return first;
+}
+
+static bool barrier_has_demand(const Intersection *intr, uint8_t barrier)
+{
+    for (uint32_t m = 0; m < movement_cnt; m++)
+    {
+        if (movements[m].barrier == barrier && movement_demand(intr, m) > 0)
+            return true;
+    }
+    return false;
+}
+
+// Movements compatible with every member of set (all of them for an empty set)
+static uint32_t compatible_with_all(const uint32_t *compat, uint32_t set, uint32_t all)
+{
+    uint32_t result = all;
+    for (uint32_t m = 0; m < RING_MAX_MOVEMENTS; m++)
+    {
+        if ((set >> m) & 1)
+            result &= compat[m];
+    }
+    return result;
+}
+
+// Grows one barrier group from a concurrent pair of seeds. A movement joins
+// ring 1 if it fits beside everything on ring 0 and ring 0 if it fits beside
+// everything on ring 1; each step takes the candidate that leaves the most
+// others placeable.
+static void grow_barrier_group(const uint32_t *compat, uint32_t left, uint32_t seed0, uint32_t seed1, uint32_t *ring0,
+                               uint32_t *ring1)
+{
+    uint32_t r0 = 1u << seed0;
+    uint32_t r1 = seed1 == RING_NONE ? 0 : 1u << seed1;
+
+    while (true)
+    {
+        uint32_t pool = left & ~(r0 | r1);
+        uint32_t into1 = pool & compatible_with_all(compat, r0, left);
+        uint32_t into0 = r1 ? pool & compatible_with_all(compat, r1, left) : 0;
+
+        int best = -1;
+        bool best_ring1 = false;
+        int best_placeable = -1;
+        for (uint32_t m = 0; m < RING_MAX_MOVEMENTS; m++)
+        {
+            for (int ring = 1; ring >= 0; ring--)
+            {
+                if (!(((ring ? into1 : into0) >> m) & 1))
+                    continue;
+                uint32_t n0 = ring ? r0 : r0 | (1u << m);
+                uint32_t n1 = ring ? r1 | (1u << m) : r1;
+                uint32_t rest = pool & ~(1u << m);
+                uint32_t placeable = rest & (compatible_with_all(compat, n0, left) | compatible_with_all(compat, n1, left));
+                int count = __builtin_popcount(placeable);
+                if (count > best_placeable)
+                {
+                    best_placeable = count;
+                    best = m;
+                    best_ring1 = ring;
+                }
+            }
+        }
+        if (best == -1)
+            break;
+        if (best_ring1)
+            r1 |= (1u << best);
+        else
+            r0 |= (1u << best);
+    }
+
+    *ring0 = r0;
+    *ring1 = r1;
+}
+
+// --- PUBLIC API ---
+
+void ring_barrier_reset()
+{
+    movement_cnt = 0;
+    ring_cnt = 0;
+    barrier_cnt = 0;
+    used_lanes = 0;
+    composite_cnt = 0;
+    loaded = false;
+}
+
+int ring_barrier_add_movement(const Intersection *intr, const uint32_t *lane_idx, uint32_t lane_cnt, uint8_t ring,
+                              uint8_t barrier, uint32_t max_green_ms)
+{
+    if (movement_cnt >= RING_MAX_MOVEMENTS || ring >= RING_MAX_RINGS || barrier >= RING_MAX_BARRIERS || lane_cnt == 0)
+        return -1;
+
+    uint64_t lanes = 0;
+    for (uint32_t i = 0; i < lane_cnt; i++)
+    {
+        if (lane_idx[i] >= intr->lane_cnt || intr->lanes[lane_idx[i]].type != LANE_IN || ((used_lanes >> lane_idx[i]) & 1))
+            return -1;
+        lanes |= (1ULL << lane_idx[i]);
+    }
+
+    // Lanes timed as one movement run together, so none of them may conflict with another
+    uint64_t conns = lane_connections(intr, lanes);
+    if (conns == 0 || (connection_conflicts(intr, conns) & conns))
+        return -1;
+
+    RingMovement *mv = &movements[movement_cnt];
+    mv->lanes = lanes;
+    mv->connections = conns;
+    mv->max_green_ms = max_green_ms;
+    mv->ring = ring;
+    mv->barrier = barrier;
+    movement_conflicts[movement_cnt] = connection_conflicts(intr, conns);
+    used_lanes |= lanes;
+
+    if (ring + 1 > ring_cnt)
+        ring_cnt = ring + 1;
+    if (barrier + 1 > barrier_cnt)
+        barrier_cnt = barrier + 1;
+    return movement_cnt++;
+}
+
+bool ring_barrier_build_auto(const Intersection *intr)
+{
+    ring_barrier_reset();
+
+    // One candidate movement per inbound lane; parallel lanes (same bearing, same conflicts) share one
+    uint64_t lanes[RING_MAX_MOVEMENTS];
+    uint64_t conflicts[RING_MAX_MOVEMENTS];
+    uint16_t bearing[RING_MAX_MOVEMENTS];
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        if (intr->lanes[i].type != LANE_IN)
+            continue;
+        uint64_t conns = lane_connections(intr, 1ULL << i);
+        if (conns == 0)
+            continue;
+        uint64_t conf = connection_conflicts(intr, conns);
+
+        uint32_t k = 0;
+        while (k < n && !(bearing[k] == intr->lanes[i].bearing && conflicts[k] == conf))
+            k++;
+        if (k == n)
+        {
+            if (n == RING_MAX_MOVEMENTS)
+                return false;
+            lanes[n] = 0;
+            conflicts[n] = conf;
+            bearing[n] = intr->lanes[i].bearing;
+            n++;
+        }
+        lanes[k] |= (1ULL << i);
+    }
+    if (n == 0)
+        return false;
+
+    uint32_t compat[RING_MAX_MOVEMENTS] = {0};
+    for (uint32_t a = 0; a < n; a++)
+    {
+        uint64_t conns_a = lane_connections(intr, lanes[a]);
+        for (uint32_t b = 0; b < n; b++)
+        {
+            if (a != b && (conflicts[b] & conns_a) == 0 && (conflicts[a] & lane_connections(intr, lanes[b])) == 0)
+                compat[a] |= (1u << b);
+        }
+    }
+
+    // Barrier groups one at a time, each the best any pair of seeds can grow
+    uint32_t left = (1u << n) - 1;
+    uint8_t barrier = 0;
+    while (left)
+    {
+        if (barrier == RING_MAX_BARRIERS)
+        {
+            ring_barrier_reset();
+            return false;
+        }
+
+        // Most concurrent pairs first, then most movements
+        uint32_t best0 = 0, best1 = 0;
+        int best_pairs = -1, best_size = -1;
+        for (uint32_t a = 0; a < n; a++)
+        {
+            for (uint32_t b = a; b < n; b++)
+            {
+                bool alone = a == b;
+                if (!((left >> a) & 1) || !((left >> b) & 1) || (!alone && !((compat[a] >> b) & 1)))
+                    continue;
+                uint32_t r0, r1;
+                grow_barrier_group(compat, left, a, alone ? RING_NONE : b, &r0, &r1);
+                int pairs = __builtin_popcount(r0) * __builtin_popcount(r1);
+                int size = __builtin_popcount(r0 | r1);
+                if (pairs > best_pairs || (pairs == best_pairs && size > best_size))
+                {
+                    best_pairs = pairs;
+                    best_size = size;
+                    best0 = r0;
+                    best1 = r1;
+                }
+            }
+        }
+
+        for (uint8_t ring = 0; ring < 2; ring++)
+        {
+            uint32_t members = ring ? best1 : best0;
+            for (uint32_t m = 0; m < n; m++)
+            {
+                if (!((members >> m) & 1))
+                    continue;
+                uint32_t idx[MAX_LANE_CNT];
+                uint32_t cnt = 0;
+                for (uint32_t i = 0; i < intr->lane_cnt; i++)
+                {
+                    if ((lanes[m] >> i) & 1)
+                        idx[cnt++] = i;
+                }
+                ring_barrier_add_movement(intr, idx, cnt, ring, barrier, 0);
+            }
+        }
+        left &= ~(best0 | best1);
+        barrier++;
+    }
+    return true;
+}
+
+bool ring_barrier_load_phases(Intersection *intr)
+{
+    loaded = false;
+    composite_cnt = 0;
+    if (movement_cnt == 0 || intr->phase_cnt != 0)
+        return false;
+
+    // Concurrency across rings is what makes each ring free to move on its own
+    for (uint32_t a = 0; a < movement_cnt; a++)
+    {
+        for (uint32_t b = a + 1; b < movement_cnt; b++)
+        {
+            if (movements[a].barrier == movements[b].barrier && movements[a].ring != movements[b].ring &&
+                !movements_compatible(a, b))
+            {
+                Serial.printf("[RING] Movements %lu and %lu conflict across rings in barrier group %d.\n",
+                              (unsigned long)a, (unsigned long)b, movements[a].barrier);
+                return false;
+            }
+        }
+    }
+
+    // Count first, so a layout that does not fit loads nothing
+    uint32_t total = 0;
+    for (uint8_t b = 0; b < barrier_cnt; b++)
+    {
+        uint32_t combos = 1;
+        for (uint8_t r = 0; r < ring_cnt; r++)
+        {
+            uint32_t n = 0;
+            for (uint32_t m = 0; m < movement_cnt; m++)
+                n += movements[m].ring == r && movements[m].barrier == b;
+            if (n > 0)
+                combos *= n;
+        }
+        total += combos;
+    }
+    if (total > MAX_PHASE_CNT || total > intr->phase_cap)
+    {
+        Serial.printf("[RING] %lu ring combinations, only %d phase slots.\n", (unsigned long)total, intr->phase_cap);
+        return false;
+    }
+
+    for (uint8_t b = 0; b < barrier_cnt; b++)
+    {
+        // Odometer over the rings' movements in this group
+        uint8_t choice[RING_MAX_RINGS];
+        for (uint8_t r = 0; r < ring_cnt; r++)
+            choice[r] = ring_first(r, b);
+        bool any = false;
+        for (uint8_t r = 0; r < ring_cnt; r++)
+            any |= choice[r] != RING_NONE;
+        if (!any)
+        {
+            Serial.printf("[RING] Barrier group %d has no movements.\n", b);
+            intr->phase_cnt = 0;
+            return false;
+        }
+
+        while (true)
+        {
+            uint64_t mask = 0;
+            for (uint8_t r = 0; r < ring_cnt; r++)
+            {
+                composite_movement[composite_cnt][r] = choice[r];
+                if (choice[r] != RING_NONE)
+                    mask |= movements[choice[r]].connections;
+            }
+            for (uint8_t r = ring_cnt; r < RING_MAX_RINGS; r++)
+                composite_movement[composite_cnt][r] = RING_NONE;
+            composite_barrier[composite_cnt] = b;
+            if (!is_phase_safe(intr, mask))
+            {
+                Serial.printf("[RING] Composite phase %lu runs conflicting movements.\n", (unsigned long)composite_cnt);
+                intr->phase_cnt = 0;
+                return false;
+            }
+            add_phase(intr, mask, 0);
+            composite_cnt++;
+
+            uint8_t r = 0;
+            while (r < ring_cnt)
+            {
+                uint8_t next = choice[r] == RING_NONE ? RING_NONE : ring_following(choice[r]);
+                if (next != RING_NONE)
+                {
+                    choice[r] = next;
+                    break;
+                }
+                choice[r] = ring_first(r, b);
+                r++;
+            }
+            if (r == ring_cnt)
+                break;
+        }
+    }
+
+    for (uint8_t r = 0; r < RING_MAX_RINGS; r++)
+        ring_movement[r] = RING_NONE;
+    loaded = true;
+
+    Serial.printf("[RING] %lu movements on %d rings, %d barrier groups, %lu composite phases\n",
+                  (unsigned long)movement_cnt, ring_cnt, barrier_cnt, (unsigned long)composite_cnt);
+    return true;
+}
+
+bool ring_barrier_active()
+{
+    return loaded;
+}
+
+void ring_barrier_phase_started(uint32_t phase_idx, unsigned long now)
+{
+    if (!loaded || phase_idx >= composite_cnt)
+        return;
+    for (uint8_t r = 0; r < ring_cnt; r++)
+    {
+        uint8_t m = composite_movement[phase_idx][r];
+        if (m != ring_movement[r])
+        {
+            ring_movement[r] = m;
+            ring_start[r] = now;
+        }
+    }
+}
+
+uint8_t ring_barrier_elapsed(unsigned long now, uint32_t *elapsed_ms)
+{
+    memset(elapsed_ms, 0, RING_MAX_RINGS * sizeof(uint32_t));
+    if (!loaded)
+        return 0;
+    for (uint8_t r = 0; r < ring_cnt; r++)
+        elapsed_ms[r] = now - ring_start[r];
+    return ring_cnt;
+}
+
+uint32_t ring_barrier_next_phase(const Intersection *intr, uint32_t current_phase, const uint32_t *ring_elapsed_ms,
+                                 uint64_t blocked_conns, uint64_t called_lanes, uint32_t min_green_ms,
+                                 uint32_t max_green_ms)
+{
+    if (!loaded || current_phase >= composite_cnt)
+        return current_phase;
+
+    demand_blocked_conns = blocked_conns;
+    demand_called_lanes = called_lanes;
+
+    uint8_t barrier = composite_barrier[current_phase];
+    bool demand_elsewhere = false;
+    for (uint8_t b = 0; b < barrier_cnt; b++)
+    {
+        if (b != barrier && barrier_has_demand(intr, b))
+            demand_elsewhere = true;
+    }
+
+    uint8_t next[RING_MAX_RINGS];
+    memcpy(next, composite_movement[current_phase], sizeof(next));
+    bool changed = false;
+    bool at_barrier = true; // Every ring is done with this group
+
+    for (uint8_t r = 0; r < ring_cnt; r++)
+    {
+        uint8_t m = next[r];
+        if (m == RING_NONE)
+            continue;
+
+        uint32_t elapsed = ring_elapsed_ms[r];
+        uint32_t max_green = movements[m].max_green_ms ? movements[m].max_green_ms : max_green_ms;
+        if (elapsed < min_green_ms || (movement_demand(intr, m) > 0 && elapsed < max_green))
+        {
+            at_barrier = false;
+            continue;
+        }
+
+        // Nothing waits on the far side: the ring may cycle within its group
+        uint8_t successor = ring_successor(intr, m, !demand_elsewhere);
+        if (successor != RING_NONE)
+        {
+            next[r] = successor;
+            changed = true;
+            at_barrier = false;
+        }
+        // Otherwise the ring rests on m at the barrier until the other rings get there
+    }
+
+    if (!changed && at_barrier && demand_elsewhere)
+    {
+        uint8_t target = barrier;
+        do
+        {
+            target = (target + 1) % barrier_cnt;
+        } while (!barrier_has_demand(intr, target));
+
+        for (uint8_t r = 0; r < ring_cnt; r++)
+            next[r] = ring_entry(intr, r, target);
+        changed = true;
+    }
+
+    if (!changed)
+        return current_phase;
+
+    for (uint32_t p = 0; p < composite_cnt; p++)
+    {
+        if (memcmp(composite_movement[p], next, ring_cnt) == 0)
+            return p;
+    }
+    return current_phase;
+}
+
+uint32_t ring_barrier_movement_cnt()
+{
+    return movement_cnt;
+}
+
+const RingMovement *ring_barrier_movement(uint32_t movement_idx)
+{
+    return &movements[movement_idx];
+}
@@ -0,0 +1,162 @@
+#include "SafetyMonitor.h"
+#include <string.h>
+#include <Arduino.h>
+
+// --- STATE ---
+static SafetyTables monitor_tables;
+static volatile uint32_t last_heartbeat_ms = 0;
+static volatile SafetyFault latched_fault = SAFETY_OK;
+static volatile uint32_t wcet_cycles = 0;
+static TaskHandle_t monitor_task_handle = NULL;
+
+static void mark_channel(LightFrame *frame, int16_t channel)
+{
+    if (channel < 0 || channel >= LIGHT_OUTPUT_MAX_CHANNELS)
+        return;
+    frame->bits[channel >> 3] |= (uint8_t)(1 << (channel & 7));
+}
+
+void safety_build_tables(SafetyTables *tables, const Intersection *intr)
+{
+    memset(tables, 0, sizeof(SafetyTables));
+    if (!intr)
+        return;
+
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        const Lane *lane = &intr->lanes[i];
+        if (lane->type == LANE_OUT) // WALK signals are monitored like vehicle greens
+            continue;
+
+        int16_t green = lane->hw.green_pin;
+        if (green >= 0 && green < LIGHT_OUTPUT_MAX_CHANNELS)
+        {
+            tables->lane_green_byte[i] = green >> 3;
+            tables->lane_green_bit[i] = (uint8_t)(1 << (green & 7));
+        }
+        mark_channel(&tables->green_yellow_channels, lane->hw.green_pin);
+        mark_channel(&tables->green_yellow_channels, lane->hw.yellow_pin);
+        mark_channel(&tables->red_channels, lane->hw.red_pin);
+    }
+
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+    {
+        tables->lane_connections[intr->connections[c].source_lane_idx] |= ((uint64_t)1 << c);
+    }
+
+    memcpy(tables->conflict_masks, intr->conflict_masks, intr->connection_cnt * sizeof(uint64_t));
+}
+
+uint64_t safety_check_outputs(const SafetyTables *tables, const LightFrame *output_levels)
+{
+    // 1. Effective green connections: a lane showing green releases all of its movements
+    uint64_t green_connections = 0;
+    for (uint32_t i = 0; i < MAX_LANE_CNT; i++)
+    {
+        uint64_t lane_green = (uint64_t)((output_levels->bits[tables->lane_green_byte[i]] & tables->lane_green_bit[i]) != 0);
+        green_connections |= tables->lane_connections[i] & (0 - lane_green);
+    }
+
+    // 2. Any green connection with a green enemy is a violation. No early exit.
+    uint64_t violations = 0;
+    for (uint32_t c = 0; c < MAX_CONNECTION_CNT; c++)
+    {
+        uint64_t is_green = (green_connections >> c) & 1;
+        violations |= (0 - is_green) & green_connections & tables->conflict_masks[c];
+    }
+    return violations;
+}
+
+static void force_all_red(const LightFrame *levels)
+{
+    // Greens and yellows off, reds on, everything else untouched; one backend commit.
+    // Without a sample (bus held) only the reds stay on.
+    LightFrame fallback;
+    for (int i = 0; i < LIGHT_OUTPUT_FRAME_BYTES; i++)
+    {
+        uint8_t kept = levels ? levels->bits[i] & ~monitor_tables.green_yellow_channels.bits[i] : 0;
+        fallback.bits[i] = kept | monitor_tables.red_channels.bits[i];
+    }
+
+    // Never waits for the bus: if the controller holds it, the backend blanks
+    // the lamps out of band and the frame follows on a later sample
+    light_output_force(&fallback);
+}
+
+static void safety_monitor_task(void *arg)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+
+    for (;;)
+    {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(SAFETY_MONITOR_PERIOD_MS));
+
+        uint32_t start = ESP.getCycleCount();
+
+        // Read the heartbeat before the clock so a concurrent update can't look like time going backwards
+        uint32_t heartbeat = last_heartbeat_ms;
+        uint32_t now = millis();
+
+        // A busy bus skips one sample; a controller stuck on it trips the heartbeat,
+        // and the fallback below does not need the bus
+        LightFrame levels;
+        bool sampled = light_output_read(&levels);
+        uint64_t violations = sampled ? safety_check_outputs(&monitor_tables, &levels) : 0;
+
+        if (latched_fault == SAFETY_OK)
+        {
+            if (violations)
+                latched_fault = SAFETY_FAULT_CONFLICTING_GREEN;
+            else if (now - heartbeat > SAFETY_HEARTBEAT_TIMEOUT_MS)
+                latched_fault = SAFETY_FAULT_STALE_HEARTBEAT;
+        }
+
+        // Re-asserted every sample while latched, in case anything else touches the outputs
+        if (latched_fault != SAFETY_OK)
+            force_all_red(sampled ? &levels : NULL);
+
+        uint32_t elapsed = ESP.getCycleCount() - start;
+        if (elapsed > wcet_cycles)
+            wcet_cycles = elapsed;
+    }
+}
+
+// --- PUBLIC API ---
+
+void safety_monitor_setup(const Intersection *intr)
+{
+    safety_build_tables(&monitor_tables, intr);
+    last_heartbeat_ms = millis();
+    latched_fault = SAFETY_OK;
+    wcet_cycles = 0;
+
+    if (monitor_task_handle != NULL)
+        return;
+
+    // Highest priority, on the core the Arduino loop does not use
+    xTaskCreatePinnedToCore(safety_monitor_task, "safety_mon", 4096, NULL,
+                            configMAX_PRIORITIES - 1, &monitor_task_handle, SAFETY_MONITOR_CORE);
+
+    Serial.printf("[SAFETY] Monitor running at %d Hz, heartbeat timeout %d ms\n",
+                  1000 / SAFETY_MONITOR_PERIOD_MS, SAFETY_HEARTBEAT_TIMEOUT_MS);
+}
+
+void safety_monitor_heartbeat()
+{
+    last_heartbeat_ms = millis();
+}
+
+bool safety_monitor_tripped()
+{
+    return latched_fault != SAFETY_OK;
+}
+
+SafetyFault safety_monitor_fault()
+{
+    return latched_fault;
+}
+
+uint32_t safety_monitor_wcet_us()
+{
+    return wcet_cycles / ESP.getCpuFreqMHz();
+}
@@ -0,0 +1,296 @@
+#include "SensorBus.h"
+#include <string.h>
+#include <Arduino.h>
+
+// --- HELPERS ---
+
+static uint32_t data_payload_len(uint32_t channel_cnt)
+{
+    return 1 + 2 * channel_cnt;
+}
+
+static uint32_t reply_payload_len(uint8_t type, uint32_t channel_cnt)
+{
+    return data_payload_len(channel_cnt) + (type == SENSOR_BUS_PREEMPT ? 2 : 0);
+}
+
+static void node_missed(SensorBusNode *node)
+{
+    node->missed++;
+    if (node->misses_in_row < 0xFF)
+        node->misses_in_row++;
+    if (!node->offline && node->misses_in_row >= SENSOR_BUS_OFFLINE_MISSES)
+    {
+        node->offline = true;
+        Serial.printf("[BUS] Node %u offline after %u missed polls\n", node->address, node->misses_in_row);
+    }
+}
+
+// Next node to poll after index from (-1 = cycle start), or -1 when the cycle is done.
+// Offline nodes only get a poll on every SENSOR_BUS_RETRY_CYCLES-th cycle.
+static int32_t next_node(const SensorBus *bus, int32_t from)
+{
+    bool retry = (bus->cycles % SENSOR_BUS_RETRY_CYCLES) == 0;
+    for (int32_t i = from + 1; i < (int32_t)bus->node_cnt; i++)
+    {
+        if (!bus->nodes[i].offline || retry)
+            return i;
+    }
+    return -1;
+}
+
+static void finish_cycle(SensorBus *bus, unsigned long now_us)
+{
+    uint32_t took = now_us - bus->cycle_start_us;
+    if (took > bus->max_cycle_us)
+        bus->max_cycle_us = took;
+    bus->frame_lanes = bus->cycle_lanes;
+    bus->frame_ready = true;
+    bus->current = -1;
+    bus->cycles++;
+}
+
+static void accept_data(SensorBus *bus, const SensorBusFrame *frame, unsigned long now_us)
+{
+    SensorBusNode *node = &bus->nodes[bus->current];
+    uint32_t n = frame->len ? frame->payload[0] : 0;
+    if (n > node->channel_cnt || frame->len != reply_payload_len(frame->type, n))
+    {
+        bus->stray_frames++;
+        return;
+    }
+
+    if (frame->type == SENSOR_BUS_PREEMPT)
+    {
+        uint16_t calls = frame->payload[1 + 2 * n] | (frame->payload[2 + 2 * n] << 8);
+        for (uint32_t k = 0; k < node->channel_cnt; k++)
+        {
+            if (((calls >> k) & 1) && node->lane_idx[k] != SENSOR_BUS_NO_LANE)
+                bus->preempt_lanes |= (1ULL << node->lane_idx[k]);
+        }
+        bus->preempt_calls++;
+    }
+
+    for (uint32_t k = 0; k < n; k++)
+    {
+        uint8_t lane = node->lane_idx[k];
+        if (lane == SENSOR_BUS_NO_LANE)
+            continue;
+        bus->values[lane] = frame->payload[1 + 2 * k] | (frame->payload[2 + 2 * k] << 8);
+        bus->cycle_lanes |= (1ULL << lane);
+    }
+
+    uint32_t took = now_us - bus->slot_start_us;
+    if (took > node->max_reply_us)
+        node->max_reply_us = took;
+    node->replies++;
+    node->misses_in_row = 0;
+    if (node->offline)
+    {
+        node->offline = false;
+        Serial.printf("[BUS] Node %u back online\n", node->address);
+    }
+    bus->replied = true;
+}
+
+// --- PUBLIC API ---
+
+uint16_t sensor_bus_crc16(const uint8_t *data, uint32_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+uint32_t sensor_bus_encode(uint8_t *out, uint8_t address, uint8_t type, uint8_t seq, const uint8_t *payload,
+                           uint8_t len)
+{
+    if (len > SENSOR_BUS_MAX_PAYLOAD)
+        return 0;
+    out[0] = SENSOR_BUS_SYNC0;
+    out[1] = SENSOR_BUS_SYNC1;
+    out[2] = address;
+    out[3] = type;
+    out[4] = seq;
+    out[5] = len;
+    if (len)
+        memcpy(&out[SENSOR_BUS_HEADER_BYTES], payload, len);
+    uint32_t end = SENSOR_BUS_HEADER_BYTES + len;
+    uint16_t crc = sensor_bus_crc16(&out[2], end - 2);
+    out[end] = crc & 0xFF;
+    out[end + 1] = crc >> 8;
+    return end + SENSOR_BUS_CRC_BYTES;
+}
+
+bool sensor_bus_parse(SensorBusParser *parser, uint8_t byte, SensorBusFrame *out)
+{
+    uint8_t pos = parser->pos;
+    if ((pos == 0 && byte != SENSOR_BUS_SYNC0) || (pos == 1 && byte != SENSOR_BUS_SYNC1) ||
+        (pos == 5 && byte > SENSOR_BUS_MAX_PAYLOAD))
+    {
+        // Drop the partial frame; the offending byte may start the next one
+        parser->skipped_bytes += pos;
+        parser->pos = 0;
+        if (byte == SENSOR_BUS_SYNC0)
+            parser->buf[parser->pos++] = byte;
+        else
+            parser->skipped_bytes++;
+        return false;
+    }
+
+    parser->buf[pos++] = byte;
+    parser->pos = pos;
+    if (pos < SENSOR_BUS_HEADER_BYTES || pos < SENSOR_BUS_HEADER_BYTES + parser->buf[5] + SENSOR_BUS_CRC_BYTES)
+        return false;
+
+    parser->pos = 0;
+    uint32_t end = SENSOR_BUS_HEADER_BYTES + parser->buf[5];
+    uint16_t crc = parser->buf[end] | (parser->buf[end + 1] << 8);
+    if (crc != sensor_bus_crc16(&parser->buf[2], end - 2))
+    {
+        parser->crc_errors++;
+        return false;
+    }
+
+    out->address = parser->buf[2];
+    out->type = parser->buf[3];
+    out->seq = parser->buf[4];
+    out->len = parser->buf[5];
+    memcpy(out->payload, &parser->buf[SENSOR_BUS_HEADER_BYTES], out->len);
+    return true;
+}
+
+uint32_t sensor_bus_frame_us(uint32_t baud, uint32_t payload_len)
+{
+    // 8N1: ten bit times per byte
+    uint32_t bytes = SENSOR_BUS_HEADER_BYTES + payload_len + SENSOR_BUS_CRC_BYTES;
+    return (uint32_t)((uint64_t)bytes * 10 * 1000000 / baud);
+}
+
+void sensor_bus_init(SensorBus *bus, uint32_t baud)
+{
+    memset(bus, 0, sizeof(*bus));
+    bus->baud = baud ? baud : SENSOR_BUS_BAUD;
+    bus->current = -1;
+}
+
+int sensor_bus_add_node(SensorBus *bus, uint8_t address, const uint8_t *lane_idx, uint32_t channel_cnt)
+{
+    if (bus->node_cnt >= SENSOR_BUS_MAX_NODES || address == 0 || address > 247)
+        return -1;
+    for (uint32_t i = 0; i < bus->node_cnt; i++)
+    {
+        if (bus->nodes[i].address == address)
+            return -1;
+    }
+    if (channel_cnt > SENSOR_BUS_MAX_CHANNELS)
+        channel_cnt = SENSOR_BUS_MAX_CHANNELS;
+
+    SensorBusNode *node = &bus->nodes[bus->node_cnt];
+    memset(node, 0, sizeof(*node));
+    node->address = address;
+    node->channel_cnt = channel_cnt;
+    for (uint32_t k = 0; k < channel_cnt; k++)
+        node->lane_idx[k] = lane_idx[k] < MAX_LANE_CNT ? lane_idx[k] : SENSOR_BUS_NO_LANE;
+    node->slot_us = sensor_bus_frame_us(bus->baud, 0) + SENSOR_BUS_TURNAROUND_US +
+                    sensor_bus_frame_us(bus->baud, reply_payload_len(SENSOR_BUS_PREEMPT, channel_cnt)) +
+                    SENSOR_BUS_SLOT_MARGIN_US;
+    return bus->node_cnt++;
+}
+
+uint32_t sensor_bus_poll(SensorBus *bus, unsigned long now_us, uint8_t *out)
+{
+    int32_t next;
+    if (bus->current < 0)
+    {
+        if (bus->cycles > 0 && now_us - bus->cycle_start_us < SENSOR_BUS_CYCLE_MS * 1000UL)
+            return 0;
+        bus->cycle_start_us = now_us;
+        bus->cycle_lanes = 0;
+        next = next_node(bus, -1);
+        if (next < 0)
+        {
+            finish_cycle(bus, now_us);
+            return 0;
+        }
+    }
+    else
+    {
+        // The slot ends early on a good reply, otherwise when its time is up
+        if (!bus->replied && now_us - bus->slot_start_us < bus->nodes[bus->current].slot_us)
+            return 0;
+        if (!bus->replied)
+            node_missed(&bus->nodes[bus->current]);
+        next = next_node(bus, bus->current);
+        if (next < 0)
+        {
+            finish_cycle(bus, now_us);
+            return 0;
+        }
+    }
+
+    bus->current = next;
+    bus->replied = false;
+    bus->slot_start_us = now_us;
+    bus->seq++;
+    bus->nodes[next].polls++;
+    return sensor_bus_encode(out, bus->nodes[next].address, SENSOR_BUS_POLL, bus->seq, NULL, 0);
+}
+
+void sensor_bus_receive(SensorBus *bus, const uint8_t *data, uint32_t len, unsigned long now_us)
+{
+    SensorBusFrame frame;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        uint32_t crc_errors = bus->parser.crc_errors;
+        bool ok = sensor_bus_parse(&bus->parser, data[i], &frame);
+        if (bus->parser.crc_errors != crc_errors && bus->current >= 0)
+            bus->nodes[bus->current].crc_errors++;
+        if (!ok || frame.type == SENSOR_BUS_POLL) // Our own poll, on a transceiver that echoes
+            continue;
+
+        bool reply = frame.type == SENSOR_BUS_DATA || frame.type == SENSOR_BUS_PREEMPT;
+        if (bus->current >= 0 && !bus->replied && reply &&
+            frame.address == bus->nodes[bus->current].address && frame.seq == bus->seq)
+            accept_data(bus, &frame, now_us);
+        else
+            bus->stray_frames++;
+    }
+}
+
+bool sensor_bus_take_frame(SensorBus *bus, uint16_t *values, uint64_t *reported_lanes)
+{
+    if (!bus->frame_ready)
+        return false;
+    bus->frame_ready = false;
+    for (uint32_t i = 0; i < MAX_LANE_CNT; i++)
+    {
+        if ((bus->frame_lanes >> i) & 1)
+            values[i] = bus->values[i];
+    }
+    *reported_lanes = bus->frame_lanes;
+    return true;
+}
+
+uint64_t sensor_bus_take_preemption(SensorBus *bus)
+{
+    uint64_t lanes = bus->preempt_lanes;
+    bus->preempt_lanes = 0;
+    return lanes;
+}
+
+uint32_t sensor_bus_latency_bound_us(const SensorBus *bus)
+{
+    uint32_t slots = 0;
+    for (uint32_t i = 0; i < bus->node_cnt; i++)
+        slots += bus->nodes[i].slot_us;
+    uint32_t period = SENSOR_BUS_CYCLE_MS * 1000UL;
+    if (slots > period)
+        period = slots;
+    return SENSOR_BUS_NODE_SAMPLE_MS * 1000UL + slots + period;
+}
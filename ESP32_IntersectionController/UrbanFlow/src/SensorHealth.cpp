@@ -0,0 +1,280 @@
+#include "SensorHealth.h"
+#include <string.h>
+#include <time.h>
+#include <Arduino.h>
+#include <Preferences.h>
+#include "FlightRecorder.h"
+
+// --- STATE ---
+typedef struct {
+    uint16_t last_value;
+    uint16_t last_good_value;
+    SensorStatus status;
+    bool heard;
+
+    unsigned long last_frame_ms;
+    unsigned long last_change_ms;
+    unsigned long rail_since_ms;    // 0 = not on a rail
+    unsigned long clean_since_ms;   // 0 = last reading was faulty
+    unsigned long jump_window_ms;
+    uint8_t jumps;
+
+    // Current profile slot
+    uint32_t slot_sum;
+    uint16_t slot_samples;
+    bool profile_dirty;
+} SensorLaneState;
+
+static SensorLaneState lanes[MAX_LANE_CNT];
+static uint8_t profile[MAX_LANE_CNT][SENSOR_PROFILE_SLOTS];
+static int current_slot = -1;
+static unsigned long setup_time = 0;
+static Preferences prefs;
+
+static const char *PREFS_NAMESPACE = "sensorprof";
+
+// --- HELPERS ---
+
+static void profile_key(const Intersection *intr, uint32_t lane_idx, char *key, size_t len)
+{
+    snprintf(key, len, "lane%lu", (unsigned long)intr->lanes[lane_idx].id);
+}
+
+// Slot of the local time of day, or -1 until the clock has been set (NTP)
+static int time_of_day_slot()
+{
+    time_t now = time(NULL);
+    struct tm local;
+    if (now < 1600000000 || !localtime_r(&now, &local))
+        return -1;
+    return (local.tm_hour * 60 + local.tm_min) / SENSOR_PROFILE_SLOT_MIN;
+}
+
+static uint8_t to_profile(uint16_t value)
+{
+    uint16_t q = value >> 2;
+    return q >= SENSOR_PROFILE_UNKNOWN ? SENSOR_PROFILE_UNKNOWN - 1 : (uint8_t)q;
+}
+
+static void set_status(const Intersection *intr, uint32_t i, SensorStatus status)
+{
+    SensorLaneState *s = &lanes[i];
+    if (s->status == status)
+        return;
+
+    Serial.printf("[SENSOR] Lane %lu: %s -> %s%s\n", (unsigned long)intr->lanes[i].id, sensor_status_name(s->status),
+                  sensor_status_name(status), status == SENSOR_OK ? "" : " (using learned demand)");
+    s->status = status;
+    recorder_fault(FAULT_SOURCE_SENSOR, (uint8_t)status, (uint8_t)i);
+}
+
+// Faulty this frame = restart the recovery clock; clean long enough = trusted again
+static void report(const Intersection *intr, uint32_t i, SensorStatus detected, unsigned long now)
+{
+    SensorLaneState *s = &lanes[i];
+    if (detected != SENSOR_OK)
+    {
+        s->clean_since_ms = 0;
+        set_status(intr, i, detected);
+        return;
+    }
+
+    if (s->status == SENSOR_OK)
+        return;
+    if (s->clean_since_ms == 0)
+        s->clean_since_ms = now | 1;
+    else if (now - s->clean_since_ms >= SENSOR_RECOVERY_MS)
+        set_status(intr, i, SENSOR_OK);
+}
+
+static void fold_slot(const Intersection *intr, int slot)
+{
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        SensorLaneState *s = &lanes[i];
+        if (s->slot_samples == 0)
+            continue;
+
+        uint8_t observed = to_profile(s->slot_sum / s->slot_samples);
+        uint8_t *p = &profile[i][slot];
+        if (*p == SENSOR_PROFILE_UNKNOWN)
+            *p = observed;
+        else
+            *p = (uint8_t)(*p + ((int)observed - (int)*p) / SENSOR_PROFILE_WEIGHT);
+
+        s->slot_sum = 0;
+        s->slot_samples = 0;
+        s->profile_dirty = true;
+    }
+}
+
+static void save_profiles(const Intersection *intr)
+{
+    if (!prefs.begin(PREFS_NAMESPACE, false))
+        return;
+
+    char key[16];
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        if (!lanes[i].profile_dirty)
+            continue;
+        profile_key(intr, i, key, sizeof(key));
+        prefs.putBytes(key, profile[i], SENSOR_PROFILE_SLOTS);
+        lanes[i].profile_dirty = false;
+    }
+    prefs.end();
+}
+
+// --- PUBLIC API ---
+
+void sensor_health_setup(const Intersection *intr)
+{
+    memset(lanes, 0, sizeof(lanes));
+    memset(profile, SENSOR_PROFILE_UNKNOWN, sizeof(profile));
+    current_slot = time_of_day_slot();
+    setup_time = millis();
+
+    uint32_t loaded = 0;
+    if (prefs.begin(PREFS_NAMESPACE, true))
+    {
+        char key[16];
+        for (uint32_t i = 0; i < intr->lane_cnt; i++)
+        {
+            profile_key(intr, i, key, sizeof(key));
+            if (prefs.getBytes(key, profile[i], SENSOR_PROFILE_SLOTS) == SENSOR_PROFILE_SLOTS)
+                loaded++;
+            else
+                memset(profile[i], SENSOR_PROFILE_UNKNOWN, SENSOR_PROFILE_SLOTS);
+        }
+        prefs.end();
+    }
+    Serial.printf("[SENSOR] Demand profiles loaded for %lu lanes%s\n", (unsigned long)loaded,
+                  current_slot < 0 ? " (clock not set yet)" : "");
+}
+
+void sensor_health_on_frame(const Intersection *intr, const uint16_t *values, uint64_t reported_lanes, unsigned long now)
+{
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        if (!((reported_lanes >> i) & 1))
+            continue;
+
+        SensorLaneState *s = &lanes[i];
+        uint16_t v = values[i];
+
+        if (!s->heard)
+        {
+            s->heard = true;
+            s->last_value = v;
+            s->last_change_ms = now;
+            s->jump_window_ms = now;
+        }
+
+        uint16_t step = v > s->last_value ? v - s->last_value : s->last_value - v;
+        s->last_frame_ms = now;
+        s->last_value = v;
+
+        // 1. Implausible rate
+        if (now - s->jump_window_ms >= 60000)
+        {
+            s->jump_window_ms = now;
+            s->jumps = 0;
+        }
+        if (step > SENSOR_MAX_STEP && s->jumps < 255)
+            s->jumps++;
+
+        // 2. Flatline
+        if (step > SENSOR_NOISE_BAND)
+            s->last_change_ms = now;
+
+        // 3. Pinned to a rail
+        bool on_rail = v <= SENSOR_RAIL_MARGIN || v >= SENSOR_MAX_VALUE - SENSOR_RAIL_MARGIN;
+        if (!on_rail)
+            s->rail_since_ms = 0;
+        else if (s->rail_since_ms == 0)
+            s->rail_since_ms = now | 1;
+
+        SensorStatus detected = SENSOR_OK;
+        if (s->jumps > SENSOR_MAX_JUMPS_PER_MIN)
+            detected = SENSOR_IMPLAUSIBLE;
+        else if (s->rail_since_ms && now - s->rail_since_ms >= SENSOR_STUCK_MS)
+            detected = SENSOR_STUCK;
+        else if (now - s->last_change_ms >= SENSOR_FLATLINE_MS)
+            detected = SENSOR_FLATLINE;
+
+        report(intr, i, detected, now);
+
+        // Rail readings are suspect until they have been there long enough to tell
+        if (s->status == SENSOR_OK && !on_rail)
+        {
+            s->last_good_value = v;
+            if (current_slot >= 0)
+            {
+                s->slot_sum += v;
+                s->slot_samples++;
+            }
+        }
+    }
+}
+
+void sensor_health_update(const Intersection *intr, unsigned long now)
+{
+    // Missing frames: lanes that went quiet, and inbound lanes never heard from at all
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        SensorLaneState *s = &lanes[i];
+        bool quiet = s->heard ? now - s->last_frame_ms > SENSOR_FRAME_TIMEOUT_MS
+                              : intr->lanes[i].type == LANE_IN && now - setup_time > SENSOR_FRAME_TIMEOUT_MS;
+        if (quiet)
+            report(intr, i, SENSOR_MISSING, now);
+    }
+
+    int slot = time_of_day_slot();
+    if (slot == current_slot)
+        return;
+
+    if (current_slot >= 0)
+    {
+        fold_slot(intr, current_slot);
+        save_profiles(intr);
+    }
+    current_slot = slot;
+}
+
+uint16_t sensor_demand(uint32_t lane_idx)
+{
+    if (lane_idx >= MAX_LANE_CNT)
+        return 0;
+
+    const SensorLaneState *s = &lanes[lane_idx];
+    if (s->status == SENSOR_OK)
+        return s->last_value;
+
+    if (current_slot >= 0 && profile[lane_idx][current_slot] != SENSOR_PROFILE_UNKNOWN)
+        return (uint16_t)profile[lane_idx][current_slot] << 2;
+
+    return s->last_good_value;
+}
+
+SensorStatus sensor_status(uint32_t lane_idx)
+{
+    return lane_idx < MAX_LANE_CNT ? lanes[lane_idx].status : SENSOR_MISSING;
+}
+
+const char *sensor_status_name(SensorStatus status)
+{
+    switch (status)
+    {
+    case SENSOR_OK:
+        return "OK";
+    case SENSOR_MISSING:
+        return "MISSING";
+    case SENSOR_STUCK:
+        return "STUCK";
+    case SENSOR_FLATLINE:
+        return "FLATLINE";
+    case SENSOR_IMPLAUSIBLE:
+        return "IMPLAUSIBLE";
+    }
+    return "?";
+}
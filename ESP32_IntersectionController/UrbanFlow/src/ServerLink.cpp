@@ -0,0 +1,94 @@
+#include "ServerLink.h"
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <HTTPClient.h>
+
+// --- STATE ---
+static WiFiClientSecure tls_client;
+static HTTPClient http;
+static ServerLinkStats stats;
+
+static uint32_t backoff_ms = 0;
+static unsigned long next_attempt_time = 0;
+
+void server_link_setup()
+{
+    tls_client.setInsecure(); // Needed for using https on localhost
+    tls_client.setHandshakeTimeout(SERVER_LINK_TIMEOUT_MS / 1000);
+
+    http.setReuse(true); // Keep-alive: end() leaves the TLS session open
+    http.setTimeout(SERVER_LINK_TIMEOUT_MS);
+    http.setConnectTimeout(SERVER_LINK_TIMEOUT_MS);
+
+    backoff_ms = 0;
+    next_attempt_time = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+uint32_t server_link_backoff_remaining()
+{
+    long remaining = (long)(next_attempt_time - millis());
+    return remaining > 0 ? remaining : 0;
+}
+
+const ServerLinkStats *server_link_stats()
+{
+    return &stats;
+}
+
+static void on_transport_failure()
+{
+    // Drop the (possibly half-dead) session so the next attempt starts clean
+    tls_client.stop();
+
+    backoff_ms = backoff_ms == 0 ? SERVER_LINK_BACKOFF_MIN_MS : backoff_ms * 2;
+    if (backoff_ms > SERVER_LINK_BACKOFF_MAX_MS)
+        backoff_ms = SERVER_LINK_BACKOFF_MAX_MS;
+    next_attempt_time = millis() + backoff_ms;
+    stats.failures++;
+
+    Serial.printf("[LINK] Connection lost. Retrying in %lu ms.\n", (unsigned long)backoff_ms);
+}
+
+static int request(const String &url, const char *method, const String &payload, String *body)
+{
+    if (WiFi.status() != WL_CONNECTED)
+        return HTTPC_ERROR_NOT_CONNECTED;
+    if (server_link_backoff_remaining() > 0)
+        return SERVER_LINK_ERROR_BACKOFF;
+
+    unsigned long start = millis();
+    if (!tls_client.connected())
+        stats.handshakes++;
+
+    http.begin(tls_client, url);
+    int code = http.sendRequest(method, payload);
+
+    if (code > 0)
+    {
+        // Always drain the body, or the connection cannot be reused
+        String response = http.getString();
+        if (body)
+            *body = response;
+        backoff_ms = 0;
+    }
+    http.end(); // Keeps the connection unless the server asked to close it
+
+    stats.requests++;
+    stats.last_latency_ms = millis() - start;
+
+    if (code < 0)
+        on_transport_failure();
+
+    return code;
+}
+
+int server_link_get(const char *url, String *body)
+{
+    return request(String(url), "GET", String(""), body);
+}
+
+int server_link_post(const String &url, const String &payload, String *body)
+{
+    return request(url, "POST", payload, body);
+}
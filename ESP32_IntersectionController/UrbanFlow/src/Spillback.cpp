@@ -0,0 +1,191 @@
+#include "Spillback.h"
+#include "FlightRecorder.h"
+#include <string.h>
+#include <Arduino.h>
+
+// --- STATE ---
+static uint16_t storage[MAX_LANE_CNT];          // 0 = not configured
+static uint16_t exit_queue[MAX_LANE_CNT];
+static unsigned long queue_time[MAX_LANE_CNT];  // Last queue input, 0 = none
+static unsigned long detector_since[MAX_LANE_CNT]; // Detector kept its state since
+static uint64_t detector_lanes = 0;
+static uint64_t detector_occupied = 0;
+static unsigned long last_update = 0;
+static SpillbackStats stats;
+
+// --- HELPERS ---
+
+static uint64_t connections_into(const Intersection *intr, uint64_t lanes)
+{
+    uint64_t conns = 0;
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+    {
+        if ((lanes >> intr->connections[c].target_lane_idx) & 1)
+            conns |= (1ULL << c);
+    }
+    return conns;
+}
+
+// Inbound lanes with at least one movement, all of them blocked
+static uint64_t lanes_held(const Intersection *intr, uint64_t blocked_conns)
+{
+    uint64_t conns[MAX_LANE_CNT] = {0};
+    for (uint32_t c = 0; c < intr->connection_cnt; c++)
+        conns[intr->connections[c].source_lane_idx] |= (1ULL << c);
+
+    uint64_t held = 0;
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        if (intr->lanes[i].type == LANE_IN && conns[i] && (conns[i] & ~blocked_conns) == 0)
+            held |= (1ULL << i);
+    }
+    return held;
+}
+
+// --- PUBLIC API ---
+
+void spillback_reset()
+{
+    memset(storage, 0, sizeof(storage));
+}
+
+void spillback_set_storage(uint32_t lane_idx, uint16_t vehicles)
+{
+    if (lane_idx < MAX_LANE_CNT)
+        storage[lane_idx] = vehicles;
+}
+
+uint16_t spillback_storage(uint32_t lane_idx)
+{
+    return storage[lane_idx];
+}
+
+void spillback_setup(const Intersection *intr, bool use_detectors, unsigned long now)
+{
+    memset(exit_queue, 0, sizeof(exit_queue));
+    memset(queue_time, 0, sizeof(queue_time));
+    memset(&stats, 0, sizeof(stats));
+    detector_lanes = 0;
+    detector_occupied = 0;
+    last_update = now;
+
+    uint32_t exits = 0;
+    uint32_t detectors = 0;
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        const Lane *lane = &intr->lanes[i];
+        detector_since[i] = now;
+        if (lane->type != LANE_OUT)
+            continue;
+        if (storage[i] == 0)
+            storage[i] = SPILLBACK_DEFAULT_STORAGE;
+        exits++;
+
+        if (!use_detectors || lane->hw.sensor_pin == -1)
+            continue;
+        pinMode(lane->hw.sensor_pin, INPUT);
+        detector_lanes |= (1ULL << i);
+        detectors++;
+    }
+    Serial.printf("[SPILLBACK] %lu exits, %lu exit detectors\n", (unsigned long)exits, (unsigned long)detectors);
+}
+
+void spillback_queue(uint32_t lane_idx, uint16_t vehicles, unsigned long now)
+{
+    if (lane_idx >= MAX_LANE_CNT)
+        return;
+    exit_queue[lane_idx] = vehicles;
+    queue_time[lane_idx] = now | 1;
+}
+
+void spillback_reading(uint32_t lane_idx, uint16_t value, unsigned long now)
+{
+    if (lane_idx >= MAX_LANE_CNT)
+        return;
+    if (value > SPILLBACK_READING_FULL)
+        value = SPILLBACK_READING_FULL;
+    uint16_t cap = storage[lane_idx] ? storage[lane_idx] : SPILLBACK_DEFAULT_STORAGE;
+    spillback_queue(lane_idx, (uint16_t)((uint32_t)value * cap / SPILLBACK_READING_FULL), now);
+}
+
+void spillback_update(const Intersection *intr, unsigned long now)
+{
+    stats.blocked_ms += __builtin_popcountll(stats.blocked_lanes) * (now - last_update);
+    last_update = now;
+
+    uint64_t blocked = stats.blocked_lanes;
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        if (intr->lanes[i].type != LANE_OUT)
+            continue;
+        uint64_t bit = 1ULL << i;
+
+        // Each input votes to block, and must agree before the exit clears
+        bool full = false;
+        bool clear = true;
+        if (queue_time[i] != 0 && now - queue_time[i] <= SPILLBACK_READING_TIMEOUT_MS)
+        {
+            uint32_t q = exit_queue[i] * 100;
+            full = q >= (uint32_t)storage[i] * SPILLBACK_ON_PERCENT;
+            clear = q <= (uint32_t)storage[i] * SPILLBACK_OFF_PERCENT;
+        }
+        if (detector_lanes & bit)
+        {
+            bool occupied = digitalRead(intr->lanes[i].hw.sensor_pin) == HIGH;
+            if (occupied != ((detector_occupied & bit) != 0))
+            {
+                detector_since[i] = now;
+                detector_occupied ^= bit;
+            }
+            unsigned long steady = now - detector_since[i];
+            if (occupied && steady >= SPILLBACK_OCCUPIED_MS)
+                full = true;
+            if (occupied || steady < SPILLBACK_CLEAR_MS)
+                clear = false;
+        }
+
+        if (!(blocked & bit) && full)
+        {
+            blocked |= bit;
+            stats.events++;
+            Serial.printf("[SPILLBACK] Exit lane %lu blocked (queue %u of %u)\n", (unsigned long)intr->lanes[i].id,
+                          exit_queue[i], storage[i]);
+        }
+        else if ((blocked & bit) && clear && !full)
+        {
+            blocked &= ~bit;
+            Serial.printf("[SPILLBACK] Exit lane %lu clear (queue %u of %u)\n", (unsigned long)intr->lanes[i].id,
+                          exit_queue[i], storage[i]);
+        }
+    }
+
+    if (blocked != stats.blocked_lanes)
+    {
+        stats.blocked_lanes = blocked;
+        stats.blocked_conns = connections_into(intr, blocked);
+        uint64_t held = lanes_held(intr, stats.blocked_conns);
+        stats.holds += __builtin_popcountll(held & ~stats.held_lanes);
+        stats.held_lanes = held;
+        recorder_spillback(blocked);
+    }
+}
+
+uint64_t spillback_blocked_lanes()
+{
+    return stats.blocked_lanes;
+}
+
+uint64_t spillback_blocked_connections()
+{
+    return stats.blocked_conns;
+}
+
+uint64_t spillback_held_lanes()
+{
+    return stats.held_lanes;
+}
+
+const SpillbackStats *spillback_stats()
+{
+    return &stats;
+}
@@ -1,10 +1,22 @@
 #include "TrafficController.h"
 #include "CONFIG.h"
+#include "SafetyMonitor.h"
+#include "PhaseOptimizer.h"
+#include "LightOutput.h"
+#include "SensorHealth.h"
+#include "FlightRecorder.h"
+#include "GreenWave.h"
+#include "Actuation.h"
+#include "QueueEstimator.h"
+#include "RingBarrier.h"
+#include "Calibration.h"
+#include "Spillback.h"
 
 #define DEBUG false  // Set to true for detailed Sensor readings
 
 // --- GLOBALS ---
 Intersection intr; 
+PolicyNet policy;
 
 // --- CONSTANTS ---
 const uint32_t MIN_GREEN_TIME = 5000;
@@ -14,50 +26,105 @@ const uint32_t SIMULATE_TRAFFIC_INTERVAL = 500;
 const uint32_t DECISION_TIME_INTERVAL = 1000;
 
 // --- TRANSITION CONSTANTS ---
-const uint32_t YELLOW_DURATION_MS = 2000;      
-const uint32_t PEDESTRIAN_DURATION_MS = 5000;  
-const uint32_t PEDESTRIAN_COOLDOWN_MS = 60000; 
+const uint32_t YELLOW_DURATION_MS = 2000;      // Intergreens add the red clearance per conflicting pair
+const uint32_t PEDESTRIAN_DURATION_MS = 5000;  // WALK time per crossing
+const uint32_t PEDESTRIAN_MAX_WAIT_MS = 60000;  // A request is served within this, whatever the traffic
+const uint32_t PEDESTRIAN_SIM_REQUEST_PERMILLE = 10; // Per crosswalk per simulation tick
+const uint32_t SIM_EXIT_DRAIN_PERCENT = 60;          // Per exit lane per simulation tick
 
-// --- ENUMS ---
-enum ControllerState {
-    STATE_GREEN_RUNNING,
-    STATE_YELLOW_TRANSITION,
-    STATE_PEDESTRIAN_RED
-};
+// --- PREEMPTION CONSTANTS ---
+const uint32_t PREEMPT_HOLD_MS = 10000;      // Emergency green kept this long after the last call
+const uint32_t PREEMPT_MAX_HOLD_MS = 60000;  // A stuck detector cannot hold the junction forever
 
 // --- STATE ---
 unsigned long last_decision_time = 0;
 unsigned long last_simulation_time = 0;
 unsigned long current_phase_start_time = 0;
 unsigned long transition_start_time = 0; 
+unsigned long last_estimator_time = 0;
+unsigned long last_queue_estimate_time = 0;
 
-unsigned long last_pedestrian_time = 0; 
+// --- PEDESTRIAN STATE ---
+unsigned long ped_request_time[MAX_LANE_CNT] = {0}; // 0 = nobody waiting
+uint64_t walk_lanes = 0;                            // Crosswalks showing WALK
+unsigned long walk_start_time = 0;
+bool exclusive_walk_pending = false;                // Overdue crossing no vehicle phase can carry
+uint64_t cleared_walk_lanes = 0;                    // Crosswalks whose WALK ended since the last transition
+unsigned long walk_end_time = 0;
+uint64_t ended_conns = 0;                           // Vehicle movements whose clearance may still block a crossing
+unsigned long conn_end_time[MAX_CONNECTION_CNT];    // When each of them got its yellow
+
+// --- PREEMPTION STATE ---
+volatile bool preempt_irq = false;          // Detector edge seen since the last pass
+int      preempt_lane = -1;                 // Approach being preempted, -1 = none
+uint64_t preempt_conns = 0;                 // Every movement out of that approach (same source never conflicts)
+unsigned long preempt_request_time = 0;
+unsigned long preempt_last_call = 0;
+unsigned long preempt_green_time = 0;       // 0 = approach not green yet
+uint32_t preempt_max_latency_ms = 0;        // Worst request-to-green seen
+uint32_t preempt_latency_bound_ms = 0;      // Worst case for this layout, from the clearance matrix
+int      preempt_locked_lane = -1;          // Lane whose call ran into PREEMPT_MAX_HOLD_MS
+unsigned long preempt_locked_since = 0;
+
+// --- TRANSITION STATE ---
+uint64_t lit_green_lanes = 0;                 // Vehicle lanes showing green right now
+uint64_t yellow_lanes = 0;                    // Ending lanes still on yellow
+uint64_t waiting_lanes = 0;                   // Next phase lanes still inside their intergreen
+uint32_t lane_start_offset_ms[MAX_LANE_CNT];  // When each waiting lane may go green, from transition start
+uint32_t transition_length_ms = 0;
+
+// --- SPILLBACK STATE ---
+uint64_t held_lanes = 0;                      // Lanes of the green kept red by a blocked exit
+uint64_t held_yellow_lanes = 0;               // Of those, still showing their yellow
+unsigned long held_since[MAX_LANE_CNT];
 
 uint32_t current_phase_idx = 0;
 uint32_t next_pending_phase_idx = 0;     
 int      phase_change_counter = 0;       
 ControllerState current_state = STATE_GREEN_RUNNING;
+bool     safety_fault_reported = false;
+DecisionContext decision_ctx; // Inputs of the last decision, as recorded
+
+unsigned long phase_last_serviced[MAX_PHASE_CNT] = {0};
 
-unsigned long phase_last_serviced[4] = {0, 0, 0, 0};
+// --- ACTUATED STATE ---
+bool gap_out_decided = false; // This gap already had its immediate decision
+bool max_out_decided = false;
+bool spillback_decided = false; // This blockage of the green already had its immediate decision
 
 uint16_t received_sensor_value[64];   
 
+ArrivalEstimator arrival_estimator;
+QueueEstimator queue_estimator;
+uint16_t sim_queue[MAX_LANE_CNT]; // SIMULATION_MODE ground truth; the controller only sees the estimate
+uint16_t sim_exit_queue[MAX_LANE_CNT]; // Vehicles standing on each exit lane
+LookaheadStats lookahead_stats;
+uint32_t policy_max_infer_us = 0;
+
 // --- HARDWARE HELPERS ---
 
+// Staged only: the lamps change on the next light_output_commit()
 void set_lights(const Lane *lane, bool red, bool yellow, bool green) {
-    if (lane->hw.red_pin != -1) digitalWrite(lane->hw.red_pin, red ? HIGH : LOW);
-    if (lane->hw.yellow_pin != -1) digitalWrite(lane->hw.yellow_pin, yellow ? HIGH : LOW);
-    if (lane->hw.green_pin != -1) digitalWrite(lane->hw.green_pin, green ? HIGH : LOW);
+    // Never fight the safety monitor's all-red fallback
+    if (safety_monitor_tripped()) { red = true; yellow = false; green = false; }
+
+    if (lane->hw.red_pin != -1) light_output_set(lane->hw.red_pin, red);
+    if (lane->hw.yellow_pin != -1) light_output_set(lane->hw.yellow_pin, yellow);
+    if (lane->hw.green_pin != -1) light_output_set(lane->hw.green_pin, green);
 }
 
 void initialize_hardware(Intersection *intr) {
+    light_output_setup(LIGHT_OUTPUT_BACKEND);
+
     for (uint32_t i = 0; i < intr->lane_cnt; i++) {
         const Lane *lane = &intr->lanes[i];
-        if (lane->hw.red_pin != -1) { pinMode(lane->hw.red_pin, OUTPUT); digitalWrite(lane->hw.red_pin, HIGH); }
-        if (lane->hw.yellow_pin != -1) { pinMode(lane->hw.yellow_pin, OUTPUT); digitalWrite(lane->hw.yellow_pin, LOW); }
-        if (lane->hw.green_pin != -1) { pinMode(lane->hw.green_pin, OUTPUT); digitalWrite(lane->hw.green_pin, LOW); }
-        if (lane->hw.sensor_pin != -1) { pinMode(lane->hw.sensor_pin, INPUT); }
+        if (lane->hw.red_pin != -1) light_output_claim(lane->hw.red_pin);
+        if (lane->hw.yellow_pin != -1) light_output_claim(lane->hw.yellow_pin);
+        if (lane->hw.green_pin != -1) light_output_claim(lane->hw.green_pin);
+        if (lane->hw.sensor_pin != -1) { pinMode(lane->hw.sensor_pin, INPUT); } // Sensors stay on GPIO
+        set_lights(lane, true, false, false);
     }
+    light_output_commit();
 }
 
 // 1. NORMAL GREEN
@@ -67,40 +134,158 @@ void apply_phase_lights_green(Intersection *intr, int phase_idx) {
         Lane *lane = &intr->lanes[i];
         if (lane->type != LANE_IN) continue;
 
-        bool is_green = false;
-        for (uint32_t c = 0; c < intr->connection_cnt; c++) {
-            if (intr->connections[c].source_lane_idx == i) {
-                if (next_phase->active_connections_mask & (1ULL << c)) {
-                    is_green = true;
-                    break;
-                }
-            }
-        }
+        bool is_green = (next_phase->green_lanes_mask >> i) & 1;
         if (is_green) set_lights(lane, false, false, true); // Green ON
         else set_lights(lane, true, false, false);          // Red ON
     }
+    lit_green_lanes = next_phase->green_lanes_mask;
+    yellow_lanes = 0;
+    waiting_lanes = 0;
+    held_lanes = 0;
+    held_yellow_lanes = 0;
 }
 
-// 2. TRANSITION YELLOW
-void apply_transition_yellow(Intersection *intr, int phase_idx_ending) {
-    const Phase *ending_phase = &intr->phases[phase_idx_ending];
-    
+// 2. TRANSITION (INTERGREEN)
+
+// Movements losing their green: every connection of a lane going dark, plus
+// crossings whose WALK has ended since the last transition
+uint64_t ending_connections(Intersection *intr, uint64_t ending_lanes) {
+    uint64_t ending = 0;
+    for (uint32_t c = 0; c < intr->connection_cnt; c++) {
+        uint32_t src = intr->connections[c].source_lane_idx;
+        if (((ending_lanes | cleared_walk_lanes) >> src) & 1) ending |= (1ULL << c);
+    }
+    return ending;
+}
+
+// Vehicle lanes getting their yellow now; a crossing that conflicts with one
+// of their movements waits out its clearance before WALK, whenever it is requested
+void note_ended_lanes(Intersection *intr, uint64_t lanes, unsigned long now) {
+    for (uint32_t c = 0; c < intr->connection_cnt; c++) {
+        uint32_t src = intr->connections[c].source_lane_idx;
+        if (!((lanes >> src) & 1) || intr->lanes[src].type != LANE_IN) continue;
+        conn_end_time[c] = now;
+        ended_conns |= (1ULL << c);
+    }
+}
+
+// How long starting_conn still has to wait for every conflicting movement that ended
+uint32_t intergreen_wait_ms(Intersection *intr, uint64_t ending_conns, uint32_t starting_conn, unsigned long now) {
+    uint32_t wait = 0;
+    uint64_t enemies = ending_conns & intr->conflict_masks[starting_conn];
+    for (uint32_t c = 0; c < intr->connection_cnt; c++) {
+        if (!((enemies >> c) & 1)) continue;
+
+        uint32_t needed = intergreen_ms(intr, c, starting_conn, YELLOW_DURATION_MS);
+        // Vehicle movements end now; a crossing ended when its WALK did
+        bool walk = intr->lanes[intr->connections[c].source_lane_idx].type == LANE_CROSSWALK;
+        uint32_t elapsed = walk ? now - walk_end_time : 0;
+        if (needed > elapsed && needed - elapsed > wait) wait = needed - elapsed;
+    }
+    return wait;
+}
+
+// Lanes green on both sides carry straight through. Lanes that end get their
+// yellow. Every new lane turns green as soon as its own conflicting movements
+// have cleared, rather than everyone waiting a fixed yellow.
+void begin_transition(Intersection *intr, uint64_t starting_conns, unsigned long now) {
+    uint64_t next_green = 0;
+    for (uint32_t c = 0; c < intr->connection_cnt; c++) {
+        uint32_t src = intr->connections[c].source_lane_idx;
+        if (((starting_conns >> c) & 1) && intr->lanes[src].type == LANE_IN) next_green |= (1ULL << src);
+    }
+
+    // Held lanes may have gone red moments ago, so they clear as if ending now;
+    // one still on its yellow shows it again, in full, before anything else
+    uint64_t ending_lanes = (lit_green_lanes & ~next_green) | held_yellow_lanes;
+    uint64_t ending_conns = ending_connections(intr, ending_lanes | held_lanes);
+    note_ended_lanes(intr, ending_lanes | held_lanes, now);
+
+    transition_start_time = now;
+    transition_length_ms = ending_lanes ? YELLOW_DURATION_MS : 0;
+    yellow_lanes = ending_lanes;
+    waiting_lanes = next_green & ~lit_green_lanes;
+    lit_green_lanes &= ~ending_lanes;
+    memset(lane_start_offset_ms, 0, sizeof(lane_start_offset_ms));
+
+    for (uint32_t c = 0; c < intr->connection_cnt; c++) {
+        if (!((starting_conns >> c) & 1)) continue;
+
+        uint32_t wait = intergreen_wait_ms(intr, ending_conns, c, now);
+        uint32_t src = intr->connections[c].source_lane_idx;
+        if (((yellow_lanes >> src) & 1) && wait < YELLOW_DURATION_MS) wait = YELLOW_DURATION_MS;
+        if (wait > lane_start_offset_ms[src]) lane_start_offset_ms[src] = wait;
+        if (wait > transition_length_ms) transition_length_ms = wait;
+    }
+    held_lanes = 0;
+    held_yellow_lanes = 0;
+
     for (uint32_t i = 0; i < intr->lane_cnt; i++) {
-        Lane *lane = &intr->lanes[i];
-        if (lane->type != LANE_IN) continue;
+        if ((yellow_lanes >> i) & 1) set_lights(&intr->lanes[i], false, true, false);
+    }
+    cleared_walk_lanes = 0;
 
-        bool was_green = false;
-        for (uint32_t c = 0; c < intr->connection_cnt; c++) {
-            if (intr->connections[c].source_lane_idx == i) {
-                if (ending_phase->active_connections_mask & (1ULL << c)) {
-                    was_green = true;
-                    break;
-                }
+    Serial.printf(">>> INTERGREEN %lu ms (carried 0x%llx)\n", (unsigned long)transition_length_ms,
+                  (unsigned long long)(lit_green_lanes & next_green));
+}
+
+// Ends yellows and releases waiting lanes whose clearance has expired.
+// Returns true once the whole transition is done.
+bool update_transition(Intersection *intr, unsigned long now) {
+    uint32_t elapsed = now - transition_start_time;
+
+    if (yellow_lanes && elapsed >= YELLOW_DURATION_MS) {
+        for (uint32_t i = 0; i < intr->lane_cnt; i++) {
+            if ((yellow_lanes >> i) & 1) set_lights(&intr->lanes[i], true, false, false);
+        }
+        yellow_lanes = 0;
+    }
+
+    // Spillback holds apply to normal phases only, never to the emergency approach
+    uint64_t hold = current_state == STATE_YELLOW_TRANSITION ? spillback_held_lanes() : 0;
+    for (uint32_t i = 0; i < intr->lane_cnt && waiting_lanes; i++) {
+        if (((waiting_lanes >> i) & 1) && elapsed >= lane_start_offset_ms[i]) {
+            if ((hold >> i) & 1) {
+                held_lanes |= (1ULL << i); // Cleared, but red until its exit clears
+            } else {
+                set_lights(&intr->lanes[i], false, false, true);
+                lit_green_lanes |= (1ULL << i);
             }
+            waiting_lanes &= ~(1ULL << i);
         }
+    }
+
+    return elapsed >= transition_length_ms && yellow_lanes == 0 && waiting_lanes == 0;
+}
 
-        if (was_green) set_lights(lane, false, true, false); 
-        else set_lights(lane, true, false, false); 
+// Gridlock avoidance: a lane of the running green whose every movement runs into
+// a blocked exit gets its yellow and stays red, so nobody stops in the box. It
+// rejoins the green once an exit clears; the rest of the phase never stopped,
+// so nothing conflicting has run meanwhile.
+void update_spillback_holds(Intersection *intr, unsigned long now) {
+    uint64_t hold = spillback_held_lanes();
+    uint64_t phase_lanes = intr->phases[current_phase_idx].green_lanes_mask;
+    for (uint32_t i = 0; i < intr->lane_cnt; i++) {
+        uint64_t bit = 1ULL << i;
+        if (!(phase_lanes & bit)) continue;
+
+        if ((lit_green_lanes & bit) && (hold & bit)) {
+            lit_green_lanes &= ~bit;
+            held_lanes |= bit;
+            held_yellow_lanes |= bit;
+            held_since[i] = now;
+            note_ended_lanes(intr, bit, now);
+            set_lights(&intr->lanes[i], false, true, false);
+            Serial.printf("[SPILLBACK] Holding lane %lu\n", (unsigned long)intr->lanes[i].id);
+        } else if ((held_yellow_lanes & bit) && now - held_since[i] >= YELLOW_DURATION_MS) {
+            held_yellow_lanes &= ~bit;
+            set_lights(&intr->lanes[i], true, false, false);
+        } else if ((held_lanes & bit) && !(held_yellow_lanes & bit) && !(hold & bit)) {
+            held_lanes &= ~bit;
+            lit_green_lanes |= bit;
+            set_lights(&intr->lanes[i], false, false, true);
+            Serial.printf("[SPILLBACK] Releasing lane %lu\n", (unsigned long)intr->lanes[i].id);
+        }
     }
 }
 
@@ -111,89 +296,361 @@ void apply_all_red(Intersection *intr) {
         if (lane->type != LANE_IN) continue;
         set_lights(lane, true, false, false); // Red ON
     }
+    lit_green_lanes = 0;
+    yellow_lanes = 0;
+    waiting_lanes = 0;
+    held_lanes = 0;
+    held_yellow_lanes = 0;
+}
+
+// 4. WALK SIGNALS
+void apply_walk_lights(Intersection *intr) {
+    for (uint32_t i = 0; i < intr->lane_cnt; i++) {
+        Lane *lane = &intr->lanes[i];
+        if (lane->type != LANE_CROSSWALK) continue;
+
+        bool walk = (walk_lanes >> i) & 1;
+        set_lights(lane, !walk, false, walk);
+    }
+}
+
+// --- PEDESTRIAN HELPERS ---
+
+void request_crossing(uint32_t lane_idx, unsigned long now) {
+    if (ped_request_time[lane_idx] == 0 && !((walk_lanes >> lane_idx) & 1)) {
+        ped_request_time[lane_idx] = now | 1;
+    }
+}
+
+void poll_pedestrian_buttons(Intersection *intr, unsigned long now) {
+    for (uint32_t i = 0; i < intr->lane_cnt; i++) {
+        const Lane *lane = &intr->lanes[i];
+        if (lane->type != LANE_CROSSWALK || lane->hw.sensor_pin == -1) continue;
+        if (digitalRead(lane->hw.sensor_pin) == HIGH) request_crossing(i, now);
+    }
+}
+
+// MAX_GREEN_TIME unless the running phase sets its own max-out
+uint32_t current_max_green() {
+    return actuation_max_green(current_phase_idx, MAX_GREEN_TIME);
+}
+
+// A crossing fits a phase if its pedestrian connection conflicts with none of the phase's movements
+bool crossing_compatible(Intersection *intr, uint32_t lane_idx, uint64_t vehicle_mask) {
+    for (uint32_t c = 0; c < intr->connection_cnt; c++) {
+        if (intr->connections[c].source_lane_idx == lane_idx && (intr->conflict_masks[c] & vehicle_mask)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A crossing may show WALK once every conflicting vehicle movement that ended
+// has cleared it. Movements cleared everywhere drop out of ended_conns.
+bool crossing_cleared(Intersection *intr, uint32_t lane_idx, unsigned long now) {
+    bool cleared = true;
+    for (uint32_t p = 0; p < intr->connection_cnt; p++) {
+        if (intr->connections[p].source_lane_idx != lane_idx) continue;
+
+        uint64_t enemies = ended_conns & intr->conflict_masks[p];
+        for (uint32_t c = 0; c < intr->connection_cnt; c++) {
+            if (!((enemies >> c) & 1)) continue;
+            if (now - conn_end_time[c] < intergreen_ms(intr, c, p, YELLOW_DURATION_MS)) cleared = false;
+            else if (now - conn_end_time[c] >= YELLOW_DURATION_MS + UINT8_MAX * INTERGREEN_UNIT_MS) ended_conns &= ~(1ULL << c);
+        }
+    }
+    return cleared;
+}
+
+// Start WALK for every waiting crossing the running phase can carry, if the green has room for it
+void grant_compatible_walks(Intersection *intr, unsigned long now) {
+    if (now - current_phase_start_time + PEDESTRIAN_DURATION_MS > current_max_green()) return;
+
+    uint64_t vehicle_mask = intr->phases[current_phase_idx].active_connections_mask;
+    uint64_t granted = 0;
+    for (uint32_t i = 0; i < intr->lane_cnt; i++) {
+        if (ped_request_time[i] == 0) continue;
+        if (crossing_compatible(intr, i, vehicle_mask) && crossing_cleared(intr, i, now)) {
+            granted |= (1ULL << i);
+            ped_request_time[i] = 0;
+        }
+    }
+
+    if (granted) {
+        walk_lanes |= granted;
+        walk_start_time = now;
+        Serial.printf(">>> WALK alongside Phase %d (crosswalks 0x%llx)\n", current_phase_idx, (unsigned long long)granted);
+        apply_walk_lights(intr);
+    }
+}
+
+void end_expired_walks(Intersection *intr, unsigned long now) {
+    if (walk_lanes && now - walk_start_time >= PEDESTRIAN_DURATION_MS) {
+        cleared_walk_lanes |= walk_lanes;
+        walk_end_time = now;
+        walk_lanes = 0;
+        apply_walk_lights(intr);
+    }
+}
+
+// Pedestrian connections of every crosswalk with someone waiting
+uint64_t requested_crossing_connections(Intersection *intr) {
+    uint64_t mask = 0;
+    for (uint32_t c = 0; c < intr->connection_cnt; c++) {
+        if (ped_request_time[intr->connections[c].source_lane_idx] != 0) mask |= (1ULL << c);
+    }
+    return mask;
+}
+
+int32_t context_pressure(Intersection *intr, const DecisionContext *ctx, int phase_index);
+
+// Phase that can carry the longest-waiting overdue crossing, or -1.
+// If no vehicle phase can, flags an exclusive all-red pedestrian interval instead.
+int overdue_crossing_phase(Intersection *intr, const DecisionContext *ctx, bool *exclusive_walk) {
+    int overdue_lane = -1;
+    uint32_t longest_wait = 0;
+    for (uint32_t i = 0; i < intr->lane_cnt; i++) {
+        if (!((ctx->waiting_crossings >> i) & 1)) continue;
+        uint32_t wait = ctx->crossing_wait_ms[i];
+        if (wait >= PEDESTRIAN_MAX_WAIT_MS && wait >= longest_wait) {
+            longest_wait = wait;
+            overdue_lane = i;
+        }
+    }
+    if (overdue_lane == -1) return -1;
+
+    int best_phase = -1;
+    int32_t best_pressure = -1;
+    for (uint32_t p = 0; p < intr->phase_cnt; p++) {
+        if (!crossing_compatible(intr, overdue_lane, intr->phases[p].active_connections_mask)) continue;
+        // Staying only helps if the green still has room for the walk
+        if (p == ctx->current_phase && ctx->green_ms + PEDESTRIAN_DURATION_MS > ctx->max_green_ms) continue;
+
+        int32_t pressure = context_pressure(intr, ctx, p);
+        if (pressure > best_pressure) {
+            best_pressure = pressure;
+            best_phase = p;
+        }
+    }
+
+    if (best_phase == -1) *exclusive_walk = true;
+    return best_phase;
 }
 
 // --- LOGIC FUNCTIONS ---
 
+// Chance of an arrival per SIMULATE_TRAFFIC_INTERVAL, from the lane's demand reading
+int arrival_percent(uint32_t lane_idx) {
+    int sensor_val = sensor_demand(lane_idx); // Learned profile while the sensor is flagged
+    return map(sensor_val, 0, 1023, 5, 100);
+}
+
+// Movements allowed to discharge right now (carried-over and early-start lanes keep moving through transitions)
+uint64_t moving_connections(Intersection *intr) {
+    if (current_state == STATE_PREEMPT_CLEARANCE || current_state == STATE_PREEMPT_HOLD) return preempt_conns;
+    uint64_t moving = intr->phases[current_phase_idx].active_connections_mask;
+    if (current_state == STATE_YELLOW_TRANSITION) moving |= intr->phases[next_pending_phase_idx].active_connections_mask;
+    return moving;
+}
+
 void simulate_traffic_changes(Intersection *intr) {
     if (DEBUG) Serial.println("\n--- Sensor Readings ---");
 
-    // 1. Simulate ARRIVALS
+    // 1. Simulate ARRIVALS, counted upstream
     for (uint32_t i = 0; i < intr->lane_cnt; i++) {
         if (intr->lanes[i].type == LANE_IN) {
-            int sensor_val = received_sensor_value[i];
-            int arrival_probability = map(sensor_val, 0, 1023, 5, 100);
-
-            if (random(0, 100) < arrival_probability) {
-                intr->lanes[i].current_traffic_value++;
-                if (intr->lanes[i].current_traffic_value > 255)
-                    intr->lanes[i].current_traffic_value = 255;
+            if (random(0, 100) < arrival_percent(i) && sim_queue[i] < 255) {
+                sim_queue[i]++;
+                queue_estimator_count(&queue_estimator, i, 1, 0);
             }
         }
     }
 
-    // 2. Simulate DEPARTURES
-    if (current_state == STATE_GREEN_RUNNING) {
-        const Phase *curr = &intr->phases[current_phase_idx];
-        for (uint32_t c = 0; c < intr->connection_cnt; c++) {
-            if (curr->active_connections_mask & (1ULL << c)) {
-                uint32_t src = intr->connections[c].source_lane_idx;
-                if (intr->lanes[src].current_traffic_value > 0) {
-                    if (random(0, 100) < 50) {
-                        intr->lanes[src].current_traffic_value--;
-                    }
+    // 2. Simulate PEDESTRIANS pressing the button
+    for (uint32_t i = 0; i < intr->lane_cnt; i++) {
+        if (intr->lanes[i].type == LANE_CROSSWALK && random(0, 1000) < PEDESTRIAN_SIM_REQUEST_PERMILLE) {
+            request_crossing(i, millis());
+        }
+    }
+
+    // 3. Simulate DEPARTURES, counted at the stop line and per movement. Nobody leaves into a full exit.
+    uint64_t moving = moving_connections(intr);
+    for (uint32_t c = 0; c < intr->connection_cnt; c++) {
+        if (moving & (1ULL << c)) {
+            uint32_t src = intr->connections[c].source_lane_idx;
+            uint32_t tgt = intr->connections[c].target_lane_idx;
+            bool exit = intr->lanes[tgt].type == LANE_OUT;
+            if (!((lit_green_lanes >> src) & 1)) continue;
+            if (exit && sim_exit_queue[tgt] >= spillback_storage(tgt)) continue;
+            if (sim_queue[src] > 0) {
+                if (random(0, 100) < 50) {
+                    sim_queue[src]--;
+                    if (exit) sim_exit_queue[tgt]++;
+                    queue_estimator_count(&queue_estimator, src, 0, 1);
+                    calibration_departure(intr, src, c, moving, sim_queue[src], millis());
                 }
             }
         }
     }
+
+    // 4. Simulate the EXITS draining toward the next junction
+    for (uint32_t i = 0; i < intr->lane_cnt; i++) {
+        if (intr->lanes[i].type != LANE_OUT) continue;
+        if (sim_exit_queue[i] > 0 && random(0, 100) < SIM_EXIT_DRAIN_PERCENT) sim_exit_queue[i]--;
+        spillback_queue(i, sim_exit_queue[i], millis());
+    }
+}
+
+// What each inbound lane can measure: exact counts in simulation, stop-line
+// detectors where fitted, otherwise only its demand reading.
+void attach_queue_sources(Intersection *intr) {
+    queue_estimator_reset(&queue_estimator);
+    memset(sim_queue, 0, sizeof(sim_queue));
+    memset(sim_exit_queue, 0, sizeof(sim_exit_queue));
+    for (uint32_t i = 0; i < intr->lane_cnt; i++) {
+        if (intr->lanes[i].type != LANE_IN) continue;
+        if (SIMULATION_MODE) {
+            queue_estimator_attach(&queue_estimator, i, QUEUE_SOURCE_ARRIVALS | QUEUE_SOURCE_DEPARTURES);
+        } else if (actuation_has_detector(i)) {
+            queue_estimator_attach(&queue_estimator, i, QUEUE_SOURCE_DEPARTURES | QUEUE_SOURCE_OCCUPANCY);
+        }
+    }
 }
 
-int32_t calculate_phase_pressure(Intersection *intr, int phase_index) {
-    int32_t pressure = 0;
+// Every QUEUE_ESTIMATOR_PERIOD_MS: detector readings in, one filter step, estimates out to lane_traffic
+void update_queue_estimates(Intersection *intr, unsigned long now) {
+    for (uint32_t i = 0; i < intr->lane_cnt; i++) {
+        if (intr->lanes[i].type != LANE_IN) continue;
+        queue_estimator_set_rate(&queue_estimator, i, arrival_percent(i) * QUEUE_Q8 * 1000 / (100 * SIMULATE_TRAFFIC_INTERVAL));
+    }
+
+    queue_estimator_step(&queue_estimator, intr, lit_green_lanes | yellow_lanes, now - last_queue_estimate_time);
+    last_queue_estimate_time = now;
+
+    for (uint32_t i = 0; i < intr->lane_cnt; i++) {
+        if (intr->lanes[i].type == LANE_IN) intr->lane_traffic[i] = queue_estimate(&queue_estimator, i);
+    }
+}
+
+int32_t phase_pressure(Intersection *intr, int phase_index, uint64_t blocked_conns, uint64_t called_lanes) {
+    int32_t pressure = 0; // CONNECTION_WEIGHT_ONE per vehicle on a reference movement
     const Phase *p = &intr->phases[phase_index];
+    // Nothing counts toward a blocked exit: a green for it would only fill the box
+    uint64_t open = p->active_connections_mask & ~blocked_conns;
     for (uint32_t c = 0; c < intr->connection_cnt; c++) {
-        if (p->active_connections_mask & (1ULL << c)) {
+        if (open & (1ULL << c)) {
             uint32_t source_idx = intr->connections[c].source_lane_idx;
-            pressure += intr->lanes[source_idx].current_traffic_value;
+            uint32_t weight = intr->connections[c].weight;
+            // A detector call without a counted queue stands for one vehicle
+            if (intr->lane_traffic[source_idx] == 0 && ((called_lanes >> source_idx) & 1)) pressure += weight;
+            pressure += intr->lane_traffic[source_idx] * weight;
         }
     }
-    return pressure;
+    // Rounded up, so a queue on a lightly weighted movement still counts
+    return (pressure + CONNECTION_WEIGHT_ONE - 1) / CONNECTION_WEIGHT_ONE;
 }
 
-int determine_next_phase(Intersection *intr) {
+int32_t calculate_phase_pressure(Intersection *intr, int phase_index) {
+    return phase_pressure(intr, phase_index, spillback_blocked_connections(), actuation_called_lanes());
+}
+
+int32_t context_pressure(Intersection *intr, const DecisionContext *ctx, int phase_index) {
+    return phase_pressure(intr, phase_index, ctx->blocked_conns, ctx->called_lanes);
+}
+
+// Everything determine_next_phase() reads besides the layout, lane_traffic and the weights
+void gather_decision_context(Intersection *intr, DecisionContext *ctx, unsigned long now, bool gapped_out) {
+    ctx->current_phase = current_phase_idx;
+    ctx->green_ms = now - current_phase_start_time;
+    ctx->max_green_ms = current_max_green();
+    ctx->gapped_out = gapped_out;
+    ctx->blocked_conns = spillback_blocked_connections();
+    ctx->called_lanes = actuation_called_lanes();
+
+    ctx->waiting_crossings = 0;
+    for (uint32_t i = 0; i < intr->lane_cnt; i++) {
+        ctx->crossing_wait_ms[i] = 0;
+        if (ped_request_time[i] == 0) continue;
+        ctx->waiting_crossings |= (1ULL << i);
+        ctx->crossing_wait_ms[i] = now - ped_request_time[i];
+    }
+    for (uint32_t p = 0; p < intr->phase_cnt; p++) {
+        ctx->since_served_ms[p] = now - phase_last_serviced[p];
+        ctx->wave_bonus[p] = green_wave_phase_bonus(intr, p, now);
+    }
+    ctx->ring_cnt = ring_barrier_elapsed(now, ctx->ring_elapsed_ms);
+
+    // A switch costs the yellow plus the start-up lost time learned at this junction
+    ctx->switch_loss_ms = YELLOW_DURATION_MS + calibration_lost_time_ms(intr, ~0ULL);
+    ctx->arrival = arrival_estimator;
+}
+
+// Composite the rings move on to. Each ring keeps its own min and max green,
+// so this may run while the composite itself is still young.
+int ring_barrier_decision(Intersection *intr, const DecisionContext *ctx, DecisionReason *reason) {
+    int next = ring_barrier_next_phase(intr, ctx->current_phase, ctx->ring_elapsed_ms, ctx->blocked_conns,
+                                       ctx->called_lanes, MIN_GREEN_TIME, MAX_GREEN_TIME);
+    if (next != (int)ctx->current_phase) Serial.printf("Rings -> Phase %d\n", next);
+    *reason = REASON_RING_BARRIER;
+    return next;
+}
+
+int determine_next_phase(Intersection *intr, const DecisionContext *ctx, DecisionReason *reason, bool *exclusive_walk) {
     int best_phase_idx = -1;
-    unsigned long now = millis();
-    unsigned long current_duration = now - current_phase_start_time;
+    uint32_t current_phase = ctx->current_phase;
+    uint32_t current_duration = ctx->green_ms;
+    uint32_t max_green = ctx->max_green_ms;
+    *exclusive_walk = false;
+
+    // A young composite: only rings past their own min green may move on
+    if (current_duration <= MIN_GREEN_TIME) return ring_barrier_decision(intr, ctx, reason);
 
     Serial.println("\n--- Decision Time ---");
 
+    // PEDESTRIAN MAX WAIT
+    int crossing_phase = overdue_crossing_phase(intr, ctx, exclusive_walk);
+    if (crossing_phase != -1) {
+        Serial.printf(">> Pedestrian max wait reached. Serving via Phase %d.\n", crossing_phase);
+        *reason = REASON_PEDESTRIAN;
+        return crossing_phase;
+    }
+
+    // A platoon on its way is demand too, so it keeps the junction out of timer mode
     int32_t total_system_pressure = 0;
     for (uint32_t i = 0; i < intr->phase_cnt; i++) {
-        total_system_pressure += calculate_phase_pressure(intr, i);
+        total_system_pressure += context_pressure(intr, ctx, i) + ctx->wave_bonus[i];
     }
 
     // IDLE MODE
     if (total_system_pressure == 0) {
         Serial.println(">> No Traffic Detected. Using Timer Logic.");
-        uint32_t target_duration = intr->phases[current_phase_idx].duration_ms;
+        *reason = REASON_IDLE;
+        uint32_t target_duration = intr->phases[current_phase].duration_ms;
         if (target_duration == 0) target_duration = intr->default_phase_duration_ms;
 
-        if (current_duration >= target_duration) {
-            return (current_phase_idx + 1) % intr->phase_cnt;
-        } else {
-            return current_phase_idx;
+        if (current_duration < target_duration) return current_phase;
+
+        // The next phase in sequence that sends nobody into a blocked exit, else hold
+        uint64_t blocked = ctx->blocked_conns;
+        for (uint32_t n = 1; n <= intr->phase_cnt; n++) {
+            uint32_t p = (current_phase + n) % intr->phase_cnt;
+            if (!(intr->phases[p].active_connections_mask & blocked)) return p;
         }
+        return current_phase;
     } 
     
+    // RING AND BARRIER: every ring cycles through its own movements, so nothing starves
+    if (ring_barrier_active()) return ring_barrier_decision(intr, ctx, reason);
+
     // MAX PRESSURE MODE
     int starved_phase = -1;
-    unsigned long max_wait_time = 0;
+    uint32_t max_wait_time = 0;
     
     for (uint32_t i = 0; i < intr->phase_cnt; i++) {
-        if (i == current_phase_idx) continue;
+        if (i == current_phase) continue;
         
-        if (calculate_phase_pressure(intr, i) > 0) {
-            unsigned long wait_time = now - phase_last_serviced[i];
+        if (context_pressure(intr, ctx, i) > 0) {
+            uint32_t wait_time = ctx->since_served_ms[i];
             if (wait_time > STARVATION_THRESHOLD) {
                 if (wait_time > max_wait_time) {
                     max_wait_time = wait_time;
@@ -203,17 +660,77 @@ int determine_next_phase(Intersection *intr) {
         }
     }
 
-    if (starved_phase != -1) return starved_phase;
+    if (starved_phase != -1) {
+        *reason = REASON_STARVATION;
+        return starved_phase;
+    }
+
+    // GAP OUT: nothing left on this green, the most pressing other phase takes over
+    if (ctx->gapped_out) {
+        int gap_phase = -1;
+        int32_t gap_pressure = 0;
+        for (uint32_t i = 0; i < intr->phase_cnt; i++) {
+            if (i == current_phase) continue;
+            int32_t p = context_pressure(intr, ctx, i) + ctx->wave_bonus[i];
+            if (p > gap_pressure) {
+                gap_pressure = p;
+                gap_phase = i;
+            }
+        }
+        if (gap_phase != -1) {
+            Serial.printf(">> Gap out after %lu ms. Phase %d has pressure %d.\n", current_duration, gap_phase, gap_pressure);
+            *reason = REASON_GAP_OUT;
+            return gap_phase;
+        }
+    }
+
+    // LOOKAHEAD MODE
+    if (CONTROL_ALGORITHM == ALGO_LOOKAHEAD) {
+        bool max_out = current_duration >= max_green;
+        int next = lookahead_next_phase(intr, &ctx->arrival, current_phase, ctx->switch_loss_ms, max_out,
+                                        ctx->blocked_conns, &lookahead_stats);
+        Serial.printf("Lookahead -> Phase %d (%.1f veh*s, %lu nodes, %lu us, worst %lu us)\n", next,
+                      lookahead_stats.predicted_cost, (unsigned long)lookahead_stats.nodes,
+                      (unsigned long)lookahead_stats.compute_us, (unsigned long)lookahead_stats.max_compute_us);
+        *reason = REASON_LOOKAHEAD;
+        return next;
+    }
+
+    // LEARNED POLICY MODE (falls through to Max Pressure if no policy is loaded)
+    if (CONTROL_ALGORITHM == ALGO_LEARNED_POLICY && policy.loaded) {
+        int8_t x[POLICY_MAX_INPUTS];
+        unsigned long start = micros();
+        policy_build_input(&policy, intr, current_phase, current_duration, x);
+        int next = policy_infer(&policy, x, NULL);
+        uint32_t infer_us = micros() - start;
+        if (infer_us > policy_max_infer_us) policy_max_infer_us = infer_us;
+        Serial.printf("Policy -> Phase %d (%lu us, worst %lu us)\n", next, (unsigned long)infer_us, (unsigned long)policy_max_infer_us);
+
+        // Max-out still applies: if the policy wants to hold past the max green, Max Pressure picks the successor.
+        // So does spillback: the policy does not see blocked exits, Max Pressure does.
+        bool spilled = (intr->phases[next].active_connections_mask & ctx->blocked_conns) &&
+                       context_pressure(intr, ctx, next) == 0;
+        if (!(current_duration >= max_green && next == (int)current_phase) && !spilled) {
+            *reason = REASON_POLICY;
+            return next;
+        }
+    }
 
+    *reason = REASON_MAX_PRESSURE;
     int32_t max_pressure = -1;
+    int32_t current_pressure = 0;
     bool force_switch = false;
-    if (current_duration >= MAX_GREEN_TIME) force_switch = true;
+    if (current_duration >= max_green) force_switch = true;
     
     for (uint32_t i = 0; i < intr->phase_cnt; i++) {
-        if (force_switch && i == current_phase_idx) continue;
+        // Platoons announced by upstream peers count as if already queued
+        int32_t bonus = ctx->wave_bonus[i];
+        if (bonus != 0) *reason = REASON_GREEN_WAVE;
+        int32_t p = context_pressure(intr, ctx, i) + bonus;
+        if (i == current_phase) current_pressure = p;
+        if (force_switch && i == current_phase) continue;
         
-        int32_t p = calculate_phase_pressure(intr, i);
-        Serial.printf("Phase %d Pressure: %d\n", i, p);
+        Serial.printf("Phase %d Pressure: %d (green wave +%d)\n", i, p, bonus);
         
         if (p > max_pressure) {
             max_pressure = p;
@@ -221,31 +738,203 @@ int determine_next_phase(Intersection *intr) {
         }
     }
     
-    if (!force_switch && max_pressure == calculate_phase_pressure(intr, current_phase_idx)) {
-        return current_phase_idx;
+    if (!force_switch && max_pressure == current_pressure) {
+        return current_phase;
+    }
+
+    return (best_phase_idx == -1) ? current_phase : best_phase_idx;
+}
+
+// State changes go through here so the flight recorder sees every one
+void enter_state(ControllerState next) {
+    recorder_state((uint8_t)current_state, (uint8_t)next, (uint8_t)current_phase_idx, (uint8_t)next_pending_phase_idx);
+    current_state = next;
+}
+
+// --- PREEMPTION HELPERS ---
+
+void IRAM_ATTR preempt_isr() {
+    preempt_irq = true;
+}
+
+// Longest a call can wait for its green: an intergreen already running is
+// allowed to finish, then the approach gets its own.
+uint32_t preemption_latency_bound(Intersection *intr) {
+    uint32_t worst = YELLOW_DURATION_MS;
+    for (uint32_t e = 0; e < intr->connection_cnt; e++) {
+        for (uint32_t s = 0; s < intr->connection_cnt; s++) {
+            if (!((intr->conflict_masks[e] >> s) & 1)) continue;
+            uint32_t needed = intergreen_ms(intr, e, s, YELLOW_DURATION_MS);
+            if (needed > worst) worst = needed;
+        }
+    }
+    return 2 * worst;
+}
+
+// Edges are latched by the interrupt so a short pulse between passes still counts
+void poll_preemption(Intersection *intr) {
+    if (PREEMPT_PIN == -1) return;
+    bool called = preempt_irq || digitalRead(PREEMPT_PIN) == HIGH;
+    preempt_irq = false;
+    if (called) controller_request_preemption(find_lane_index_by_id(intr, PREEMPT_LANE_ID));
+}
+
+// Cuts whatever is running. WALKs end now and still get their clearance;
+// every movement in the way gets its intergreen from the clearance matrix.
+void start_preemption(Intersection *intr, unsigned long now) {
+    if (walk_lanes) {
+        cleared_walk_lanes |= walk_lanes;
+        walk_end_time = now;
+        walk_lanes = 0;
+        apply_walk_lights(intr);
     }
+    // An exclusive walk the cut transition was heading for waits its turn:
+    // its calls stay in ped_request_time and the next decision flags it again
+    exclusive_walk_pending = false;
+
+    Serial.printf(">>> PREEMPTION: Clearing for lane %lu\n", (unsigned long)intr->lanes[preempt_lane].id);
+    enter_state(STATE_PREEMPT_CLEARANCE);
+    begin_transition(intr, preempt_conns, now);
+}
 
-    return (best_phase_idx == -1) ? current_phase_idx : best_phase_idx;
+void note_preemption_green(unsigned long now) {
+    uint32_t latency = now - preempt_request_time;
+    preempt_green_time = now | 1;
+    if (latency > preempt_max_latency_ms) preempt_max_latency_ms = latency;
+
+    Serial.printf(">>> PREEMPTION GREEN after %lu ms (worst %lu ms, bound %lu ms)\n", (unsigned long)latency,
+                  (unsigned long)preempt_max_latency_ms, (unsigned long)preempt_latency_bound_ms);
+    if (latency > preempt_latency_bound_ms) Serial.println("!!! PREEMPTION LATENCY ABOVE BOUND !!!");
+}
+
+// Back to normal operation at the phase with the most queued traffic, longest unserved on a tie
+int preempt_reentry_phase(Intersection *intr, unsigned long now) {
+    int best_phase = 0;
+    int32_t best_pressure = -1;
+    unsigned long best_wait = 0;
+    for (uint32_t p = 0; p < intr->phase_cnt; p++) {
+        int32_t pressure = calculate_phase_pressure(intr, p);
+        unsigned long wait = now - phase_last_serviced[p];
+        if (pressure > best_pressure || (pressure == best_pressure && wait > best_wait)) {
+            best_pressure = pressure;
+            best_wait = wait;
+            best_phase = p;
+        }
+    }
+    return best_phase;
+}
+
+void end_preemption(Intersection *intr, unsigned long now) {
+    if (now - preempt_green_time >= PREEMPT_MAX_HOLD_MS) {
+        Serial.printf("!!! PREEMPTION: lane %lu held too long, ignoring it for a while\n",
+                      (unsigned long)intr->lanes[preempt_lane].id);
+        preempt_locked_lane = preempt_lane;
+        preempt_locked_since = now;
+    }
+
+    int next = preempt_reentry_phase(intr, now);
+    Serial.printf(">>> PREEMPTION OVER. Re-entering at Phase %d.\n", next);
+    preempt_lane = -1;
+    next_pending_phase_idx = next;
+    enter_state(STATE_YELLOW_TRANSITION);
+    begin_transition(intr, intr->phases[next].active_connections_mask, now);
+    phase_change_counter++;
 }
 
 // --- PUBLIC API ---
 
+void controller_request_preemption(uint32_t lane_idx) {
+    if (lane_idx >= intr.lane_cnt || intr.lanes[lane_idx].type != LANE_IN) return;
+
+    unsigned long now = millis();
+    if (preempt_lane == (int)lane_idx) {
+        preempt_last_call = now;
+        return;
+    }
+    if (preempt_lane != -1) return; // One emergency at a time; the other keeps calling
+    if (preempt_locked_lane == (int)lane_idx && now - preempt_locked_since < PREEMPT_MAX_HOLD_MS) return;
+
+    uint64_t conns = 0;
+    for (uint32_t c = 0; c < intr.connection_cnt; c++) {
+        if (intr.connections[c].source_lane_idx == lane_idx) conns |= (1ULL << c);
+    }
+    if (conns == 0) return;
+
+    preempt_lane = lane_idx;
+    preempt_conns = conns;
+    preempt_request_time = now;
+    preempt_last_call = now;
+    preempt_green_time = 0;
+    Serial.printf(">>> PREEMPTION REQUEST: lane %lu\n", (unsigned long)intr.lanes[lane_idx].id);
+}
+
+void controller_request_crossing(uint32_t lane_idx) {
+    if (lane_idx >= intr.lane_cnt || intr.lanes[lane_idx].type != LANE_CROSSWALK) return;
+    request_crossing(lane_idx, millis());
+}
+
 void controller_setup() {
     Serial.println("--- Initializing Hardware from Config ---");
     initialize_hardware(&intr);
 
     unsigned long now = millis();
     current_phase_start_time = now;
-    last_pedestrian_time = now; // Initialize cooldown
-    for (int i = 0; i < 4; i++) phase_last_serviced[i] = now;
+    memset(ped_request_time, 0, sizeof(ped_request_time));
+    walk_lanes = 0;
+    cleared_walk_lanes = 0;
+    ended_conns = 0;
+    exclusive_walk_pending = false;
+    for (int i = 0; i < MAX_PHASE_CNT; i++) phase_last_serviced[i] = now;
+
+    arrival_estimator_reset(&arrival_estimator);
+    last_estimator_time = now;
+
+    recorder_setup(&intr, CONTROL_ALGORITHM);
+    sensor_health_setup(&intr);
+    calibration_setup(&intr);
+    actuation_setup(&intr, ACTUATED_DETECTORS, now);
+    spillback_setup(&intr, EXIT_DETECTORS, now);
+    attach_queue_sources(&intr);
+    last_queue_estimate_time = now;
+
+    preempt_lane = -1;
+    preempt_locked_lane = -1;
+    preempt_irq = false;
+    preempt_latency_bound_ms = preemption_latency_bound(&intr);
+    if (PREEMPT_PIN != -1) {
+        pinMode(PREEMPT_PIN, INPUT);
+        attachInterrupt(digitalPinToInterrupt(PREEMPT_PIN), preempt_isr, RISING);
+    }
+    Serial.printf("[PREEMPT] Worst-case request-to-green: %lu ms\n", (unsigned long)preempt_latency_bound_ms);
 
     current_state = STATE_GREEN_RUNNING;
     apply_phase_lights_green(&intr, current_phase_idx);
+    apply_walk_lights(&intr);
+    light_output_commit();
+
+    safety_monitor_setup(&intr);
+    green_wave_phase_started(&intr, current_phase_idx, now);
+    ring_barrier_phase_started(current_phase_idx, now);
 }
 
 void controller_loop() {
     if (intr.lane_cnt == 0) return;
 
+    safety_monitor_heartbeat();
+
+    if (safety_monitor_tripped()) {
+        if (!safety_fault_reported) {
+            Serial.printf("!!! SAFETY FAULT %d: ALL RED LATCHED (monitor WCET %lu us) !!!\n",
+                          safety_monitor_fault(), (unsigned long)safety_monitor_wcet_us());
+            safety_fault_reported = true;
+
+            // Keep the lead-up to the fault across the reboot
+            recorder_fault(FAULT_SOURCE_SAFETY, (uint8_t)safety_monitor_fault(), 0);
+            recorder_flush();
+        }
+        return;
+    }
+
     unsigned long now = millis();
 
     // --- 1. SIMULATION ---
@@ -256,26 +945,95 @@ void controller_loop() {
         }
     }
 
-    // --- 2. STATE MACHINE ---
+    poll_pedestrian_buttons(&intr, now);
+    sensor_health_update(&intr, now);
+    green_wave_update(&intr, current_phase_idx, now);
+    actuation_update(&intr, lit_green_lanes, now);
+    calibration_update(&intr, lit_green_lanes, now);
+    spillback_update(&intr, now);
+
+    // Stop-line detectors: crossings on green are departures, presence on red means a queue is standing
+    for (uint32_t i = 0; i < intr.lane_cnt; i++) {
+        if (SIMULATION_MODE || !actuation_has_detector(i)) continue;
+        queue_estimator_occupancy(&queue_estimator, i, actuation_occupied(i));
+        if (!((lit_green_lanes >> i) & 1)) continue;
+        uint16_t pulses = actuation_new_pulses(i);
+        queue_estimator_count(&queue_estimator, i, 0, pulses);
+        for (uint16_t k = 0; k < pulses; k++) {
+            calibration_departure(&intr, i, CALIBRATION_ANY_CONNECTION, moving_connections(&intr), intr.lane_traffic[i], now);
+        }
+    }
+
+    // Preemption is checked every pass, not at decision time, and ignores MIN_GREEN_TIME
+    poll_preemption(&intr);
+    if (preempt_lane != -1) {
+        if (current_state == STATE_GREEN_RUNNING || current_state == STATE_PEDESTRIAN_RED) {
+            start_preemption(&intr, now);
+        } else if (current_state == STATE_YELLOW_TRANSITION) {
+            waiting_lanes &= (1ULL << preempt_lane); // Let the running intergreen finish, but start nothing new
+        }
+    }
+
+    // --- 2. DEMAND ESTIMATION ---
+    if (now - last_queue_estimate_time >= QUEUE_ESTIMATOR_PERIOD_MS) {
+        update_queue_estimates(&intr, now);
+    }
+    if (now - last_estimator_time >= DECISION_TIME_INTERVAL) {
+        uint64_t serving_lanes = lit_green_lanes | yellow_lanes; // Green or still discharging on yellow
+        recorder_queues(&intr, serving_lanes);
+        arrival_estimator_update(&arrival_estimator, &intr, serving_lanes, now - last_estimator_time);
+        last_estimator_time = now;
+    }
+
+    // --- 3. STATE MACHINE ---
     switch (current_state) {
         
         // A: GREEN LIGHTS
-        case STATE_GREEN_RUNNING:
-            if (now - last_decision_time > DECISION_TIME_INTERVAL) {
-                unsigned long current_duration = now - current_phase_start_time;
+        case STATE_GREEN_RUNNING: {
+            grant_compatible_walks(&intr, now);
+            end_expired_walks(&intr, now);
+            update_spillback_holds(&intr, now);
+
+            // Gap-out, max-out and an exit of this green spilling back are checked on every pass
+            // and decide straight away, once per event
+            unsigned long current_duration = now - current_phase_start_time;
+            bool gapped_out = current_duration > MIN_GREEN_TIME && actuation_gapped_out(&intr, current_phase_idx, now);
+            bool maxed_out = current_duration >= current_max_green();
+            bool spilled = current_duration > MIN_GREEN_TIME &&
+                           (intr.phases[current_phase_idx].active_connections_mask & spillback_blocked_connections());
+            if (!gapped_out) gap_out_decided = false;
+            if (!spilled) spillback_decided = false;
+            bool actuated = (gapped_out && !gap_out_decided) || (maxed_out && !max_out_decided) ||
+                            (spilled && !spillback_decided);
+
+            if (now - last_decision_time > DECISION_TIME_INTERVAL || (actuated && walk_lanes == 0)) {
+                if (DEBUG) Serial.printf("[SAFETY] Monitor WCET: %lu us\n", (unsigned long)safety_monitor_wcet_us());
+                if (DEBUG) Serial.printf("[QUEUE] Estimator WCET: %lu us over %d lanes\n", (unsigned long)queue_estimator.max_step_us, intr.lane_cnt);
 
-                if (current_duration > MIN_GREEN_TIME) {
-                    int desired_phase = determine_next_phase(&intr);
+                // Never cut a green while pedestrians are walking alongside it. Under the
+                // ring model a young composite may still let its older rings move on.
+                bool min_green_met = current_duration > MIN_GREEN_TIME;
+                if ((min_green_met || ring_barrier_active()) && walk_lanes == 0) {
+                    DecisionReason reason;
+                    bool exclusive_walk;
+                    gather_decision_context(&intr, &decision_ctx, now, gapped_out);
+                    int desired_phase = determine_next_phase(&intr, &decision_ctx, &reason, &exclusive_walk);
+                    if (exclusive_walk) exclusive_walk_pending = true;
+                    gap_out_decided = gapped_out;
+                    max_out_decided = maxed_out;
+                    spillback_decided = spilled;
+                    recorder_decision(&intr, &decision_ctx, desired_phase, reason, exclusive_walk);
                     
-                    if (desired_phase != current_phase_idx) {
+                    if (desired_phase != current_phase_idx || exclusive_walk_pending) {
                         Serial.printf(">>> SWITCHING: Phase %d -> Phase %d\n", current_phase_idx, desired_phase);
                         
                         next_pending_phase_idx = desired_phase;
-                        current_state = STATE_YELLOW_TRANSITION;
-                        transition_start_time = now;
-                        
-                        // Apply Yellow
-                        apply_transition_yellow(&intr, current_phase_idx); 
+                        enter_state(STATE_YELLOW_TRANSITION);
+
+                        // An exclusive walk clears toward the waiting crossings, everything else toward the next phase
+                        uint64_t starting = exclusive_walk_pending ? requested_crossing_connections(&intr)
+                                                                   : intr.phases[desired_phase].active_connections_mask;
+                        begin_transition(&intr, starting, now);
                         phase_change_counter++;
                     } 
                     else {
@@ -285,30 +1043,45 @@ void controller_loop() {
                 last_decision_time = now;
             }
             break;
+        }
 
         // B: YELLOW TRANSITION
         case STATE_YELLOW_TRANSITION:
-            if (now - transition_start_time > YELLOW_DURATION_MS) {
+            if (update_transition(&intr, now)) {
                 
+                if (preempt_lane != -1) {
+                    start_preemption(&intr, now);
+                }
                 // PEDESTRIAN CHECK LOGIC
-                // 1. Is it changing phases? (Yes, we are in Yellow transition)
-                // 2. Has enough time passed since the last pedestrian cycle?
-                bool time_for_pedestrians = (now - last_pedestrian_time >= PEDESTRIAN_COOLDOWN_MS);
-
-                if (time_for_pedestrians) {
+                // Only when an overdue crossing conflicts with every vehicle phase
+                else if (exclusive_walk_pending) {
                     Serial.println(">>> PEDESTRIAN MODE TRIGGERED (ALL RED)");
-                    current_state = STATE_PEDESTRIAN_RED;
+                    enter_state(STATE_PEDESTRIAN_RED);
                     transition_start_time = now;
-                    last_pedestrian_time = now; // Reset timer
+                    exclusive_walk_pending = false;
                     apply_all_red(&intr);
+
+                    // Everyone waiting crosses now, once the last vehicles have cleared them
+                    for (uint32_t i = 0; i < intr.lane_cnt; i++) {
+                        if (ped_request_time[i] != 0 && crossing_cleared(&intr, i, now)) {
+                            walk_lanes |= (1ULL << i);
+                            ped_request_time[i] = 0;
+                        }
+                    }
+                    walk_start_time = now;
+                    apply_walk_lights(&intr);
                 } 
                 else {
-                    // Normal Cycle
-                    current_state = STATE_GREEN_RUNNING;
+                    // Normal Cycle: every lane of the new phase is already green
                     current_phase_idx = next_pending_phase_idx;
+                    enter_state(STATE_GREEN_RUNNING);
                     current_phase_start_time = now;
                     phase_last_serviced[current_phase_idx] = now;
-                    apply_phase_lights_green(&intr, current_phase_idx);
+                    gap_out_decided = false;
+                    max_out_decided = false;
+                    spillback_decided = false;
+                    green_wave_phase_started(&intr, current_phase_idx, now);
+                    ring_barrier_phase_started(current_phase_idx, now);
                 }
             }
             break;
@@ -317,16 +1090,39 @@ void controller_loop() {
         case STATE_PEDESTRIAN_RED:
             if (now - transition_start_time > PEDESTRIAN_DURATION_MS) {
                 
-                // --- NEW PRINT STATEMENT ---
                 Serial.printf(">>> PEDESTRIAN DONE. Resuming Phase %d.\n", next_pending_phase_idx);
+                cleared_walk_lanes |= walk_lanes;
+                walk_end_time = now;
+                walk_lanes = 0;
+                apply_walk_lights(&intr);
                 
-                // Resume the phase we were supposed to go to
-                current_state = STATE_GREEN_RUNNING;
-                current_phase_idx = next_pending_phase_idx;
-                current_phase_start_time = now;
-                phase_last_serviced[current_phase_idx] = now;
-                apply_phase_lights_green(&intr, current_phase_idx);
+                // Resume the phase we were supposed to go to, once the crossings have cleared
+                enter_state(STATE_YELLOW_TRANSITION);
+                begin_transition(&intr, intr.phases[next_pending_phase_idx].active_connections_mask, now);
             }
             break;
+
+        // D: EMERGENCY PREEMPTION
+        case STATE_PREEMPT_CLEARANCE: {
+            bool cleared = update_transition(&intr, now);
+            if (preempt_green_time == 0 && ((lit_green_lanes >> preempt_lane) & 1)) note_preemption_green(now);
+            if (cleared) enter_state(STATE_PREEMPT_HOLD);
+            break;
+        }
+
+        case STATE_PREEMPT_HOLD:
+            if (now - preempt_last_call >= PREEMPT_HOLD_MS || now - preempt_green_time >= PREEMPT_MAX_HOLD_MS) {
+                end_preemption(&intr, now);
+            }
+            break;
+    }
+
+    // Whatever changed this pass reaches the lamps as one frame
+    uint32_t commits = light_output_commit_count();
+    light_output_commit();
+    if (light_output_commit_count() != commits) {
+        LightFrame frame;
+        light_output_read(&frame);
+        recorder_output(&frame);
     }
 }
\ No newline at end of file
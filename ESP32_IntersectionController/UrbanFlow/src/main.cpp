@@ -1,10 +1,17 @@
 #include <Arduino.h>
 #include <WiFi.h>
-#include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include "TrafficController.h"
+#include "SensorHealth.h"
+#include "FlightRecorder.h"
+#include "ServerLink.h"
+#include "GreenWave.h"
+#include "Actuation.h"
+#include "RingBarrier.h"
+#include "Spillback.h"
+#include "SensorBus.h"
 #include "WIFI_CREDENTIALS.h"
-#include "DEFAULT_JSON_CONFIG.h"
+#include "DEFAULT_STATIC_CONFIG.h"
 #include "CONFIG.h"
 
 #ifndef SIMULATION_MODE
@@ -34,9 +41,18 @@
 #define RXD2 16
 #define TXD2 17
 #endif
+#define SENSOR_BUS_DE_PIN 4 // RS-485 driver enable (DE and /RE tied), with SENSOR_BUS
 
 char rxBuffer[256];
 
+SensorBus sensor_bus;
+uint8_t sensor_bus_frame[SENSOR_BUS_MAX_FRAME];
+
+const int CONFIG_FETCH_ATTEMPTS = 4;
+
+// Arena backing for the cloud config (the static plan brings its own)
+uint8_t *intersection_storage = NULL;
+
 void send_intersection_status(const char *currentStatus)
 {
     if (WiFi.status() != WL_CONNECTED)
@@ -45,35 +61,41 @@ void send_intersection_status(const char *currentStatus)
         return;
     }
 
-    WiFiClientSecure client;
-    client.setInsecure(); // Needed for using https on localhost
-
-    HTTPClient http;
-    String fullUrl = String(sendStatusUrl) + String(currentStatus);
+    // Spillback since boot: blocking events, inbound lane holds, and the exits
+    // blocked and lanes held right now as lane-slot masks (config order)
+    const SpillbackStats *spill = spillback_stats();
+    char spillback[128];
+    snprintf(spillback, sizeof(spillback), "&spillback_events=%lu&spillback_holds=%lu&blocked_exits=%llx&held_lanes=%llx",
+             (unsigned long)spill->events, (unsigned long)spill->holds,
+             (unsigned long long)spill->blocked_lanes, (unsigned long long)spill->held_lanes);
+    String fullUrl = String(sendStatusUrl) + "&status=" + String(currentStatus) + spillback;
 
     Serial.print("Posting status to: ");
     Serial.println(fullUrl);
 
-    http.begin(client, fullUrl);
-    int httpResponseCode = http.POST("");
+    String response;
+    int httpResponseCode = server_link_post(fullUrl, String(""), &response);
 
     if (httpResponseCode > 0)
     {
-        String response = http.getString();
-        Serial.printf("Status Update Success (Code %d): %s\n", httpResponseCode, response.c_str());
+        Serial.printf("Status Update Success (Code %d, %lu ms): %s\n", httpResponseCode,
+                      (unsigned long)server_link_stats()->last_latency_ms, response.c_str());
     }
     else
     {
-        Serial.printf("Status Update Failed. Error: %s\n", http.errorToString(httpResponseCode).c_str());
+        Serial.printf("Status Update Failed. Error: %d\n", httpResponseCode);
     }
-    http.end();
 }
+void apply_sensor_frame(Intersection *intr, uint64_t reported_lanes);
+
 void parse_traffic_data(Intersection *intr, const char *data)
 {
     // Format: "1,123 2,234 3,423"
     // ID,Value Space ID,Value
+    // An exit lane's value is how full it is (Spillback.h)
 
     const char *p = data;
+    uint64_t reported_lanes = 0;
 
     while (*p)
     {
@@ -103,6 +125,7 @@ void parse_traffic_data(Intersection *intr, const char *data)
             if (intr->lanes[i].id == incomingID)
             {
                 received_sensor_value[i] = val;
+                reported_lanes |= (1ULL << i);
 
                 break;
             }
@@ -112,8 +135,233 @@ void parse_traffic_data(Intersection *intr, const char *data)
         while (*p && *p != ' ')
             p++;
     }
+
+    apply_sensor_frame(intr, reported_lanes);
+}
+
+// Readings already in received_sensor_value, from either sensor link
+void apply_sensor_frame(Intersection *intr, uint64_t reported_lanes)
+{
+    recorder_sensor_frame(received_sensor_value, reported_lanes, intr->lane_cnt);
+    sensor_health_on_frame(intr, received_sensor_value, reported_lanes, millis());
+
+    for (uint32_t i = 0; i < intr->lane_cnt; i++)
+    {
+        if (((reported_lanes >> i) & 1) && intr->lanes[i].type == LANE_OUT)
+            spillback_reading(i, received_sensor_value[i], millis());
+    }
 }
+// Parse the optional learned policy block. Needs the graph built first.
+bool parsePolicy(JsonObject p)
+{
+    policy_reset(&policy);
+
+    JsonArray w1 = p["w1"];
+    JsonArray b1 = p["b1"];
+    JsonArray w2 = p["w2"];
+    JsonArray b2 = p["b2"];
+
+    // Sizes checked before they go into the uint8_t counts, which would wrap
+    size_t input_cnt = w1.size() > 0 ? w1[0].size() : 0;
+    if (w1.size() > POLICY_MAX_HIDDEN || input_cnt > POLICY_MAX_INPUTS || w2.size() > MAX_PHASE_CNT ||
+        b1.size() != w1.size() || b2.size() != w2.size())
+    {
+        return false;
+    }
+
+    policy.hidden_cnt = w1.size();
+    policy.output_cnt = w2.size();
+    policy.input_cnt = input_cnt;
+    policy.queue_shift = p["queue_shift"] | 0;
+    policy.hidden_mult = p["hidden_mult"] | 1;
+    policy.hidden_shift = p["hidden_shift"] | 8;
+
+    for (uint32_t j = 0; j < policy.hidden_cnt; j++)
+    {
+        JsonArray row = w1[j];
+        if (row.size() != policy.input_cnt)
+            return false;
+        for (uint32_t i = 0; i < policy.input_cnt; i++)
+            policy.w1[j][i] = row[i].as<int8_t>();
+        policy.b1[j] = b1[j].as<int32_t>();
+    }
+
+    for (uint32_t k = 0; k < policy.output_cnt; k++)
+    {
+        JsonArray row = w2[k];
+        if (row.size() != policy.hidden_cnt)
+            return false;
+        for (uint32_t j = 0; j < policy.hidden_cnt; j++)
+            policy.w2[k][j] = row[j].as<int8_t>();
+        policy.b2[k] = b2[k].as<int32_t>();
+    }
+
+    return policy_validate(&policy, &intr);
+}
+
 // Parse JSON Config
+// [[x, y], ...] in metres into xy. Returns the point count, 0 if absent or malformed.
+uint32_t parsePathPoints(JsonArray points, float *xy)
+{
+    if (points.isNull() || points.size() < 2 || points.size() > PATH_MAX_POINTS)
+        return 0;
+
+    for (uint32_t i = 0; i < points.size(); i++)
+    {
+        JsonArray point = points[i];
+        if (point.size() != 2)
+            return 0;
+        xy[2 * i] = point[0].as<float>();
+        xy[2 * i + 1] = point[1].as<float>();
+    }
+    return points.size();
+}
+
+// Optional drawn geometry. A connection takes its own "path" or "arc"; without
+// one, the straight line from where its source lane's "path" ends to where the
+// target lane's begins. Pedestrian movements use the crosswalk's own path.
+void parsePathGeometry(JsonArray lanes, JsonArray connections)
+{
+    float xy[2 * PATH_MAX_POINTS];
+    float tgt[2 * PATH_MAX_POINTS];
+    uint32_t drawn = 0;
+
+    for (uint32_t c = 0; c < intr.connection_cnt; c++)
+    {
+        const Connection *conn = &intr.connections[c];
+        JsonObject cfg = c < connections.size() ? connections[c] : JsonObject();
+        JsonObject arc = cfg["arc"];
+        uint32_t n = parsePathPoints(cfg["path"], xy);
+        bool ok = false;
+
+        if (n > 0)
+        {
+            ok = set_connection_path(&intr, c, xy, n);
+        }
+        else if (!arc.isNull())
+        {
+            ok = set_connection_arc(&intr, c, arc["cx"] | 0.0f, arc["cy"] | 0.0f, arc["r"] | 0.0f, arc["from"] | 0.0f,
+                                    arc["to"] | 0.0f);
+        }
+        else
+        {
+            uint32_t ns = parsePathPoints(lanes[conn->source_lane_idx]["path"], xy);
+            if (conn->source_lane_idx == conn->target_lane_idx)
+            {
+                ok = ns > 0 && set_connection_path(&intr, c, xy, ns);
+            }
+            else if (ns > 0 && parsePathPoints(lanes[conn->target_lane_idx]["path"], tgt) > 0)
+            {
+                float line[4] = {xy[2 * (ns - 1)], xy[2 * (ns - 1) + 1], tgt[0], tgt[1]};
+                ok = set_connection_path(&intr, c, line, 2);
+            }
+        }
+
+        if (ok)
+            drawn++;
+    }
+
+    if (drawn > 0)
+        Serial.printf("[GEO] %lu of %d movements drawn, %.1f m clearance\n", (unsigned long)drawn, intr.connection_cnt,
+                      intr.path_clearance_m);
+}
+
+// Optional "green_wave" block: neighbouring controllers and which of their
+// outbound lanes feed our inbound lanes. Needs the graph built first.
+uint16_t green_wave_port = 0;
+uint32_t green_wave_node_id = 0;
+
+void parseGreenWave(JsonObject gw)
+{
+    green_wave_reset();
+    green_wave_port = gw["port"] | GREEN_WAVE_PORT;
+    green_wave_node_id = gw["node_id"] | 0;
+
+    for (JsonObject p : gw["peers"].as<JsonArray>())
+    {
+        int peer = green_wave_add_peer(p["host"], p["port"] | GREEN_WAVE_PORT);
+        if (peer < 0)
+        {
+            Serial.printf("WARNING: Green wave peer %s skipped.\n", p["host"] | "?");
+            continue;
+        }
+
+        for (JsonObject link : p["links"].as<JsonArray>())
+        {
+            uint32_t lane_idx = find_lane_index_by_id(&intr, link["lane_id"]);
+            if (lane_idx >= intr.lane_cnt || intr.lanes[lane_idx].type != LANE_IN ||
+                !green_wave_add_link(lane_idx, peer, link["peer_lane_id"], link["travel_ms"]))
+            {
+                Serial.printf("WARNING: Green wave link to lane %d skipped.\n", link["lane_id"].as<int>());
+            }
+        }
+    }
+}
+
+// Optional "sensor_bus": which lane each acquisition node's channels read
+// (SensorBus.h). Lane ids not in the graph leave their channel unused.
+void parseSensorBus(JsonObject sb)
+{
+    for (JsonObject node : sb["nodes"].as<JsonArray>())
+    {
+        uint8_t lanes[SENSOR_BUS_MAX_CHANNELS];
+        uint32_t cnt = 0;
+        for (JsonVariant id : node["lanes"].as<JsonArray>())
+        {
+            if (cnt == SENSOR_BUS_MAX_CHANNELS)
+                break;
+            uint32_t lane_idx = find_lane_index_by_id(&intr, id.as<uint32_t>());
+            lanes[cnt++] = lane_idx < intr.lane_cnt ? lane_idx : SENSOR_BUS_NO_LANE;
+        }
+
+        if (sensor_bus_add_node(&sensor_bus, node["address"] | 0, lanes, cnt) < 0)
+            Serial.printf("WARNING: Sensor bus node %d skipped.\n", node["address"] | 0);
+    }
+}
+
+// Optional "ring_barrier": true builds the rings from the conflict matrix, an
+// object lays them out (RingBarrier.h). Needs the conflicts computed first.
+bool parseRingBarrier(JsonVariant rb)
+{
+    if (rb.is<bool>())
+        return rb.as<bool>() && ring_barrier_build_auto(&intr);
+
+    JsonArray barriers = rb["barriers"];
+    for (uint32_t b = 0; b < barriers.size(); b++)
+    {
+        JsonArray rings = barriers[b];
+        for (uint32_t r = 0; r < rings.size(); r++)
+        {
+            for (JsonVariant mv : rings[r].as<JsonArray>())
+            {
+                uint32_t idx[MAX_LANE_CNT];
+                uint32_t cnt = 0;
+                JsonArray ids = mv["lanes"];
+                if (ids.isNull())
+                {
+                    idx[cnt++] = find_lane_index_by_id(&intr, mv.as<uint32_t>());
+                }
+                else
+                {
+                    for (JsonVariant id : ids)
+                    {
+                        if (cnt < MAX_LANE_CNT)
+                            idx[cnt++] = find_lane_index_by_id(&intr, id.as<uint32_t>());
+                    }
+                }
+
+                if (ring_barrier_add_movement(&intr, idx, cnt, r, b, mv["max_green_ms"] | 0) < 0)
+                {
+                    Serial.printf("WARNING: Ring movement in barrier group %lu, ring %lu is invalid.\n", (unsigned long)b,
+                                  (unsigned long)r);
+                    return false;
+                }
+            }
+        }
+    }
+    return ring_barrier_movement_cnt() > 0;
+}
+
 bool parseConfig(String jsonPayload)
 {
     DynamicJsonDocument doc(16384);
@@ -134,9 +382,37 @@ bool parseConfig(String jsonPayload)
         return false;
     }
 
-    intersection_init(&intr, doc["default_phase_duration_ms"]);
-
     JsonArray lanes = doc["lanes"];
+    JsonArray connections = doc["connections"];
+    JsonArray phases = doc["phases"];
+
+    // Each crosswalk may need a pedestrian connection on top of the configured ones
+    uint32_t crosswalk_cnt = 0;
+    for (JsonObject l : lanes)
+    {
+        if (l["type"].as<int>() == LANE_CROSSWALK)
+            crosswalk_cnt++;
+    }
+    uint32_t connection_cap = connections.size() + crosswalk_cnt;
+
+    // The ring model generates its own phases, one per ring combination
+    bool ring_barrier = doc.containsKey("ring_barrier");
+    uint32_t phase_cap = ring_barrier && phases.size() < MAX_PHASE_CNT ? MAX_PHASE_CNT : phases.size();
+
+    // One allocation, sized exactly to this junction
+    size_t storage_bytes = intersection_storage_bytes(lanes.size(), connection_cap, phase_cap);
+    free(intersection_storage);
+    intersection_storage = (uint8_t *)malloc(storage_bytes);
+
+    IntersectionArena arena;
+    arena_init(&arena, intersection_storage, storage_bytes);
+    if (!intersection_init(&intr, doc["default_phase_duration_ms"], &arena, lanes.size(), connection_cap, phase_cap))
+    {
+        Serial.printf("Error: Config too large or out of memory (%u bytes).\n", (unsigned)storage_bytes);
+        return false;
+    }
+
+    spillback_reset();
     for (JsonObject l : lanes)
     {
         LaneHardware hw;
@@ -146,33 +422,69 @@ bool parseConfig(String jsonPayload)
         hw.yellow_pin = l_hw["yellow_pin"];
         hw.red_pin = l_hw["green_pin"];
         uint16_t bearing = l.containsKey("bearing") ? l["bearing"] : 0;
-        add_lane(&intr, l["id"], (LaneType)l["type"].as<int>(), hw, bearing);
+        uint32_t idx = add_lane(&intr, l["id"], (LaneType)l["type"].as<int>(), hw, bearing);
+        if (idx != INTGRAPH_INVALID_INDEX && l["type"].as<int>() == LANE_OUT)
+            spillback_set_storage(idx, l["storage"] | 0);
     }
 
-    JsonArray connections = doc["connections"];
     for (JsonObject c : connections)
     {
         add_connection(&intr, c["source_lane_idx"], c["target_lane_idx"]);
     }
+    add_crosswalk_connections(&intr);
+
+    intr.path_clearance_m = doc["path_clearance_m"] | PATH_CLEARANCE_M;
+    parsePathGeometry(lanes, connections);
 
     compute_conflicts_on_device(&intr);
+    compute_clearances_on_device(&intr);
 
-    JsonArray phases = doc["phases"];
     int phaseCount = 0;
-    for (JsonObject p : phases)
+    actuation_reset();
+    ring_barrier_reset();
+    if (ring_barrier && !(parseRingBarrier(doc["ring_barrier"]) && ring_barrier_load_phases(&intr)))
     {
-        uint64_t mask = p["active_connections_mask"].as<uint64_t>();
-        if (!is_phase_safe(&intr, mask))
+        Serial.println("WARNING: Ring/barrier layout rejected. Using the configured phases.");
+        ring_barrier_reset();
+    }
+
+    // Configured phases, unless the rings brought their own
+    if (!ring_barrier_active())
+    {
+        for (JsonObject p : phases)
         {
-            //Serial.printf("FATAL: Cloud requested UNSAFE Phase #%d (Mask: %llu). Ignoring for now.\n", phaseCount, mask);
-            // return false;
+            uint64_t mask = p["active_connections_mask"].as<uint64_t>();
+            if (!is_phase_safe(&intr, mask))
+            {
+                // Refused outright: the safety monitor would force all-red the first time it is driven
+                Serial.printf("ERROR: Cloud requested UNSAFE Phase #%d (Mask: %llu).\n", phaseCount, mask);
+                return false;
+            }
+            add_phase(&intr, mask, p["duration_ms"]);
+            actuation_set_phase_limits(phaseCount, p["gap_ms"] | 0, p["max_green_ms"] | 0);
+            phaseCount++;
         }
-        add_phase(&intr, mask, p["duration_ms"]);
-        phaseCount++;
     }
 
     Serial.printf("Graph Built: %d Lanes, %d Conn, %d Phases\n", intr.lane_cnt, intr.connection_cnt, intr.phase_cnt);
 
+    policy_reset(&policy);
+    if (doc.containsKey("policy"))
+    {
+        if (parsePolicy(doc["policy"]))
+            Serial.printf("Learned Policy Loaded: %d inputs, %d hidden\n", policy.input_cnt, policy.hidden_cnt);
+        else
+            Serial.println("WARNING: Policy block does not match this intersection. Using Max Pressure.");
+    }
+
+    green_wave_reset();
+    if (doc.containsKey("green_wave"))
+        parseGreenWave(doc["green_wave"]);
+
+    sensor_bus_init(&sensor_bus, SENSOR_BUS_BAUD);
+    if (doc.containsKey("sensor_bus"))
+        parseSensorBus(doc["sensor_bus"]);
+
     if (intr.phase_cnt == 0)
     {
         Serial.println("Error: No valid safe phases found.");
@@ -181,15 +493,83 @@ bool parseConfig(String jsonPayload)
     return true;
 }
 
+// Without a "sensor_bus" block, node 1 reads the inbound lanes in config order
+void sensor_bus_start()
+{
+    if (sensor_bus.node_cnt == 0)
+    {
+        uint8_t lanes[SENSOR_BUS_MAX_CHANNELS];
+        uint32_t cnt = 0;
+        for (uint32_t i = 0; i < intr.lane_cnt && cnt < SENSOR_BUS_MAX_CHANNELS; i++)
+        {
+            if (intr.lanes[i].type == LANE_IN)
+                lanes[cnt++] = i;
+        }
+        sensor_bus_init(&sensor_bus, SENSOR_BUS_BAUD);
+        sensor_bus_add_node(&sensor_bus, 1, lanes, cnt);
+    }
+
+    pinMode(SENSOR_BUS_DE_PIN, OUTPUT);
+    digitalWrite(SENSOR_BUS_DE_PIN, LOW);
+    Serial.printf("[BUS] %lu nodes, readings at most %lu ms old\n", (unsigned long)sensor_bus.node_cnt,
+                  (unsigned long)(sensor_bus_latency_bound_us(&sensor_bus) / 1000));
+}
+
+// Polls go out with the driver enabled and the line is released as soon as
+// the last bit has left, before the node's turnaround ends.
+void sensor_bus_service()
+{
+    uint8_t rx[64];
+    int avail;
+    while ((avail = Serial2.available()) > 0)
+    {
+        int n = Serial2.readBytes(rx, avail < (int)sizeof(rx) ? avail : sizeof(rx));
+        sensor_bus_receive(&sensor_bus, rx, n, micros());
+    }
+
+    uint32_t len = sensor_bus_poll(&sensor_bus, micros(), sensor_bus_frame);
+    if (len)
+    {
+        digitalWrite(SENSOR_BUS_DE_PIN, HIGH);
+        Serial2.write(sensor_bus_frame, len);
+        Serial2.flush();
+        digitalWrite(SENSOR_BUS_DE_PIN, LOW);
+    }
+
+    // Emergency calls go through at once, not with the cycle's frame
+    uint64_t called = sensor_bus_take_preemption(&sensor_bus);
+    for (uint32_t i = 0; called && i < intr.lane_cnt; i++)
+    {
+        if ((called >> i) & 1)
+            controller_request_preemption(i);
+    }
+
+    uint64_t reported_lanes;
+    if (sensor_bus_take_frame(&sensor_bus, received_sensor_value, &reported_lanes))
+        apply_sensor_frame(&intr, reported_lanes);
+}
+
 void setup()
 {
     Serial.begin(115200);
     delay(2000);
-    Serial2.begin(9600, SERIAL_8N1, RXD2, TXD2);
+    Serial2.begin(SENSOR_BUS ? SENSOR_BUS_BAUD : 9600, SERIAL_8N1, RXD2, TXD2);
     pinMode(HEARTBEAT_PIN, OUTPUT);
 
     Serial.println("\n--- WiFi Traffic Controller ---");
 
+    // --- FIXED DEPLOYMENT: compile-time plan, no network, no parsing ---
+    if (USE_STATIC_CONFIG)
+    {
+        intersection_load_static(&intr, OFFLINE_INTERSECTION);
+        Serial.printf("Static Config Loaded: %d Lanes, %d Conn, %d Phases\n", intr.lane_cnt, intr.connection_cnt, intr.phase_cnt);
+        Serial.println("--- Starting Traffic Controller ---");
+        if (SENSOR_BUS)
+            sensor_bus_start();
+        controller_setup();
+        return;
+    }
+
     bool cloudConfigSuccess = false;
     bool systemReady = false;
     bool wifiAvailable = false;
@@ -212,6 +592,8 @@ void setup()
         Serial.print("IP: ");
         Serial.println(WiFi.localIP());
         wifiAvailable = true;
+        server_link_setup();
+        configTzTime(TIME_ZONE, NTP_SERVER); // Time-of-day demand profiles need local time
     }
     else
     {
@@ -221,21 +603,20 @@ void setup()
     // --- STEP 2: Fetch Config from Cloud ---
     if (wifiAvailable)
     {
-        WiFiClientSecure client;
-        client.setInsecure();
-
-        HTTPClient http;
         Serial.print("Fetching config from: ");
         Serial.println(serverUrl);
 
-        http.setTimeout(5000);
-        http.begin(client, serverUrl);
-
-        int httpCode = http.GET();
+        // Reconnects with backoff; the session stays open for the status posts that follow
+        String payload;
+        int httpCode = server_link_get(serverUrl, &payload);
+        for (int attempt = 1; httpCode < 0 && attempt < CONFIG_FETCH_ATTEMPTS; attempt++)
+        {
+            delay(server_link_backoff_remaining());
+            httpCode = server_link_get(serverUrl, &payload);
+        }
 
         if (httpCode == 200)
         {
-            String payload = http.getString();
             Serial.println("Cloud Config Received. Parsing...");
 
             if (parseConfig(payload))
@@ -256,7 +637,9 @@ void setup()
             Serial.printf("HTTP Failed. Error Code: %d\n", httpCode);
             send_intersection_status("CONFIG_ERROR"); // REQUIREMENT: Send Error on HTTP fail
         }
-        http.end();
+
+        const ServerLinkStats *link = server_link_stats();
+        Serial.printf("[LINK] %lu requests over %lu TLS handshakes.\n", (unsigned long)link->requests, (unsigned long)link->handshakes);
     }
 
     // --- STEP 3: Fallback ONLY if SIMULATION_MODE is active ---
@@ -267,7 +650,7 @@ void setup()
             Serial.println("\n!!! Cloud Config Failed. SIMULATION_MODE is ON. !!!");
             Serial.println("Attempting to load DEFAULT OFFLINE CONFIG...");
 
-            if (parseConfig(DEFAULT_OFFLINE_CONFIG))
+            if (intersection_load_static(&intr, OFFLINE_INTERSECTION))
             {
                 Serial.println("SUCCESS: Default Config Loaded (Simulation).");
                 // We do NOT send "OK" here. We leave the previous "CONFIG_ERROR"
@@ -276,7 +659,7 @@ void setup()
             }
             else
             {
-                Serial.println("CRITICAL ERROR: Default JSON is also invalid.");
+                Serial.println("CRITICAL ERROR: Default offline config could not be loaded.");
             }
         }
         else
@@ -290,6 +673,10 @@ void setup()
     if (systemReady)
     {
         Serial.println("--- Starting Traffic Controller ---");
+        if (wifiAvailable)
+            green_wave_setup(green_wave_port, green_wave_node_id);
+        if (SENSOR_BUS)
+            sensor_bus_start();
         controller_setup();
     }
     else
@@ -305,18 +692,40 @@ void setup()
 }
 void loop()
 {
-    if (Serial2.available() > 0)
+    if (SENSOR_BUS)
+    {
+        sensor_bus_service();
+    }
+    else if (Serial2.available() > 0)
     {
         int bytesRead = Serial2.readBytesUntil('\n', rxBuffer, sizeof(rxBuffer) - 1);
         if (bytesRead > 0)
         {
             rxBuffer[bytesRead] = '\0';
-            parse_traffic_data(&intr, rxBuffer);
+            if (strncmp(rxBuffer, "PRE,", 4) == 0)
+                controller_request_preemption(find_lane_index_by_id(&intr, atoi(rxBuffer + 4)));
+            else
+                parse_traffic_data(&intr, rxBuffer);
         }
     }
 
+    // 'd' on the console: save the flight recorder and print it for tools/flight_replay.py,
+    // a slice per pass
+    if (Serial.available() > 0 && Serial.read() == 'd')
+        recorder_dump_start();
+    recorder_dump_step();
+
     controller_loop();
 
+    // Periodic status, from a green so the post never stretches a transition
+    static unsigned long last_status_report = millis();
+    if (STATUS_REPORT_INTERVAL_MS && WiFi.status() == WL_CONNECTED && current_state == STATE_GREEN_RUNNING &&
+        millis() - last_status_report >= STATUS_REPORT_INTERVAL_MS)
+    {
+        last_status_report = millis();
+        send_intersection_status("OK");
+    }
+
     // Heartbeat for watchdog
     long now = millis();
     if ((now / 500) % 2 == 0)
@@ -0,0 +1,207 @@
+#!/usr/bin/env python3
+"""Deterministic replay of a flight recording (FlightRecorder.h).
+
+Decodes /flight.bin, either pulled off the board as a file or captured from
+the serial console after sending 'd' (the hex lines between ---FLIGHT BEGIN---
+and ---FLIGHT END---), and re-runs every DECISION through the firmware's own
+determine_next_phase(), built for the host (libufhost.so, see ufhost.py).
+
+A decision record carries everything the decision read besides the layout:
+queues, connection weights, blocked exits, detector calls, waiting
+crossings, the time since each phase was served, green-wave bonuses, ring
+timers and the lookahead's arrival rates. So every kind replays, pedestrian,
+green wave, ring and barrier and the learned policy included, and each one
+on its own however much of the lead-up the ring has lost. The layout comes
+from --layout, the intersections.json the board ran, policy block and all;
+its lane, connection and phase counts must match the BOOT record. Any
+decision that comes out differently, in phase, reason or exclusive walk, is
+a divergence and fails the replay.
+
+    make -C ../host
+    python3 flight_replay.py flight.bin --layout intersections.json --name IntersectieDemo
+    python3 flight_replay.py console.log --layout intersections.json --dump
+"""
+
+import argparse
+import json
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import ufhost  # noqa: E402
+
+MAGIC = 0x52464655
+VERSION = 2
+DECISION_EXCLUSIVE_WALK = 0x02
+
+REC_BOOT, REC_SENSOR_FRAME, REC_QUEUES, REC_DECISION, REC_STATE, REC_OUTPUT, REC_FAULT, REC_SPILLBACK = range(1, 9)
+TYPE_NAMES = {REC_BOOT: "BOOT", REC_SENSOR_FRAME: "SENSOR", REC_QUEUES: "QUEUES", REC_DECISION: "DECISION",
+              REC_STATE: "STATE", REC_OUTPUT: "OUTPUT", REC_FAULT: "FAULT", REC_SPILLBACK: "SPILL"}
+REASONS = ["pedestrian", "idle", "starvation", "lookahead", "policy", "max_pressure", "green_wave", "gap_out", "ring_barrier"]
+ALGORITHMS = ["max_pressure", "lookahead", "learned_policy"]
+STATES = ["GREEN", "INTERGREEN", "PED_ALL_RED", "PREEMPT_CLEAR", "PREEMPT_HOLD"]
+FAULT_SOURCES = ["safety", "sensor"]
+SENSOR_STATUSES = ["OK", "MISSING", "STUCK", "FLATLINE", "IMPLAUSIBLE"]
+
+
+# --- Decoding ---
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if b"---FLIGHT BEGIN---" in data:
+        text = data.decode("ascii", "replace")
+        body = text.split("---FLIGHT BEGIN---", 1)[1].split("---FLIGHT END---", 1)[0]
+        data = bytes.fromhex("".join(line.strip() for line in body.splitlines()))
+    magic, version, used, dropped = struct.unpack_from("<IIII", data, 0)
+    if magic != MAGIC:
+        raise SystemExit("%s: not a flight recording" % path)
+    if version != VERSION:
+        raise SystemExit("%s: recording version %d, this tool reads %d" % (path, version, VERSION))
+    return data[16:16 + used], dropped
+
+
+def records(body):
+    pos = 0
+    while pos + 7 <= len(body):
+        t, typ, n = struct.unpack_from("<IBH", body, pos)
+        yield t, typ, body[pos + 7:pos + 7 + n]
+        pos += 7 + n
+
+
+def parse_boot(p):
+    lane_cnt, conn_cnt, phase_cnt, algorithm = p[0], p[1], p[2], p[3]
+    default_ms, = struct.unpack_from("<I", p, 4)
+    pos = 8
+    lanes = [{"type": p[pos + i]} for i in range(lane_cnt)]
+    pos += lane_cnt
+    conns = [{"source_lane_idx": p[pos + 2 * c], "target_lane_idx": p[pos + 2 * c + 1]} for c in range(conn_cnt)]
+    pos += 2 * conn_cnt
+    phases = []
+    for _ in range(phase_cnt):
+        mask, ms = struct.unpack_from("<QI", p, pos)
+        phases.append({"active_connections_mask": mask, "duration_ms": ms})
+        pos += 12
+    cfg = {"lanes": lanes, "connections": conns, "phases": phases, "default_phase_duration_ms": default_ms}
+    return cfg, ALGORITHMS[algorithm] if algorithm < len(ALGORITHMS) else "max_pressure"
+
+
+def u16s(p, offset, count):
+    return list(struct.unpack_from("<%dH" % count, p, offset))
+
+
+def load_layout(layouts, name, boot, algorithm):
+    """A bank running the layout named name, or else the first one whose lane,
+    connection and phase counts match the BOOT record."""
+    for cfg in layouts:
+        if name is not None and cfg.get("name") != name:
+            continue
+        bank = ufhost.Bank(1)
+        try:
+            bank.load(cfg, algorithm)
+            info = bank.info(0)
+            if (info.lane_cnt, info.connection_cnt, info.phase_cnt) == (boot[0], boot[1], boot[2]):
+                return bank
+        except ufhost.UrbanFlowError:
+            pass
+        bank.close()
+    return None
+
+
+def reason_name(reason):
+    return REASONS[reason] if reason < len(REASONS) else "?%d" % reason
+
+
+# --- Replay ---
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("recording", help="flight.bin, or a serial log containing a FLIGHT dump")
+    ap.add_argument("--layout", required=True, help="intersections.json the board ran, with its policy block")
+    ap.add_argument("--name", help="layout name in --layout (default: the first one whose counts match the "
+                                   "recording; name it when several do)")
+    ap.add_argument("--dump", action="store_true", help="print every record as a timeline")
+    args = ap.parse_args()
+
+    body, dropped = load(args.recording)
+    with open(args.layout) as f:
+        layouts = json.load(f)
+    if isinstance(layouts, dict):
+        layouts = [layouts]
+
+    bank = None
+    matched, diverged = 0, []
+    for t, typ, p in records(body):
+        line = None
+        if typ == REC_BOOT:
+            cfg, algorithm = parse_boot(p)
+            bank = load_layout(layouts, args.name, p, algorithm)
+            if bank is None:
+                raise SystemExit("%s: no layout with %d lanes, %d connections and %d phases%s" % (
+                    args.layout, p[0], p[1], p[2], " named " + args.name if args.name else ""))
+            lane_cnt = p[0]
+            line = "%d lanes, %d connections, %d phases, %s" % (len(cfg["lanes"]), len(cfg["connections"]),
+                                                                len(cfg["phases"]), algorithm)
+        elif bank is None:
+            continue
+        elif typ == REC_SENSOR_FRAME:
+            mask, = struct.unpack_from("<Q", p, 0)
+            line = "lanes 0x%x = %s" % (mask, u16s(p, 8, (len(p) - 8) // 2))
+        elif typ == REC_QUEUES:
+            serving, = struct.unpack_from("<Q", p, 0)
+            line = "serving 0x%x queues %s" % (serving, u16s(p, 8, lane_cnt))
+        elif typ == REC_DECISION:
+            current, chosen, reason, flags = p[0], p[1], p[2], p[3]
+            green_ms, = struct.unpack_from("<I", p, 4)
+            walk = bool(flags & DECISION_EXCLUSIVE_WALK)
+            line = "phase %d -> %d (%s%s, green %d ms) queues %s" % (
+                current, chosen, reason_name(reason), ", all-red walk" if walk else "", green_ms, u16s(p, 12, lane_cnt))
+            try:
+                replayed = bank.replay_decision(0, p)
+            except ufhost.UrbanFlowError as e:
+                replayed = (None, None, None)
+                line += "  UNREADABLE: %s" % e
+            if replayed == (chosen, reason, walk):
+                matched += 1
+            else:
+                diverged.append((t, current, (chosen, reason, walk), replayed))
+                if replayed[0] is not None:
+                    line += "  DIVERGES: firmware picks %d (%s%s)" % (
+                        replayed[0], reason_name(replayed[1]), ", all-red walk" if replayed[2] else "")
+        elif typ == REC_STATE:
+            frm, to, current, pending = p[0], p[1], p[2], p[3]
+            line = "%s -> %s (phase %d, pending %d)" % (STATES[frm], STATES[to], current, pending)
+        elif typ == REC_OUTPUT:
+            line = p.hex()
+        elif typ == REC_SPILLBACK:
+            lanes, = struct.unpack_from("<Q", p, 0)
+            line = "blocked exits 0x%x" % lanes
+        elif typ == REC_FAULT:
+            source = FAULT_SOURCES[p[0]] if p[0] < len(FAULT_SOURCES) else "?"
+            if p[0] == 1:
+                line = "sensor lane %d %s" % (p[2], SENSOR_STATUSES[p[1]] if p[1] < len(SENSOR_STATUSES) else p[1])
+            else:
+                line = "%s fault %d" % (source, p[1])
+
+        if args.dump and line is not None:
+            print("%10d  %-8s %s" % (t, TYPE_NAMES.get(typ, "?%d" % typ), line))
+
+    if bank is None:
+        raise SystemExit("%s: no BOOT record" % args.recording)
+    bank.close()
+
+    print("%d decisions replayed, %d match, %d diverge (%d records lost to the ring)" % (
+        matched + len(diverged), matched, len(diverged), dropped))
+    if diverged:
+        t, current, (chosen, reason, walk), (r_chosen, r_reason, r_walk) = diverged[0]
+        replayed = "unreadable" if r_chosen is None else "%d (%s%s)" % (
+            r_chosen, reason_name(r_reason), ", all-red walk" if r_walk else "")
+        print("first divergence at %d ms: phase %d, board chose %d (%s%s), firmware on the host %s" % (
+            t, current, chosen, reason_name(reason), ", all-red walk" if walk else "", replayed))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,210 @@
+#!/usr/bin/env python3
+"""Stops per vehicle along a corridor of green-wave coordinated controllers.
+
+Chains --junctions four-arm junctions east-west. Every junction is the
+firmware itself, controller_loop() under max pressure in host/libufhost.so
+through ufhost.py, one bank for the corridor, each with its own millis()
+clock started at a different time. With coordination each layout carries a
+"green_wave" block, so each junction opens its own UDP socket on this host
+and GreenWave.cpp talks to its neighbours over real loopback datagrams:
+NTP-style clock sync, then a TIMING message with the departing platoons on
+every green start and once per second after. Without it the layouts are
+the same bar that block, so the only difference between the two runs is
+green_wave_phase_bonus().
+
+Vehicles are tracked one by one. A lane showing green discharges one queued
+vehicle per GREEN_WAVE_HEADWAY_MS; a vehicle reaching the stop line on red,
+or behind a queue, stops. Corridor vehicles enter at either end and run
+the whole corridor, side-street vehicles cross one junction.
+
+    make -C ../host
+    python3 green_wave_bench.py
+    python3 green_wave_bench.py --junctions 5 --travel-ms 15000 --duration-s 3600
+"""
+
+import argparse
+import collections
+import os
+import random
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import ufhost  # noqa: E402
+
+TICK_MS = 500     # One controller pass per tick, as in kpi_bench.py
+HEADWAY_MS = 1000  # GREEN_WAVE_HEADWAY_MS
+
+# Lane slots of the synthetic junction: inbound W, E, N, S then outbound W, E, N, S
+IN_W, IN_E, IN_N, IN_S, OUT_W, OUT_E, OUT_N, OUT_S = range(8)
+THROUGH = {IN_W: OUT_E, IN_E: OUT_W, IN_N: OUT_S, IN_S: OUT_N}
+
+
+def lane_id(slot):
+    return slot + 1
+
+
+def junction_cfg(k, args, coordinated):
+    # Right-hand traffic: each lane sits 10 degrees off its arm's axis, so
+    # opposing throughs run side by side rather than down one chord
+    bearings = [260, 80, 350, 170, 280, 100, 10, 190]
+    lanes = [{"id": lane_id(i), "type": 0 if i < 4 else 1, "bearing": b} for i, b in enumerate(bearings)]
+    connections = [{"source_lane_idx": s, "target_lane_idx": t} for s, t in sorted(THROUGH.items())]
+    # Connection order follows the inbound slots: W, E, N, S
+    phases = [{"active_connections_mask": 0b0011, "duration_ms": 20000},
+              {"active_connections_mask": 0b1100, "duration_ms": 20000}]
+    cfg = {"name": "corridor %d" % k, "lanes": lanes, "connections": connections, "phases": phases,
+           "default_phase_duration_ms": 20000}
+    if not coordinated:
+        return cfg
+
+    # Eastbound traffic leaves k-1 on OUT_E and reaches k on IN_W, westbound the other way
+    peers = []
+    for j, lane, out in ((k - 1, IN_W, OUT_E), (k + 1, IN_E, OUT_W)):
+        if 0 <= j < args.junctions:
+            link = {"lane_id": lane_id(lane), "peer_lane_id": lane_id(out), "travel_ms": args.travel_ms}
+            peers.append({"host": "127.0.0.1", "port": args.port + j, "links": [link]})
+    cfg["green_wave"] = {"port": args.port + k, "node_id": k, "peers": peers}
+    return cfg
+
+
+class Vehicle:
+    __slots__ = ("corridor", "entered", "stops")
+
+    def __init__(self, corridor, now):
+        self.corridor = corridor
+        self.entered = now
+        self.stops = 0
+
+
+class Node:
+    """One junction of the bank and the vehicles at its stop lines."""
+
+    def __init__(self, bank, cfg):
+        self.idx = bank.load(cfg, "max_pressure")
+        self.queues = [collections.deque() for _ in range(8)]
+        self.next_free = [0] * 8
+        self.state = bank.state[self.idx]
+        self.switches = 0
+
+    def green(self, bank, lane):
+        return bank.light(self.idx, lane) == ufhost.LIGHT_GREEN
+
+    def sense(self, bank):
+        for lane in THROUGH:
+            bank.set_queue(self.idx, lane, min(len(self.queues[lane]), 255))
+
+    def observe(self, bank):
+        state = bank.state[self.idx]
+        if state == ufhost.STATE_INTERGREEN and self.state != ufhost.STATE_INTERGREEN:
+            self.switches += 1
+        self.state = state
+
+    def arrive(self, bank, lane, vehicle, now):
+        if not self.queues[lane] and self.green(bank, lane) and self.next_free[lane] <= now:
+            self.next_free[lane] = now + HEADWAY_MS
+            return [(lane, vehicle)]
+        vehicle.stops += 1
+        self.queues[lane].append(vehicle)
+        return []
+
+    def discharge(self, bank, now):
+        out = []
+        for lane in THROUGH:
+            if self.queues[lane] and self.green(bank, lane) and self.next_free[lane] <= now:
+                self.next_free[lane] = now + HEADWAY_MS
+                out.append((lane, self.queues[lane].popleft()))
+        return out
+
+
+def run(args, coordinated, seed):
+    with ufhost.Bank(args.junctions) as bank:
+        return simulate(bank, args, coordinated, seed)
+
+
+def simulate(bank, args, coordinated, seed):
+    rng = random.Random(seed)
+    n = args.junctions
+    nodes = [Node(bank, junction_cfg(k, args, coordinated)) for k in range(n)]
+    # Clocks far apart, as boards powered up at different times
+    for node in nodes:
+        bank.step(rng.randrange(0, 1 << 30), node.idx, 1)
+
+    in_flight = []  # (arrive_ms, node, lane, vehicle)
+    done = {True: [], False: []}
+    for tick in range(args.duration_s * 1000 // TICK_MS):
+        now = tick * TICK_MS
+
+        # Demand: corridor at both ends, side streets everywhere
+        for lane, k in ((IN_W, 0), (IN_E, n - 1)):
+            if rng.random() < args.main_rate:
+                in_flight.append((now, k, lane, Vehicle(True, now)))
+        for k in range(n):
+            for lane in (IN_N, IN_S):
+                if rng.random() < args.side_rate:
+                    in_flight.append((now, k, lane, Vehicle(False, now)))
+
+        # Junctions pass in order, so each sees the datagrams its peers sent before it
+        for node in nodes:
+            node.sense(bank)
+        bank.step(TICK_MS)
+        for node in nodes:
+            node.observe(bank)
+
+        due = [v for v in in_flight if v[0] <= now]
+        in_flight = [v for v in in_flight if v[0] > now]
+        moved = []
+        for _, k, lane, vehicle in due:
+            moved += [(k, l, v) for l, v in nodes[k].arrive(bank, lane, vehicle, now)]
+        for k, node in enumerate(nodes):
+            moved += [(k, l, v) for l, v in node.discharge(bank, now)]
+
+        for k, lane, vehicle in moved:
+            j = k + 1 if lane == IN_W else k - 1 if lane == IN_E else -1
+            if vehicle.corridor and 0 <= j < n:
+                in_flight.append((now + args.travel_ms, j, lane, vehicle))
+            else:
+                done[vehicle.corridor].append((vehicle, now))
+
+    info = [bank.info(node.idx) for node in nodes]
+    corridor, side = done[True], done[False]
+    return {
+        "stops_per_vehicle": sum(v.stops for v, _ in corridor) / max(1, len(corridor)),
+        "corridor_vehicles": len(corridor),
+        "corridor_time_s": sum(t - v.entered for v, t in corridor) / 1000.0 / max(1, len(corridor)),
+        "side_delay_s": sum(t - v.entered for v, t in side) / 1000.0 / max(1, len(side)),
+        "switches_per_h": sum(node.switches for node in nodes) * 3600.0 / args.duration_s / n,
+        "messages": sum(i.wave_messages_sent for i in info),
+        "predicting": all(i.wave_platoons_predicted > 0 for i in info),
+    }
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--junctions", type=int, default=4)
+    ap.add_argument("--travel-ms", type=int, default=20000, help="stop line to stop line between neighbours")
+    ap.add_argument("--duration-s", type=int, default=1800)
+    ap.add_argument("--main-rate", type=float, default=0.15, help="corridor arrivals per 500 ms tick, each end")
+    ap.add_argument("--side-rate", type=float, default=0.06, help="side-street arrivals per 500 ms tick, each arm")
+    ap.add_argument("--seeds", type=int, default=3)
+    ap.add_argument("--port", type=int, default=42100, help="first UDP port; one per junction")
+    args = ap.parse_args()
+
+    print("%-13s %8s %9s %10s %10s %10s %9s" % ("", "stops/veh", "corridor", "travel_s", "side_s", "switch/h", "messages"))
+    totals = {}
+    for coordinated in (False, True):
+        rows = [run(args, coordinated, seed) for seed in range(args.seeds)]
+        mean = {key: sum(r[key] for r in rows) / len(rows) for key in rows[0] if key != "predicting"}
+        totals[coordinated] = mean
+        print("%-13s %8.2f %9d %10.1f %10.1f %10.1f %9d" % (
+            "green wave" if coordinated else "uncoordinated", mean["stops_per_vehicle"], mean["corridor_vehicles"],
+            mean["corridor_time_s"], mean["side_delay_s"], mean["switches_per_h"], mean["messages"]))
+        if coordinated and not all(r["predicting"] for r in rows):
+            print("WARNING: some junctions never predicted a platoon (peers not synced?)")
+
+    off, on = totals[False]["stops_per_vehicle"], totals[True]["stops_per_vehicle"]
+    print("stops per corridor vehicle: %.2f -> %.2f (%+.0f%%)" % (off, on, 100.0 * (on - off) / max(off, 1e-9)))
+    return 0 if on <= off else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Local HTTPS stand-in for the dashboard server.
+
+Serves the two endpoints the controller uses, with HTTP/1.1 keep-alive, and
+logs every new TLS connection so connection reuse by ServerLink is visible:
+
+    GET  /Intersection/GetConfigByName?name=<name>
+    POST /Intersection/UpdateStatus?name=<name>&status=<status>
+
+    python3 https_standin.py intersections.json --port 7281
+
+A self-signed certificate is generated with openssl on first run (the
+controller uses setInsecure(), so any certificate is accepted). Point
+serverUrl / sendStatusUrl in WIFI_CREDENTIALS.h at this machine.
+"""
+
+import argparse
+import http.server
+import json
+import os
+import ssl
+import subprocess
+import threading
+import time
+from urllib.parse import parse_qs, urlparse
+
+connections = 0
+requests = 0
+lock = threading.Lock()
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"  # keep-alive
+    intersections = []
+    close_after = 0
+
+    def setup(self):
+        global connections
+        super().setup()
+        with lock:
+            connections += 1
+        self.served = 0
+        self.log_message("new TLS connection (total %d)", connections)
+
+    def reply(self, code, body):
+        global requests
+        data = body.encode()
+        self.send_response(code)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.served += 1
+        # Optionally drop the connection to exercise reconnect/backoff
+        if self.close_after and self.served >= self.close_after:
+            self.send_header("Connection", "close")
+            self.close_connection = True
+        self.end_headers()
+        self.wfile.write(data)
+        with lock:
+            requests += 1
+        self.log_message("%d requests over %d connections", requests, connections)
+
+    def do_GET(self):
+        url = urlparse(self.path)
+        query = parse_qs(url.query)
+        if url.path != "/Intersection/GetConfigByName":
+            return self.reply(404, '{"error": "not found"}')
+        name = query.get("name", [""])[0]
+        for item in self.intersections:
+            if item.get("name") == name:
+                return self.reply(200, json.dumps(item))
+        self.reply(404, '{"error": "unknown intersection"}')
+
+    def do_POST(self):
+        url = urlparse(self.path)
+        query = parse_qs(url.query)
+        length = int(self.headers.get("Content-Length", 0))
+        if length:
+            self.rfile.read(length)
+        if url.path != "/Intersection/UpdateStatus":
+            return self.reply(404, '{"error": "not found"}')
+        self.log_message("status %s = %s", query.get("name", ["?"])[0], query.get("status", ["?"])[0])
+        self.reply(200, '{"ok": true, "time": %d}' % int(time.time()))
+
+
+def ensure_cert(cert, key):
+    if os.path.exists(cert) and os.path.exists(key):
+        return
+    subprocess.check_call(["openssl", "req", "-x509", "-newkey", "rsa:2048", "-nodes", "-days", "365",
+                           "-subj", "/CN=urbanflow-standin", "-keyout", key, "-out", cert])
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("intersections", help="intersections.json from the dashboard")
+    ap.add_argument("--port", type=int, default=7281)
+    ap.add_argument("--cert", default="standin_cert.pem")
+    ap.add_argument("--key", default="standin_key.pem")
+    ap.add_argument("--close-after", type=int, default=0, help="close each connection after N requests")
+    args = ap.parse_args()
+
+    with open(args.intersections) as f:
+        Handler.intersections = json.load(f)
+    Handler.close_after = args.close_after
+
+    ensure_cert(args.cert, args.key)
+    ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    ctx.load_cert_chain(args.cert, args.key)
+
+    server = http.server.ThreadingHTTPServer(("0.0.0.0", args.port), Handler)
+    server.socket = ctx.wrap_socket(server.socket, server_side=True)
+    print("stand-in listening on https://0.0.0.0:%d" % args.port)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
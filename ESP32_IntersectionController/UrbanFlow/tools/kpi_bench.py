@@ -0,0 +1,280 @@
+#!/usr/bin/env python3
+"""Traffic KPI regression benchmark over the dashboard's intersection corpus.
+
+Runs every layout in intersections.json under each control algorithm the
+firmware offers (CONTROL_ALGORITHM in CONFIG.h) and a fixed set of demand
+profiles, then compares average delay, throughput, max queue and phase
+switches against a stored baseline. Any change to determine_next_phase()
+that makes traffic worse shows up as a REGRESSION and a non-zero exit code.
+
+The controller is the firmware itself: controller_loop() and everything under
+it, built into host/libufhost.so and driven through ufhost.py, one junction
+per layout and seed, all stepped together in 500 ms passes. This script is
+only the traffic around it: arrivals per demand profile, departures from
+lanes the controller shows green, and the queues pushed back as its sensor
+counts. The learned policy only runs on layouts that carry a "policy" block.
+
+Emergency preemption is checked separately: calls on random approaches
+under peak traffic, with the worst request-to-green latency the controller
+measures held against the bound it derives from its clearance matrix
+(preemption_latency_bound()).
+
+    make -C ../host
+    python3 kpi_bench.py ../../../Web_IoTDashboard/ESP_Server/web/UrbanFlowApp/intersections.json
+    python3 kpi_bench.py intersections.json --update-baseline
+"""
+
+import argparse
+import json
+import os
+import random
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import ufhost  # noqa: E402
+from train_policy import Junction  # noqa: E402
+
+# --- Simulation ---
+TICK_MS = 500              # One controller pass per tick, the firmware simulation tick
+DEPART_P = 0.5             # Per movement shown green, per tick
+
+# --- Preemption scenario ---
+PREEMPT_CALL_MS = 8000     # How long an approaching vehicle keeps calling
+PREEMPT_EVERY_S = 90
+
+ALGORITHMS = ["max_pressure", "lookahead", "learned_policy"]
+KPIS = ["avg_delay_s", "throughput_vph", "max_queue", "switches_per_h"]
+# Direction in which a KPI gets worse, and the slack allowed before flagging
+WORSE_IF_HIGHER = {"avg_delay_s": True, "throughput_vph": False, "max_queue": True, "switches_per_h": True}
+ABS_SLACK = {"avg_delay_s": 0.5, "throughput_vph": 5.0, "max_queue": 1.0, "switches_per_h": 5.0}
+
+
+# --- Demand profiles: arrival probability per inbound lane per 500 ms tick ---
+
+def profile_light(k, n, t_s):
+    return 0.05
+
+
+def profile_peak(k, n, t_s):
+    return 0.22
+
+
+def profile_asymmetric(k, n, t_s):
+    return 0.30 if k < (n + 1) // 2 else 0.06
+
+
+def profile_surge(k, n, t_s):
+    return 0.50 if k == 0 and 240 <= t_s < 420 else 0.10
+
+
+PROFILES = {
+    "light": profile_light,
+    "peak": profile_peak,
+    "asymmetric": profile_asymmetric,
+    "surge": profile_surge,
+}
+
+
+# --- Traffic around the controller ---
+
+class Run:
+    """One junction in the bank and the traffic on its approaches."""
+
+    def __init__(self, bank, cfg, algorithm, seed, preempts=()):
+        self.lay = Junction(cfg)
+        self.idx = bank.load(cfg, algorithm)
+        self.rng = random.Random(seed)
+        self.queue = [0] * self.lay.lane_cnt
+        self.preempts = preempts  # (start_ms, lane) calls, each repeated for PREEMPT_CALL_MS
+        self.movements = [s for s, _ in self.lay.conns if s in self.lay.in_lanes]
+        self.state = bank.state[self.idx]
+        self.queue_ms, self.departures, self.max_queue, self.switches, self.preemptions = 0, 0, 0, 0, 0
+
+    def before(self, bank, profile, now):
+        lay, queue, rng, idx = self.lay, self.queue, self.rng, self.idx
+
+        # Arrivals
+        for k, l in enumerate(lay.in_lanes):
+            if rng.random() < profile(k, len(lay.in_lanes), now / 1000.0):
+                queue[l] = min(queue[l] + 1, 255)
+
+        # Departures: a lane showing green releases all of its movements
+        for s in self.movements:
+            if bank.light(idx, s) == ufhost.LIGHT_GREEN and queue[s] > 0 and rng.random() < DEPART_P:
+                queue[s] -= 1
+                self.departures += 1
+
+        for l in lay.in_lanes:
+            bank.set_queue(idx, l, queue[l])
+        for start, lane in self.preempts:
+            if start <= now < start + PREEMPT_CALL_MS:
+                bank.preempt[idx] = lane
+                break
+
+    def after(self, bank):
+        state = bank.state[self.idx]
+        if state == ufhost.STATE_INTERGREEN and self.state != ufhost.STATE_INTERGREEN:
+            self.switches += 1
+        preempting = (ufhost.STATE_PREEMPT_CLEARANCE, ufhost.STATE_PREEMPT_HOLD)
+        if state in preempting and self.state not in preempting:
+            self.preemptions += 1
+        self.state = state
+
+        self.queue_ms += sum(self.queue) * TICK_MS
+        self.max_queue = max([self.max_queue] + [self.queue[l] for l in self.lay.in_lanes])
+
+    def kpis(self, duration_s):
+        hours = duration_s / 3600.0
+        return {
+            # Little's law: queue-seconds per vehicle served
+            "avg_delay_s": (self.queue_ms / 1000.0) / max(1, self.departures),
+            "throughput_vph": self.departures / hours,
+            "max_queue": self.max_queue,
+            "switches_per_h": self.switches / hours,
+        }
+
+
+def simulate(jobs, algorithm, profile, duration_s):
+    """jobs: (cfg, seed, preempts) per junction, all stepped in one bank. Returns their Runs."""
+    with ufhost.Bank(len(jobs)) as bank:
+        runs = [Run(bank, cfg, algorithm, seed, preempts) for cfg, seed, preempts in jobs]
+        for tick in range(duration_s * 1000 // TICK_MS):
+            now = tick * TICK_MS
+            for r in runs:
+                r.before(bank, profile, now)
+            bank.step(TICK_MS)
+            for r in runs:
+                r.after(bank)
+        for r in runs:
+            r.info = bank.info(r.idx)
+    return runs
+
+
+def runnable(cfg):
+    """Whether the controller runs this layout: inbound lanes, phases, none of them unsafe."""
+    lay = Junction(cfg)
+    if lay.phase_cnt == 0 or not lay.in_lanes:
+        return False
+    with ufhost.Bank(1) as bank:
+        try:
+            bank.load(cfg, "max_pressure")
+        except ufhost.UrbanFlowError:
+            return False
+    return True
+
+
+def bench(layouts, duration_s, seeds):
+    for cfg in layouts:
+        if not runnable(cfg):
+            print("note: %s skipped, the controller refuses it" % cfg.get("name"))
+    layouts = [cfg for cfg in layouts if runnable(cfg)]
+    results = {}
+    for algorithm in ALGORITHMS:
+        chosen = [cfg for cfg in layouts if algorithm != "learned_policy" or cfg.get("policy")]
+        if not chosen:
+            continue
+        for name, profile in PROFILES.items():
+            jobs = [(cfg, 1000 + s, ()) for cfg in chosen for s in range(seeds)]
+            runs = simulate(jobs, algorithm, profile, duration_s)
+            for k, cfg in enumerate(chosen):
+                kpis = [r.kpis(duration_s) for r in runs[k * seeds:(k + 1) * seeds]]
+                results.setdefault(cfg["name"], {}).setdefault(algorithm, {})[name] = {
+                    m: round(sum(x[m] for x in kpis) / seeds, 2) for m in KPIS}
+    return results
+
+
+def preempt_check(layouts, duration_s, seeds):
+    """Worst request-to-green of emergency calls under peak traffic, against the controller's bound."""
+    jobs = []
+    for cfg in layouts:
+        if not runnable(cfg):
+            continue
+        lay = Junction(cfg)
+        lanes = [l for l in lay.in_lanes if any(s == l for s, _ in lay.conns)]
+        for seed in range(seeds):
+            rng = random.Random(5000 + seed)
+            calls = [(k * PREEMPT_EVERY_S * 1000 + rng.randrange(0, 30000, TICK_MS), rng.choice(lanes))
+                     for k in range(duration_s // PREEMPT_EVERY_S)] if lanes else []
+            jobs.append((cfg, 1000 + seed, calls))
+    runs = simulate(jobs, "max_pressure", PROFILES["peak"], duration_s)
+
+    violations = 0
+    print("\n%-22s %8s %10s %10s" % ("preemption", "calls", "worst ms", "bound ms"))
+    for k in range(0, len(runs), seeds):
+        group = runs[k:k + seeds]
+        if not group[0].preempts:
+            continue
+        worst = max(r.info.preempt_worst_ms for r in group)
+        bound = group[0].info.preempt_bound_ms
+        # A pass every tick: each of the two intergreens can be seen to end up to a tick late
+        over = worst > bound + 2 * TICK_MS
+        print("%-22s %8d %10d %10d %s" % (group[0].lay.cfg["name"][:22], sum(r.preemptions for r in group),
+                                          worst, bound, "OVER BOUND" if over else ""))
+        violations += over
+    return violations
+
+
+def compare(results, baseline, tolerance):
+    regressions = 0
+    print("%-22s %-15s %-11s %10s %10s %8s %8s" % ("layout", "algorithm", "profile", "delay s", "veh/h", "max q", "sw/h"))
+    for layout, algos in results.items():
+        for algorithm, profiles in algos.items():
+            for profile, kpis in profiles.items():
+                base = baseline.get(layout, {}).get(algorithm, {}).get(profile)
+                flags = []
+                if base:
+                    for k in KPIS:
+                        slack = abs(base[k]) * tolerance + ABS_SLACK[k]
+                        delta = kpis[k] - base[k]
+                        if (delta > slack) if WORSE_IF_HIGHER[k] else (-delta > slack):
+                            flags.append("%s %.2f -> %.2f" % (k, base[k], kpis[k]))
+                print("%-22s %-15s %-11s %10.2f %10.1f %8d %8.1f %s" % (
+                    layout[:22], algorithm, profile, kpis["avg_delay_s"], kpis["throughput_vph"],
+                    kpis["max_queue"], kpis["switches_per_h"],
+                    ("REGRESSION: " + ", ".join(flags)) if flags else ("" if base else "(new)")))
+                regressions += len(flags)
+    return regressions
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("intersections", help="intersections.json from the dashboard")
+    ap.add_argument("--baseline", default=os.path.join(here, "kpi_baseline.json"))
+    ap.add_argument("--update-baseline", action="store_true", help="store these results as the new baseline")
+    ap.add_argument("--duration-s", type=int, default=900)
+    ap.add_argument("--seeds", type=int, default=3)
+    ap.add_argument("--tolerance", type=float, default=0.05, help="relative slack before a KPI counts as worse")
+    ap.add_argument("--only", help="run a single layout by name")
+    args = ap.parse_args()
+
+    with open(args.intersections) as f:
+        layouts = json.load(f)
+    if args.only:
+        layouts = [l for l in layouts if l.get("name") == args.only]
+
+    results = bench(layouts, args.duration_s, args.seeds)
+
+    baseline = {}
+    if os.path.exists(args.baseline) and not args.update_baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+    regressions = compare(results, baseline, args.tolerance)
+    regressions += preempt_check(layouts, args.duration_s, args.seeds)
+
+    if args.update_baseline:
+        with open(args.baseline, "w") as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+        print("wrote %s" % args.baseline)
+        return 0
+
+    if regressions:
+        print("%d KPI regression(s) against %s" % (regressions, args.baseline))
+        return 1
+    print("no regressions")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Compute cost of the lookahead optimizer against the delay it saves.
+
+Runs every layout in intersections.json under Max Pressure and under the
+lookahead (PhaseOptimizer.cpp) with the traffic of kpi_bench.py, the same
+seeds for both, and prints per layout and demand profile the average delay
+of each, the lookahead's reduction, and what its searches cost: decisions
+taken, mean and worst time per search on this host, and the largest search
+in nodes against LOOKAHEAD_MAX_NODES.
+
+Host time only bounds the board's: the search is the same code and the same
+node count there, so the worst node count times the board's cost per node
+(lookahead_test on the target, or the console's "Lookahead ->" lines) is
+what has to fit DECISION_TIME_INTERVAL.
+
+    make -C ../host
+    python3 lookahead_bench.py ../../../Web_IoTDashboard/ESP_Server/web/UrbanFlowApp/intersections.json
+"""
+
+import argparse
+import json
+import os
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from kpi_bench import PROFILES, runnable, simulate  # noqa: E402
+
+LOOKAHEAD_MAX_NODES = 4096  # PhaseOptimizer.h
+DECISION_TIME_INTERVAL_MS = 1000  # TrafficController.cpp
+
+
+def bench(layouts, duration_s, seeds):
+    """Rows of (layout, profile, max pressure delay, lookahead delay, lookahead Runs)."""
+    rows = []
+    for name, profile in PROFILES.items():
+        jobs = [(cfg, 1000 + s, ()) for cfg in layouts for s in range(seeds)]
+        base = simulate(jobs, "max_pressure", profile, duration_s)
+        ahead = simulate(jobs, "lookahead", profile, duration_s)
+        for k, cfg in enumerate(layouts):
+            group = slice(k * seeds, (k + 1) * seeds)
+            delay = [sum(r.kpis(duration_s)["avg_delay_s"] for r in runs[group]) / seeds for runs in (base, ahead)]
+            rows.append((cfg["name"], name, delay[0], delay[1], ahead[group]))
+    return rows
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("intersections", help="intersections.json from the dashboard")
+    ap.add_argument("--duration-s", type=int, default=900)
+    ap.add_argument("--seeds", type=int, default=3)
+    ap.add_argument("--only", help="run a single layout by name")
+    args = ap.parse_args()
+
+    with open(args.intersections) as f:
+        layouts = [cfg for cfg in json.load(f) if runnable(cfg)]
+    if args.only:
+        layouts = [cfg for cfg in layouts if cfg.get("name") == args.only]
+
+    rows = bench(layouts, args.duration_s, args.seeds)
+
+    print("%-22s %-11s %9s %9s %7s %9s %8s %8s %7s" % (
+        "layout", "profile", "mp dly s", "la dly s", "gain", "searches", "mean us", "worst us", "nodes"))
+    total_mp, total_la, worst_us, worst_nodes = 0.0, 0.0, 0, 0
+    for layout, profile, mp, la, runs in rows:
+        calls = sum(r.info.lookahead_calls for r in runs)
+        mean_us = sum(r.info.lookahead_mean_us * r.info.lookahead_calls for r in runs) / max(1, calls)
+        us = max(r.info.lookahead_worst_us for r in runs)
+        nodes = max(r.info.lookahead_worst_nodes for r in runs)
+        print("%-22s %-11s %9.2f %9.2f %6.1f%% %9d %8.1f %8d %7d" % (
+            layout[:22], profile, mp, la, 100.0 * (mp - la) / mp if mp else 0.0, calls, mean_us, us, nodes))
+        total_mp, total_la = total_mp + mp, total_la + la
+        worst_us, worst_nodes = max(worst_us, us), max(worst_nodes, nodes)
+
+    if rows:
+        print("\ndelay %.2f s -> %.2f s per vehicle (%+.1f%%) over %d runs; worst search %d us on this host, "
+              "%d of %d nodes (decision budget %d ms)" % (
+                  total_mp / len(rows), total_la / len(rows), -100.0 * (total_mp - total_la) / max(total_mp, 1e-9),
+                  len(rows), worst_us, worst_nodes, LOOKAHEAD_MAX_NODES, DECISION_TIME_INTERVAL_MS))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
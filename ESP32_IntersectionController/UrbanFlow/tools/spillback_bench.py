@@ -0,0 +1,273 @@
+#!/usr/bin/env python3
+"""Gridlock on a grid of junctions with finite links, with and without spillback holding.
+
+Lays --rows x --cols four-arm junctions out on a grid, every approach one
+lane: through traffic only, opposing approaches green together, or with
+--turn-share left and right turns sharing it, each approach on its own
+phase. The link between two neighbours holds --storage vehicles,
+counting those still driving on it and those queued at the next stop line;
+the links leaving the grid hold as many and drain one vehicle per
+--exit-headway-ms, except the east exits of the first row, which drain at
+--incident-headway-ms (a lane closure downstream) to start the spillback.
+
+A vehicle given green into a full link drives into the box anyway and waits
+there for space, and while it does nothing else crosses that junction: the
+box blocking that spreads a jam across the grid and locks it. Both runs
+share this physics. Every junction is the firmware itself, controller_loop()
+under max pressure in host/libufhost.so through ufhost.py, one bank for the
+grid. With holding, each controller is told how many vehicles stand on its
+exit links, as the sensor link would report them, and each exit's storage
+is the link's: Spillback.h then blocks it at SPILLBACK_ON_PERCENT and clears
+it at SPILLBACK_OFF_PERCENT, a green whose exit blocks is re-decided at
+once, and a lane whose every movement is blocked is held red inside its
+green (update_spillback_holds). Without holding the exits read empty.
+Without turns a held lane is exactly a blocked movement; with them, a
+shared lane is held only once all three of its exits are blocked, and the
+turning vehicles still queued behind a blocked one are what is left to
+lock the box.
+
+    make -C ../host
+    python3 spillback_bench.py
+    python3 spillback_bench.py --rows 4 --cols 4 --storage 8 --rate 0.1
+    python3 spillback_bench.py --turn-share 0.2
+"""
+
+import argparse
+import collections
+import os
+import random
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import ufhost  # noqa: E402
+
+TICK_MS = 500              # One controller pass per tick, as in kpi_bench.py
+HEADWAY_MS = 1000
+
+# Lane slots of the synthetic junction: inbound W, E, N, S then outbound W, E, N, S.
+# IN_W is the approach from the west, so its vehicles travel east.
+IN_W, IN_E, IN_N, IN_S, OUT_W, OUT_E, OUT_N, OUT_S = range(8)
+# Through, left, right per approach
+TURNS = {IN_W: (OUT_E, OUT_N, OUT_S), IN_E: (OUT_W, OUT_S, OUT_N),
+         IN_N: (OUT_S, OUT_E, OUT_W), IN_S: (OUT_N, OUT_W, OUT_E)}
+# Where each exit leads: row and column step, and the approach it reaches
+NEIGHBOUR = {OUT_E: (0, 1, IN_W), OUT_W: (0, -1, IN_E), OUT_S: (1, 0, IN_N), OUT_N: (-1, 0, IN_S)}
+
+
+def junction_cfg(turns, storage):
+    # Right-hand traffic: each lane sits 10 degrees off its arm's axis, so
+    # opposing throughs run side by side rather than down one chord
+    bearings = [260, 80, 350, 170, 280, 100, 10, 190]
+    lanes = [{"id": i + 1, "type": 0 if i < 4 else 1, "bearing": b} for i, b in enumerate(bearings)]
+    for lane in lanes[4:]:
+        lane["storage"] = storage
+    per_lane = 3 if turns else 1
+    connections = [{"source_lane_idx": s, "target_lane_idx": t} for s in (IN_W, IN_E, IN_N, IN_S)
+                   for t in TURNS[s][:per_lane]]
+    # Connection order follows the inbound slots: W, E, then N, S. Through
+    # only, opposing approaches share a green; with turns each approach gets
+    # its own, as the controller runs no left turn against oncoming traffic.
+    if turns:
+        masks = [0b111 << 3 * k for k in range(4)]
+    else:
+        masks = [0b0011, 0b1100]
+    phases = [{"active_connections_mask": m, "duration_ms": 20000} for m in masks]
+    return {"name": "grid", "lanes": lanes, "connections": connections, "phases": phases,
+            "default_phase_duration_ms": 20000}
+
+
+class Vehicle:
+    __slots__ = ("entered", "turn", "link")
+
+    def __init__(self, now):
+        self.entered = now
+        self.turn = None  # Exit slot at the junction it is queued at
+        self.link = None  # Link it is counted on
+
+
+class Link:
+    """An exit lane up to the next stop line, or out of the grid."""
+
+    def __init__(self, storage, node=None, lane=None, drain_ms=HEADWAY_MS):
+        self.storage = storage
+        self.node, self.lane = node, lane  # None: leaves the grid
+        self.drain_ms = drain_ms
+        self.occupancy = 0
+        self.driving = collections.deque()  # (arrive_ms, vehicle)
+        self.leaving = collections.deque()  # Boundary links: at the far end
+        self.next_drain = 0
+
+    def full(self):
+        return self.occupancy >= self.storage
+
+
+class Node:
+    """One junction of the bank (controller_loop() without preemption) and its box."""
+
+    def __init__(self, bank, cfg, holding):
+        self.idx = bank.load(cfg, "max_pressure")
+        self.holding = holding
+        self.links = {}  # Exit slot -> Link
+        self.queues = [collections.deque() for _ in range(8)]
+        self.next_free = [0] * 8
+        self.box = None  # (vehicle, link) stuck in the junction
+        self.box_ms = 0
+        self.state = bank.state[self.idx]
+        self.switches = 0
+
+    def sense(self, bank):
+        """What the controller's detectors report: stop-line queues, and with holding its exits."""
+        for lane in (IN_W, IN_E, IN_N, IN_S):
+            bank.set_queue(self.idx, lane, min(len(self.queues[lane]), 255))
+        for slot, link in self.links.items():
+            bank.set_queue(self.idx, slot, min(link.occupancy, 255) if self.holding else 0)
+
+    def observe(self, bank):
+        state = bank.state[self.idx]
+        if state == ufhost.STATE_INTERGREEN and self.state != ufhost.STATE_INTERGREEN:
+            self.switches += 1
+        self.state = state
+
+    def discharge(self, bank, now):
+        """Vehicles crossing the junction this tick on its greens, into their exit links."""
+        if self.box is not None:
+            self.box_ms += TICK_MS
+            vehicle, link = self.box
+            if link.full():
+                return
+            self.box = None
+            enter(link, vehicle, now)
+        for lane in (IN_W, IN_E, IN_N, IN_S):
+            if bank.light(self.idx, lane) != ufhost.LIGHT_GREEN:
+                continue
+            if not self.queues[lane] or self.next_free[lane] > now:
+                continue
+            self.next_free[lane] = now + HEADWAY_MS
+            vehicle = self.queues[lane].popleft()
+            if vehicle.link is not None:
+                vehicle.link.occupancy -= 1
+            link = self.links[vehicle.turn]
+            if link.full():
+                # Green is green: it pulls into the box and waits there
+                self.box = (vehicle, link)
+                return
+            enter(link, vehicle, now)
+
+
+def enter(link, vehicle, now):
+    link.occupancy += 1
+    vehicle.link = link
+    link.driving.append((now + link.travel_ms, vehicle))
+
+
+def join(node, lane, vehicle, rng, turns):
+    r = rng.random()
+    through, left, right = TURNS[lane]
+    if turns[0] >= 1.0:
+        vehicle.turn = through
+        node.queues[lane].append(vehicle)
+        return
+    vehicle.turn = through if r < turns[0] else left if r < turns[0] + turns[1] else right
+    node.queues[lane].append(vehicle)
+
+
+def run(args, holding, seed):
+    with ufhost.Bank(args.rows * args.cols) as bank:
+        return simulate(bank, args, holding, seed)
+
+
+def simulate(bank, args, holding, seed):
+    rng = random.Random(seed)
+    cfg = junction_cfg(args.turn_share > 0, args.storage)
+    turns = (1.0 - 2 * args.turn_share, args.turn_share, args.turn_share)
+    grid = [[Node(bank, cfg, holding) for _ in range(args.cols)] for _ in range(args.rows)]
+    links = []
+    for r in range(args.rows):
+        for c in range(args.cols):
+            for slot, (dr, dc, lane) in NEIGHBOUR.items():
+                rr, cc = r + dr, c + dc
+                if 0 <= rr < args.rows and 0 <= cc < args.cols:
+                    link = Link(args.storage, grid[rr][cc], lane)
+                else:
+                    incident = slot == OUT_E and r == 0
+                    link = Link(args.storage, drain_ms=args.incident_headway_ms if incident else args.exit_headway_ms)
+                link.travel_ms = args.travel_ms
+                grid[r][c].links[slot] = link
+                links.append(link)
+
+    # Approaches from outside the grid: (node, inbound slot)
+    entries = [(grid[r][0], IN_W) for r in range(args.rows)] + [(grid[r][-1], IN_E) for r in range(args.rows)] + \
+              [(grid[0][c], IN_N) for c in range(args.cols)] + [(grid[-1][c], IN_S) for c in range(args.cols)]
+    nodes = [node for row in grid for node in row]
+
+    done = []
+    ticks = args.duration_s * 1000 // TICK_MS
+    for tick in range(ticks):
+        now = tick * TICK_MS
+        for node, lane in entries:
+            if rng.random() < args.rate:
+                join(node, lane, Vehicle(now), rng, turns)
+
+        for node in nodes:
+            node.sense(bank)
+        bank.step(TICK_MS)
+        for node in nodes:
+            node.observe(bank)
+            node.discharge(bank, now)
+
+        for link in links:
+            while link.driving and link.driving[0][0] <= now:
+                _, vehicle = link.driving.popleft()
+                if link.node is None:
+                    link.leaving.append(vehicle)
+                else:
+                    join(link.node, link.lane, vehicle, rng, turns)
+            if link.leaving and link.next_drain <= now:
+                vehicle = link.leaving.popleft()
+                link.occupancy -= 1
+                link.next_drain = now + link.drain_ms
+                done.append((vehicle, now))
+
+    tail = args.duration_s * 1000 * 9 // 10
+    return {
+        "vehicles_out": len(done),
+        "tail_per_min": sum(1 for _, t in done if t >= tail) * 60000.0 / (args.duration_s * 1000 - tail),
+        "travel_s": sum(t - v.entered for v, t in done) / 1000.0 / max(1, len(done)),
+        "box_blocked_pct": 100.0 * sum(n.box_ms for n in nodes) / (len(nodes) * ticks * TICK_MS),
+        "locked_boxes": sum(1 for n in nodes if n.box is not None),
+        "switches_per_h": sum(n.switches for n in nodes) * 3600.0 / args.duration_s / len(nodes),
+    }
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--rows", type=int, default=3)
+    ap.add_argument("--cols", type=int, default=3)
+    ap.add_argument("--storage", type=int, default=10, help="vehicles per link")
+    ap.add_argument("--travel-ms", type=int, default=15000, help="free-flow time along a link")
+    ap.add_argument("--duration-s", type=int, default=3600)
+    ap.add_argument("--rate", type=float, default=0.08, help="arrivals per 500 ms tick on each approach into the grid")
+    ap.add_argument("--turn-share", type=float, default=0.0, help="left and right turns, each")
+    ap.add_argument("--exit-headway-ms", type=int, default=HEADWAY_MS)
+    ap.add_argument("--incident-headway-ms", type=int, default=6000, help="first-row east exits")
+    ap.add_argument("--seeds", type=int, default=3)
+    args = ap.parse_args()
+
+    print("%-10s %10s %10s %9s %10s %8s %9s" % ("", "veh out", "tail/min", "travel_s", "box block", "locked",
+                                              "switch/h"))
+    totals = {}
+    for holding in (False, True):
+        rows = [run(args, holding, seed) for seed in range(args.seeds)]
+        mean = {key: sum(r[key] for r in rows) / len(rows) for key in rows[0]}
+        totals[holding] = mean
+        print("%-10s %10.0f %10.1f %9.1f %9.1f%% %8.1f %9.1f" % (
+            "holding" if holding else "no holding", mean["vehicles_out"], mean["tail_per_min"], mean["travel_s"],
+            mean["box_blocked_pct"], mean["locked_boxes"], mean["switches_per_h"]))
+
+    off, on = totals[False]["vehicles_out"], totals[True]["vehicles_out"]
+    print("vehicles through the grid: %.0f -> %.0f (%+.0f%%)" % (off, on, 100.0 * (on - off) / max(off, 1e-9)))
+    return 0 if on >= off else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
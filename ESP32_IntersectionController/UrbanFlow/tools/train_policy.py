@@ -0,0 +1,281 @@
+#!/usr/bin/env python3
+"""Train an int8 phase-selection policy for one intersection and export it.
+
+Host side of PolicyNet.h. Simulates the junction with the same traffic model
+as simulate_traffic_changes() (arrivals per lane every 500 ms, 50% departure
+chance per green connection, MIN_GREEN_TIME, yellow transitions), trains a
+small MLP with an evolution strategy against average queue length, quantizes
+it and writes the config back with a "policy" block the firmware loads in
+parsePolicy().
+
+infer_int8() is a line-for-line port of policy_infer(): pure integer maths,
+so its decisions are bit-identical to the ESP32.
+
+    python3 train_policy.py intersections.json --name IntersectieComplexa2 -o out.json
+"""
+
+import argparse
+import json
+import random
+
+MIN_GREEN_MS = 5000
+MAX_GREEN_MS = 50000
+YELLOW_MS = 2000
+TICK_MS = 500
+DECISION_MS = 1000
+HIDDEN_SHIFT = 16
+
+
+# --- Intersection ---
+
+def load_intersection(path, name):
+    with open(path) as f:
+        data = json.load(f)
+    if isinstance(data, list):
+        for item in data:
+            if item.get("name") == name:
+                return item
+        raise SystemExit("No intersection named %r in %s" % (name, path))
+    return data
+
+
+class Junction:
+    def __init__(self, cfg):
+        self.cfg = cfg
+        self.lanes = cfg["lanes"]
+        self.lane_cnt = len(self.lanes)
+        self.conns = [(c["source_lane_idx"], c["target_lane_idx"]) for c in cfg["connections"]]
+        self.phases = [p["active_connections_mask"] for p in cfg["phases"]]
+        self.phase_cnt = len(self.phases)
+        self.in_lanes = [i for i, l in enumerate(self.lanes) if l["type"] == 0]
+        self.input_cnt = self.lane_cnt + self.phase_cnt + 1
+        # Connections served per phase, as source lane indices
+        self.phase_sources = [[s for c, (s, _) in enumerate(self.conns) if m >> c & 1] for m in self.phases]
+
+
+# --- Features (policy_build_input) ---
+
+def build_input(j, queue, phase, green_ms, queue_shift):
+    x = [min(q >> queue_shift, 127) for q in queue]
+    x += [127 if p == phase else 0 for p in range(j.phase_cnt)]
+    x.append(min(green_ms // 1000, 127))
+    return x
+
+
+# --- Float network (training) ---
+
+def param_count(j, hidden):
+    return hidden * j.input_cnt + hidden + j.phase_cnt * hidden + j.phase_cnt
+
+
+def unpack(theta, j, hidden):
+    k = 0
+    w1 = []
+    for _ in range(hidden):
+        w1.append(theta[k:k + j.input_cnt])
+        k += j.input_cnt
+    b1 = theta[k:k + hidden]
+    k += hidden
+    w2 = []
+    for _ in range(j.phase_cnt):
+        w2.append(theta[k:k + hidden])
+        k += hidden
+    b2 = theta[k:k + j.phase_cnt]
+    return w1, b1, w2, b2
+
+
+def forward_float(net, x):
+    w1, b1, w2, b2 = net
+    h = [max(0.0, b + sum(w * xi for w, xi in zip(row, x))) for row, b in zip(w1, b1)]
+    logits = [b + sum(w * hi for w, hi in zip(row, h)) for row, b in zip(w2, b2)]
+    return logits, h
+
+
+def argmax(values):
+    best = 0
+    for k in range(1, len(values)):
+        if values[k] > values[best]:
+            best = k
+    return best
+
+
+# --- Int8 network (policy_infer) ---
+
+def clamp(v, lo, hi):
+    return lo if v < lo else hi if v > hi else v
+
+
+def quantize(net, j, calib_inputs):
+    w1, b1, w2, b2 = net
+    s1 = 127.0 / max(1e-9, max(abs(w) for row in w1 for w in row))
+    h_max = max([1e-9] + [max(forward_float(net, x)[1]) for x in calib_inputs])
+    sh = 127.0 / h_max
+    s2 = 127.0 / max(1e-9, max(abs(w) for row in w2 for w in row))
+    return {
+        "queue_shift": 0,
+        "hidden_mult": max(1, int(round(sh / s1 * (1 << HIDDEN_SHIFT)))),
+        "hidden_shift": HIDDEN_SHIFT,
+        "w1": [[clamp(int(round(w * s1)), -127, 127) for w in row] for row in w1],
+        "b1": [int(round(b * s1)) for b in b1],
+        "w2": [[clamp(int(round(w * s2)), -127, 127) for w in row] for row in w2],
+        "b2": [int(round(b * s2 * sh)) for b in b2],
+    }
+
+
+def infer_int8(q, x):
+    shift = q["hidden_shift"]
+    rnd = 1 << (shift - 1)
+    h = []
+    for row, b in zip(q["w1"], q["b1"]):
+        acc = b + sum(w * xi for w, xi in zip(row, x))
+        scaled = (acc * q["hidden_mult"] + rnd) >> shift  # arithmetic shift, like int64 >> on the ESP32
+        h.append(clamp(scaled, 0, 127))
+    best, best_logit = 0, None
+    for k, (row, b) in enumerate(zip(q["w2"], q["b2"])):
+        acc = b + sum(w * hi for w, hi in zip(row, h))
+        if best_logit is None or acc > best_logit:
+            best, best_logit = k, acc
+    return best
+
+
+# --- Simulator (simulate_traffic_changes + controller_loop) ---
+
+def max_pressure(j, queue, phase, green_ms):
+    pressures = [sum(queue[s] for s in srcs) for srcs in j.phase_sources]
+    force = green_ms >= MAX_GREEN_MS
+    best, best_p = phase, -1
+    for p in range(j.phase_cnt):
+        if force and p == phase:
+            continue
+        if pressures[p] > best_p:
+            best, best_p = p, pressures[p]
+    if not force and best_p == pressures[phase]:
+        return phase
+    return best
+
+
+def simulate(j, choose, arrival_prob, duration_s, seed, record=None):
+    rng = random.Random(seed)
+    queue = [0] * j.lane_cnt
+    phase, green_ms, yellow_ms, pending = 0, 0, 0, 0
+    queue_sum, samples, switches = 0, 0, 0
+    since_decision = 0
+
+    for _ in range(duration_s * 1000 // TICK_MS):
+        for i in j.in_lanes:
+            if rng.random() < arrival_prob[i]:
+                queue[i] = min(queue[i] + 1, 255)
+
+        if yellow_ms > 0:
+            yellow_ms -= TICK_MS
+            if yellow_ms <= 0:
+                phase, green_ms = pending, 0
+        else:
+            for s in j.phase_sources[phase]:
+                if queue[s] > 0 and rng.random() < 0.5:
+                    queue[s] -= 1
+            green_ms += TICK_MS
+            since_decision += TICK_MS
+            if since_decision >= DECISION_MS:
+                since_decision = 0
+                if green_ms > MIN_GREEN_MS:
+                    if record is not None:
+                        record.append((list(queue), phase, green_ms))
+                    nxt = choose(queue, phase, green_ms)
+                    if nxt != phase:
+                        pending, yellow_ms = nxt, YELLOW_MS
+                        switches += 1
+
+        queue_sum += sum(queue)
+        samples += 1
+
+    return queue_sum / samples, switches
+
+
+def random_profile(j, rng):
+    return [rng.uniform(0.05, 0.45) if i in j.in_lanes else 0.0 for i in range(j.lane_cnt)]
+
+
+# --- Training ---
+
+def train(j, hidden, generations, population, sigma, lr, episode_s, seed):
+    rng = random.Random(seed)
+    theta = [rng.gauss(0, 0.1) for _ in range(param_count(j, hidden))]
+
+    def fitness(params, gen):
+        net = unpack(params, j, hidden)
+        total = 0.0
+        for e in range(2):
+            prof_rng = random.Random(seed * 1000 + gen * 10 + e)
+            prof = random_profile(j, prof_rng)
+            choose = lambda q, p, g: argmax(forward_float(net, build_input(j, q, p, g, 0))[0])
+            total += simulate(j, choose, prof, episode_s, seed + gen * 10 + e)[0]
+        return -total / 2
+
+    for gen in range(generations):
+        noises, scores = [], []
+        for _ in range(population // 2):
+            eps = [rng.gauss(0, 1) for _ in theta]
+            for sign in (1, -1):
+                cand = [t + sign * sigma * e for t, e in zip(theta, eps)]
+                noises.append([sign * e for e in eps])
+                scores.append(fitness(cand, gen))
+        # Rank-normalized update
+        order = sorted(range(len(scores)), key=lambda k: scores[k])
+        ranks = [0.0] * len(scores)
+        for r, k in enumerate(order):
+            ranks[k] = r / (len(scores) - 1) - 0.5
+        for n in range(len(theta)):
+            theta[n] += lr / (len(scores) * sigma) * sum(ranks[k] * noises[k][n] for k in range(len(scores)))
+        print("gen %3d  best avg queue %.2f" % (gen, -max(scores)))
+
+    return unpack(theta, j, hidden)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("config", help="intersection JSON, or intersections.json with --name")
+    ap.add_argument("--name", help="intersection name inside a list file")
+    ap.add_argument("-o", "--output", required=True, help="config with the policy block added")
+    ap.add_argument("--hidden", type=int, default=16)
+    ap.add_argument("--generations", type=int, default=40)
+    ap.add_argument("--population", type=int, default=16)
+    ap.add_argument("--sigma", type=float, default=0.05)
+    ap.add_argument("--lr", type=float, default=0.03)
+    ap.add_argument("--episode-s", type=int, default=300)
+    ap.add_argument("--seed", type=int, default=1)
+    args = ap.parse_args()
+
+    cfg = load_intersection(args.config, args.name)
+    j = Junction(cfg)
+    if args.hidden > 32 or j.lane_cnt > 64 or j.phase_cnt > 32:
+        raise SystemExit("Exceeds POLICY_MAX_HIDDEN / MAX_LANE_CNT / MAX_PHASE_CNT")
+
+    net = train(j, args.hidden, args.generations, args.population, args.sigma, args.lr, args.episode_s, args.seed)
+
+    # Calibrate the hidden scale on states the float policy actually visits
+    calib = []
+    prof = random_profile(j, random.Random(args.seed))
+    choose_f = lambda q, p, g: argmax(forward_float(net, build_input(j, q, p, g, 0))[0])
+    record = []
+    simulate(j, choose_f, prof, args.episode_s, args.seed, record)
+    calib = [build_input(j, q, p, g, 0) for q, p, g in record] or [[0] * j.input_cnt]
+    q8 = quantize(net, j, calib)
+
+    # Evaluate int8 policy vs Max Pressure on fresh demand
+    eval_rng = random.Random(args.seed + 99)
+    mp_total, pol_total = 0.0, 0.0
+    for e in range(5):
+        prof = random_profile(j, eval_rng)
+        mp_total += simulate(j, lambda q, p, g: max_pressure(j, q, p, g), prof, args.episode_s, 7000 + e)[0]
+        pol_total += simulate(j, lambda q, p, g: infer_int8(q8, build_input(j, q, p, g, 0)), prof, args.episode_s, 7000 + e)[0]
+    print("avg queue  max-pressure %.2f  int8 policy %.2f" % (mp_total / 5, pol_total / 5))
+
+    cfg["policy"] = q8
+    with open(args.output, "w") as f:
+        json.dump(cfg, f, indent=2)
+    print("wrote %s" % args.output)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,171 @@
+"""ctypes binding of libufhost.so, the host build of the controller (host/urbanflow.h).
+
+The benchmarks run the firmware itself through this: controller_loop() with
+its decisions, intergreens and preemption, one junction per layout, stepped
+in batches. The flight replay feeds recorded decisions to the same code. Build the library first:
+
+    make -C ../host
+"""
+
+import ctypes
+import json
+import os
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_LIB = os.path.join(HERE, "..", "host", "libufhost.so")
+
+# --- urbanflow.h ---
+ABI_VERSION = 6
+MAX_LANES = 64
+
+ALGO = {"max_pressure": 0, "lookahead": 1, "learned_policy": 2}
+
+STATE_GREEN, STATE_INTERGREEN, STATE_PEDESTRIAN, STATE_PREEMPT_CLEARANCE, STATE_PREEMPT_HOLD = range(5)
+LIGHT_RED, LIGHT_YELLOW, LIGHT_GREEN, LIGHT_NONE = range(4)
+
+STATUS = {-1: "bad argument", -2: "parse error", -3: "not a junction the controller can run",
+          -4: "bank full", -5: "out of memory"}
+
+
+class Info(ctypes.Structure):
+    _fields_ = [("lane_cnt", ctypes.c_uint32),
+                ("connection_cnt", ctypes.c_uint32),
+                ("phase_cnt", ctypes.c_uint32),
+                ("preempt_bound_ms", ctypes.c_uint32),
+                ("preempt_worst_ms", ctypes.c_uint32),
+                ("lookahead_calls", ctypes.c_uint32),
+                ("lookahead_mean_us", ctypes.c_uint32),
+                ("lookahead_worst_us", ctypes.c_uint32),
+                ("lookahead_worst_nodes", ctypes.c_uint32),
+                ("wave_messages_sent", ctypes.c_uint32),
+                ("wave_messages_received", ctypes.c_uint32),
+                ("wave_platoons_predicted", ctypes.c_uint32)]
+
+
+class UrbanFlowError(Exception):
+    pass
+
+
+def load_library(path=None):
+    path = path or os.environ.get("UFHOST_LIB", DEFAULT_LIB)
+    if not os.path.exists(path):
+        raise UrbanFlowError("%s not found: build it with `make -C %s`" % (path, os.path.dirname(path)))
+    lib = ctypes.CDLL(path)
+
+    bank, u32, i32, size = ctypes.c_void_p, ctypes.c_uint32, ctypes.c_int32, ctypes.c_size_t
+    u8p, u16p = ctypes.POINTER(ctypes.c_uint8), ctypes.POINTER(ctypes.c_uint16)
+    signatures = {
+        "urbanflow_abi_version": (u32, []),
+        "urbanflow_bank_create": (bank, [u32]),
+        "urbanflow_bank_destroy": (None, [bank]),
+        "urbanflow_count": (u32, [bank]),
+        "urbanflow_load_json": (i32, [bank, ctypes.c_char_p, size, i32]),
+        "urbanflow_info": (i32, [bank, u32, ctypes.POINTER(Info)]),
+        "urbanflow_push_sensors": (i32, [bank, u32, u32, u16p, u32]),
+        "urbanflow_push_calls": (i32, [bank, u32, u32, ctypes.POINTER(ctypes.c_uint64), ctypes.POINTER(ctypes.c_int16)]),
+        "urbanflow_step": (i32, [bank, u32, u32, u32]),
+        "urbanflow_read_phases": (i32, [bank, u32, u32, u8p, u8p, u8p]),
+        "urbanflow_read_lights": (i32, [bank, u32, u32, u8p, u32]),
+        "urbanflow_replay_decision": (i32, [bank, u32, ctypes.c_char_p, size, u8p, u8p, u8p]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        fn = getattr(lib, name)
+        fn.restype, fn.argtypes = restype, argtypes
+
+    if lib.urbanflow_abi_version() != ABI_VERSION:
+        raise UrbanFlowError("%s has ABI %d, expected %d" % (path, lib.urbanflow_abi_version(), ABI_VERSION))
+    return lib
+
+
+def check(status):
+    if status < 0:
+        raise UrbanFlowError(STATUS.get(status, "status %d" % status))
+    return status
+
+
+class Bank:
+    """A bank of junctions and the arrays every batched call reads or fills.
+
+    After step(), phase/pending/state hold one entry per junction and lights
+    one MAX_LANES row per junction (UrbanFlowLight per lane slot)."""
+
+    def __init__(self, capacity, lib=None):
+        self.lib = lib or load_library()
+        self.handle = self.lib.urbanflow_bank_create(capacity)
+        if not self.handle:
+            raise UrbanFlowError("out of memory for %d junctions" % capacity)
+        self.capacity = capacity
+        self.queues = (ctypes.c_uint16 * (capacity * MAX_LANES))()
+        self.crossings = (ctypes.c_uint64 * capacity)()
+        self.preempt = (ctypes.c_int16 * capacity)(*([-1] * capacity))
+        self.phase = (ctypes.c_uint8 * capacity)()
+        self.pending = (ctypes.c_uint8 * capacity)()
+        self.state = (ctypes.c_uint8 * capacity)()
+        self.lights = (ctypes.c_uint8 * (capacity * MAX_LANES))()
+
+    def close(self):
+        if self.handle:
+            self.lib.urbanflow_bank_destroy(self.handle)
+            self.handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __len__(self):
+        return self.lib.urbanflow_count(self.handle)
+
+    def load(self, cfg, algorithm):
+        """Appends one layout (a dict as in intersections.json) and returns its index."""
+        text = json.dumps(cfg).encode()
+        idx = check(self.lib.urbanflow_load_json(self.handle, text, len(text), ALGO[algorithm]))
+        self.read(idx, 1)
+        return idx
+
+    def info(self, idx):
+        info = Info()
+        check(self.lib.urbanflow_info(self.handle, idx, ctypes.byref(info)))
+        return info
+
+    def set_queue(self, idx, lane, queue):
+        self.queues[idx * MAX_LANES + lane] = queue
+
+    def light(self, idx, lane):
+        return self.lights[idx * MAX_LANES + lane]
+
+    def step(self, dt_ms, first=0, n=None):
+        """Pushes queues and calls, runs one pass of every junction, reads the outputs.
+        Calls are cleared once pushed; repeat a preemption call every step it lasts."""
+        n = len(self) - first if n is None else n
+        lib, h = self.lib, self.handle
+        check(lib.urbanflow_push_sensors(h, first, n, self.row(self.queues, first, ctypes.c_uint16), MAX_LANES))
+        check(lib.urbanflow_push_calls(h, first, n, self.at(self.crossings, first, ctypes.c_uint64),
+                                       self.at(self.preempt, first, ctypes.c_int16)))
+        for k in range(first, first + n):
+            self.crossings[k], self.preempt[k] = 0, -1
+        check(lib.urbanflow_step(h, first, n, dt_ms))
+        self.read(first, n)
+
+    def read(self, first, n):
+        lib, h = self.lib, self.handle
+        check(lib.urbanflow_read_phases(h, first, n, self.at(self.phase, first, ctypes.c_uint8),
+                                        self.at(self.pending, first, ctypes.c_uint8),
+                                        self.at(self.state, first, ctypes.c_uint8)))
+        check(lib.urbanflow_read_lights(h, first, n, self.row(self.lights, first, ctypes.c_uint8), MAX_LANES))
+
+    def replay_decision(self, idx, payload):
+        """Re-runs a REC_DECISION payload on junction idx: (chosen, reason, exclusive walk)."""
+        chosen, reason, exclusive = ctypes.c_uint8(), ctypes.c_uint8(), ctypes.c_uint8()
+        check(self.lib.urbanflow_replay_decision(self.handle, idx, bytes(payload), len(payload), ctypes.byref(chosen),
+                                                 ctypes.byref(reason), ctypes.byref(exclusive)))
+        return chosen.value, reason.value, bool(exclusive.value)
+
+    @staticmethod
+    def at(array, k, ctype):
+        return ctypes.cast(ctypes.byref(array, k * ctypes.sizeof(ctype)), ctypes.POINTER(ctype))
+
+    @staticmethod
+    def row(array, k, ctype):
+        return Bank.at(array, k * MAX_LANES, ctype)